@@ -0,0 +1,279 @@
+/*
+ * SafeNeck – batch kernels over accelerometer samples
+ * ===================================================
+ * The BNO085 hands over a packet of samples at a time, so the per-sample
+ * arithmetic can run over the whole batch in one pass with the
+ * processor's SIMD instructions:
+ *
+ *   accelMagSqBatch     x² + y² + z² of raw int16 axes          (uint32)
+ *   accelFirstOutside   first |a|² outside [lo, hi], or n
+ *   accelWindowStats    Σv, Σv², max v of int16 values (n ≤ 32768)
+ *
+ * Samples are packed as AccelXyz, four int16 with a zero pad, so one
+ * 32-bit word holds (x, y) and the next (z, 0):
+ *
+ *   Cortex-M4 (__ARM_FEATURE_DSP)   SMUAD/SMLAD: one sample per two MACs,
+ *                                   SMLAD/SMLALD/SSUB16+SEL for the stats
+ *   x86 SSE2                        PMADDWD, 2 samples per register
+ *   x86 AVX2                        VPMADDWD, 4 samples per register
+ *   anything else                   the scalar loops below
+ *
+ * The un-suffixed functions use the best variant compiled in; every
+ * variant stays callable by namespace for host/kernelbench.  Threshold
+ * crossing has no M4 SIMD form (the M4 packs 8/16-bit lanes only), so
+ * the device runs the scalar loop there.  Results are bit-identical.
+ *
+ *   AccelXyz s[32];  uint32_t m[32];
+ *   accelMagSqBatch(s, m, n);
+ *   size_t i = accelFirstOutside(m, n, STILL_LO_SQ, STILL_HI_SQ);
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__ARM_FEATURE_DSP)
+#include <arm_acle.h>
+#define ACCEL_BATCH_M4 1
+#elif defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define ACCEL_BATCH_X86 1
+#endif
+
+struct alignas(8) AccelXyz {
+    int16_t x, y, z;
+    int16_t pad;               /* must be 0 */
+};
+
+struct AccelStats {
+    int32_t sum   = 0;
+    int64_t sumSq = 0;
+    int16_t peak  = INT16_MIN;
+};
+
+namespace accel_batch {
+
+/* ── Portable reference ────────────────────────────────────────────── */
+namespace scalar {
+
+inline void magSq(const AccelXyz *s, uint32_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        out[i] = (uint32_t)((int32_t)s[i].x * s[i].x) + (uint32_t)((int32_t)s[i].y * s[i].y) +
+                 (uint32_t)((int32_t)s[i].z * s[i].z);
+}
+
+inline size_t firstOutside(const uint32_t *m, size_t n, uint32_t lo, uint32_t hi) {
+    for (size_t i = 0; i < n; i++)
+        if (m[i] < lo || m[i] > hi) return i;
+    return n;
+}
+
+inline AccelStats windowStats(const int16_t *v, size_t n) {
+    AccelStats st;
+    for (size_t i = 0; i < n; i++) {
+        st.sum += v[i];
+        st.sumSq += (int32_t)v[i] * v[i];
+        if (v[i] > st.peak) st.peak = v[i];
+    }
+    return st;
+}
+
+}  // namespace scalar
+
+#if ACCEL_BATCH_M4
+/* ── Cortex-M4 DSP extension ───────────────────────────────────────── */
+namespace m4 {
+
+inline int32_t word(const void *p) {
+    int32_t w;
+    memcpy(&w, p, 4);          /* one LDR */
+    return w;
+}
+
+inline void magSq(const AccelXyz *s, uint32_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        int32_t xy = word(&s[i].x), z0 = word(&s[i].z);
+        /* x² + y² + z² + 0²; the sum wraps exactly as the uint32 one. */
+        out[i] = (uint32_t)__smlad(z0, z0, __smuad(xy, xy));
+    }
+}
+
+inline size_t firstOutside(const uint32_t *m, size_t n, uint32_t lo, uint32_t hi) {
+    return scalar::firstOutside(m, n, lo, hi);
+}
+
+inline AccelStats windowStats(const int16_t *v, size_t n) {
+    AccelStats st;
+    int32_t sum = 0;
+    int64_t sumSq = 0;
+    int32_t peak = (int32_t)0x80008000;          /* INT16_MIN in both halves */
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        int32_t w = word(v + i);
+        sum   = __smlad(w, 0x00010001, sum);
+        sumSq = __smlald(w, w, sumSq);
+        __ssub16(w, peak);                       /* GE per half: w ≥ peak */
+        peak  = __sel(w, peak);
+    }
+    int16_t lo = (int16_t)peak, hi = (int16_t)(peak >> 16);
+    st.sum = sum;
+    st.sumSq = sumSq;
+    st.peak = lo > hi ? lo : hi;
+    for (; i < n; i++) {
+        st.sum += v[i];
+        st.sumSq += (int32_t)v[i] * v[i];
+        if (v[i] > st.peak) st.peak = v[i];
+    }
+    return st;
+}
+
+}  // namespace m4
+#endif
+
+#if ACCEL_BATCH_X86
+/* ── x86 SSE2 (every x86-64) ───────────────────────────────────────── */
+namespace sse2 {
+
+/* (x²+y², z²) per sample → x²+y²+z², four samples. */
+inline __m128i fold4(__m128i a, __m128i b) {
+    __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 odd  = _mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1));
+    return _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+}
+
+inline void magSq(const AccelXyz *s, uint32_t *out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(s + i + 2));
+        _mm_storeu_si128((__m128i *)(out + i), fold4(_mm_madd_epi16(a, a), _mm_madd_epi16(b, b)));
+    }
+    scalar::magSq(s + i, out + i, n - i);
+}
+
+inline size_t firstOutside(const uint32_t *m, size_t n, uint32_t lo, uint32_t hi) {
+    /* No unsigned compare: flip the sign bit and compare signed. */
+    const __m128i bias = _mm_set1_epi32((int32_t)0x80000000);
+    const __m128i vlo = _mm_set1_epi32((int32_t)(lo ^ 0x80000000u));
+    const __m128i vhi = _mm_set1_epi32((int32_t)(hi ^ 0x80000000u));
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(m + i)), bias);
+        __m128i out = _mm_or_si128(_mm_cmplt_epi32(v, vlo), _mm_cmpgt_epi32(v, vhi));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(out));
+        if (mask) return i + (size_t)__builtin_ctz((unsigned)mask);
+    }
+    return i + scalar::firstOutside(m + i, n - i, lo, hi);
+}
+
+inline AccelStats windowStats(const int16_t *v, size_t n) {
+    const __m128i ones = _mm_set1_epi16(1), zero = _mm_setzero_si128();
+    __m128i sum = zero, sumSq = zero, peak = _mm_set1_epi16(INT16_MIN);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(v + i));
+        sum  = _mm_add_epi32(sum, _mm_madd_epi16(x, ones));
+        __m128i sq = _mm_madd_epi16(x, x);       /* ≤ 2^31: zero-extend, not sign */
+        sumSq = _mm_add_epi64(sumSq, _mm_add_epi64(_mm_unpacklo_epi32(sq, zero),
+                                                   _mm_unpackhi_epi32(sq, zero)));
+        peak = _mm_max_epi16(peak, x);
+    }
+    alignas(16) int32_t s4[4];
+    alignas(16) int64_t q2[2];
+    alignas(16) int16_t p8[8];
+    _mm_store_si128((__m128i *)s4, sum);
+    _mm_store_si128((__m128i *)q2, sumSq);
+    _mm_store_si128((__m128i *)p8, peak);
+    AccelStats st = scalar::windowStats(v + i, n - i);
+    st.sum += s4[0] + s4[1] + s4[2] + s4[3];
+    st.sumSq += q2[0] + q2[1];
+    for (int16_t p : p8) if (p > st.peak) st.peak = p;
+    return st;
+}
+
+}  // namespace sse2
+
+/* ── x86 AVX2, for host-side evaluation (check the CPU first) ──────── */
+namespace avx2 {
+
+__attribute__((target("avx2")))
+inline void magSq(const AccelXyz *s, uint32_t *out, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(s + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(s + i + 4));
+        /* hadd works per 128-bit lane: samples come out 0 1 4 5 | 2 3 6 7. */
+        __m256i h = _mm256_hadd_epi32(_mm256_madd_epi16(a, a), _mm256_madd_epi16(b, b));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_permute4x64_epi64(h, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    scalar::magSq(s + i, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+inline size_t firstOutside(const uint32_t *m, size_t n, uint32_t lo, uint32_t hi) {
+    const __m256i bias = _mm256_set1_epi32((int32_t)0x80000000);
+    const __m256i vlo = _mm256_set1_epi32((int32_t)(lo ^ 0x80000000u));
+    const __m256i vhi = _mm256_set1_epi32((int32_t)(hi ^ 0x80000000u));
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(m + i)), bias);
+        __m256i out = _mm256_or_si256(_mm256_cmpgt_epi32(vlo, v), _mm256_cmpgt_epi32(v, vhi));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(out));
+        if (mask) return i + (size_t)__builtin_ctz((unsigned)mask);
+    }
+    return i + scalar::firstOutside(m + i, n - i, lo, hi);
+}
+
+__attribute__((target("avx2")))
+inline AccelStats windowStats(const int16_t *v, size_t n) {
+    const __m256i ones = _mm256_set1_epi16(1), zero = _mm256_setzero_si256();
+    __m256i sum = zero, sumSq = zero, peak = _mm256_set1_epi16(INT16_MIN);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(v + i));
+        sum  = _mm256_add_epi32(sum, _mm256_madd_epi16(x, ones));
+        __m256i sq = _mm256_madd_epi16(x, x);
+        sumSq = _mm256_add_epi64(sumSq, _mm256_add_epi64(_mm256_unpacklo_epi32(sq, zero),
+                                                         _mm256_unpackhi_epi32(sq, zero)));
+        peak = _mm256_max_epi16(peak, x);
+    }
+    alignas(32) int32_t s8[8];
+    alignas(32) int64_t q4[4];
+    alignas(32) int16_t p16[16];
+    _mm256_store_si256((__m256i *)s8, sum);
+    _mm256_store_si256((__m256i *)q4, sumSq);
+    _mm256_store_si256((__m256i *)p16, peak);
+    AccelStats st = scalar::windowStats(v + i, n - i);
+    for (int32_t s : s8) st.sum += s;
+    for (int64_t q : q4) st.sumSq += q;
+    for (int16_t p : p16) if (p > st.peak) st.peak = p;
+    return st;
+}
+
+}  // namespace avx2
+#endif
+
+#if ACCEL_BATCH_M4
+namespace best = m4;
+#elif ACCEL_BATCH_X86 && defined(__AVX2__)
+namespace best = avx2;
+#elif ACCEL_BATCH_X86
+namespace best = sse2;
+#else
+namespace best = scalar;
+#endif
+
+}  // namespace accel_batch
+
+inline void accelMagSqBatch(const AccelXyz *s, uint32_t *out, size_t n) {
+    accel_batch::best::magSq(s, out, n);
+}
+
+inline size_t accelFirstOutside(const uint32_t *magSq, size_t n, uint32_t lo, uint32_t hi) {
+    return accel_batch::best::firstOutside(magSq, n, lo, hi);
+}
+
+inline AccelStats accelWindowStats(const int16_t *v, size_t n) {
+    return accel_batch::best::windowStats(v, n);
+}
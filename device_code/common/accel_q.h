@@ -0,0 +1,45 @@
+/*
+ * SafeNeck – integer-domain acceleration magnitude
+ * ================================================
+ * The BNO085 reports acceleration as signed Q-format m/s² (Q8 for the
+ * accelerometer and linear acceleration reports).  Threshold tests only
+ * need |a| compared with a constant, so both sides are squared and kept
+ * in raw units: one multiply-add per axis per sample, no sqrt, no divide,
+ * no float.  Thresholds are converted at compile time.
+ *
+ *   constexpr uint32_t IMPACT_SQ = accelRawSq(2.5, 8);
+ *   if (accelMagSq(x, y, z) > IMPACT_SQ) ...
+ *   log(accelRawSqToG(magSq, 8));          // floats only for output
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+constexpr double ACCEL_G_MS2 = 9.81;     /* the firmwares' g, as before */
+
+/* (g · 9.81 · 2^q)², rounded: the squared raw magnitude at `g`. */
+constexpr uint32_t accelRawSq(double g, uint8_t qPoint) {
+    return (uint32_t)(g * ACCEL_G_MS2 * (1u << qPoint) * g * ACCEL_G_MS2 * (1u << qPoint) + 0.5);
+}
+
+/* x² + y² + z² of raw int16 axes: at most 3 · 2^30, fits in 32 bits. */
+inline uint32_t accelMagSq(int16_t x, int16_t y, int16_t z) {
+    return (uint32_t)((int32_t)x * x) + (uint32_t)((int32_t)y * y) + (uint32_t)((int32_t)z * z);
+}
+
+/* floor(√v), bit by bit: no float, no divide. */
+inline uint32_t isqrt32(uint32_t v) {
+    uint32_t r = 0, bit = 1UL << 30;
+    while (bit > v) bit >>= 2;
+    while (bit) {
+        if (v >= r + bit) { v -= r + bit; r = (r >> 1) + bit; }
+        else              { r >>= 1; }
+        bit >>= 2;
+    }
+    return r;
+}
+
+inline float accelRawSqToG(uint32_t magSq, uint8_t qPoint) {
+    return sqrtf((float)magSq) / (float)(1u << qPoint) / (float)ACCEL_G_MS2;
+}
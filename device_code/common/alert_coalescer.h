@@ -0,0 +1,140 @@
+/*
+ * SafeNeck – fold repeated detections into one alert
+ * ==================================================
+ * A cooldown after each alert throws away whatever is detected inside
+ * it, including a second, harder fall.  Instead, every detection within
+ * windowMs of the previous one is folded into the open alert: detection
+ * count, peak g, worst kind and the time from first to last.  The open
+ * alert is only sent again when its severity goes up:
+ *
+ *   severity = kind rank (impact < fall) · 8 + min(peak g / band, 7)
+ *
+ * When the window closes after detections that were folded without
+ * being sent, one final update carries the totals.  A burst of
+ * detections therefore costs at most one publish per severity step plus
+ * one, and nothing detected is lost.
+ *
+ *   AlertCoalescer alerts(60000, 2000);           // 60 s window, 2 g bands
+ *   if (alerts.add(ms, ALERT_FALL, gMilli) == AlertCoalescer::SEND) publish(alerts.current());
+ *   if (alerts.expire(millis())) publish(alerts.current());     // every pass
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+
+#include "event_codec.h"   /* AlertKind, Event */
+
+struct CoalescedAlert {
+    AlertKind kind     = ALERT_IMPACT;   /* worst so far                 */
+    uint16_t  peakMilli = 0;
+    uint16_t  count    = 0;              /* detections folded in         */
+    uint32_t  firstMs  = 0, lastMs = 0;
+    uint8_t   update   = 0;              /* 0 = first report, then 1, 2… */
+    uint8_t   severity = 0;
+
+    uint16_t spanS() const { return (uint16_t)((lastMs - firstMs) / 1000); }
+
+    /* The coalescing fields of an ALERT event. */
+    void fill(Event &e) const {
+        e.alertKind   = kind;
+        e.gMilli      = peakMilli;
+        e.alertCount  = count;
+        e.alertSpanS  = spanS();
+        e.alertUpdate = update;
+    }
+};
+
+class AlertCoalescer {
+public:
+    enum Action : uint8_t { FOLDED, SEND };
+
+    struct Stats {
+        uint32_t alerts     = 0;   /* windows opened                    */
+        uint32_t detections = 0;
+        uint32_t updates    = 0;   /* sends after the first, per window */
+        uint32_t folded     = 0;   /* detections that sent nothing      */
+    };
+
+    AlertCoalescer(uint32_t windowMs, uint16_t bandMilli)
+        : windowMs_(windowMs), bandMilli_(bandMilli ? bandMilli : 1) {}
+
+    /* One detection.  SEND: publish current() now (a new alert or a
+     * severity step); FOLDED: counted into the open alert only. */
+    Action add(uint32_t ms, AlertKind kind, uint16_t gMilli) {
+        stats_.detections++;
+        if (!open_ || ms - a_.lastMs > windowMs_) {
+            a_ = CoalescedAlert();
+            a_.kind = kind;
+            a_.peakMilli = gMilli;
+            a_.count = 1;
+            a_.firstMs = a_.lastMs = ms;
+            a_.severity = severityOf(kind, gMilli);
+            open_ = true;
+            sentCount_ = 1;
+            stats_.alerts++;
+            return SEND;
+        }
+        if (kind == ALERT_FALL) a_.kind = ALERT_FALL;
+        if (gMilli > a_.peakMilli) a_.peakMilli = gMilli;
+        if (a_.count < 0xFFFF) a_.count++;
+        a_.lastMs = ms;
+        uint8_t sev = severityOf(a_.kind, a_.peakMilli);
+        if (sev == a_.severity) {
+            stats_.folded++;
+            return FOLDED;
+        }
+        a_.severity = sev;
+        return resend();
+    }
+
+    /* Closes the window once it has passed; true when detections were
+     * folded since the last send, and current() is the final update. */
+    bool expire(uint32_t ms) {
+        if (!open_ || ms - a_.lastMs <= windowMs_) return false;
+        open_ = false;
+        if (a_.count == sentCount_) return false;
+        resend();
+        return true;
+    }
+
+    /* Reopens an alert carried across a reset (boot_state.h): `a` as it
+     * was last sent, its last detection `ageMs` before `ms`.  True when
+     * it is still inside its window; current() is then its next update,
+     * to be sent again since what was queued before the reset may never
+     * have left, and detections from here on fold into it. */
+    bool resume(const CoalescedAlert &a, uint32_t ms, uint32_t ageMs) {
+        if (ageMs > windowMs_) return false;
+        uint32_t spanMs = a.lastMs - a.firstMs;
+        a_ = a;
+        a_.lastMs   = ms - ageMs;
+        a_.firstMs  = a_.lastMs - spanMs;
+        a_.severity = severityOf(a_.kind, a_.peakMilli);
+        open_ = true;
+        resend();
+        return true;
+    }
+
+    bool                  open()    const { return open_; }
+    const CoalescedAlert &current() const { return a_; }
+    const Stats          &stats()   const { return stats_; }
+
+private:
+    uint8_t severityOf(AlertKind kind, uint16_t gMilli) const {
+        uint16_t band = gMilli / bandMilli_;
+        return (uint8_t)((kind == ALERT_FALL ? 8 : 0) + (band < 7 ? band : 7));
+    }
+
+    Action resend() {
+        if (a_.update < 0xFF) a_.update++;
+        sentCount_ = a_.count;
+        stats_.updates++;
+        return SEND;
+    }
+
+    uint32_t       windowMs_;
+    uint16_t       bandMilli_;
+    bool           open_ = false;
+    uint16_t       sentCount_ = 0;
+    CoalescedAlert a_;
+    Stats          stats_;
+};
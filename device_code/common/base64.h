@@ -0,0 +1,66 @@
+/*
+ * SafeNeck – base64 for binary publish payloads
+ * =============================================
+ * Particle event data must be text.  RFC 4648 alphabet without padding:
+ * the decoder works out the tail from the length.  4 characters carry
+ * 3 bytes, so a 622-character event holds 466 bytes of binary.
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+inline size_t base64Len(size_t bytes) { return (bytes * 4 + 2) / 3; }
+
+/* Writes base64Len(n) characters plus a NUL; returns the length, or 0 if
+ * `cap` is too small. */
+inline size_t base64Encode(char *out, size_t cap, const uint8_t *in, size_t n) {
+    static const char A[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t len = base64Len(n);
+    if (len + 1 > cap) return 0;
+    char *o = out;
+    size_t i = 0;
+    for (; i + 3 <= n; i += 3) {
+        uint32_t w = (uint32_t)in[i] << 16 | (uint32_t)in[i + 1] << 8 | in[i + 2];
+        *o++ = A[w >> 18];
+        *o++ = A[(w >> 12) & 63];
+        *o++ = A[(w >> 6) & 63];
+        *o++ = A[w & 63];
+    }
+    if (i < n) {
+        uint32_t w = (uint32_t)in[i] << 16 | (i + 1 < n ? (uint32_t)in[i + 1] << 8 : 0);
+        *o++ = A[w >> 18];
+        *o++ = A[(w >> 12) & 63];
+        if (i + 1 < n) *o++ = A[(w >> 6) & 63];
+    }
+    *o = '\0';
+    return len;
+}
+
+/* Decodes `len` characters (trailing '=' tolerated); returns the byte
+ * count, or -1 on a bad character or a too-small `cap`. */
+inline int base64Decode(uint8_t *out, size_t cap, const char *in, size_t len) {
+    while (len && in[len - 1] == '=') len--;
+    if (len % 4 == 1 || len * 3 / 4 > cap) return -1;
+    size_t n = 0;
+    uint32_t w = 0;
+    uint8_t  bits = 0;
+    for (size_t i = 0; i < len; i++) {
+        char c = in[i];
+        uint32_t v;
+        if (c >= 'A' && c <= 'Z')      v = (uint32_t)(c - 'A');
+        else if (c >= 'a' && c <= 'z') v = (uint32_t)(c - 'a' + 26);
+        else if (c >= '0' && c <= '9') v = (uint32_t)(c - '0' + 52);
+        else if (c == '+')             v = 62;
+        else if (c == '/')             v = 63;
+        else return -1;
+        w = w << 6 | v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out[n++] = (uint8_t)(w >> bits);
+        }
+    }
+    return (int)n;
+}
@@ -0,0 +1,69 @@
+/*
+ * SafeNeck – base85 (Z85 alphabet) for binary publish payloads
+ * ============================================================
+ * 5 characters carry 4 bytes, against base64's 4 for 3.  The Z85
+ * alphabet has no quote, backslash or comma, so the text drops straight
+ * into a JSON string or a webhook template.  Unlike strict Z85 the input
+ * need not be a multiple of 4 bytes: a final group of k bytes is written
+ * as k + 1 characters (the Ascii85 rule) and the decoder pads it back.
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+inline size_t base85Len(size_t bytes) { return bytes / 4 * 5 + (bytes % 4 ? bytes % 4 + 1 : 0); }
+
+/* Writes base85Len(n) characters plus a NUL; returns the length, or 0 if
+ * `cap` is too small. */
+inline size_t base85Encode(char *out, size_t cap, const uint8_t *in, size_t n) {
+    static const char A[] =
+        "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ.-:+=^!/*?&<>()[]{}@%$#";
+    size_t len = base85Len(n);
+    if (len + 1 > cap) return 0;
+    char *o = out;
+    for (size_t i = 0; i < n; i += 4) {
+        size_t k = n - i < 4 ? n - i : 4;
+        uint32_t w = 0;
+        for (size_t j = 0; j < 4; j++) w = w << 8 | (j < k ? in[i + j] : 0);
+        char g[5];
+        for (int j = 4; j >= 0; j--) { g[j] = A[w % 85]; w /= 85; }
+        for (size_t j = 0; j < k + 1; j++) *o++ = g[j];
+    }
+    *o = '\0';
+    return len;
+}
+
+inline int base85Value(uint8_t c) {
+    static const char PUNCT[] = ".-:+=^!/*?&<>()[]{}@%$#";
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'Z') return c - 'A' + 36;
+    for (int i = 0; PUNCT[i]; i++)
+        if (PUNCT[i] == c) return 62 + i;
+    return -1;
+}
+
+/* Decodes `len` characters; returns the byte count, or -1 on a bad
+ * character, a 1-character tail or a too-small `cap`. */
+inline int base85Decode(uint8_t *out, size_t cap, const char *in, size_t len) {
+    if (len % 5 == 1) return -1;
+    size_t n = len / 5 * 4 + (len % 5 ? len % 5 - 1 : 0);
+    if (n > cap) return -1;
+    uint8_t *o = out;
+    for (size_t i = 0; i < len; i += 5) {
+        size_t k = len - i < 5 ? len - i : 5;
+        uint64_t w = 0;
+        for (size_t j = 0; j < 5; j++) {
+            int v = 84;                           /* pad with the top digit */
+            if (j < k) {
+                v = base85Value((uint8_t)in[i + j]);
+                if (v < 0) return -1;
+            }
+            w = w * 85 + (uint32_t)v;
+        }
+        if (w > 0xFFFFFFFFull && k == 5) return -1;
+        for (size_t j = 0; j < k - 1; j++) *o++ = (uint8_t)(w >> (24 - 8 * j));
+    }
+    return (int)n;
+}
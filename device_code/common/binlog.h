@@ -0,0 +1,188 @@
+/*
+ * SafeNeck – deferred binary log
+ * ==============================
+ * Serial.printlnf() on the detection path formats floats and blocks on
+ * the USB CDC buffer right when timing matters.  Here a call site only
+ * stores a catalog ID (common/log_catalog.h), the time and its raw
+ * arguments as 32-bit words in a fixed ring: a handful of stores, no
+ * formatting, no Serial, no heap.  The text is made later:
+ *
+ *   • drain() in idle time formats records to Serial from the catalog,
+ *   • or, with raw set, writes each record as "@<base64>" and leaves the
+ *     formatting to host/logdecode, built from the same catalog.
+ *
+ * Record: one header word (ID | argument count << 8), millis(), then one
+ * word per argument: integers as their low 32 bits, floats and doubles
+ * as float bits.  A full ring drops the new record and counts it; the
+ * count is reported with the next drain.  One thread logs and drains.
+ *
+ *   BinLog<256> binlog;                                   // 1 KB
+ *   binlog.log(LOG_FALL_DETECTED, peakG);                 // hot path
+ *   binlog.drain(Serial, 8, false);                       // idle time
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <type_traits>
+
+#include "Particle.h"
+#include "base64.h"
+#include "log_catalog.h"
+
+static const uint8_t BINLOG_MAX_ARGS = 8;
+static const size_t  BINLOG_MAX_WORDS = 2 + BINLOG_MAX_ARGS;   /* header, ms, args */
+static const size_t  BINLOG_LINE_MAX = 192;
+
+/* One argument as a word: the low 32 bits of an integer, or float bits. */
+template <typename T>
+inline typename std::enable_if<std::is_floating_point<T>::value, uint32_t>::type
+binlogWord(T v) {
+    float f = (float)v;
+    uint32_t w;
+    memcpy(&w, &f, sizeof(w));
+    return w;
+}
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, uint32_t>::type
+binlogWord(T v) {
+    return (uint32_t)v;
+}
+
+/* Formats one record (its argument words) from the catalog: printf
+ * semantics per conversion, each argument taken as the conversion says.
+ * Returns the length; missing arguments print as '?'. */
+inline size_t binlogFormat(uint8_t id, const uint32_t *args, uint8_t n, char *out, size_t cap) {
+    if (!cap) return 0;
+    if (id >= LOG_ID_COUNT) return (size_t)snprintf(out, cap, "[log] unknown format %u", id);
+    const char *f = LOG_FORMATS[id];
+    size_t len = 0;
+    uint8_t used = 0;
+    auto put = [&](int wrote) {
+        if (wrote > 0) len += (size_t)wrote < cap - len ? (size_t)wrote : cap - len - 1;
+    };
+    while (*f && len + 1 < cap) {
+        if (*f != '%') { out[len++] = *f++; continue; }
+        if (f[1] == '%') { out[len++] = '%'; f += 2; continue; }
+
+        /* "%-08.2" … up to the conversion; length modifiers are dropped
+         * and the word is passed as long / double instead. */
+        char spec[16];
+        size_t s = 0;
+        spec[s++] = *f++;
+        while (*f && strchr("-+ #0123456789.", *f) && s < sizeof(spec) - 3) spec[s++] = *f++;
+        while (*f && strchr("hlLjzt", *f)) f++;
+        char conv = *f ? *f++ : 'd';
+        if (used >= n) { out[len++] = '?'; continue; }
+        uint32_t w = args[used++];
+        switch (conv) {
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': {
+            float v;
+            memcpy(&v, &w, sizeof(v));
+            spec[s++] = conv; spec[s] = '\0';
+            put(snprintf(out + len, cap - len, spec, (double)v));
+            break;
+        }
+        case 'd': case 'i':
+            spec[s++] = 'l'; spec[s++] = conv; spec[s] = '\0';
+            put(snprintf(out + len, cap - len, spec, (long)(int32_t)w));
+            break;
+        case 'c':
+            spec[s++] = 'c'; spec[s] = '\0';
+            put(snprintf(out + len, cap - len, spec, (int)(char)w));
+            break;
+        default:   /* u o x X */
+            spec[s++] = 'l'; spec[s++] = conv; spec[s] = '\0';
+            put(snprintf(out + len, cap - len, spec, (unsigned long)w));
+            break;
+        }
+    }
+    out[len] = '\0';
+    return len;
+}
+
+template <size_t WORDS>
+class BinLog {
+    static_assert((WORDS & (WORDS - 1)) == 0, "WORDS must be a power of two");
+    static_assert(WORDS >= BINLOG_MAX_WORDS, "ring too small for one record");
+
+public:
+    struct Stats {
+        uint32_t records   = 0;
+        uint32_t dropped   = 0;   /* ring full                     */
+        uint32_t drained   = 0;
+        uint32_t highWater = 0;   /* words queued, at most         */
+    };
+
+    template <typename... A>
+    void log(LogId id, A... args) {
+        static_assert(sizeof...(A) <= BINLOG_MAX_ARGS, "too many log arguments");
+        const uint32_t words[] = { (uint32_t)id | (uint32_t)sizeof...(A) << 8,
+                                   (uint32_t)millis(), binlogWord(args)... };
+        const size_t n = sizeof(words) / sizeof(words[0]);
+        if (WORDS - (head_ - tail_) < n) {
+            stats_.dropped++;
+            return;
+        }
+        for (size_t i = 0; i < n; i++) ring_[(head_ + i) & (WORDS - 1)] = words[i];
+        head_ += n;
+        stats_.records++;
+        if (head_ - tail_ > stats_.highWater) stats_.highWater = head_ - tail_;
+    }
+
+    bool empty() const { return head_ == tail_; }
+
+    /* Writes up to maxRecords queued records to `out` (anything with
+     * println(const char *)): formatted "[<ms>] text", or "@<base64>"
+     * with raw.  Returns the number written. */
+    template <typename Out>
+    uint32_t drain(Out &out, uint32_t maxRecords, bool raw) {
+        char line[BINLOG_LINE_MAX];
+        uint32_t done = 0;
+        if (stats_.dropped != droppedReported_) {
+            droppedReported_ = stats_.dropped;
+            uint32_t arg = droppedReported_;
+            emit(out, LOG_DROPPED, (uint32_t)millis(), &arg, 1, raw, line);
+        }
+        while (done < maxRecords && !empty()) {
+            uint32_t hdr = ring_[tail_ & (WORDS - 1)];
+            uint32_t ms  = ring_[(tail_ + 1) & (WORDS - 1)];
+            uint8_t  n   = (uint8_t)(hdr >> 8);
+            uint32_t args[BINLOG_MAX_ARGS];
+            for (uint8_t i = 0; i < n; i++) args[i] = ring_[(tail_ + 2 + i) & (WORDS - 1)];
+            tail_ += 2 + n;
+            emit(out, (uint8_t)hdr, ms, args, n, raw, line);
+            done++;
+        }
+        stats_.drained += done;
+        return done;
+    }
+
+    const Stats &stats() const { return stats_; }
+
+private:
+    template <typename Out>
+    static void emit(Out &out, uint8_t id, uint32_t ms, const uint32_t *args, uint8_t n,
+                     bool raw, char (&line)[BINLOG_LINE_MAX]) {
+        if (raw) {
+            uint8_t bytes[BINLOG_MAX_WORDS * 4];
+            uint32_t words[BINLOG_MAX_WORDS] = { (uint32_t)id | (uint32_t)n << 8, ms };
+            memcpy(words + 2, args, n * sizeof(uint32_t));
+            size_t len = (2 + n) * 4;
+            for (size_t i = 0; i < len; i++) bytes[i] = (uint8_t)(words[i / 4] >> (8 * (i % 4)));
+            line[0] = '@';
+            base64Encode(line + 1, sizeof(line) - 1, bytes, len);
+        } else {
+            int p = snprintf(line, sizeof(line), "[%lu] ", (unsigned long)ms);
+            binlogFormat(id, args, n, line + p, sizeof(line) - p);
+        }
+        out.println(line);
+    }
+
+    uint32_t ring_[WORDS];
+    uint32_t head_ = 0, tail_ = 0;   /* free-running word counts */
+    uint32_t droppedReported_ = 0;
+    Stats    stats_;
+};
@@ -0,0 +1,165 @@
+/*
+ * SafeNeck – state carried across a reset for a fast restart
+ * ==========================================================
+ * After a brownout or a watchdog reset the firmware used to start from
+ * nothing: the GPS acquired from scratch and an open fall alert was
+ * forgotten.  BootState keeps a small record of what is worth having
+ * back:
+ *
+ *   • last fix   – position and the UTC second it was taken (PMTK741)
+ *   • UTC        – when the record was last refreshed
+ *   • open alert – the coalesced alert as last sent, and when
+ *
+ * in two places: retained RAM, which survives any reset that leaves the
+ * nRF52840's SRAM powered (a brownout or a watchdog), and two flash slots
+ * for a full power loss.  Each copy has a magic and a CRC-32.  At boot the
+ * retained copy wins if it checks out, else the newer flash slot.  keep()
+ * only refreshes the retained copy; save() also rewrites the older flash
+ * slot, so a write torn by the next brownout leaves the other intact.
+ *
+ *   retained BootRecord bootRetained;             // Device OS: not zeroed at reset
+ *   BootState boot(bootRetained, "/safeneck/boot");
+ *   boot.begin();                                 // first thing in setup()
+ *   boot.record().fixUnix = …;  boot.keep();      // on every change
+ *   boot.save();                                  // now and then, and at alerts
+ *
+ *   gpsTimeAid(body, sizeof(body), now);          // "PMTK740,…" for the drain
+ *   gpsPositionAid(body, sizeof(body), boot.record(), now);       // "PMTK741,…"
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "flash_journal.h"     /* JournalStore, journalCrc32 */
+#include "nmea_fix.h"          /* formatE7 */
+
+static const uint32_t BOOT_MAGIC      = 0x31424E53;   /* "SNB1" */
+static const uint32_t BOOT_SLOT_BYTES = 4096;         /* one flash sector per slot */
+
+struct BootRecord {
+    uint32_t magic;
+    uint32_t seq;            /* saves to flash; the newer slot wins      */
+    uint32_t boots;          /* resets this record has come through      */
+    uint32_t savedUnix;      /* UTC at the last keep(), 0 = unknown      */
+    uint32_t fixUnix;        /* last fix: UTC, 0 = none                  */
+    int32_t  latE7, lonE7;
+    int32_t  altDm;
+    uint32_t alertUnix;      /* open alert: last detection, 0 = none     */
+    uint16_t alertPeakMilli;
+    uint16_t alertCount;
+    uint16_t alertSpanS;
+    uint8_t  alertKind;
+    uint8_t  alertUpdate;
+    uint32_t crc;            /* over everything above                    */
+};
+
+/* UTC fields of a Unix time (proleptic Gregorian, days → civil date). */
+struct UtcFields {
+    uint16_t year;
+    uint8_t  month, day, hour, minute, second;
+};
+
+inline UtcFields utcFields(uint32_t unixTime) {
+    UtcFields u;
+    uint32_t secs = unixTime % 86400;
+    u.hour   = (uint8_t)(secs / 3600);
+    u.minute = (uint8_t)(secs / 60 % 60);
+    u.second = (uint8_t)(secs % 60);
+    int32_t  z   = (int32_t)(unixTime / 86400) + 719468;
+    int32_t  era = z / 146097;
+    uint32_t doe = (uint32_t)(z - era * 146097);
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp  = (5 * doy + 2) / 153;
+    u.day   = (uint8_t)(doy - (153 * mp + 2) / 5 + 1);
+    u.month = (uint8_t)(mp < 10 ? mp + 3 : mp - 9);
+    u.year  = (uint16_t)(yoe + era * 400 + (u.month <= 2));
+    return u;
+}
+
+/* PA1010D aiding sentence bodies, for GpsI2cDrain::command():
+ *   PMTK740,YYYY,MM,DD,hh,mm,ss                  UTC now
+ *   PMTK741,lat,lon,alt,YYYY,MM,DD,hh,mm,ss      position, UTC now    */
+inline bool gpsTimeAid(char *out, size_t size, uint32_t unixTime) {
+    UtcFields u = utcFields(unixTime);
+    int n = snprintf(out, size, "PMTK740,%u,%02u,%02u,%02u,%02u,%02u", u.year, u.month,
+                     u.day, u.hour, u.minute, u.second);
+    return n > 0 && (size_t)n < size;
+}
+
+inline bool gpsPositionAid(char *out, size_t size, const BootRecord &r, uint32_t unixTime) {
+    UtcFields u = utcFields(unixTime);
+    char lat[16], lon[16];
+    formatE7(lat, sizeof(lat), r.latE7);
+    formatE7(lon, sizeof(lon), r.lonE7);
+    int n = snprintf(out, size, "PMTK741,%s,%s,%ld,%u,%02u,%02u,%02u,%02u,%02u", lat, lon,
+                     (long)(r.altDm / 10), u.year, u.month, u.day, u.hour, u.minute, u.second);
+    return n > 0 && (size_t)n < size;
+}
+
+class BootState {
+public:
+    enum Source : uint8_t { BOOT_NONE, BOOT_RETAINED, BOOT_FLASH };
+
+    BootState(BootRecord &ram, const char *dir) : ram_(ram), store_(dir) {}
+
+    /* Recovers the record (retained RAM, else flash, else a blank one)
+     * and counts this boot.  Returns where it came from. */
+    Source begin() {
+        bool flashOk = store_.begin(2, BOOT_SLOT_BYTES);
+        source_ = BOOT_NONE;
+        if (valid(ram_)) {
+            source_ = BOOT_RETAINED;
+        } else {
+            BootRecord slot[2];
+            int best = -1;
+            for (int i = 0; flashOk && i < 2; i++) {
+                if (store_.read((uint8_t)i, 0, &slot[i], sizeof(BootRecord)) && valid(slot[i]) &&
+                    (best < 0 || slot[i].seq > slot[best].seq))
+                    best = i;
+            }
+            if (best >= 0) {
+                ram_ = slot[best];
+                source_ = BOOT_FLASH;
+            } else {
+                memset(&ram_, 0, sizeof(ram_));
+                ram_.magic = BOOT_MAGIC;
+            }
+        }
+        ram_.boots++;
+        keep();
+        return source_;
+    }
+
+    BootRecord &record() { return ram_; }
+    Source      source() const { return source_; }
+
+    /* The retained copy is current again (after editing record()). */
+    void keep() { ram_.crc = crcOf(ram_); }
+
+    /* keep(), then the same record to the older flash slot. */
+    bool save() {
+        ram_.seq++;
+        keep();
+        uint8_t slot = (uint8_t)(ram_.seq & 1);
+        bool ok = store_.erase(slot) && store_.program(slot, 0, &ram_, sizeof(ram_));
+        if (ok) saves_++;
+        return ok;
+    }
+
+    uint32_t saves() const { return saves_; }
+
+private:
+    static uint32_t crcOf(const BootRecord &r) {
+        return journalCrc32((const uint8_t *)&r, offsetof(BootRecord, crc));
+    }
+    static bool valid(const BootRecord &r) { return r.magic == BOOT_MAGIC && r.crc == crcOf(r); }
+
+    BootRecord  &ram_;
+    JournalStore store_;
+    Source       source_ = BOOT_NONE;
+    uint32_t     saves_  = 0;
+};
@@ -0,0 +1,283 @@
+/*
+ * SafeNeck – packed binary event schema
+ * =====================================
+ * Location, alert, impact and freefall events as fixed little-endian
+ * records instead of snprintf JSON: no float formatting on the device and
+ * about a quarter of the bytes on air.  The same header encodes on the
+ * Boron and decodes on Linux (host/eventdecode, host/firebaserelay).
+ *
+ * Record (version 1):
+ *
+ *   u8 version · u8 type · u32 Unix time, then by type:
+ *
+ *   LOCATION  u8 flags (bit 0: fix) · u8 sats · u8 battery % ·
+ *             i32 lat 1e-7° · i32 lon 1e-7° · i32 alt dm ·
+ *             u16 speed 0.1 km/h · u16 HDOP ×100                 25 bytes
+ *   ALERT     u8 kind · u8 flags · u8 battery % · u16 peak mg ·
+ *             i32 lat · i32 lon                                   19 bytes
+ *             + u16 detections · u16 span s · u8 update           24 bytes
+ *   IMPACT    u16 peak mg · u16 threshold mg                      10 bytes
+ *   FREEFALL  u16 minimum mg · u16 duration ms                    10 bytes
+ *
+ * Battery 0xFF means unknown.  New fields are only ever appended, and
+ * decoders ignore bytes past the ones they know; any other layout change
+ * bumps EVENT_VERSION.  A record without the appended alert fields is
+ * one detection, span 0, first report (common/alert_coalescer.h).
+ *
+ * Text form: base85 (Z85 alphabet) after a '~' marker, or plain base64
+ * for consumers that cannot take base85's punctuation.  decodeEvent()
+ * accepts either.
+ *
+ *   Event e;  e.type = EVENT_IMPACT;  e.gMilli = 3370;  …
+ *   encodeEvent(e, buf, sizeof(buf));              // "~…"
+ *   if (decodeEvent(text, len, e)) formatEventJson(e, json, sizeof(json));
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "base64.h"
+#include "base85.h"
+#include "nmea_fix.h"
+
+static const uint8_t EVENT_VERSION = 1;
+static const size_t  EVENT_MAX_BYTES = 32;
+
+enum EventType : uint8_t {
+    EVENT_LOCATION = 1,
+    EVENT_ALERT    = 2,
+    EVENT_IMPACT   = 3,
+    EVENT_FREEFALL = 4,
+};
+
+enum AlertKind : uint8_t { ALERT_FALL, ALERT_IMPACT };
+
+enum EventText : uint8_t { TEXT_BASE85, TEXT_BASE64 };
+
+struct Event {
+    uint8_t  type        = 0;
+    uint32_t unixTime    = 0;
+    bool     hasFix      = false;    /* LOCATION, ALERT                 */
+    int32_t  latE7       = 0;
+    int32_t  lonE7       = 0;
+    int32_t  altDm       = 0;        /* LOCATION                        */
+    uint16_t speedKmhX10 = 0;
+    uint16_t hdopX100    = 0;
+    uint8_t  sats        = 0;
+    uint8_t  batteryPct  = 0xFF;     /* LOCATION, ALERT                 */
+    uint8_t  alertKind   = ALERT_FALL;
+    uint16_t gMilli      = 0;        /* peak, or minimum for FREEFALL   */
+    uint16_t thresholdMilli = 0;     /* IMPACT                          */
+    uint16_t durationMs  = 0;        /* FREEFALL                        */
+    uint16_t alertCount  = 1;        /* ALERT: detections folded in     */
+    uint16_t alertSpanS  = 0;        /*   first → last detection        */
+    uint8_t  alertUpdate = 0;        /*   0 = first report              */
+};
+
+/* g → mg for the u16 fields, saturating at 65.535 g. */
+inline uint16_t toMilliG(float g) {
+    if (!(g > 0)) return 0;
+    return g >= 65.535f ? 0xFFFF : (uint16_t)(g * 1000.0f + 0.5f);
+}
+
+/* ── Binary record ───────────────────────────────────────────────────── */
+class EventWriter {
+public:
+    EventWriter(uint8_t *buf, size_t cap) : p_(buf), end_(buf + cap), start_(buf) {}
+    void u8(uint8_t v)   { if (p_ < end_) *p_++ = v; else over_ = true; }
+    void u16(uint16_t v) { u8((uint8_t)v); u8((uint8_t)(v >> 8)); }
+    void u32(uint32_t v) { u16((uint16_t)v); u16((uint16_t)(v >> 16)); }
+    void i32(int32_t v)  { u32((uint32_t)v); }
+    size_t size() const  { return over_ ? 0 : (size_t)(p_ - start_); }
+private:
+    uint8_t *p_, *end_, *start_;
+    bool     over_ = false;
+};
+
+class EventReader {
+public:
+    EventReader(const uint8_t *buf, size_t len) : p_(buf), end_(buf + len) {}
+    uint8_t  u8()  { if (p_ < end_) return *p_++; short_ = true; return 0; }
+    uint16_t u16() { uint16_t lo = u8(); return (uint16_t)(lo | (uint16_t)u8() << 8); }
+    uint32_t u32() { uint32_t lo = u16(); return lo | (uint32_t)u16() << 16; }
+    int32_t  i32() { return (int32_t)u32(); }
+    bool ok()   const { return !short_; }
+    bool more() const { return p_ < end_; }
+private:
+    const uint8_t *p_, *end_;
+    bool short_ = false;
+};
+
+/* Returns the record length, or 0 for an unknown type / small buffer. */
+inline size_t packEvent(const Event &e, uint8_t *out, size_t cap) {
+    EventWriter w(out, cap);
+    w.u8(EVENT_VERSION);
+    w.u8(e.type);
+    w.u32(e.unixTime);
+    switch (e.type) {
+    case EVENT_LOCATION:
+        w.u8(e.hasFix ? 1 : 0);
+        w.u8(e.sats);
+        w.u8(e.batteryPct);
+        w.i32(e.latE7);
+        w.i32(e.lonE7);
+        w.i32(e.altDm);
+        w.u16(e.speedKmhX10);
+        w.u16(e.hdopX100);
+        break;
+    case EVENT_ALERT:
+        w.u8(e.alertKind);
+        w.u8(e.hasFix ? 1 : 0);
+        w.u8(e.batteryPct);
+        w.u16(e.gMilli);
+        w.i32(e.latE7);
+        w.i32(e.lonE7);
+        w.u16(e.alertCount);
+        w.u16(e.alertSpanS);
+        w.u8(e.alertUpdate);
+        break;
+    case EVENT_IMPACT:
+        w.u16(e.gMilli);
+        w.u16(e.thresholdMilli);
+        break;
+    case EVENT_FREEFALL:
+        w.u16(e.gMilli);
+        w.u16(e.durationMs);
+        break;
+    default:
+        return 0;
+    }
+    return w.size();
+}
+
+/* False for a newer version, an unknown type or a truncated record. */
+inline bool unpackEvent(const uint8_t *in, size_t len, Event &e) {
+    EventReader r(in, len);
+    if (r.u8() != EVENT_VERSION) return false;
+    e = Event();
+    e.type = r.u8();
+    e.unixTime = r.u32();
+    switch (e.type) {
+    case EVENT_LOCATION:
+        e.hasFix      = r.u8() & 1;
+        e.sats        = r.u8();
+        e.batteryPct  = r.u8();
+        e.latE7       = r.i32();
+        e.lonE7       = r.i32();
+        e.altDm       = r.i32();
+        e.speedKmhX10 = r.u16();
+        e.hdopX100    = r.u16();
+        break;
+    case EVENT_ALERT:
+        e.alertKind   = r.u8();
+        e.hasFix      = r.u8() & 1;
+        e.batteryPct  = r.u8();
+        e.gMilli      = r.u16();
+        e.latE7       = r.i32();
+        e.lonE7       = r.i32();
+        if (r.more()) {
+            e.alertCount  = r.u16();
+            e.alertSpanS  = r.u16();
+            e.alertUpdate = r.u8();
+        }
+        break;
+    case EVENT_IMPACT:
+        e.gMilli         = r.u16();
+        e.thresholdMilli = r.u16();
+        break;
+    case EVENT_FREEFALL:
+        e.gMilli     = r.u16();
+        e.durationMs = r.u16();
+        break;
+    default:
+        return false;
+    }
+    return r.ok();
+}
+
+/* ── Text form for the publish data ──────────────────────────────────── */
+
+/* Returns the text length (excluding the NUL), or 0 on failure. */
+inline size_t encodeEvent(const Event &e, char *out, size_t cap, EventText text = TEXT_BASE85) {
+    uint8_t bin[EVENT_MAX_BYTES];
+    size_t n = packEvent(e, bin, sizeof(bin));
+    if (!n) return 0;
+    if (text == TEXT_BASE64) return base64Encode(out, cap, bin, n);
+    if (cap < 2) return 0;
+    out[0] = '~';
+    size_t len = base85Encode(out + 1, cap - 1, bin, n);
+    return len ? len + 1 : 0;
+}
+
+inline bool decodeEvent(const char *text, size_t len, Event &e) {
+    uint8_t bin[64];
+    int n = len && text[0] == '~' ? base85Decode(bin, sizeof(bin), text + 1, len - 1)
+                                  : base64Decode(bin, sizeof(bin), text, len);
+    return n > 0 && unpackEvent(bin, (size_t)n, e);
+}
+
+/* ── JSON rendering for the receiver side (integer formatting only) ─── */
+
+inline const char *eventName(uint8_t type) {
+    switch (type) {
+    case EVENT_LOCATION: return "location";
+    case EVENT_ALERT:    return "alert";
+    case EVENT_IMPACT:   return "impact";
+    case EVENT_FREEFALL: return "freefall";
+    default:             return "unknown";
+    }
+}
+
+/* Returns snprintf's count: the JSON was truncated if it is ≥ cap. */
+inline int formatEventJson(const Event &e, char *out, size_t cap) {
+    char lat[16], lon[16], bat[8];
+    formatE7(lat, sizeof(lat), e.latE7);
+    formatE7(lon, sizeof(lon), e.lonE7);
+    if (e.batteryPct == 0xFF) snprintf(bat, sizeof(bat), "null");
+    else                      snprintf(bat, sizeof(bat), "%u", e.batteryPct);
+    unsigned g = e.gMilli;
+
+    switch (e.type) {
+    case EVENT_LOCATION: {
+        int32_t alt = e.altDm < 0 ? -e.altDm : e.altDm;
+        return snprintf(out, cap,
+            "{\"event\":\"location\",\"ts\":%lu,\"fix\":%s,\"lat\":%s,\"lon\":%s,"
+            "\"alt_m\":%s%ld.%ld,\"spd_kmph\":%u.%u,\"hdop\":%u.%02u,\"sats\":%u,\"bat\":%s}",
+            (unsigned long)e.unixTime, e.hasFix ? "true" : "false", lat, lon,
+            e.altDm < 0 ? "-" : "", (long)(alt / 10), (long)(alt % 10),
+            e.speedKmhX10 / 10, e.speedKmhX10 % 10, e.hdopX100 / 100, e.hdopX100 % 100,
+            e.sats, bat);
+    }
+    case EVENT_ALERT: {
+        /* Coalescing fields only when there is something to say. */
+        char folded[64] = "";
+        if (e.alertCount > 1 || e.alertUpdate)
+            snprintf(folded, sizeof(folded), ",\"count\":%u,\"span_s\":%u,\"update\":%u",
+                     e.alertCount, e.alertSpanS, e.alertUpdate);
+        if (!e.hasFix)
+            return snprintf(out, cap,
+                "{\"event\":\"alert\",\"ts\":%lu,\"alert\":\"%s\",\"g\":%u.%03u,\"gps\":false,\"bat\":%s%s}",
+                (unsigned long)e.unixTime, e.alertKind == ALERT_FALL ? "fall" : "impact",
+                g / 1000, g % 1000, bat, folded);
+        return snprintf(out, cap,
+            "{\"event\":\"alert\",\"ts\":%lu,\"alert\":\"%s\",\"g\":%u.%03u,"
+            "\"lat\":%s,\"lon\":%s,\"bat\":%s%s}",
+            (unsigned long)e.unixTime, e.alertKind == ALERT_FALL ? "fall" : "impact",
+            g / 1000, g % 1000, lat, lon, bat, folded);
+    }
+    case EVENT_IMPACT:
+        return snprintf(out, cap,
+            "{\"event\":\"impact\",\"ts\":%lu,\"g\":%u.%03u,\"threshold\":%u.%03u}",
+            (unsigned long)e.unixTime, g / 1000, g % 1000,
+            e.thresholdMilli / 1000, e.thresholdMilli % 1000);
+    case EVENT_FREEFALL:
+        return snprintf(out, cap,
+            "{\"event\":\"freefall\",\"ts\":%lu,\"g\":%u.%03u,\"duration_ms\":%u}",
+            (unsigned long)e.unixTime, g / 1000, g % 1000, e.durationMs);
+    default:
+        return snprintf(out, cap, "{\"event\":\"unknown\",\"type\":%u}", e.type);
+    }
+}
@@ -0,0 +1,263 @@
+/*
+ * SafeNeck – fall / impact detector, specialised per sensitivity profile
+ * ======================================================================
+ * One state machine for both firmwares.  Every threshold and timing
+ * constant comes from a profile struct given as the template argument,
+ * so the compiler folds them into the comparisons: a profile costs no
+ * RAM and no loads, and a detector instance is a few words of state.
+ *
+ *   IDLE ──impact──────────────────────────────▶ IMPACT ─▶ POST_IMPACT
+ *     │                                                      │ still, tipped → fall alert
+ *     └─freefall confirmed─▶ FREEFALL ─impact─▶ POST_IMPACT ─┤ upright/moving → impact alert
+ *                              │ recovery / window over → IDLE └ timeout → IDLE
+ *
+ * Samples are squared magnitudes in raw Q units (accel_q.h), so neither
+ * firmware needs a sqrt per sample.  A profile that sets
+ * POST_IMPACT_STILL_MS to 0 alerts as soon as a freefall ends in an
+ * impact, and IDLE_IMPACT_ALERTS false ignores impacts without one.
+ *
+ * When samples carry an up vector (orientation.h), a profile with
+ * POST_IMPACT_TILT_DEG set only calls a fall if the wearer also ended up
+ * tipped that far from where they were shortly before the impact; a
+ * shove that leaves them standing still is an impact.  The reference is
+ * the orientation TILT_REFERENCE_MS..2·TILT_REFERENCE_MS before the
+ * impact, so rotation during the fall itself is not part of it.
+ * Samples without orientation fall back to stillness alone.
+ *
+ * Several instances with different profiles can be fed the same stream;
+ * step() only reports what happened, so a shadow profile is evaluated in
+ * the field without publishing anything:
+ *
+ *   FallDetector<FieldProfile>  detector;
+ *   FallDetector<TrialProfile>  shadow;
+ *   if (detector.step(s) == DETECTOR_ALERT_FALL) publishAlert();
+ *   shadow.step(s);                         // counted in shadow.stats()
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+
+#include "accel_q.h"
+#include "orientation.h"
+
+/* Defaults; a profile derives from this and overrides what differs. */
+struct DetectorProfile {
+    static constexpr uint8_t  Q_POINT              = 8;      /* sample units        */
+    static constexpr double   IMPACT_G             = 3.0;    /* impact above this   */
+    static constexpr double   FREEFALL_G           = 0.2;    /* freefall below this */
+    static constexpr bool     FREEFALL_NEEDS_MOTION = true;  /* stability class 4   */
+    static constexpr uint32_t FREEFALL_CONFIRM_MS  = 500;    /* low g sustained     */
+    static constexpr uint32_t FREEFALL_MIN_MS      = 100;    /* shorter: plain impact */
+    static constexpr uint32_t FREEFALL_WINDOW_MS   = 1000;   /* impact must follow  */
+    static constexpr bool     FREEFALL_ENDS_ON_RECOVERY = true;
+    static constexpr bool     IDLE_IMPACT_ALERTS   = true;   /* impacts w/o freefall */
+    static constexpr uint32_t POST_IMPACT_STILL_MS = 2000;   /* 0: alert at impact  */
+    static constexpr uint32_t POST_IMPACT_MOVING_MS = 500;   /* motion after this   */
+    static constexpr uint32_t POST_IMPACT_TIMEOUT_MS = 4000;
+    static constexpr double   STILL_SPREAD_G       = 0.15;   /* when class unknown  */
+    static constexpr double   POST_IMPACT_TILT_DEG = 0;      /* fall needs this; 0 = off */
+    static constexpr uint32_t TILT_REFERENCE_MS    = 500;    /* pre-impact reference age */
+};
+
+/* reference.c: linear acceleration (gravity removed) with the stability
+ * classifier and the game rotation vector.  Impacts alert on their own;
+ * stillness after one, lying well away from the pre-impact posture,
+ * makes it a fall. */
+struct ImpactStillnessProfile : DetectorProfile {
+    static constexpr double   POST_IMPACT_TILT_DEG = 45;
+};
+
+/* main.c: raw accelerometer (gravity included), no classifier.  Any
+ * dip below 0.4 g followed within 500 ms by a spike over 2.5 g is a
+ * fall; anything else is ignored. */
+struct FreefallImpactProfile : DetectorProfile {
+    static constexpr double   IMPACT_G             = 2.5;
+    static constexpr double   FREEFALL_G           = 0.4;
+    static constexpr bool     FREEFALL_NEEDS_MOTION = false;
+    static constexpr uint32_t FREEFALL_CONFIRM_MS  = 0;
+    static constexpr uint32_t FREEFALL_MIN_MS      = 0;
+    static constexpr uint32_t FREEFALL_WINDOW_MS   = 499;
+    static constexpr bool     FREEFALL_ENDS_ON_RECOVERY = false;
+    static constexpr bool     IDLE_IMPACT_ALERTS   = false;
+    static constexpr uint32_t POST_IMPACT_STILL_MS = 0;
+};
+
+enum DetectorState : uint8_t {
+    DETECTOR_IDLE,
+    DETECTOR_FREEFALL,
+    DETECTOR_IMPACTED,
+    DETECTOR_POST_IMPACT,
+};
+
+enum DetectorEvent : uint8_t {
+    DETECTOR_NONE,
+    DETECTOR_IMPACT,          /* impact from idle                         */
+    DETECTOR_FREEFALL_START,  /* sustained low g confirmed                */
+    DETECTOR_FALL_PATTERN,    /* freefall ended in an impact              */
+    DETECTOR_MONITORING,      /* watching for stillness after an impact   */
+    DETECTOR_TIMEOUT,         /* post-impact watch gave up                */
+    DETECTOR_ALERT_IMPACT,
+    DETECTOR_ALERT_FALL,
+};
+
+struct DetectorSample {
+    static const uint16_t SPREAD_UNKNOWN = 0xFFFF;
+
+    uint32_t ms;
+    uint32_t magSq;                       /* |a|², raw Q units           */
+    uint8_t  stability = 0;               /* BNO085 class, 0 = unknown   */
+    uint16_t spreadMg  = SPREAD_UNKNOWN;  /* recent std dev of |a|       */
+    UpVector up;                          /* orientation, unknown = 0    */
+};
+
+inline const char *detectorStateName(DetectorState s) {
+    switch (s) {
+    case DETECTOR_IDLE:        return "idle";
+    case DETECTOR_FREEFALL:    return "freefall";
+    case DETECTOR_IMPACTED:    return "impact";
+    case DETECTOR_POST_IMPACT: return "post_impact";
+    default:                   return "?";
+    }
+}
+
+template <typename P>
+class FallDetector {
+public:
+    typedef P Profile;
+
+    /* Thresholds in sample units; immediates for a constexpr profile. */
+    static constexpr uint32_t impactSq()   { return accelRawSq(P::IMPACT_G, P::Q_POINT); }
+    static constexpr uint32_t freefallSq() { return accelRawSq(P::FREEFALL_G, P::Q_POINT); }
+    static constexpr uint16_t stillSpreadMg() { return (uint16_t)(P::STILL_SPREAD_G * 1000.0 + 0.5); }
+    static constexpr int16_t  uprightCosQ14() { return cosQ14Deg(P::POST_IMPACT_TILT_DEG); }
+
+    struct Stats {
+        uint32_t impacts      = 0;
+        uint32_t freefalls    = 0;
+        uint32_t fallPatterns = 0;
+        uint32_t impactAlerts = 0;
+        uint32_t fallAlerts   = 0;
+        uint32_t timeouts     = 0;
+        uint32_t tiltVetoes   = 0;   /* still but upright: impact, not fall */
+    };
+
+    DetectorEvent step(const DetectorSample &s) {
+        const uint32_t now = s.ms;
+        const uint32_t m   = s.magSq;
+        if (m > peakSq_) peakSq_ = m;
+
+        /* Freefall confirmation: low g sustained, optionally only while
+         * the wearer was moving, so a still sensor's noise never counts. */
+        if (m < freefallSq() && (!P::FREEFALL_NEEDS_MOTION || s.stability == 4)) {
+            if (!lowRun_) { lowRun_ = true; lowStart_ = now; }
+            lowSpan_ = now - lowStart_;
+            if (lowSpan_ >= P::FREEFALL_CONFIRM_MS) confirmed_ = true;
+        } else if (m >= freefallSq()) {
+            lowRun_ = false;
+            confirmed_ = false;
+        }
+
+        /* Pre-impact posture: the up vector of one to two reference
+         * periods ago, refreshed only while nothing is in progress. */
+        if (P::POST_IMPACT_TILT_DEG > 0 && state_ == DETECTOR_IDLE && s.up.known() &&
+            now - upAt_ >= P::TILT_REFERENCE_MS) {
+            upRef_  = upNext_;
+            upNext_ = s.up;
+            upAt_   = now;
+        }
+
+        switch (state_) {
+        case DETECTOR_IDLE:
+            if (m > impactSq()) {
+                if (!P::IDLE_IMPACT_ALERTS) break;
+                enter(DETECTOR_IMPACTED, now);
+                peakSq_ = m;
+                stats_.impacts++;
+                return DETECTOR_IMPACT;
+            }
+            if (confirmed_) {
+                enter(DETECTOR_FREEFALL, now);
+                peakSq_ = 0;
+                stats_.freefalls++;
+                return DETECTOR_FREEFALL_START;
+            }
+            break;
+
+        case DETECTOR_FREEFALL:
+            if (m > impactSq() && now - since_ <= P::FREEFALL_WINDOW_MS) {
+                peakSq_ = m;
+                clearLow();
+                if (lowSpan_ >= P::FREEFALL_MIN_MS) {
+                    stats_.fallPatterns++;
+                    if (P::POST_IMPACT_STILL_MS == 0) return alert(DETECTOR_ALERT_FALL);
+                    enter(DETECTOR_POST_IMPACT, now);
+                    return DETECTOR_FALL_PATTERN;
+                }
+                enter(DETECTOR_IMPACTED, now);      /* too short: plain impact */
+            } else if (P::FREEFALL_ENDS_ON_RECOVERY && m >= freefallSq() && m <= impactSq()) {
+                reset();
+            } else if (now - since_ > P::FREEFALL_WINDOW_MS) {
+                reset();
+            }
+            break;
+
+        case DETECTOR_IMPACTED:
+            enter(DETECTOR_POST_IMPACT, now);
+            return DETECTOR_MONITORING;
+
+        case DETECTOR_POST_IMPACT: {
+            /* stability: 0=unknown, 1=on table, 2=stationary, 3=stable, 4=motion */
+            uint32_t t = now - since_;
+            if (t >= P::POST_IMPACT_STILL_MS) {
+                bool still = s.stability > 0 ? s.stability <= 3
+                                             : s.spreadMg < stillSpreadMg();
+                if (still && P::POST_IMPACT_TILT_DEG > 0 && upRef_.known() && s.up.known() &&
+                    tiltCosQ14(upRef_, s.up) > uprightCosQ14()) {
+                    stats_.tiltVetoes++;
+                    still = false;
+                }
+                return alert(still ? DETECTOR_ALERT_FALL : DETECTOR_ALERT_IMPACT);
+            }
+            if (t >= P::POST_IMPACT_MOVING_MS && s.stability == 4)
+                return alert(DETECTOR_ALERT_IMPACT);
+            if (t > P::POST_IMPACT_TIMEOUT_MS) {
+                reset();
+                stats_.timeouts++;
+                return DETECTOR_TIMEOUT;
+            }
+            break;
+        }
+        }
+        return DETECTOR_NONE;
+    }
+
+    /* Largest |a|² since the event began; what an alert reports. */
+    uint32_t      peakMagSq()  const { return peakSq_; }
+    float         peakG()      const { return accelRawSqToG(peakSq_, P::Q_POINT); }
+    DetectorState state()      const { return state_; }
+    const Stats  &stats()      const { return stats_; }
+
+private:
+    void enter(DetectorState s, uint32_t now) { state_ = s; since_ = now; }
+    void clearLow() { lowRun_ = false; confirmed_ = false; }
+    void reset() { state_ = DETECTOR_IDLE; peakSq_ = 0; clearLow(); }
+
+    DetectorEvent alert(DetectorEvent e) {
+        if (e == DETECTOR_ALERT_FALL) stats_.fallAlerts++;
+        else                          stats_.impactAlerts++;
+        state_ = DETECTOR_IDLE;
+        return e;
+    }
+
+    DetectorState state_     = DETECTOR_IDLE;
+    uint32_t      since_     = 0;
+    uint32_t      lowStart_  = 0;
+    uint32_t      lowSpan_   = 0;       /* length of the latest low-g run */
+    bool          lowRun_    = false;
+    bool          confirmed_ = false;
+    uint32_t      peakSq_    = 0;
+    UpVector      upRef_;               /* posture before the event      */
+    UpVector      upNext_;
+    uint32_t      upAt_      = 0;
+    Stats         stats_;
+};
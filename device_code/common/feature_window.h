@@ -0,0 +1,134 @@
+/*
+ * SafeNeck – sliding-window acceleration features
+ * ===============================================
+ * Keeps the last ~2 s of |a| samples (milli-g) in a fixed ring and
+ * maintains, per sample and without rescanning:
+ *
+ *   • mean and variance      running sum and sum of squares
+ *   • peak |a|, peak |jerk|  monotonic max-deques (amortised O(1))
+ *   • jerk                   Δ|a| / Δt of the newest sample, mg/s
+ *   • time below freefall,   summed sample intervals spent under / over
+ *     time above impact      the thresholds
+ *
+ * A sample leaves when it is older than the span or the ring is full,
+ * and takes its contribution to every running total with it.  Memory is
+ * N · 16 bytes plus two N-entry deques, fixed at compile time.
+ *
+ *   FeatureWindow<256> win(2000, 200, 3000);  // span ms, freefall/impact mg
+ *   win.push(sample.ms, magnitudeMg);
+ *   if (win.msBelowFreefall() > 100 && win.peakMg() > 3000) ...
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+
+#include "accel_q.h"     /* isqrt32 */
+
+template <uint16_t N>
+class FeatureWindow {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "FeatureWindow capacity must be a power of two");
+
+public:
+    static constexpr uint16_t CAPACITY = N;
+    static const uint16_t MAX_GAP_MS = 100;   /* longer gaps count as this */
+
+    FeatureWindow(uint32_t spanMs, int32_t freefallMg, int32_t impactMg)
+        : spanMs_(spanMs), freefallMg_(freefallMg), impactMg_(impactMg) {}
+
+    void push(uint32_t ms, int32_t mg) {
+        Entry e;
+        e.ms   = ms;
+        e.mg   = mg;
+        e.dtMs = 0;
+        e.jerk = 0;
+        if (head_ != tail_) {
+            const Entry &prev = buf_[(head_ - 1) & (N - 1)];
+            uint32_t dt = ms - prev.ms;
+            e.dtMs = (uint16_t)(dt < MAX_GAP_MS ? dt : MAX_GAP_MS);
+            if (dt) e.jerk = (int32_t)((int64_t)(mg - prev.mg) * 1000 / (int32_t)dt);
+        }
+        if (head_ - tail_ == N) evict();
+
+        uint32_t i = head_++;
+        buf_[i & (N - 1)] = e;
+        sum_   += mg;
+        sumSq_ += (int64_t)mg * mg;
+        if (mg < freefallMg_) belowMs_ += e.dtMs;
+        if (mg > impactMg_)   aboveMs_ += e.dtMs;
+
+        uint32_t absJerk = e.jerk < 0 ? (uint32_t)-e.jerk : (uint32_t)e.jerk;
+        while (peakTail_ != peakHead_ && buf_[peakQ_[(peakTail_ - 1) & (N - 1)] & (N - 1)].mg <= mg)
+            peakTail_--;
+        peakQ_[peakTail_++ & (N - 1)] = i;
+        while (jerkTail_ != jerkHead_ && absJerkAt(jerkQ_[(jerkTail_ - 1) & (N - 1)]) <= absJerk)
+            jerkTail_--;
+        jerkQ_[jerkTail_++ & (N - 1)] = i;
+
+        while (head_ - tail_ > 1 && ms - buf_[tail_ & (N - 1)].ms > spanMs_) evict();
+    }
+
+    void clear() {
+        head_ = tail_ = 0;
+        peakHead_ = peakTail_ = jerkHead_ = jerkTail_ = 0;
+        sum_ = sumSq_ = 0;
+        belowMs_ = aboveMs_ = 0;
+    }
+
+    uint16_t count()  const { return (uint16_t)(head_ - tail_); }
+    uint32_t spanMs() const { return count() ? newest().ms - buf_[tail_ & (N - 1)].ms : 0; }
+
+    int32_t meanMg() const { return count() ? (int32_t)(sum_ / count()) : 0; }
+
+    uint32_t varianceMg2() const {
+        uint16_t n = count();
+        if (n < 2) return 0;
+        int64_t v = (sumSq_ - sum_ * sum_ / n) / n;
+        return v > 0 ? (uint32_t)(v < 0xFFFFFFFF ? v : 0xFFFFFFFF) : 0;
+    }
+    uint32_t stddevMg() const { return isqrt32(varianceMg2()); }
+
+    int32_t  peakMg()         const { return count() ? buf_[peakQ_[peakHead_ & (N - 1)] & (N - 1)].mg : 0; }
+    int32_t  jerkMgPerS()     const { return count() ? newest().jerk : 0; }
+    uint32_t peakJerkMgPerS() const { return count() ? absJerkAt(jerkQ_[jerkHead_ & (N - 1)]) : 0; }
+
+    uint32_t msBelowFreefall() const { return belowMs_; }
+    uint32_t msAboveImpact()   const { return aboveMs_; }
+
+private:
+    struct Entry {
+        uint32_t ms;
+        int32_t  mg;
+        int32_t  jerk;      /* mg/s since the previous sample */
+        uint16_t dtMs;      /* capped interval to it          */
+    };
+
+    const Entry &newest() const { return buf_[(head_ - 1) & (N - 1)]; }
+
+    uint32_t absJerkAt(uint32_t i) const {
+        int32_t j = buf_[i & (N - 1)].jerk;
+        return j < 0 ? (uint32_t)-j : (uint32_t)j;
+    }
+
+    void evict() {
+        uint32_t i = tail_++;
+        const Entry &e = buf_[i & (N - 1)];
+        sum_   -= e.mg;
+        sumSq_ -= (int64_t)e.mg * e.mg;
+        if (e.mg < freefallMg_) belowMs_ -= e.dtMs;
+        if (e.mg > impactMg_)   aboveMs_ -= e.dtMs;
+        if (peakHead_ != peakTail_ && peakQ_[peakHead_ & (N - 1)] == i) peakHead_++;
+        if (jerkHead_ != jerkTail_ && jerkQ_[jerkHead_ & (N - 1)] == i) jerkHead_++;
+    }
+
+    uint32_t spanMs_;
+    int32_t  freefallMg_, impactMg_;
+
+    Entry    buf_[N];
+    uint32_t head_ = 0, tail_ = 0;              /* free-running sample indices */
+    uint32_t peakQ_[N], jerkQ_[N];              /* indices, values decreasing  */
+    uint32_t peakHead_ = 0, peakTail_ = 0;
+    uint32_t jerkHead_ = 0, jerkTail_ = 0;
+
+    int64_t  sum_ = 0, sumSq_ = 0;
+    uint32_t belowMs_ = 0, aboveMs_ = 0;
+};
@@ -0,0 +1,555 @@
+/*
+ * SafeNeck – store-and-forward journal in flash
+ * =============================================
+ * The outbox (publish_queue.h) holds eight events in RAM: a subway ride
+ * or a rural dead zone overflows it within minutes, and a reboot loses
+ * whatever it held.  Events that cannot go out now are appended here
+ * instead and replayed once the cloud is back:
+ *
+ *   • Segments – SEGMENTS equal segments, written append-only and erased
+ *                only as a whole, one after the other round the ring, so
+ *                every segment sees the same number of erases.  Each
+ *                starts with a header: magic, generation (rises with
+ *                every erase, so the newest segment is found at boot) and
+ *                its own erase count.  A full journal overwrites its
+ *                oldest segment: unsent alerts in it are rewritten at the
+ *                head, anything else unsent is lost and counted.
+ *   • Records  – length, priority, sequence number, event name and data,
+ *                CRC-32 over all of it, and the length again at the end
+ *                so the journal can be read backwards.  A record torn by
+ *                a brownout fails its CRC; the scan stops there and the
+ *                rest of that segment is left unused.
+ *   • Replay   – next() hands out the unsent records newest first, every
+ *                alert before anything else; the caller feeds them to the
+ *                outbox a few at a time, which paces them at one per
+ *                second.  One call walks at most WALK_MAX records (one
+ *                read each) and pending() says it paused there: the next
+ *                call resumes from the cursor, so a long run of records
+ *                another pass skips never holds up loop().  Once all are
+ *                delivered, commit() appends a mark record ("delivered up
+ *                to sequence N"): nothing is rewritten in place, so a
+ *                replay costs one small record.  If the outbox refused or
+ *                evicted any of them, abandon() ends the replay without a
+ *                mark instead.
+ *
+ * Delivery is at least once: a reboot between a record's ACK and the
+ * commit, or an abandoned replay, sends it again.  On the device the
+ * segments are files on the Boron's LittleFS file system (erase =
+ * truncate); on the host a NOR flash stand-in backed by a file counts
+ * page programs and erases (host/shim/flash_host.h).  No heap; one loop() thread.
+ *
+ *   FlashJournal<16, 4096, 622> journal("/safeneck/journal");   // 64 KB
+ *   journal.begin();                                      // in setup()
+ *   journal.append("safeneck/fall", text, outbox.ALERT);  // offline
+ *   while (room && journal.next(rec)) outbox.publish(rec.name, rec.data, …);
+ *   if (!journal.next(rec) && !journal.pending() && outbox idle)
+ *       outbox dropped any ? journal.abandon() : journal.commit();
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+static const uint32_t JOURNAL_MAGIC       = 0x314A4E53;   /* "SNJ1"          */
+static const uint32_t JOURNAL_HEADER      = 16;           /* segment header  */
+static const uint32_t JOURNAL_OVERHEAD    = 14;           /* per record      */
+static const uint8_t  JOURNAL_ALERT       = 0;            /* PublishQueue::ALERT */
+static const uint8_t  JOURNAL_MARK        = 0xFF;         /* "delivered up to" */
+static const size_t   JOURNAL_NAME_MAX    = 64;           /* Particle limit  */
+
+/* CRC-32 (IEEE, as zlib), a nibble at a time from a 16-entry table. */
+inline uint32_t journalCrc32(const uint8_t *p, size_t n, uint32_t crc = 0) {
+    static const uint32_t T[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+        0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    crc = ~crc;
+    while (n--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ T[crc & 15];
+        crc = (crc >> 4) ^ T[crc & 15];
+    }
+    return ~crc;
+}
+
+#if defined(PLATFORM_ID)
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* One LittleFS file per segment.  LittleFS is copy-on-write with its
+ * own wear levelling, so "erase" is a truncate and bytes past the end
+ * read as erased (0xFF), like the NOR flash underneath.  The last file
+ * used stays open: a replay walks one segment at a time, and an open
+ * per record would cost more than the read.  One descriptor, as each
+ * open file holds a LittleFS cache in RAM; writes are synced at once. */
+class JournalStore {
+public:
+    explicit JournalStore(const char *dir) : dir_(dir) {}
+    ~JournalStore() { if (fd_ >= 0) ::close(fd_); }
+
+    bool begin(uint8_t segments, uint32_t segBytes) {
+        /* Each level of the path; mkdir fails harmlessly when it exists. */
+        char sub[sizeof(path_)];
+        for (size_t i = 1; dir_[i - 1] && i < sizeof(sub); i++) {
+            if (dir_[i] != '/' && dir_[i]) continue;
+            memcpy(sub, dir_, i);
+            sub[i] = 0;
+            mkdir(sub, 0777);
+        }
+        return true;
+    }
+
+    bool read(uint8_t seg, uint32_t off, void *p, uint32_t n) {
+        memset(p, 0xFF, n);
+        int fd = file(seg, false);
+        if (fd < 0) return true;                     /* never written */
+        return ::lseek(fd, off, SEEK_SET) == (off_t)off && ::read(fd, p, n) >= 0;
+    }
+
+    bool program(uint8_t seg, uint32_t off, const void *p, uint32_t n) {
+        int fd = file(seg, true);
+        if (fd < 0) return false;
+        return ::lseek(fd, off, SEEK_SET) == (off_t)off && ::write(fd, p, n) == (int)n &&
+               ::fsync(fd) == 0;
+    }
+
+    bool erase(uint8_t seg) {
+        int fd = file(seg, true);
+        return fd >= 0 && ::ftruncate(fd, 0) == 0 && ::fsync(fd) == 0;
+    }
+
+private:
+    /* The segment's file, reusing the open one; -1 if it does not exist
+     * and `create` is false. */
+    int file(uint8_t seg, bool create) {
+        if (fd_ >= 0 && fdSeg_ == seg) return fd_;
+        if (fd_ >= 0) ::close(fd_);
+        snprintf(path_, sizeof(path_), "%s/%u", dir_, (unsigned)seg);
+        fd_    = ::open(path_, create ? O_RDWR | O_CREAT : O_RDWR);
+        fdSeg_ = seg;
+        return fd_;
+    }
+
+    const char *dir_;
+    char        path_[48];
+    int         fd_    = -1;
+    uint8_t     fdSeg_ = 0;
+};
+#else
+#include "flash_host.h"          /* host/shim: file-backed NOR stand-in */
+#endif
+
+template <uint8_t SEGMENTS, uint32_t SEG_BYTES, size_t DATA_MAX>
+class FlashJournal {
+    static_assert(SEGMENTS >= 2, "a journal needs a segment to fall back on");
+    static_assert(SEG_BYTES < 0xFFFF, "record offsets are 16-bit");
+
+public:
+    static const uint32_t RECORD_MAX   = JOURNAL_OVERHEAD + JOURNAL_NAME_MAX - 1 + DATA_MAX;
+    static const uint32_t RESCUE_BYTES = 1024;    /* alerts carried past a roll */
+    static const uint32_t WALK_MAX     = 32;      /* records one next() reads */
+    static_assert(JOURNAL_HEADER + RESCUE_BYTES + RECORD_MAX <= SEG_BYTES,
+                  "rescued alerts and the largest record must fit in one segment");
+
+    struct Record {
+        uint32_t seq;
+        uint8_t  prio;
+        char     name[JOURNAL_NAME_MAX];
+        char     data[DATA_MAX + 1];
+    };
+
+    struct Stats {
+        uint32_t appended     = 0;
+        uint32_t payloadBytes = 0;    /* names + data appended          */
+        uint32_t writtenBytes = 0;    /* records, marks, headers        */
+        uint32_t replayed     = 0;    /* handed out by next()           */
+        uint32_t commits      = 0;
+        uint32_t abandoned    = 0;    /* replays sent again in full     */
+        uint32_t erases       = 0;    /* segment erases since boot      */
+        uint32_t overwritten  = 0;    /* unsent, lost to a full journal */
+        uint32_t rescued      = 0;    /* alerts carried over instead    */
+        uint32_t corrupt      = 0;    /* records failing their CRC      */
+        uint32_t failed       = 0;    /* store errors                   */
+    };
+
+    explicit FlashJournal(const char *dir) : store_(dir) {}
+
+    /* Finds the newest segment, the end of the journal and what is still
+     * unsent.  Formats an empty (or foreign) journal. */
+    bool begin() {
+        if (!store_.begin(SEGMENTS, SEG_BYTES)) return false;
+        int cur = -1;
+        for (uint8_t s = 0; s < SEGMENTS; s++) {
+            Segment &g = seg_[s];
+            g = Segment();
+            uint32_t h[4];
+            if (!store_.read(s, 0, h, sizeof(h))) { stats_.failed++; continue; }
+            if (h[0] != JOURNAL_MAGIC || h[3] != journalCrc32((const uint8_t *)h, 12)) continue;
+            g.valid  = true;
+            g.gen    = h[1];
+            g.erases = h[2];
+            if (cur < 0 || g.gen > seg_[cur].gen) cur = s;
+        }
+        if (cur < 0) return format(0, 1);
+
+        cur_ = (uint8_t)cur;
+        for (uint8_t s = 0; s < SEGMENTS; s++) {
+            if (seg_[s].valid) scan(s);
+        }
+        backlog_ = 0;
+        for (uint8_t s = 0; s < SEGMENTS; s++) backlog_ += unsent(s, acked_);
+        return true;
+    }
+
+    /* Appends one event; false on a store error or an oversized event. */
+    bool append(const char *name, const char *data, uint8_t prio) {
+        size_t nl = strlen(name), dl = strlen(data);
+        if (nl >= JOURNAL_NAME_MAX || dl > DATA_MAX) return false;
+        if (!write(prio, name, nl, data, dl)) return false;
+        stats_.appended++;
+        stats_.payloadBytes += nl + dl;
+        backlog_++;
+        if (replaying_) newSince_++;
+        return true;
+    }
+
+    /* The next unsent record of the current replay (started on the first
+     * call): alerts newest first, then everything else newest first.
+     * False once all have been handed out, or when this call has read
+     * WALK_MAX records without finding one (pending()). */
+    bool next(Record &r) {
+        if (!replaying_) {
+            if (!backlog_) return false;
+            replaying_ = true;
+            pass_      = 0;
+            head_      = lastSeq_;
+            newSince_  = 0;
+            rewind();
+        }
+        walked_ = 0;
+        while (pass_ < 2) {
+            switch (step(r)) {
+            case FOUND:
+                stats_.replayed++;
+                return true;
+            case PAUSED:
+                return false;
+            case END:
+                if (++pass_ < 2) rewind();
+                break;
+            }
+        }
+        return false;
+    }
+
+    /* After next() returned false: it paused at WALK_MAX, not at the end
+     * of the replay, and the walk goes on from the cursor next call. */
+    bool pending() const { return replaying_ && pass_ < 2; }
+
+    /* Everything next() handed out has been delivered. */
+    bool commit() {
+        if (!replaying_ || pass_ < 2) return false;
+        uint8_t mark[4];
+        for (int i = 0; i < 4; i++) mark[i] = (uint8_t)(head_ >> (8 * i));
+        bool ok = write(JOURNAL_MARK, "", 0, (const char *)mark, sizeof(mark));
+        acked_     = head_;
+        backlog_   = newSince_;
+        replaying_ = false;
+        stats_.commits++;
+        return ok;
+    }
+
+    /* Ends the current replay without a mark: something it handed out
+     * was not delivered, so all of it stays unsent and the next replay
+     * sends it again. */
+    void abandon() {
+        if (!replaying_) return;
+        replaying_ = false;
+        stats_.abandoned++;
+    }
+
+    uint32_t     backlog()   const { return backlog_; }     /* unsent records  */
+    bool         replaying() const { return replaying_; }
+    const Stats &stats()     const { return stats_; }
+
+    /* Lowest and highest erase count over the segments in use. */
+    void eraseCounts(uint32_t &lo, uint32_t &hi) const {
+        lo = UINT32_MAX;
+        hi = 0;
+        for (uint8_t s = 0; s < SEGMENTS; s++) {
+            if (!seg_[s].valid) continue;
+            if (seg_[s].erases < lo) lo = seg_[s].erases;
+            if (seg_[s].erases > hi) hi = seg_[s].erases;
+        }
+        if (lo > hi) lo = 0;
+    }
+
+private:
+    struct Segment {
+        bool     valid   = false;
+        bool     full    = false;     /* torn record: no more appends   */
+        uint32_t gen     = 0;
+        uint32_t erases  = 0;
+        uint32_t end     = JOURNAL_HEADER;   /* after the last good record */
+    };
+
+    enum Step : uint8_t { FOUND, PAUSED, END };
+
+    /* Parsed view of a record read into buf_. */
+    struct View {
+        uint16_t len;
+        uint8_t  prio;
+        uint8_t  nameLen;
+        uint32_t seq;
+    };
+
+    static uint16_t get16(const uint8_t *p) { return (uint16_t)(p[0] | p[1] << 8); }
+    static uint32_t get32(const uint8_t *p) {
+        return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    }
+    static void put16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+    static void put32(uint8_t *p, uint32_t v) {
+        for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+    }
+
+    /* Erases segment s and makes it the current one, generation gen. */
+    bool format(uint8_t s, uint32_t gen) {
+        Segment &g = seg_[s];
+        uint32_t erases = g.valid ? g.erases + 1 : 1;
+        g = Segment();
+        cur_ = s;
+        stats_.erases++;
+        uint32_t h[4] = { JOURNAL_MAGIC, gen, erases, 0 };
+        h[3] = journalCrc32((const uint8_t *)h, 12);
+        if (!store_.erase(s) || !store_.program(s, 0, h, sizeof(h))) {
+            stats_.failed++;
+            g.full = true;           /* unusable: the next write moves on */
+            return false;
+        }
+        stats_.writtenBytes += sizeof(h);
+        g.valid  = true;
+        g.gen    = gen;
+        g.erases = erases;
+        return true;
+    }
+
+    /* Parses and checks a whole record of `len` bytes at p. */
+    static bool check(const uint8_t *p, uint32_t len, View &v) {
+        v.len     = get16(p);
+        v.prio    = p[2];
+        v.nameLen = p[3];
+        v.seq     = get32(p + 4);
+        return v.len == len && len >= JOURNAL_OVERHEAD + v.nameLen && len <= RECORD_MAX &&
+               get16(p + len - 2) == len && get32(p + len - 6) == journalCrc32(p, len - 6u);
+    }
+
+    /* The rest of the record at `off` of segment s, whose 8-byte header
+     * (length first) is already in buf_. */
+    bool loadBody(uint8_t s, uint32_t off, View &v) {
+        uint16_t len = get16(buf_);
+        if (len < JOURNAL_OVERHEAD || len > RECORD_MAX || off + len > SEG_BYTES) return false;
+        if (!store_.read(s, off + 8, buf_ + 8, len - 8u)) { stats_.failed++; return false; }
+        return check(buf_, len, v);
+    }
+
+    /* Reads and checks the record at `off` of segment s into buf_. */
+    bool load(uint8_t s, uint32_t off, View &v) {
+        if (off + JOURNAL_OVERHEAD > SEG_BYTES) return false;
+        if (!store_.read(s, off, buf_, 8)) { stats_.failed++; return false; }
+        return loadBody(s, off, v);
+    }
+
+    /* Walks segment s forwards: its end, the last sequence number and the
+     * newest mark. */
+    void scan(uint8_t s) {
+        Segment &g = seg_[s];
+        uint32_t off = JOURNAL_HEADER;
+        while (off + 8 <= SEG_BYTES) {
+            if (!store_.read(s, off, buf_, 8)) { stats_.failed++; g.full = true; break; }
+            if (get16(buf_) == 0xFFFF) break;               /* erased: the end */
+            View v;
+            if (!loadBody(s, off, v)) {
+                stats_.corrupt++;
+                g.full = true;
+                break;
+            }
+            if (v.seq > lastSeq_) lastSeq_ = v.seq;
+            if (v.prio == JOURNAL_MARK && v.len == JOURNAL_OVERHEAD + 4) {
+                uint32_t through = get32(buf_ + 8);
+                if (through > acked_) acked_ = through;
+            }
+            off += v.len;
+        }
+        g.end = off;
+    }
+
+    /* Event records in segment s after sequence `after` (headers only:
+     * the records were checked by scan() or written by us). */
+    uint32_t unsent(uint8_t s, uint32_t after) {
+        if (!seg_[s].valid) return 0;
+        uint32_t n = 0;
+        for (uint32_t off = JOURNAL_HEADER; off < seg_[s].end;) {
+            uint8_t h[8];
+            if (!store_.read(s, off, h, sizeof(h))) break;
+            if (get16(h) < JOURNAL_OVERHEAD) break;
+            if (h[2] != JOURNAL_MARK && get32(h + 4) > after) n++;
+            off += get16(h);
+        }
+        return n;
+    }
+
+    /* One record at the end of the current segment, moving on to the
+     * next segment (erasing it) when it does not fit. */
+    bool write(uint8_t prio, const char *name, size_t nl, const char *data, size_t dl) {
+        uint16_t len = (uint16_t)(JOURNAL_OVERHEAD + nl + dl);
+        Segment *g = &seg_[cur_];
+        if (g->full || g->end + len > SEG_BYTES) {
+            if (!roll()) return false;
+            g = &seg_[cur_];
+        }
+        put16(buf_, len);
+        buf_[2] = prio;
+        buf_[3] = (uint8_t)nl;
+        put32(buf_ + 4, lastSeq_ + 1);
+        memcpy(buf_ + 8, name, nl);
+        memcpy(buf_ + 8 + nl, data, dl);
+        put32(buf_ + len - 6, journalCrc32(buf_, len - 6u));
+        put16(buf_ + len - 2, len);
+        if (!store_.program(cur_, g->end, buf_, len)) {
+            stats_.failed++;
+            g->full = true;          /* maybe half written: start afresh */
+            return false;
+        }
+        lastSeq_++;
+        g->end += len;
+        stats_.writtenBytes += len;
+        return true;
+    }
+
+    /* Recycles the oldest segment.  Its unsent alerts are carried over
+     * (up to RESCUE_BYTES of them, rewritten with new sequence numbers);
+     * its other unsent records are lost.  Records the current replay has
+     * already handed out are in the outbox and need neither. */
+    bool roll() {
+        uint8_t  s = (uint8_t)((cur_ + 1) % SEGMENTS);
+        uint32_t kept = 0;
+        for (uint32_t off = JOURNAL_HEADER; seg_[s].valid && off < seg_[s].end;) {
+            View v;
+            if (!load(s, off, v)) break;
+            bool handedOut = replaying_ && v.seq <= head_ &&
+                             (pass_ > 0 || (at_ == s && atGen_ == seg_[s].gen && off >= atOff_));
+            if (v.prio != JOURNAL_MARK && v.seq > acked_ && !handedOut) {
+                if (v.prio == JOURNAL_ALERT && kept + v.len <= RESCUE_BYTES) {
+                    memcpy(rescue_ + kept, buf_, v.len);
+                    kept += v.len;
+                } else {
+                    if (backlog_) backlog_--;
+                    if (replaying_ && v.seq > head_ && newSince_) newSince_--;
+                    stats_.overwritten++;
+                }
+            }
+            off += v.len;
+        }
+        if (!format(s, seg_[cur_].gen + 1)) return false;
+
+        for (uint32_t off = 0; off < kept;) {
+            const uint8_t *r = rescue_ + off;
+            uint16_t len = get16(r);
+            uint8_t  nl  = r[3];
+            if (!write(r[2], (const char *)r + 8, nl, (const char *)r + 8 + nl,
+                       len - JOURNAL_OVERHEAD - nl))
+                return false;
+            if (replaying_ && get32(r + 4) <= head_) newSince_++;   /* survives the commit */
+            stats_.rescued++;
+            off += len;
+        }
+        return true;
+    }
+
+    /* Replay cursor back to the end of the journal. */
+    void rewind() {
+        at_    = cur_;
+        atGen_ = seg_[cur_].gen;
+        atOff_ = seg_[cur_].end;
+        atLen_ = 0;
+    }
+
+    /* Walks back from the cursor to the next record of this pass.  Each
+     * record is read together with the trailing length of the one before
+     * it, so the walk costs one read per record. */
+    Step step(Record &r) {
+        for (;;) {
+            /* A segment recycled under the cursor ends the pass. */
+            if (!seg_[at_].valid || seg_[at_].gen != atGen_) return END;
+            if (atOff_ <= JOURNAL_HEADER) {
+                uint8_t prev = (uint8_t)((at_ + SEGMENTS - 1) % SEGMENTS);
+                if (!seg_[prev].valid || seg_[prev].gen != atGen_ - 1) return END;
+                at_    = prev;
+                atGen_ = seg_[prev].gen;
+                atOff_ = seg_[prev].end;
+                atLen_ = 0;
+                continue;
+            }
+            if (walked_ >= WALK_MAX) return PAUSED;
+            walked_++;
+
+            uint16_t len = atLen_;
+            if (!len) {
+                uint8_t l[2];
+                if (!store_.read(at_, atOff_ - 2, l, 2)) { stats_.failed++; return END; }
+                len = get16(l);
+            }
+            if (len < JOURNAL_OVERHEAD || len > atOff_ - JOURNAL_HEADER) {
+                stats_.corrupt++;
+                return END;
+            }
+            uint32_t start = atOff_ - len;
+            uint32_t lead  = start > JOURNAL_HEADER ? 2 : 0;   /* length before it */
+            View v;
+            if (!store_.read(at_, start - lead, buf_, len + lead)) { stats_.failed++; return END; }
+            if (!check(buf_ + lead, len, v)) {
+                stats_.corrupt++;
+                return END;
+            }
+            atLen_ = lead ? get16(buf_) : 0;
+            atOff_ = start;
+            if (v.seq <= acked_) return END;                 /* delivered before */
+            if (v.seq > head_ || v.prio == JOURNAL_MARK) continue;
+            if ((v.prio == JOURNAL_ALERT) != (pass_ == 0)) continue;
+
+            const uint8_t *p = buf_ + lead;
+            size_t dl = v.len - JOURNAL_OVERHEAD - v.nameLen;
+            r.seq  = v.seq;
+            r.prio = v.prio;
+            memcpy(r.name, p + 8, v.nameLen);
+            r.name[v.nameLen] = '\0';
+            memcpy(r.data, p + 8 + v.nameLen, dl);
+            r.data[dl] = '\0';
+            return FOUND;
+        }
+    }
+
+    JournalStore store_;
+    Segment  seg_[SEGMENTS];
+    uint8_t  cur_      = 0;
+    uint32_t lastSeq_  = 0;       /* newest record, marks included    */
+    uint32_t acked_    = 0;       /* delivered up to here             */
+    uint32_t backlog_  = 0;
+
+    bool     replaying_ = false;
+    uint8_t  pass_      = 0;      /* 0: alerts, 1: the rest, 2: done  */
+    uint32_t head_      = 0;      /* newest record of this replay     */
+    uint32_t newSince_  = 0;      /* appended since it started        */
+    uint8_t  at_        = 0;      /* cursor: segment, its generation, */
+    uint32_t atGen_     = 0;      /*         offset past the record   */
+    uint32_t atOff_     = 0;
+    uint16_t atLen_     = 0;      /* length of the record before it, 0 = unread */
+    uint32_t walked_    = 0;      /* records read by this next()      */
+
+    uint8_t  buf_[RECORD_MAX + 2];
+    uint8_t  rescue_[RESCUE_BYTES];
+    Stats    stats_;
+};
@@ -0,0 +1,192 @@
+/*
+ * SafeNeck – time-budgeted, padding-aware PA1010D I2C drain
+ * =========================================================
+ * The PA1010D answers every read with NMEA from its output buffer and
+ * pads with '\n' (0x0A) once the buffer is empty.  Reading a fixed
+ * 255 bytes (main.c) or 10×32 bytes with 400 µs gaps (reference.c) every
+ * loop mostly moves padding and keeps the shared bus busy.  This reader:
+ *
+ *   • stops at the first padding byte (a 0x0A not preceded by '\r'),
+ *   • learns the module's output burst period, skipping polls while the
+ *     buffer is predicted to be empty,
+ *   • never starts a chunk that would overrun the per-call µs budget
+ *     (the first chunk of a call is always allowed),
+ *   • gives up on the call when a read comes back empty (the module is
+ *     not answering yet, or not at all), so the bus is never held.
+ *
+ *   GpsI2cDrain drain(GPS_I2C_ADDR, GPS_DRAIN_BUDGET_US);
+ *   drain.poll([](char c) { parser.feed(c); });
+ *
+ * Commands go the other way through command(): the sentence body gets
+ * its '$', checksum and CRLF here and is written in Wire-buffer chunks,
+ * so a long PMTK314 is no longer cut off at 32 bytes.
+ *
+ *   drain.command("PMTK220,1000");           // sends $PMTK220,1000*1F\r\n
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include "Particle.h"
+
+class GpsI2cDrain {
+public:
+    static const uint8_t CHUNK_BYTES = 32;     /* Device OS Wire buffer   */
+
+    struct Stats {
+        uint32_t polls        = 0;   /* calls that touched the bus      */
+        uint32_t skipped      = 0;   /* calls predicted empty           */
+        uint32_t chunks       = 0;
+        uint32_t bytes        = 0;   /* NMEA bytes delivered            */
+        uint32_t padding      = 0;   /* 0x0A filler read                */
+        uint32_t budgetStops  = 0;   /* stopped with data still pending */
+        uint32_t maxPollUs    = 0;
+        uint32_t commands     = 0;   /* command() sentences written     */
+        uint32_t nacks        = 0;   /* reads the module did not answer */
+    };
+
+    GpsI2cDrain(uint8_t addr, uint32_t budgetUs) : addr_(addr), budgetUs_(budgetUs) {}
+
+    template <typename Sink>
+    uint32_t poll(Sink &&sink) {
+        const uint32_t start = micros();
+        Skip skip = predictSkip(start);
+        if (skip != POLL) {
+            stats_.skipped++;
+            betweenBursts_ = skip == BETWEEN_BURSTS;
+            return 0;
+        }
+        stats_.polls++;
+
+        uint32_t delivered = 0;
+        bool     empty = false;
+        uint32_t chunkUs = 0;
+        const uint32_t chunks0 = stats_.chunks;
+        while (!empty) {
+            uint32_t elapsed = micros() - start;
+            if (stats_.chunks != chunks0 && elapsed + chunkUs > budgetUs_) {
+                if (delivered) stats_.budgetStops++;
+                break;
+            }
+            uint32_t t0 = micros();
+            if (Wire.requestFrom(addr_, CHUNK_BYTES) == 0) {
+                stats_.nacks++;            /* address NACK – try next call */
+                break;
+            }
+            stats_.chunks++;
+            while (Wire.available()) {
+                char c = (char)Wire.read();
+                if (c == '\n' && prev_ != '\r') {
+                    stats_.padding++;
+                    empty = true;          /* buffer ran dry – stop  */
+                    continue;
+                }
+                prev_ = c;
+                sink(c);
+                delivered++;
+            }
+            chunkUs = micros() - t0;
+        }
+
+        track(start, delivered, empty);
+        uint32_t took = micros() - start;
+        if (took > stats_.maxPollUs) stats_.maxPollUs = took;
+        stats_.bytes += delivered;
+        return delivered;
+    }
+
+    /* The last poll ran the module's buffer dry (nothing left behind). */
+    bool     drained()       const { return drained_; }
+
+    uint32_t burstPeriodMs() const { return burstPeriodUs_ / 1000; }
+    const Stats &stats()     const { return stats_; }
+
+    /* Frame and write one command sentence ("PMTK161,0"); the caller holds
+     * the bus.  Any command may change the output cadence, so it is
+     * relearnt.  False if the module did not acknowledge its address. */
+    bool command(const char *body) {
+        char line[CMD_MAX];
+        uint8_t sum = 0;
+        size_t n = 0;
+        line[n++] = '$';
+        for (const char *p = body; *p && n < CMD_MAX - 5; p++) {
+            sum ^= (uint8_t)*p;
+            line[n++] = *p;
+        }
+        static const char HEX[] = "0123456789ABCDEF";
+        line[n++] = '*';
+        line[n++] = HEX[sum >> 4];
+        line[n++] = HEX[sum & 0x0F];
+        line[n++] = '\r';
+        line[n++] = '\n';
+
+        bool ok = true;
+        for (size_t off = 0; off < n; off += CHUNK_BYTES) {
+            size_t len = n - off < CHUNK_BYTES ? n - off : CHUNK_BYTES;
+            Wire.beginTransmission(addr_);
+            Wire.write((const uint8_t *)line + off, len);
+            ok = Wire.endTransmission() == 0 && ok;
+        }
+        stats_.commands++;
+        relearn();
+        return ok;
+    }
+
+    /* Forget the learned cadence, e.g. after changing the fix rate. */
+    void relearn() { burstPeriodUs_ = 0; haveBurst_ = false; }
+
+private:
+    static const uint32_t REPOLL_US         = 5000;   /* min gap after a drain     */
+    static const uint32_t QUIET_US          = 50000;  /* gap that separates bursts */
+    static const size_t   CMD_MAX           = 96;     /* '$' … "*HH\r\n"          */
+
+    enum Skip : uint8_t { POLL, REFILL, BETWEEN_BURSTS };
+
+    Skip predictSkip(uint32_t now) const {
+        /* Never while a budget stop left data behind. */
+        if (!drained_) return POLL;
+        /* Between bursts: nothing new until the next epoch is due. */
+        if (burstPeriodUs_ && (now - lastDataUs_) >= QUIET_US &&
+            (now - burstStartUs_) < burstPeriodUs_ - burstPeriodUs_ / 8)
+            return BETWEEN_BURSTS;
+        /* Just drained: give the module time to refill before reading
+         * another chunk of mostly padding. */
+        if (now - emptyAtUs_ < REPOLL_US) return REFILL;
+        return POLL;
+    }
+
+    void track(uint32_t start, uint32_t delivered, bool empty) {
+        uint32_t now = micros();
+        if (betweenBursts_ && delivered && !empty) {
+            /* Data was already waiting when we came back: the skip window
+             * overshot the real cadence (e.g. the fix rate went up).
+             * Relearn rather than let a long estimate feed on itself. */
+            relearn();
+        }
+        betweenBursts_ = false;
+        if (delivered) {
+            /* First data after a quiet gap starts a new output burst. */
+            if (!haveData_ || start - lastDataUs_ >= QUIET_US) {
+                if (haveBurst_) {
+                    uint32_t period = start - burstStartUs_;
+                    burstPeriodUs_ = burstPeriodUs_ ? (burstPeriodUs_ * 3 + period) / 4 : period;
+                }
+                burstStartUs_ = start;
+                haveBurst_ = true;
+            }
+            lastDataUs_ = now;
+            haveData_ = true;
+        }
+        drained_ = empty;
+        if (empty) emptyAtUs_ = now;
+    }
+
+    uint8_t  addr_;
+    uint32_t budgetUs_;
+    char     prev_ = 0;
+
+    bool     haveBurst_ = false, haveData_ = false, drained_ = false;
+    bool     betweenBursts_ = false;   /* last call skipped on cadence */
+    uint32_t burstStartUs_ = 0, burstPeriodUs_ = 0, lastDataUs_ = 0;
+    uint32_t emptyAtUs_ = 0;
+
+    Stats    stats_;
+};
@@ -0,0 +1,154 @@
+/*
+ * SafeNeck – PA1010D duty cycling while the wearer is stationary
+ * ==============================================================
+ * Tracking costs the module about 25 mA.  A wearer who has not moved
+ * gets the same coordinates every epoch, so once the IMU has been at
+ * rest for a while and a good fix is in hand the module is stepped down:
+ *
+ *   TRACKING   1 Hz, full power                     (PMTK225,0)
+ *   PERIODIC   runMs on, sleepMs off, repeated      (PMTK225,2,run,sleep,run,sleep)
+ *   STANDBY    no fixes, RTC and ephemeris kept     (PMTK161,0)
+ *
+ * Motion or an alert goes straight back to TRACKING; any byte written
+ * wakes the module from standby, so the PMTK225,0 that ends periodic
+ * mode ends standby too.  After an alert the module stays at full power
+ * for alertHoldMs whatever the IMU says.  Every resume is timed until the
+ * next sentence with a valid fix (time to fix); the first fix after boot
+ * is kept apart.
+ *
+ * The manager only decides; the firmware sends the command it returns
+ * (GpsI2cDrain::command adds '$', the checksum and CRLF):
+ *
+ *   GpsPowerManager gpsPower(120000, 600000, 3000, 27000, 600000);
+ *   if (const char *cmd = gpsPower.update(ms, imuAtRest, goodFix)) drain.command(cmd);
+ *   if (parser.feed(c) && parser.fix().valid) gpsPower.fixed(millis());
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+enum GpsPowerMode : uint8_t {
+    GPS_POWER_TRACKING,
+    GPS_POWER_PERIODIC,
+    GPS_POWER_STANDBY,
+    GPS_POWER_COUNT,
+};
+
+inline const char *gpsPowerName(GpsPowerMode m) {
+    switch (m) {
+    case GPS_POWER_TRACKING: return "tracking";
+    case GPS_POWER_PERIODIC: return "periodic";
+    case GPS_POWER_STANDBY:  return "standby";
+    default:                 return "?";
+    }
+}
+
+class GpsPowerManager {
+public:
+    struct Stats {
+        uint32_t resumes    = 0;   /* back to TRACKING from either low mode */
+        uint32_t byAlert    = 0;   /*   … of them forced by an alert        */
+        uint32_t fixes      = 0;   /* resumes that got their fix            */
+        uint32_t ttffLastMs = 0;
+        uint32_t ttffMaxMs  = 0;
+        uint32_t ttffSumMs  = 0;
+        uint32_t bootFixMs  = 0;   /* first fix after power-on, 0 = none   */
+    };
+
+    /* periodicAfterMs / standbyAfterMs: stationary this long before each
+     * step down (standbyAfterMs 0 = never standby).  runMs / sleepMs: the
+     * periodic cycle, sent as both the first and the second run/sleep
+     * pair of PMTK225.  alertHoldMs: full power after an alert. */
+    GpsPowerManager(uint32_t periodicAfterMs, uint32_t standbyAfterMs,
+                    uint32_t runMs, uint32_t sleepMs, uint32_t alertHoldMs)
+        : periodicAfterMs_(periodicAfterMs), standbyAfterMs_(standbyAfterMs),
+          alertHoldMs_(alertHoldMs) {
+        snprintf(periodicCmd_, sizeof(periodicCmd_), "PMTK225,2,%lu,%lu,%lu,%lu",
+                 (unsigned long)runMs, (unsigned long)sleepMs,
+                 (unsigned long)runMs, (unsigned long)sleepMs);
+    }
+
+    /* Once per loop pass.  `stationary`: the IMU says nobody is moving;
+     * `goodFix`: the fix in hand is worth holding on to.  Returns the PMTK
+     * sentence body to send now, or nullptr. */
+    const char *update(uint32_t ms, bool stationary, bool goodFix) {
+        if (!started_) { started_ = true; since_ = stillSince_ = resumeAt_ = ms; }
+        if (holding_ && (int32_t)(ms - holdUntil_) >= 0) holding_ = false;
+        if (!stationary) {
+            stillSince_ = ms;
+            return mode_ != GPS_POWER_TRACKING ? resume(ms) : nullptr;
+        }
+        uint32_t still = ms - stillSince_;
+        if (mode_ == GPS_POWER_TRACKING) {
+            if (still < periodicAfterMs_ || !goodFix || awaitingFix_ || holding_)
+                return nullptr;
+            enter(GPS_POWER_PERIODIC, ms);
+            return periodicCmd_;
+        }
+        if (mode_ == GPS_POWER_PERIODIC && standbyAfterMs_ && still >= standbyAfterMs_) {
+            enter(GPS_POWER_STANDBY, ms);
+            return "PMTK161,0";
+        }
+        return nullptr;
+    }
+
+    /* An alert: full power at once, and for alertHoldMs after. */
+    const char *alert(uint32_t ms) {
+        holdUntil_ = ms + alertHoldMs_;
+        holding_ = true;
+        stillSince_ = ms;
+        if (mode_ == GPS_POWER_TRACKING) return nullptr;
+        stats_.byAlert++;
+        return resume(ms);
+    }
+
+    /* A sentence with a valid fix arrived. */
+    void fixed(uint32_t ms) {
+        if (!awaitingFix_ || mode_ != GPS_POWER_TRACKING) return;
+        awaitingFix_ = false;
+        uint32_t ttff = ms - resumeAt_;
+        if (!stats_.resumes) {
+            stats_.bootFixMs = ttff ? ttff : 1;
+            return;
+        }
+        stats_.fixes++;
+        stats_.ttffLastMs = ttff;
+        stats_.ttffSumMs += ttff;
+        if (ttff > stats_.ttffMaxMs) stats_.ttffMaxMs = ttff;
+    }
+
+    GpsPowerMode mode()        const { return mode_; }
+    bool         awaitingFix() const { return awaitingFix_; }
+    const Stats &stats()       const { return stats_; }
+
+    /* Total time in `m` up to `now`, including the current stretch. */
+    uint32_t msIn(GpsPowerMode m, uint32_t now) const {
+        return msIn_[m] + (m == mode_ && started_ ? now - since_ : 0);
+    }
+
+private:
+    const char *resume(uint32_t ms) {
+        enter(GPS_POWER_TRACKING, ms);
+        stats_.resumes++;
+        resumeAt_ = ms;
+        awaitingFix_ = true;
+        return "PMTK225,0";
+    }
+
+    void enter(GpsPowerMode m, uint32_t ms) {
+        msIn_[mode_] += ms - since_;
+        since_ = ms;
+        mode_ = m;
+    }
+
+    uint32_t     periodicAfterMs_, standbyAfterMs_, alertHoldMs_;
+    char         periodicCmd_[56];      /* "PMTK225,2," + 4 × 10 digits */
+    GpsPowerMode mode_        = GPS_POWER_TRACKING;
+    bool         started_     = false;
+    bool         awaitingFix_ = true;     /* boot counts as a resume */
+    bool         holding_     = false;    /* holdUntil_ not yet passed */
+    uint32_t     since_ = 0, stillSince_ = 0, resumeAt_ = 0, holdUntil_ = 0;
+    uint32_t     msIn_[GPS_POWER_COUNT] = { 0, 0, 0 };
+    Stats        stats_;
+};
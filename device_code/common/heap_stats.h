@@ -0,0 +1,75 @@
+/*
+ * SafeNeck – heap usage and fragmentation report
+ * ==============================================
+ * A device that runs for weeks must not allocate in steady state: each
+ * String reallocation leaves a hole, and holes add up until a large
+ * allocation fails.  This reads the allocator's own figures:
+ *
+ *   usedBytes   in live blocks          freeBytes   free inside the heap
+ *   freeBlocks  free chunks (holes), HEAP_BLOCKS_UNKNOWN where the
+ *               allocator does not say
+ *
+ * On the device they come from newlib-nano's mallinfo(), which fills in
+ * only arena, uordblks and fordblks: ordblks is always 0 there, so the
+ * hole count is reported as unknown rather than as a constant 0.  On the
+ * host the shim supplies all three from glibc.  HeapWatch compares
+ * successive readings and keeps the peak of the used bytes it has seen
+ * (usmblks is 0 under newlib-nano too): once the firmware is up, used
+ * bytes and free blocks should never move again, and every reading where
+ * they do is counted as churn.  On the device that comes down to used
+ * bytes alone.
+ *
+ *   HeapWatch heap;
+ *   if (heap.check()) log(heap.last(), heap.peakBytes(), heap.churn());
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+
+static const uint32_t HEAP_BLOCKS_UNKNOWN = 0xFFFFFFFF;
+
+struct HeapStats {
+    uint32_t usedBytes  = 0;
+    uint32_t freeBytes  = 0;
+    uint32_t freeBlocks = HEAP_BLOCKS_UNKNOWN;
+};
+
+#if defined(PLATFORM_ID)
+#include <malloc.h>
+
+inline HeapStats heapStats() {
+    struct mallinfo mi = mallinfo();
+    HeapStats h;
+    h.usedBytes = (uint32_t)mi.uordblks;
+    h.freeBytes = (uint32_t)mi.fordblks;
+    return h;                /* freeBlocks: not kept by newlib-nano */
+}
+#else
+HeapStats heapStats();   /* host/shim/hal_host.cpp */
+#endif
+
+class HeapWatch {
+public:
+    /* Reads the heap; true when used bytes or free blocks moved since the
+     * last check (the first check only sets the baseline). */
+    bool check() {
+        HeapStats h = heapStats();
+        bool changed = checks_ && (h.usedBytes != last_.usedBytes || h.freeBlocks != last_.freeBlocks);
+        if (changed) churn_++;
+        if (h.usedBytes > peak_) peak_ = h.usedBytes;
+        last_ = h;
+        checks_++;
+        return changed;
+    }
+
+    const HeapStats &last()      const { return last_; }
+    uint32_t         peakBytes() const { return peak_; }     /* most used at a check */
+    uint32_t         churn()     const { return churn_; }    /* checks that saw a change */
+    uint32_t         checks()    const { return checks_; }
+
+private:
+    HeapStats last_;
+    uint32_t  peak_   = 0;
+    uint32_t  churn_  = 0;
+    uint32_t  checks_ = 0;
+};
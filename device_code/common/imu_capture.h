@@ -0,0 +1,367 @@
+/*
+ * SafeNeck – pre/post-alert IMU capture, compressed for upload
+ * ============================================================
+ * Keeps the last N raw samples (Q-format int16 x/y/z plus their ms
+ * stamps) in a fixed ring.  trigger() marks the newest sample; once
+ * POST more have arrived the ring is frozen into a compressed snapshot
+ * and sampling carries on into the ring at once.  The snapshot then goes
+ * out a chunk at a time, whenever the caller has room for a publish.
+ *
+ * Snapshot encoding (CAPTURE_VERSION 1, little-endian):
+ *
+ *   version:u8  kind:u8  qPoint:u8  0:u8  unixTime:u32
+ *   count:u16   trigger:u16   t0:u32   x0:i16 y0:i16 z0:i16
+ *   bitstream — blocks of 16 samples; per block and per channel
+ *   (Δt, x, y, z) a 4-bit Rice parameter k, then for every sample the
+ *   zigzag of its delta (Δt: change of the interval; axes: change of
+ *   the value) as unary(v >> k), 0, then the low k bits.  Quotients of
+ *   RICE_ESCAPE or more are written as RICE_ESCAPE ones and 32 raw bits.
+ *
+ * Chunks are "~" + base85(id:u16 index:u8 total:u8 bytes…); decode
+ * them with host/capturedecode.
+ *
+ *   ImuCapture<640, 200> cap(8);              // Q8 samples
+ *   cap.push(ms, x, y, z);                   // every sample
+ *   cap.trigger(unixTime, ALERT_FALL);       // on an alert
+ *   if (cap.nextChunk(text, sizeof(text))) publish(text) && cap.sent();
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "base85.h"
+#include "varint.h"
+
+static const uint8_t  CAPTURE_VERSION     = 1;
+static const uint8_t  CAPTURE_CHANNELS    = 4;         /* Δt, x, y, z       */
+static const uint8_t  CAPTURE_BLOCK       = 16;
+static const uint8_t  RICE_ESCAPE         = 24;
+static const size_t   CAPTURE_HEADER      = 22;
+static const size_t   CAPTURE_CHUNK_HEAD  = 4;
+
+/* ── Bit I/O, LSB first ───────────────────────────────────────────── */
+class BitWriter {
+public:
+    BitWriter(uint8_t *out, size_t cap) : out_(out), cap_(cap) {}
+
+    void put(uint32_t v, uint8_t bits) {
+        for (uint8_t i = 0; i < bits; i++) bit((v >> i) & 1);
+    }
+    void unary(uint32_t q) {
+        for (uint32_t i = 0; i < q; i++) bit(1);
+        bit(0);
+    }
+    void rice(uint32_t v, uint8_t k) {
+        uint32_t q = v >> k;
+        if (q >= RICE_ESCAPE) {
+            for (uint8_t i = 0; i < RICE_ESCAPE; i++) bit(1);
+            put(v, 32);
+            return;
+        }
+        unary(q);
+        put(v, k);
+    }
+
+    size_t bytes()    const { return (bits_ + 7) / 8; }
+    bool   overflow() const { return overflow_; }
+
+private:
+    void bit(uint32_t b) {
+        size_t byte = bits_ >> 3;
+        if (byte >= cap_) { overflow_ = true; return; }
+        if (!(bits_ & 7)) out_[byte] = 0;
+        out_[byte] |= (uint8_t)(b << (bits_ & 7));
+        bits_++;
+    }
+
+    uint8_t *out_;
+    size_t   cap_;
+    size_t   bits_ = 0;
+    bool     overflow_ = false;
+};
+
+class BitReader {
+public:
+    BitReader(const uint8_t *in, size_t len) : in_(in), len_(len) {}
+
+    bool get(uint32_t &v, uint8_t bits) {
+        v = 0;
+        for (uint8_t i = 0; i < bits; i++) {
+            uint32_t b;
+            if (!bit(b)) return false;
+            v |= b << i;
+        }
+        return true;
+    }
+    bool rice(uint32_t &v, uint8_t k) {
+        uint32_t q = 0, b;
+        for (;;) {
+            if (!bit(b)) return false;
+            if (!b) break;
+            if (++q == RICE_ESCAPE) return get(v, 32);
+        }
+        uint32_t low;
+        if (!get(low, k)) return false;
+        v = q << k | low;
+        return true;
+    }
+
+private:
+    bool bit(uint32_t &b) {
+        if (pos_ >= len_ * 8) return false;
+        b = (in_[pos_ >> 3] >> (pos_ & 7)) & 1;
+        pos_++;
+        return true;
+    }
+
+    const uint8_t *in_;
+    size_t         len_;
+    size_t         pos_ = 0;
+};
+
+/* Bits a block of zigzagged values costs at Rice parameter k. */
+inline uint32_t riceCost(const uint32_t *v, uint8_t n, uint8_t k) {
+    uint32_t bits = 0;
+    for (uint8_t i = 0; i < n; i++) {
+        uint32_t q = v[i] >> k;
+        bits += q >= RICE_ESCAPE ? RICE_ESCAPE + 32 : q + 1 + k;
+    }
+    return bits;
+}
+
+inline uint8_t riceBestK(const uint32_t *v, uint8_t n) {
+    uint8_t  best = 0;
+    uint32_t bestBits = riceCost(v, n, 0);
+    for (uint8_t k = 1; k < 16; k++) {
+        uint32_t b = riceCost(v, n, k);
+        if (b < bestBits) { bestBits = b; best = k; }
+    }
+    return best;
+}
+
+struct CaptureSample {
+    uint32_t ms;
+    int16_t  x, y, z;
+};
+
+struct CaptureInfo {
+    uint8_t  kind;
+    uint8_t  qPoint;
+    uint32_t unixTime;
+    uint16_t count;
+    uint16_t trigger;       /* index of the sample the alert fired on */
+};
+
+/* Encodes samples at(0) … at(n − 1); returns the snapshot length, or 0
+ * if `cap` is too small. */
+template <typename At>
+size_t encodeCapture(uint8_t *out, size_t cap, const CaptureInfo &info, At at, uint16_t n) {
+    if (!n || cap < CAPTURE_HEADER) return 0;
+    uint8_t *p = out;
+    auto u16 = [&](uint16_t v) { *p++ = (uint8_t)v; *p++ = (uint8_t)(v >> 8); };
+    auto u32 = [&](uint32_t v) { u16((uint16_t)v); u16((uint16_t)(v >> 16)); };
+    *p++ = CAPTURE_VERSION;
+    *p++ = info.kind;
+    *p++ = info.qPoint;
+    *p++ = 0;
+    u32(info.unixTime);
+    u16(n);
+    u16(info.trigger);
+    const CaptureSample &s0 = at(0);
+    u32(s0.ms);
+    u16((uint16_t)s0.x);
+    u16((uint16_t)s0.y);
+    u16((uint16_t)s0.z);
+
+    BitWriter w(p, cap - CAPTURE_HEADER);
+    int32_t prevDt = 0;
+    for (uint16_t b = 1; b < n; b += CAPTURE_BLOCK) {
+        uint8_t m = n - b < CAPTURE_BLOCK ? (uint8_t)(n - b) : CAPTURE_BLOCK;
+        uint32_t v[CAPTURE_CHANNELS][CAPTURE_BLOCK];
+        for (uint8_t i = 0; i < m; i++) {
+            const CaptureSample &c = at(b + i), &l = at(b + i - 1);
+            int32_t dt = (int32_t)(c.ms - l.ms);
+            v[0][i] = zigzag(dt - prevDt);
+            v[1][i] = zigzag((int32_t)c.x - l.x);
+            v[2][i] = zigzag((int32_t)c.y - l.y);
+            v[3][i] = zigzag((int32_t)c.z - l.z);
+            prevDt = dt;
+        }
+        for (uint8_t ch = 0; ch < CAPTURE_CHANNELS; ch++) {
+            uint8_t k = riceBestK(v[ch], m);
+            w.put(k, 4);
+            for (uint8_t i = 0; i < m; i++) w.rice(v[ch][i], k);
+        }
+    }
+    return w.overflow() ? 0 : CAPTURE_HEADER + w.bytes();
+}
+
+/* Decodes a whole snapshot into `s` (room for `max`); false if malformed. */
+inline bool decodeCapture(const uint8_t *in, size_t len, CaptureInfo &info,
+                          CaptureSample *s, uint16_t max) {
+    if (len < CAPTURE_HEADER || in[0] != CAPTURE_VERSION) return false;
+    const uint8_t *p = in;
+    auto u16 = [&]() { uint16_t v = (uint16_t)(p[0] | p[1] << 8); p += 2; return v; };
+    auto u32 = [&]() { uint32_t lo = u16(); return lo | (uint32_t)u16() << 16; };
+    p += 1;
+    info.kind     = *p++;
+    info.qPoint   = *p++;
+    p++;
+    info.unixTime = u32();
+    info.count    = u16();
+    info.trigger  = u16();
+    if (!info.count || info.count > max) return false;
+    s[0].ms = u32();
+    s[0].x  = (int16_t)u16();
+    s[0].y  = (int16_t)u16();
+    s[0].z  = (int16_t)u16();
+
+    BitReader r(p, len - CAPTURE_HEADER);
+    int32_t dt = 0;
+    for (uint16_t b = 1; b < info.count; b += CAPTURE_BLOCK) {
+        uint8_t m = info.count - b < CAPTURE_BLOCK ? (uint8_t)(info.count - b) : CAPTURE_BLOCK;
+        int32_t d[CAPTURE_CHANNELS][CAPTURE_BLOCK];
+        for (uint8_t ch = 0; ch < CAPTURE_CHANNELS; ch++) {
+            uint32_t k, v;
+            if (!r.get(k, 4)) return false;
+            for (uint8_t i = 0; i < m; i++) {
+                if (!r.rice(v, (uint8_t)k)) return false;
+                d[ch][i] = unzigzag(v);
+            }
+        }
+        for (uint8_t i = 0; i < m; i++) {
+            CaptureSample &c = s[b + i];
+            const CaptureSample &l = s[b + i - 1];
+            dt  += d[0][i];
+            c.ms = l.ms + (uint32_t)dt;
+            c.x  = (int16_t)(l.x + d[1][i]);
+            c.y  = (int16_t)(l.y + d[2][i]);
+            c.z  = (int16_t)(l.z + d[3][i]);
+        }
+    }
+    return true;
+}
+
+/* Parses one chunk's text ("~…"); `bytes` gets its payload. */
+inline bool decodeCaptureChunk(const char *text, size_t len, uint16_t &id, uint8_t &index,
+                               uint8_t &total, uint8_t *bytes, size_t cap, size_t &n) {
+    if (len < 2 || text[0] != '~') return false;
+    uint8_t buf[512];
+    int got = base85Decode(buf, sizeof(buf), text + 1, len - 1);
+    if (got < (int)CAPTURE_CHUNK_HEAD || (size_t)got - CAPTURE_CHUNK_HEAD > cap) return false;
+    id    = (uint16_t)(buf[0] | buf[1] << 8);
+    index = buf[2];
+    total = buf[3];
+    n     = (size_t)got - CAPTURE_CHUNK_HEAD;
+    memcpy(bytes, buf + CAPTURE_CHUNK_HEAD, n);
+    return index < total;
+}
+
+/* ── Device side ──────────────────────────────────────────────────── */
+template <uint16_t N, uint16_t POST, size_t SNAPSHOT_MAX = 4096>
+class ImuCapture {
+    static_assert(POST > 0 && POST < N, "capture needs room for samples before the trigger");
+
+public:
+    struct Stats {
+        uint32_t captures = 0;
+        uint32_t busy     = 0;      /* triggers while a snapshot was pending */
+        uint32_t failed   = 0;      /* snapshot did not fit SNAPSHOT_MAX     */
+        uint32_t chunks   = 0;      /* chunks handed out and sent            */
+        uint32_t rawBytes = 0;      /* last snapshot, 10 B per sample        */
+        uint32_t bytes    = 0;      /* last snapshot, encoded                */
+    };
+
+    explicit ImuCapture(uint8_t qPoint) : qPoint_(qPoint) {}
+
+    void push(uint32_t ms, int16_t x, int16_t y, int16_t z) {
+        CaptureSample &s = ring_[head_ % N];
+        s.ms = ms; s.x = x; s.y = y; s.z = z;
+        head_++;
+        if (post_ && --post_ == 0) freeze();
+    }
+
+    /* Snapshot around the newest sample; false if one is still pending. */
+    bool trigger(uint32_t unixTime, uint8_t kind) {
+        if (post_ || len_) { stats_.busy++; return false; }
+        info_.unixTime = unixTime;
+        info_.kind     = kind;
+        post_          = POST;
+        triggerAt_     = head_ - 1;
+        return true;
+    }
+
+    bool pending() const { return len_ > 0; }
+
+    /* Text for the next chunk, sized for `cap` (NUL included); 0 if none. */
+    size_t nextChunk(char *out, size_t cap) {
+        if (!len_) return 0;
+        size_t per = chunkPayload(cap);
+        if (!per) return 0;
+        uint8_t total = (uint8_t)((len_ + per - 1) / per);
+        size_t off = (size_t)chunk_ * per;
+        size_t n = len_ - off < per ? len_ - off : per;
+
+        uint8_t buf[CAPTURE_CHUNK_HEAD + 256];
+        buf[0] = (uint8_t)id_;
+        buf[1] = (uint8_t)(id_ >> 8);
+        buf[2] = chunk_;
+        buf[3] = total;
+        memcpy(buf + CAPTURE_CHUNK_HEAD, snapshot_ + off, n);
+        out[0] = '~';
+        size_t len = base85Encode(out + 1, cap - 1, buf, CAPTURE_CHUNK_HEAD + n);
+        return len ? len + 1 : 0;
+    }
+
+    /* The chunk from nextChunk() was queued; move on. */
+    void sent() {
+        if (!len_) return;
+        stats_.chunks++;
+        size_t per = lastPer_;
+        if ((size_t)(++chunk_) * per >= len_) { len_ = 0; chunk_ = 0; }
+    }
+
+    const Stats &stats() const { return stats_; }
+
+private:
+    size_t chunkPayload(size_t cap) {
+        if (cap < 2 + base85Len(CAPTURE_CHUNK_HEAD + 1)) return 0;
+        size_t bytes = (cap - 2) / 5 * 4 - CAPTURE_CHUNK_HEAD;     /* '~' and NUL */
+        if (bytes > 256) bytes = 256;
+        lastPer_ = bytes;
+        return bytes;
+    }
+
+    void freeze() {
+        uint32_t n = head_ < N ? head_ : N;
+        uint32_t first = head_ - n;
+        info_.qPoint  = qPoint_;
+        info_.count   = (uint16_t)n;
+        info_.trigger = (uint16_t)(triggerAt_ - first);
+        len_ = encodeCapture(snapshot_, SNAPSHOT_MAX, info_,
+                             [&](uint32_t i) -> const CaptureSample & { return ring_[(first + i) % N]; },
+                             (uint16_t)n);
+        stats_.rawBytes = n * 10;
+        stats_.bytes    = (uint32_t)len_;
+        if (!len_) { stats_.failed++; return; }
+        stats_.captures++;
+        id_    = (uint16_t)(info_.unixTime ^ stats_.captures << 12);
+        chunk_ = 0;
+    }
+
+    uint8_t       qPoint_;
+    CaptureSample ring_[N];
+    uint32_t      head_ = 0;
+    uint16_t      post_ = 0;
+    uint32_t      triggerAt_ = 0;
+    CaptureInfo   info_ = {};
+
+    uint8_t       snapshot_[SNAPSHOT_MAX];
+    size_t        len_ = 0;
+    size_t        lastPer_ = 0;
+    uint16_t      id_ = 0;
+    uint8_t       chunk_ = 0;
+    Stats         stats_;
+};
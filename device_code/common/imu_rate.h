@@ -0,0 +1,171 @@
+/*
+ * SafeNeck – motion-adaptive IMU report rate
+ * ==========================================
+ * Picks the BNO085 report interval from what the samples themselves
+ * show, so a device lying on a table or worn by someone sitting still
+ * is not read at the rate a fall needs:
+ *
+ *   REST    nothing moving for restAfterMs           low rate
+ *   ACTIVE  moving (walking, fidgeting)              the firmware's usual rate
+ *   BURST   a transient, or motion starting at REST  200+ Hz for burstHoldMs
+ *
+ * update() is called with every sample and says when the rate changed;
+ * the caller reprograms the sensor right there, so a burst starts one
+ * sample after the transient that asked for it.  A transient during a
+ * burst extends it.  What counts as moving or transient is the
+ * firmware's call (stability class, |a| band, …).
+ *
+ * Time spent at each rate is accumulated for the logs:
+ *
+ *   ImuRateGovernor rate(50000, 10000, 5000, 5000, 2000);
+ *   if (rate.update(ms, moving, transient)) enableReport(rate.intervalUs());
+ *   log(rate.msIn(IMU_RATE_REST, ms), rate.switches());
+ *
+ * The governor belongs to the thread that feeds it.  Another thread reads
+ * an ImuRateShared that the owner publishes after each poll: the rate as
+ * an atomic, and the time shares as one consistent snapshot.
+ *
+ *   shared.publish(rate, millis());                  // IMU thread
+ *   if (shared.rate() == IMU_RATE_REST) …;           // loop()
+ *   ImuRateSnapshot s = shared.read();  log(s.msIn(IMU_RATE_REST, now));
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+enum ImuRate : uint8_t {
+    IMU_RATE_REST,
+    IMU_RATE_ACTIVE,
+    IMU_RATE_BURST,
+    IMU_RATE_COUNT,
+};
+
+inline const char *imuRateName(ImuRate r) {
+    switch (r) {
+    case IMU_RATE_REST:   return "rest";
+    case IMU_RATE_ACTIVE: return "active";
+    case IMU_RATE_BURST:  return "burst";
+    default:              return "?";
+    }
+}
+
+class ImuRateGovernor {
+public:
+    /* Report intervals in µs; the governor starts ACTIVE. */
+    ImuRateGovernor(uint32_t restUs, uint32_t activeUs, uint32_t burstUs,
+                    uint32_t restAfterMs, uint32_t burstHoldMs)
+        : restAfterMs_(restAfterMs), burstHoldMs_(burstHoldMs) {
+        intervalUs_[IMU_RATE_REST]   = restUs;
+        intervalUs_[IMU_RATE_ACTIVE] = activeUs;
+        intervalUs_[IMU_RATE_BURST]  = burstUs;
+    }
+
+    /* One sample's verdict; true when the rate changed. */
+    bool update(uint32_t ms, bool moving, bool transient) {
+        if (!started_) { started_ = true; since_ = lastMotion_ = ms; }
+        if (moving || transient) lastMotion_ = ms;
+
+        ImuRate next = rate_;
+        if (transient || (moving && rate_ == IMU_RATE_REST)) {
+            next = IMU_RATE_BURST;
+            burstUntil_ = ms + burstHoldMs_;
+        } else if (rate_ == IMU_RATE_BURST && (int32_t)(ms - burstUntil_) < 0) {
+            next = IMU_RATE_BURST;
+        } else {
+            next = ms - lastMotion_ >= restAfterMs_ ? IMU_RATE_REST : IMU_RATE_ACTIVE;
+        }
+        if (next == rate_) return false;
+
+        msIn_[rate_] += ms - since_;
+        since_ = ms;
+        rate_ = next;
+        switches_++;
+        return true;
+    }
+
+    ImuRate  rate()       const { return rate_; }
+    uint32_t intervalUs() const { return intervalUs_[rate_]; }
+    uint32_t intervalUs(ImuRate r) const { return intervalUs_[r]; }
+    uint32_t switches()   const { return switches_; }
+    bool     started()    const { return started_; }
+
+    /* Total time at `r` up to `now`, including the current stretch. */
+    uint32_t msIn(ImuRate r, uint32_t now) const {
+        return msIn_[r] + (r == rate_ && started_ ? now - since_ : 0);
+    }
+
+private:
+    uint32_t intervalUs_[IMU_RATE_COUNT];
+    uint32_t msIn_[IMU_RATE_COUNT] = { 0, 0, 0 };
+    uint32_t restAfterMs_, burstHoldMs_;
+    ImuRate  rate_       = IMU_RATE_ACTIVE;
+    bool     started_    = false;
+    uint32_t since_      = 0;
+    uint32_t lastMotion_ = 0;
+    uint32_t burstUntil_ = 0;
+    uint32_t switches_   = 0;
+};
+
+/* ImuRateGovernor's figures as of one ImuRateShared::publish(). */
+struct ImuRateSnapshot {
+    ImuRate  rate       = IMU_RATE_ACTIVE;
+    uint32_t intervalUs = 0;
+    uint32_t switches   = 0;
+    bool     started    = false;
+    uint32_t atMs       = 0;
+    uint32_t msAt[IMU_RATE_COUNT] = { 0, 0, 0 };
+
+    /* As ImuRateGovernor::msIn(): the current stretch runs on to `now`. */
+    uint32_t msIn(ImuRate r, uint32_t now) const {
+        return msAt[r] + (r == rate && started ? now - atMs : 0);
+    }
+};
+
+/* One writer (the governor's thread), any number of readers.  A sequence
+ * count, odd while a publish is under way, lets read() retry instead of
+ * returning half of one publish and half of the next. */
+class ImuRateShared {
+public:
+    void publish(const ImuRateGovernor &g, uint32_t now) {
+        uint32_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        rate_.store(g.rate(), std::memory_order_relaxed);
+        intervalUs_.store(g.intervalUs(), std::memory_order_relaxed);
+        switches_.store(g.switches(), std::memory_order_relaxed);
+        started_.store(g.started(), std::memory_order_relaxed);
+        atMs_.store(now, std::memory_order_relaxed);
+        for (int r = 0; r < IMU_RATE_COUNT; r++)
+            msAt_[r].store(g.msIn((ImuRate)r, now), std::memory_order_relaxed);
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    ImuRate rate() const { return (ImuRate)rate_.load(std::memory_order_relaxed); }
+
+    ImuRateSnapshot read() const {
+        ImuRateSnapshot s;
+        uint32_t seq;
+        do {
+            seq = seq_.load(std::memory_order_acquire);
+            s.rate       = (ImuRate)rate_.load(std::memory_order_relaxed);
+            s.intervalUs = intervalUs_.load(std::memory_order_relaxed);
+            s.switches   = switches_.load(std::memory_order_relaxed);
+            s.started    = started_.load(std::memory_order_relaxed);
+            s.atMs       = atMs_.load(std::memory_order_relaxed);
+            for (int r = 0; r < IMU_RATE_COUNT; r++)
+                s.msAt[r] = msAt_[r].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((seq & 1) || seq != seq_.load(std::memory_order_relaxed));
+        return s;
+    }
+
+private:
+    std::atomic<uint32_t> seq_{0};
+    std::atomic<uint8_t>  rate_{IMU_RATE_ACTIVE};
+    std::atomic<uint32_t> intervalUs_{0};
+    std::atomic<uint32_t> switches_{0};
+    std::atomic<bool>     started_{false};
+    std::atomic<uint32_t> atMs_{0};
+    std::atomic<uint32_t> msAt_[IMU_RATE_COUNT] = {};
+};
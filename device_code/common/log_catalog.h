@@ -0,0 +1,75 @@
+/*
+ * SafeNeck – format strings of the deferred binary log
+ * ====================================================
+ * Every message that goes through common/binlog.h is listed here once,
+ * as X(ID, "printf format").  The firmware stores the ID and the raw
+ * arguments; the idle-time drain and host/logdecode both format from
+ * this table, so the decoder always reads the strings of the build it
+ * decodes.  Arguments are numbers only (%d %u %x %c %f %e %g, any
+ * flags, width, precision and l/h modifiers); no %s.
+ *
+ * Append new entries at the end: IDs are positions, and the catalog
+ * hash logged at boot (LOG_CATALOG_HASH) tells the decoder when a
+ * capture came from a different table.
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+
+#define SAFENECK_LOG_CATALOG(X)                                                              \
+    X(LOG_BOOT,              "[log] catalog %08lx, %u formats")                              \
+    X(LOG_DROPPED,           "[log] %lu records dropped (ring full)")                        \
+    /* main.c */                                                                             \
+    X(LOG_FALL_DETECTED,     "[SafeNeck] ** FALL DETECTED ** %.2f g")                        \
+    X(LOG_SHADOW_FALL,       "[SafeNeck] shadow profile: fall at %.2f g (%lu so far, not sent)") \
+    X(LOG_FALL_ALERT,        "[SafeNeck] ** FALL ALERT queued **")                           \
+    X(LOG_FALL_ALERT_UPDATE, "[SafeNeck] ** FALL ALERT update %u queued ** %u falls in %u s, peak %u mg") \
+    X(LOG_FALL_ALERT_FULL,   "[SafeNeck] Fall alert not queued (outbox full)")               \
+    X(LOG_IMU_DROPS,         "[SafeNeck] IMU ring full – %lu samples dropped")               \
+    X(LOG_IMU_GAPS,          "[SafeNeck] BNO085 sequence gaps – %lu reports missed")         \
+    /* reference.c */                                                                        \
+    X(LOG_IMPACT,            "IMPACT detected: %.2fg (threshold: %.1fg, jerk %.0fg/s)")      \
+    X(LOG_FREEFALL,          "FREEFALL confirmed: %.2fg (sustained %lums)")                  \
+    X(LOG_FALL_PATTERN,      "FALL PATTERN: freefall->impact (%.2fg)")                       \
+    X(LOG_MONITORING,        "Monitoring post-impact activity...")                           \
+    X(LOG_POST_TIMEOUT,      "Post-impact timeout, returning to idle")                       \
+    X(LOG_ALERT_FALL,        "*** ALERT: fall ***")                                          \
+    X(LOG_ALERT_IMPACT,      "*** ALERT: impact ***")                                        \
+    X(LOG_ALERT_UPDATE_FALL, "*** ALERT UPDATE %u: fall, %u detections in %u s ***")         \
+    X(LOG_ALERT_UPDATE_IMPACT, "*** ALERT UPDATE %u: impact, %u detections in %u s ***")     \
+    X(LOG_FOLDED_FALL,       "Alert folded: fall (%u in this alert)")                        \
+    X(LOG_FOLDED_IMPACT,     "Alert folded: impact (%u in this alert)")                      \
+    X(LOG_CAPTURE_SKIPPED,   "Capture skipped: previous one still uploading")                \
+    X(LOG_PUB_ALERT,         "Publishing safety/alert: kind=%u g=%umg count=%u span=%us update=%u fix=%u lat=%ld lon=%ld") \
+    X(LOG_PUB_IMPACT,        "Publishing safety/impact_detected: g=%umg threshold=%umg")     \
+    X(LOG_PUB_FREEFALL,      "Publishing safety/freefall_detected: g=%umg duration=%lums")   \
+    X(LOG_PUB_POSITION,      "Publishing gps/position: fix=%u lat=%ld lon=%ld sats=%u hdop=%u") \
+    X(LOG_SHADOW_ALERT_FALL,   "Shadow profile would alert: fall %.2fg")                     \
+    X(LOG_SHADOW_ALERT_IMPACT, "Shadow profile would alert: impact %.2fg")
+
+enum LogId : uint8_t {
+#define SAFENECK_LOG_ID(id, fmt) id,
+    SAFENECK_LOG_CATALOG(SAFENECK_LOG_ID)
+#undef SAFENECK_LOG_ID
+    LOG_ID_COUNT
+};
+
+static const char *const LOG_FORMATS[LOG_ID_COUNT] = {
+#define SAFENECK_LOG_FMT(id, fmt) fmt,
+    SAFENECK_LOG_CATALOG(SAFENECK_LOG_FMT)
+#undef SAFENECK_LOG_FMT
+};
+
+/* FNV-1a over every format and its terminator, in ID order. */
+constexpr uint32_t logCatalogHash() {
+    uint32_t h = 2166136261u;
+#define SAFENECK_LOG_HASH(id, fmt)                                 \
+    for (const char *p = fmt;; p++) {                              \
+        h = (h ^ (uint8_t)*p) * 16777619u;                         \
+        if (!*p) break;                                            \
+    }
+    SAFENECK_LOG_CATALOG(SAFENECK_LOG_HASH)
+#undef SAFENECK_LOG_HASH
+    return h;
+}
+static constexpr uint32_t LOG_CATALOG_HASH = logCatalogHash();
@@ -0,0 +1,220 @@
+/*
+ * SafeNeck – single-pass RMC/GGA tokenizer with fixed-point output
+ * ================================================================
+ * Rides on NmeaFramer: every payload character is folded into the
+ * current field's integer accumulator as it arrives, so there is no line
+ * copy, no strtok, no atof and no double maths.  A sentence only touches
+ * the published fix once its checksum has been verified.
+ *
+ *   NmeaFixParser gps;
+ *   while (Wire.available()) gps.feed(Wire.read());
+ *   if (gps.fix().valid) ... gps.fix().latE7 ...
+ *
+ * Units: lat/lon in 1e-7 degrees, speed in 0.1 km/h, HDOP ×100,
+ * altitude in decimetres, UTC as hhmmss and date as ddmmyy.
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "nmea_stream.h"
+
+struct GpsFix {
+    int32_t  latE7     = 0;
+    int32_t  lonE7     = 0;
+    uint16_t speedKmhX10 = 0;
+    uint16_t hdopX100  = 0;
+    int32_t  altDm     = 0;
+    uint32_t utcHhmmss = 0;
+    uint32_t dateDdmmyy = 0;
+    uint8_t  sats      = 0;
+    uint8_t  quality   = 0;     /* GGA: 0 none, 1 GPS, 2 DGPS, …        */
+    bool     valid     = false; /* RMC status 'A'                       */
+};
+
+class NmeaFixParser {
+public:
+    /* Returns true when a verified RMC/GGA sentence updated fix(). */
+    bool feed(char c) {
+        switch (framer_.feed(c)) {
+        case NmeaFramer::BODY:
+            accumulate(c);
+            return false;
+        case NmeaFramer::FIELD:
+            endField();
+            field_++;
+            resetField();
+            return false;
+        case NmeaFramer::VALID:
+            endField();
+            {
+                bool used = type_ != OTHER;
+                if (used) commit();
+                startSentence();
+                return used;
+            }
+        case NmeaFramer::INVALID:
+            startSentence();
+            return false;
+        default:
+            /* '$' restarts the framer – follow it. */
+            if (c == '$') startSentence();
+            return false;
+        }
+    }
+
+    const GpsFix     &fix()    const { return fix_; }
+    const NmeaFramer &framer() const { return framer_; }
+
+    uint32_t rmcCount = 0;
+    uint32_t ggaCount = 0;
+
+private:
+    enum Type : uint8_t { OTHER, RMC, GGA };
+
+    void startSentence() {
+        type_ = OTHER;
+        field_ = 0;
+        staged_ = fix_;
+        resetField();
+    }
+
+    void resetField() {
+        int_ = 0;
+        frac_ = 0;
+        fracDigits_ = 0;
+        dot_ = false;
+        first_ = 0;
+        empty_ = true;
+    }
+
+    void accumulate(char c) {
+        if (empty_) { first_ = c; empty_ = false; }
+        if (field_ == 0) return;
+        if (c >= '0' && c <= '9') {
+            if (!dot_) {
+                int_ = int_ * 10 + (uint32_t)(c - '0');
+            } else if (fracDigits_ < 7) {
+                frac_ = frac_ * 10 + (uint32_t)(c - '0');
+                fracDigits_++;
+            }
+        } else if (c == '.') {
+            dot_ = true;
+        }
+    }
+
+    /* Fraction rescaled to exactly `digits` decimal places. */
+    uint32_t frac(uint8_t digits) const {
+        uint32_t f = frac_;
+        uint8_t  d = fracDigits_;
+        while (d < digits) { f *= 10; d++; }
+        while (d > digits) { f /= 10; d--; }
+        return f;
+    }
+
+    /* ddmm.mmmmm → 1e-7 degrees: deg·1e7 + minutes·1e7/60 */
+    int32_t coordE7() const {
+        uint32_t deg  = int_ / 100;
+        uint32_t minE5 = (int_ % 100) * 100000UL + frac(5);
+        return (int32_t)(deg * 10000000UL + (minE5 * 5 + 1) / 3);
+    }
+
+    void endField() {
+        if (field_ == 0) {
+            if (framer_.typeIs("RMC"))      type_ = RMC;
+            else if (framer_.typeIs("GGA")) type_ = GGA;
+            return;
+        }
+        if (type_ == RMC) endRmcField();
+        else if (type_ == GGA) endGgaField();
+    }
+
+    /* $xxRMC,time,status,lat,N/S,lon,E/W,speed(kn),course,date,… */
+    void endRmcField() {
+        switch (field_) {
+        case 1: staged_.utcHhmmss = int_; break;
+        case 2: staged_.valid = first_ == 'A'; break;
+        case 3: lat_ = coordE7(); latSet_ = !empty_; break;
+        case 4: if (first_ == 'S') lat_ = -lat_; break;
+        case 5: lon_ = coordE7(); lonSet_ = !empty_; break;
+        case 6: if (first_ == 'W') lon_ = -lon_; break;
+        case 7: {
+            /* knots×100 → km/h×10 */
+            uint32_t kn100 = int_ * 100 + frac(2);
+            staged_.speedKmhX10 = (uint16_t)((kn100 * 1852UL + 5000) / 10000);
+            break;
+        }
+        case 9: staged_.dateDdmmyy = int_; break;
+        }
+    }
+
+    /* $xxGGA,time,lat,N/S,lon,E/W,quality,sats,hdop,alt,M,… */
+    void endGgaField() {
+        switch (field_) {
+        case 1: staged_.utcHhmmss = int_; break;
+        case 2: lat_ = coordE7(); latSet_ = !empty_; break;
+        case 3: if (first_ == 'S') lat_ = -lat_; break;
+        case 4: lon_ = coordE7(); lonSet_ = !empty_; break;
+        case 5: if (first_ == 'W') lon_ = -lon_; break;
+        case 6: staged_.quality = (uint8_t)int_; break;
+        case 7: staged_.sats = (uint8_t)int_; break;
+        case 8: staged_.hdopX100 = (uint16_t)(int_ * 100 + frac(2)); break;
+        case 9: {
+            int32_t dm = (int32_t)(int_ * 10 + frac(1));
+            staged_.altDm = first_ == '-' ? -dm : dm;
+            break;
+        }
+        }
+    }
+
+    void commit() {
+        bool hasFix = type_ == RMC ? staged_.valid : staged_.quality > 0;
+        if (hasFix && latSet_ && lonSet_) {
+            staged_.latE7 = lat_;
+            staged_.lonE7 = lon_;
+        }
+        if (type_ == RMC) rmcCount++; else ggaCount++;
+        fix_ = staged_;
+        latSet_ = lonSet_ = false;
+    }
+
+    NmeaFramer framer_;
+    GpsFix     fix_;
+    GpsFix     staged_;
+    Type       type_  = OTHER;
+    uint8_t    field_ = 0;
+
+    uint32_t   int_ = 0, frac_ = 0;
+    uint8_t    fracDigits_ = 0;
+    bool       dot_ = false, empty_ = true;
+    char       first_ = 0;
+
+    int32_t    lat_ = 0, lon_ = 0;
+    bool       latSet_ = false, lonSet_ = false;
+};
+
+/* 1e-7 degrees → "-122.419400" (6 decimals) without floating point. */
+inline int formatE7(char *out, size_t size, int32_t e7) {
+    uint32_t a = e7 < 0 ? (uint32_t)(-(int64_t)e7) : (uint32_t)e7;
+    a = (a + 5) / 10;
+    return snprintf(out, size, "%s%lu.%06lu", e7 < 0 ? "-" : "",
+                    (unsigned long)(a / 1000000UL), (unsigned long)(a % 1000000UL));
+}
+
+/* UTC date + time of a fix → Unix seconds; 0 until RMC has supplied a
+ * date.  Days-from-civil, valid for the 2000–2099 dates NMEA carries. */
+inline uint32_t fixUnixTime(const GpsFix &f) {
+    if (!f.dateDdmmyy) return 0;
+    int32_t d = (int32_t)(f.dateDdmmyy / 10000);
+    int32_t m = (int32_t)(f.dateDdmmyy / 100 % 100);
+    int32_t y = 2000 + (int32_t)(f.dateDdmmyy % 100);
+    if (m <= 2) y--;
+    int32_t era = y / 400;
+    int32_t yoe = y - era * 400;
+    int32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    uint32_t days = (uint32_t)(era * 146097 + doe - 719468);
+    uint32_t hms = f.utcHhmmss;
+    return days * 86400UL + (hms / 10000) * 3600UL + (hms / 100 % 100) * 60UL + hms % 100;
+}
@@ -0,0 +1,160 @@
+/*
+ * SafeNeck – streaming NMEA framer
+ * ================================
+ * Per-character state machine that assembles one NMEA sentence at a time
+ * into a fixed buffer, XORs the checksum as bytes arrive and remaps the
+ * GN talker of GGA/RMC to GP in place (patching the checksum to match),
+ * so a sentence is ready for TinyGPS++ the moment its "*HH" is verified.
+ * No heap, no second pass over the line.
+ *
+ *   NmeaFramer nmea;
+ *   if (nmea.feed(c) == NmeaFramer::VALID) use(nmea.sentence());
+ *
+ * The PA1010D pads its I2C output with '\n' whenever its buffer runs dry,
+ * including in the middle of a sentence, so a bare '\n' is skipped rather
+ * than treated as a line end; sentences end at their checksum instead.
+ *
+ * feed() also reports BODY/FIELD for each payload character so a field
+ * tokenizer can ride along on the same pass.
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define NMEA_MAX_SENTENCE  96   /* 82 per NMEA 0183 + headroom for MTK */
+
+class NmeaFramer {
+public:
+    enum Result : uint8_t {
+        NONE,       /* framing / padding byte, nothing to do            */
+        BODY,       /* payload character (between '$' and '*')          */
+        FIELD,      /* ',' field separator inside the payload           */
+        VALID,      /* checksum verified – sentence() is complete       */
+        INVALID     /* checksum mismatch, truncation or overrun         */
+    };
+
+    Result feed(char c) {
+        switch (state_) {
+        case WAIT_START:
+            if (c == '$') start();
+            return NONE;
+
+        case PAYLOAD:
+            if (c == '*') {
+                append(c);
+                state_ = CS_HI;
+                return NONE;
+            }
+            if (c == '$') {                      /* sentence cut short   */
+                failed++;
+                start();
+                return INVALID;
+            }
+            if (c == '\n') {                     /* PA1010D I2C padding  */
+                padding++;
+                return NONE;
+            }
+            if (c == '\r' || len_ >= NMEA_MAX_SENTENCE - 3) {
+                if (c == '\r') failed++; else overruns++;
+                state_ = WAIT_START;
+                return INVALID;
+            }
+            append(c);
+            cs_ ^= (uint8_t)c;
+            if (len_ == 6) remapTalker();
+            return c == ',' ? FIELD : BODY;
+
+        case CS_HI:
+        case CS_LO: {
+            int v = hexValue(c);
+            if (v < 0) {
+                failed++;
+                state_ = WAIT_START;
+                return INVALID;
+            }
+            if (state_ == CS_HI) {
+                rxCs_ = (uint8_t)(v << 4);
+                append(c);
+                state_ = CS_LO;
+                return NONE;
+            }
+            rxCs_ |= (uint8_t)v;
+            append(c);
+            state_ = WAIT_START;
+            /* The sender's checksum covers the original talker. */
+            uint8_t expect = remapped_ ? (uint8_t)(cs_ ^ ('N' ^ 'P')) : cs_;
+            if (rxCs_ != expect) {
+                failed++;
+                return INVALID;
+            }
+            buf_[len_ - 2] = hexDigit(cs_ >> 4);
+            buf_[len_ - 1] = hexDigit(cs_);
+            passed++;
+            return VALID;
+        }
+        }
+        return NONE;
+    }
+
+    /* "$...*HH", NUL-terminated; complete only right after VALID. */
+    const char *sentence() const { return buf_; }
+    size_t      length()   const { return len_; }
+
+    /* Talker-independent sentence type, e.g. typeIs("GGA"). */
+    bool typeIs(const char *type3) const {
+        return len_ >= 6 && memcmp(buf_ + 3, type3, 3) == 0;
+    }
+
+    bool remapped() const { return remapped_; }
+
+    uint32_t passed   = 0;
+    uint32_t failed   = 0;
+    uint32_t overruns = 0;
+    uint32_t padding  = 0;   /* bare '\n' filler skipped mid-sentence */
+
+private:
+    enum State : uint8_t { WAIT_START, PAYLOAD, CS_HI, CS_LO };
+
+    static int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    }
+
+    static char hexDigit(uint8_t v) {
+        v &= 0x0F;
+        return (char)(v < 10 ? '0' + v : 'A' + (v - 10));
+    }
+
+    void start() {
+        len_ = 0;
+        cs_ = 0;
+        remapped_ = false;
+        append('$');
+        state_ = PAYLOAD;
+    }
+
+    void append(char c) {
+        buf_[len_++] = c;
+        buf_[len_] = '\0';
+    }
+
+    /* "$GNGGA" / "$GNRMC" → "$GP…" for parsers that only know GP. */
+    void remapTalker() {
+        if (buf_[1] == 'G' && buf_[2] == 'N' && (typeIs("GGA") || typeIs("RMC"))) {
+            buf_[2] = 'P';
+            cs_ ^= 'N' ^ 'P';
+            remapped_ = true;
+        }
+    }
+
+    char    buf_[NMEA_MAX_SENTENCE + 1] = { 0 };
+    uint8_t len_      = 0;
+    uint8_t cs_       = 0;
+    uint8_t rxCs_     = 0;
+    bool    remapped_ = false;
+    State   state_    = WAIT_START;
+};
@@ -0,0 +1,103 @@
+/*
+ * SafeNeck – device orientation from the BNO085 fusion reports
+ * ============================================================
+ * Reduces the game rotation vector (unit quaternion, Q14) or, failing
+ * that, the gravity report (Q8 m/s²) to one thing: the direction of
+ * world "up" in the sensor frame, as a Q14 unit vector.  How far the
+ * wearer has tipped between two moments is then the cosine between two
+ * such vectors – a dot product – so the post-impact check needs no
+ * float, no trig and no divide:
+ *
+ *   up = (2(ik − rj), 2(jk + ri), 1 − 2(i² + j²))     from q = (i, j, k, r)
+ *   cos Δtilt = up₀ · up₁                            Q14 · Q14 >> 14
+ *
+ * Yaw drops out, so the game rotation vector's free-running heading (no
+ * magnetometer) does not matter.  Degree thresholds are converted to a
+ * Q14 cosine at compile time.
+ *
+ *   UpTracker<250> orient;                        // stale after 250 ms
+ *   orient.rotation(ms, i, j, k, real);           // or orient.gravity(ms, x, y, z)
+ *   UpVector u = orient.up(ms);
+ *   if (u.known() && tiltCosQ14(before, u) < cosQ14Deg(45)) ...   // tipped > 45°
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+
+#include "accel_q.h"     /* isqrt32 */
+
+const int32_t ORIENT_ONE_Q14 = 1 << 14;
+
+/* World up in the sensor frame, Q14; all zero when not known. */
+struct UpVector {
+    int16_t x = 0, y = 0, z = 0;
+
+    bool known() const { return x | y | z; }
+};
+
+/* cos(deg) in Q14, evaluated by the compiler (Taylor series, |deg| ≤ 180). */
+constexpr int16_t cosQ14Deg(double deg) {
+    double x2 = deg * 3.14159265358979323846 / 180.0;
+    x2 *= x2;
+    double term = 1.0, sum = 1.0;
+    for (int n = 1; n <= 10; n++) {
+        term *= -x2 / ((2 * n - 1) * (2 * n));
+        sum += term;
+    }
+    return (int16_t)(sum * ORIENT_ONE_Q14 + (sum < 0 ? -0.5 : 0.5));
+}
+
+/* Third row of the rotation matrix of q = (i, j, k, real), all Q14.
+ * Products are Q28 and at most 2^28, so every sum fits in 32 bits. */
+inline UpVector upFromQuatQ14(int16_t i, int16_t j, int16_t k, int16_t real) {
+    UpVector u;
+    u.x = (int16_t)(((int32_t)i * k - (int32_t)real * j) >> 13);
+    u.y = (int16_t)(((int32_t)j * k + (int32_t)real * i) >> 13);
+    u.z = (int16_t)(ORIENT_ONE_Q14 - (((int32_t)i * i + (int32_t)j * j) >> 13));
+    if (!u.known()) u.z = 1;                /* exactly horizontal is still known */
+    return u;
+}
+
+/* Gravity points up in the sensor frame at rest; any Q point, scaled to a
+ * unit vector.  A zero vector (no estimate yet) stays unknown. */
+inline UpVector upFromGravity(int16_t x, int16_t y, int16_t z) {
+    UpVector u;
+    uint32_t n = isqrt32(accelMagSq(x, y, z));
+    if (!n) return u;
+    u.x = (int16_t)((int32_t)x * ORIENT_ONE_Q14 / (int32_t)n);
+    u.y = (int16_t)((int32_t)y * ORIENT_ONE_Q14 / (int32_t)n);
+    u.z = (int16_t)((int32_t)z * ORIENT_ONE_Q14 / (int32_t)n);
+    return u;
+}
+
+/* cos of the angle between two known up vectors, Q14 (16384 = no change). */
+inline int32_t tiltCosQ14(const UpVector &a, const UpVector &b) {
+    return ((int32_t)a.x * b.x + (int32_t)a.y * b.y + (int32_t)a.z * b.z) >> 14;
+}
+
+/* Latest up vector from whichever report is fresh.  The rotation vector
+ * wins; gravity is only used while no rotation vector has arrived for
+ * STALE_MS, so the two sources are not interleaved. */
+template <uint32_t STALE_MS>
+class UpTracker {
+public:
+    void rotation(uint32_t ms, int16_t i, int16_t j, int16_t k, int16_t real) {
+        up_ = upFromQuatQ14(i, j, k, real);
+        at_ = rotationAt_ = ms;
+        haveRotation_ = true;
+    }
+
+    void gravity(uint32_t ms, int16_t x, int16_t y, int16_t z) {
+        if (haveRotation_ && ms - rotationAt_ <= STALE_MS) return;
+        up_ = upFromGravity(x, y, z);
+        at_ = ms;
+    }
+
+    UpVector up(uint32_t ms) const { return ms - at_ <= STALE_MS ? up_ : UpVector(); }
+
+private:
+    UpVector up_;
+    uint32_t at_ = 0;
+    uint32_t rotationAt_ = 0;
+    bool     haveRotation_ = false;
+};
@@ -0,0 +1,200 @@
+/*
+ * SafeNeck – prioritized outbound event queue
+ * ===========================================
+ * loop() hands events to publish() and moves on; a sender thread owns
+ * the cloud link and is the only caller of Particle.publish().  A
+ * WITH_ACK publish that stalls on a poor LTE-M link (or a device that is
+ * offline) therefore never holds up sensor processing, and nothing is
+ * lost while it waits: entries stay queued until the cloud ACKs them.
+ *
+ *   • Priority – ALERT before EVENT before LOCATION before DIAG, FIFO
+ *                within one.
+ *   • Retry    – a failed publish is retried with exponential backoff
+ *                (BACKOFF_BASE_MS · 2^n, capped at BACKOFF_MAX_MS).
+ *   • Bounded  – N fixed slots of DATA_MAX bytes, no heap.  When full,
+ *                the oldest entry of the least important priority not
+ *                above the newcomer's is evicted; otherwise the newcomer
+ *                is refused.  Both count as dropped, except for DIAG
+ *                entries, which are best effort and count as shed.
+ *   • Pacing   – at most one publish per PACE_MS (Particle's 1 event/s).
+ *
+ *   PublishQueue<8, 256> outbox;
+ *   outbox.begin();                                   // in setup()
+ *   outbox.publish("safeneck/fall", json, outbox.ALERT);
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include "Particle.h"
+
+template <uint8_t N, size_t DATA_MAX>
+class PublishQueue {
+public:
+    enum Priority : uint8_t { ALERT, EVENT, LOCATION, DIAG, PRIORITIES };
+
+    static const uint32_t PACE_MS         = 1000;
+    static const uint32_t IDLE_MS         = 50;
+    static const uint32_t BACKOFF_BASE_MS = 2000;
+    static const uint32_t BACKOFF_MAX_MS  = 120000;
+    static const size_t   NAME_MAX        = 64;    /* Particle limit   */
+
+    struct Metrics {
+        uint32_t enqueued  = 0;
+        uint32_t acked     = 0;
+        uint32_t attempts  = 0;     /* Particle.publish() calls          */
+        uint32_t failures  = 0;     /* attempts that were not ACKed      */
+        uint32_t dropped   = 0;     /* evicted or refused                */
+        uint32_t shed      = 0;     /* DIAG entries evicted or refused   */
+        uint8_t  depth     = 0;
+        uint8_t  highWater = 0;
+        uint32_t ackMsLast = 0;     /* publish() call → ACK              */
+        uint32_t ackMsMax  = 0;
+        uint32_t ackMsSum  = 0;     /* ÷ acked for the mean              */
+        uint32_t queuedMsLast[PRIORITIES] = { 0 };   /* enqueue → ACK    */
+        uint32_t queuedMsMax[PRIORITIES]  = { 0 };
+    };
+
+    /* Starts the sender thread; call once the cloud objects exist. */
+    void begin(os_thread_prio_t priority = OS_THREAD_PRIORITY_DEFAULT) {
+        thread_ = new Thread("publish", [this] { run(); }, priority);
+    }
+
+    /* Queue an event; never waits on the network. */
+    bool publish(const char *name, const char *data, Priority prio) {
+        if (strlen(name) >= NAME_MAX || strlen(data) > DATA_MAX) {
+            WITH_LOCK(lock_) { lost(prio); }
+            return false;
+        }
+        bool queued = false;
+        WITH_LOCK(lock_) {
+            int i = freeSlot(prio);
+            if (i < 0) {
+                lost(prio);
+            } else {
+                Slot &s = slots_[i];
+                strcpy(s.name, name);
+                strcpy(s.data, data);
+                s.prio      = prio;
+                s.used      = true;
+                s.inFlight  = false;
+                s.attempts  = 0;
+                s.queuedMs  = millis();
+                s.notBefore = s.queuedMs;
+                m_.enqueued++;
+                m_.depth++;
+                if (m_.depth > m_.highWater) m_.highWater = m_.depth;
+                queued = true;
+            }
+        }
+        return queued;
+    }
+
+    Metrics metrics() {
+        Metrics copy;
+        WITH_LOCK(lock_) { copy = m_; }
+        return copy;
+    }
+
+private:
+    struct Slot {
+        char     name[NAME_MAX];
+        char     data[DATA_MAX + 1];
+        uint32_t queuedMs  = 0;
+        uint32_t notBefore = 0;
+        uint8_t  prio      = LOCATION;
+        uint8_t  attempts  = 0;
+        bool     used      = false;
+        bool     inFlight  = false;   /* sender owns it; never evicted */
+    };
+
+    static bool due(uint32_t now, uint32_t at) { return (int32_t)(now - at) >= 0; }
+
+    void lost(uint8_t prio) {
+        if (prio == DIAG) m_.shed++;
+        else              m_.dropped++;
+    }
+
+    int freeSlot(uint8_t prio) {
+        int victim = -1;
+        for (int i = 0; i < N; i++) {
+            const Slot &s = slots_[i];
+            if (!s.used) return i;
+            if (s.inFlight || s.prio < prio) continue;
+            if (victim < 0 || s.prio > slots_[victim].prio ||
+                (s.prio == slots_[victim].prio && !due(s.queuedMs, slots_[victim].queuedMs)))
+                victim = i;
+        }
+        if (victim >= 0) {
+            slots_[victim].used = false;
+            lost(slots_[victim].prio);
+            m_.depth--;
+        }
+        return victim;
+    }
+
+    /* Most important, then oldest, entry whose backoff has expired. */
+    int nextDue(uint32_t now) {
+        int best = -1;
+        for (int i = 0; i < N; i++) {
+            const Slot &s = slots_[i];
+            if (!s.used || s.inFlight || !due(now, s.notBefore)) continue;
+            if (best < 0 || s.prio < slots_[best].prio ||
+                (s.prio == slots_[best].prio && !due(s.queuedMs, slots_[best].queuedMs)))
+                best = i;
+        }
+        return best;
+    }
+
+    void finish(Slot &s, bool ok, uint32_t sentMs, uint32_t doneMs) {
+        m_.attempts++;
+        s.inFlight = false;
+        if (ok) {
+            uint32_t ackMs = doneMs - sentMs, queuedMs = doneMs - s.queuedMs;
+            m_.acked++;
+            m_.ackMsLast = ackMs;
+            m_.ackMsSum += ackMs;
+            if (ackMs > m_.ackMsMax) m_.ackMsMax = ackMs;
+            m_.queuedMsLast[s.prio] = queuedMs;
+            if (queuedMs > m_.queuedMsMax[s.prio]) m_.queuedMsMax[s.prio] = queuedMs;
+            s.used = false;
+            m_.depth--;
+            return;
+        }
+        m_.failures++;
+        uint8_t shift = s.attempts < 6 ? s.attempts : 6;
+        uint32_t backoff = BACKOFF_BASE_MS << shift;
+        s.notBefore = doneMs + (backoff < BACKOFF_MAX_MS ? backoff : BACKOFF_MAX_MS);
+        if (s.attempts < 255) s.attempts++;
+    }
+
+    void run() {
+        for (;;) {
+            Slot *s = nullptr;
+            if (Particle.connected()) {
+                WITH_LOCK(lock_) {
+                    int i = nextDue(millis());
+                    if (i >= 0) {
+                        s = &slots_[i];
+                        s->inFlight = true;
+                    }
+                }
+            }
+            if (!s) {
+                delay(IDLE_MS);
+                continue;
+            }
+
+            /* In flight: the slot is not touched by publish() meanwhile. */
+            uint32_t sentMs = millis();
+            bool ok = Particle.publish(s->name, s->data, PRIVATE, WITH_ACK);
+            uint32_t doneMs = millis();
+            WITH_LOCK(lock_) { finish(*s, ok, sentMs, doneMs); }
+
+            if (doneMs - sentMs < PACE_MS) delay(PACE_MS - (doneMs - sentMs));
+        }
+    }
+
+    Slot           slots_[N];
+    Metrics        m_;
+    RecursiveMutex lock_;
+    Thread        *thread_ = nullptr;
+};
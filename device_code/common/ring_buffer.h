@@ -0,0 +1,45 @@
+/*
+ * SafeNeck – fixed-capacity ring buffer
+ * =====================================
+ * Statically sized FIFO used wherever the firmware would otherwise grow a
+ * String or a heap container.  Capacity must be a power of two so the
+ * index wrap is a mask; head/tail run freely and wrap at 2^32.
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+template <typename T, uint32_t N>
+class RingBuffer {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "RingBuffer capacity must be a power of two");
+
+public:
+    static constexpr uint32_t CAPACITY = N;
+
+    bool push(const T &v) {
+        if (full()) return false;
+        buf_[head_++ & (N - 1)] = v;
+        return true;
+    }
+
+    bool pop(T &out) {
+        if (empty()) return false;
+        out = buf_[tail_++ & (N - 1)];
+        return true;
+    }
+
+    /* i = 0 is the oldest element still queued. */
+    const T &peek(uint32_t i = 0) const { return buf_[(tail_ + i) & (N - 1)]; }
+
+    uint32_t size()  const { return head_ - tail_; }
+    uint32_t free()  const { return N - size(); }
+    bool     empty() const { return head_ == tail_; }
+    bool     full()  const { return size() == N; }
+    void     clear()       { tail_ = head_; }
+
+private:
+    T        buf_[N];
+    uint32_t head_ = 0;
+    uint32_t tail_ = 0;
+};
@@ -0,0 +1,202 @@
+/*
+ * SafeNeck – SHTP transport reader for the BNO085
+ * ===============================================
+ * Reads one SHTP packet per call and decodes every sensor report in it.
+ *
+ *   • The first read is a full Wire buffer: header and up to 28 bytes of
+ *     cargo in one transaction.  Longer packets (on-chip batches) follow
+ *     as continuation reads, whose repeated 4-byte header is skipped.
+ *   • 0xFB base-timestamp and 0xFA rebase records are applied, so every
+ *     report carries the time the sensor took it, not the time it was
+ *     read: readUs − base + rebase + delay, all in 100 µs ticks.
+ *   • Channel sequence numbers count lost packets; per-report sequence
+ *     numbers count lost reports (both mod 256).
+ *
+ *   ShtpReader imu(BNO085_I2C_ADDR);
+ *   while (imu.poll([](const ShtpReport &r) { ... }) > 0) {}
+ *
+ * Packets longer than PACKET_MAX are drained and dropped (truncated).
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include "Particle.h"
+
+/* Length of a report including its id byte, 0 if unknown. */
+inline uint8_t shtpReportLength(uint8_t id) {
+    switch (id) {
+    case 0xFA: case 0xFB: return 5;            /* timestamp records       */
+    case 0x01: case 0x02: case 0x03:           /* accel, gyro, mag        */
+    case 0x04: case 0x06:                      /* linear accel, gravity   */
+        return 10;
+    case 0x05: case 0x09: return 14;           /* rotation vectors        */
+    case 0x08:            return 12;           /* game rotation vector    */
+    case 0x07: case 0x0F: return 16;           /* uncalibrated gyro / mag */
+    case 0x10:            return 5;            /* tap detector            */
+    case 0x11:            return 12;           /* step counter            */
+    case 0x12: case 0x13:                      /* significant motion,     */
+    case 0x19:            return 6;            /* stability, shake        */
+    case 0x14: case 0x15: case 0x16:           /* raw accel / gyro / mag  */
+        return 16;
+    case 0x1E:            return 16;           /* activity classifier     */
+    default:              return 0;
+    }
+}
+
+struct ShtpReport {
+    uint8_t        id;
+    uint8_t        seq;
+    uint8_t        status;      /* accuracy, 0–3                          */
+    uint32_t       timeUs;      /* sensor time on the micros() clock      */
+    const uint8_t *data;        /* fields after the 4-byte report header  */
+    uint8_t        len;         /* bytes at data                          */
+
+    int16_t i16(uint8_t field) const {
+        return (int16_t)((uint16_t)data[2 * field] | ((uint16_t)data[2 * field + 1] << 8));
+    }
+};
+
+class ShtpReader {
+public:
+    static const uint8_t  CHUNK_BYTES = 32;          /* Device OS Wire buffer */
+    static const uint16_t PACKET_MAX  = 512;
+    static const uint8_t  CHANNEL_REPORTS      = 3;
+    static const uint8_t  CHANNEL_WAKE_REPORTS = 5;
+
+    struct Stats {
+        uint32_t polls        = 0;
+        uint32_t transactions = 0;
+        uint32_t packets      = 0;      /* non-empty packets read            */
+        uint32_t bytes        = 0;      /* header + cargo                    */
+        uint32_t reports      = 0;      /* sensor reports decoded            */
+        uint32_t maxBatch     = 0;      /* most reports in one packet        */
+        uint32_t packetGaps   = 0;      /* packets missing by channel seq    */
+        uint32_t reportGaps   = 0;      /* reports missing by report seq     */
+        uint32_t unknown      = 0;      /* packets cut short by an unknown id */
+        uint32_t truncated    = 0;      /* packets over PACKET_MAX           */
+        uint32_t resyncs      = 0;      /* reads that began mid-packet       */
+    };
+
+    explicit ShtpReader(uint8_t addr) : addr_(addr) {}
+
+    /* Reads one packet.  Returns the number of sensor reports decoded,
+     * 0 if the packet carried none, or -1 if the sensor had nothing. */
+    template <typename Sink>
+    int poll(Sink &&sink) {
+        stats_.polls++;
+        uint32_t readUs = micros();
+        uint16_t len = 0;
+        uint8_t  channel = 0, seq = 0;
+        bool     midPacket = false;
+        if (!readPacket(len, channel, seq, midPacket)) return -1;
+        if (midPacket) {
+            /* The tail of a packet an earlier read abandoned: its start,
+             * and any 0xFB record, is gone. */
+            stats_.resyncs++;
+            return 0;
+        }
+
+        stats_.packets++;
+        stats_.bytes += len;
+        if (channelSeen_[channel & 7]) {
+            uint8_t missed = (uint8_t)(seq - channelSeq_[channel & 7] - 1);
+            stats_.packetGaps += missed;
+        }
+        channelSeen_[channel & 7] = true;
+        channelSeq_[channel & 7] = seq;
+
+        if (len > PACKET_MAX) {
+            stats_.truncated++;
+            return 0;
+        }
+        if (channel != CHANNEL_REPORTS && channel != CHANNEL_WAKE_REPORTS) return 0;
+        return decode(len - 4, readUs, sink);
+    }
+
+    const Stats &stats() const { return stats_; }
+
+private:
+    /* Header and cargo into packet_; continuation headers dropped. */
+    bool readPacket(uint16_t &len, uint8_t &channel, uint8_t &seq, bool &midPacket) {
+        uint8_t chunk[CHUNK_BYTES];
+        uint8_t n = read(chunk, CHUNK_BYTES);
+        if (n < 4) return false;
+        len = (uint16_t)(chunk[0] | ((chunk[1] & 0x7F) << 8));
+        if (len < 4) return false;               /* nothing pending        */
+        channel   = chunk[2];
+        seq       = chunk[3];
+        midPacket = chunk[1] & 0x80;
+
+        uint16_t got = 0;                        /* cargo bytes            */
+        uint16_t cargo = len - 4;
+        auto keep = [&](const uint8_t *p, uint16_t k) {
+            if (got + k > cargo) k = cargo - got;
+            if (got + k <= PACKET_MAX - 4) memcpy(packet_ + got, p, k);
+            got += k;
+        };
+        keep(chunk + 4, n - 4);
+        while (got < cargo) {
+            uint16_t want = cargo - got + 4;
+            n = read(chunk, want < CHUNK_BYTES ? (uint8_t)want : CHUNK_BYTES);
+            if (n <= 4) break;
+            keep(chunk + 4, n - 4);
+        }
+        if (got < cargo) len = got + 4;          /* sensor went quiet      */
+        return true;
+    }
+
+    uint8_t read(uint8_t *out, uint8_t want) {
+        stats_.transactions++;
+        uint8_t n = (uint8_t)Wire.requestFrom(addr_, want);
+        for (uint8_t i = 0; i < n; i++) out[i] = (uint8_t)Wire.read();
+        return n;
+    }
+
+    template <typename Sink>
+    int decode(uint16_t cargo, uint32_t readUs, Sink &sink) {
+        uint32_t base = readUs;                  /* until a 0xFB arrives   */
+        uint32_t rebase = 0;
+        int count = 0;
+        uint16_t pos = 0;
+        while (pos < cargo) {
+            const uint8_t *r = packet_ + pos;
+            uint8_t rlen = shtpReportLength(r[0]);
+            if (!rlen || pos + rlen > cargo) {
+                stats_.unknown++;
+                break;
+            }
+            pos += rlen;
+            uint32_t ticks = (uint32_t)r[1] | (uint32_t)r[2] << 8 |
+                             (uint32_t)r[3] << 16 | (uint32_t)r[4] << 24;
+            if (r[0] == 0xFB) { base = readUs - ticks * 100; rebase = 0; continue; }
+            if (r[0] == 0xFA) { rebase = ticks * 100; continue; }
+
+            uint8_t id = r[0];
+            if (reportSeen_[id >> 5] & (1u << (id & 31)))
+                stats_.reportGaps += (uint8_t)(r[1] - reportSeq_[id] - 1);
+            reportSeen_[id >> 5] |= 1u << (id & 31);
+            reportSeq_[id] = r[1];
+
+            uint32_t delay = ((uint32_t)(r[2] >> 2) << 8) | r[3];
+            ShtpReport rep;
+            rep.id     = id;
+            rep.seq    = r[1];
+            rep.status = r[2] & 0x03;
+            rep.timeUs = base + rebase + delay * 100;
+            rep.data   = r + 4;
+            rep.len    = rlen - 4;
+            sink(rep);
+            count++;
+        }
+        stats_.reports += count;
+        if ((uint32_t)count > stats_.maxBatch) stats_.maxBatch = count;
+        return count;
+    }
+
+    uint8_t  addr_;
+    uint8_t  packet_[PACKET_MAX - 4];
+    uint8_t  channelSeq_[8] = { 0 };
+    bool     channelSeen_[8] = { false };
+    uint8_t  reportSeq_[256] = { 0 };
+    uint32_t reportSeen_[8] = { 0 };
+    Stats    stats_;
+};
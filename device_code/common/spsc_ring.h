@@ -0,0 +1,62 @@
+/*
+ * SafeNeck – lock-free single-producer / single-consumer ring
+ * ===========================================================
+ * Hands samples from the IMU thread to loop() without a mutex: only the
+ * producer writes head_, only the consumer writes tail_, and the
+ * release/acquire pair on those indices publishes the slot contents.
+ * A full ring rejects the new sample and counts it in dropped(), so a
+ * zero there proves nothing was lost while loop() was stalled.
+ *
+ *   producer:  ring.push(sample);
+ *   consumer:  while (ring.pop(sample)) use(sample);
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+template <typename T, uint32_t N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    static constexpr uint32_t CAPACITY = N;
+
+    /* Producer side. */
+    bool push(const T &v) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t used = head - tail_.load(std::memory_order_acquire);
+        if (used == N) {
+            dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        buf_[head & (N - 1)] = v;
+        head_.store(head + 1, std::memory_order_release);
+        if (used + 1 > highWater_) highWater_ = used + 1;
+        return true;
+    }
+
+    /* Consumer side. */
+    bool pop(T &out) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) return false;
+        out = buf_[tail & (N - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* Either side; a snapshot that may already be stale. */
+    uint32_t size() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+    bool     empty()     const { return size() == 0; }
+    uint32_t dropped()   const { return dropped_.load(std::memory_order_relaxed); }
+    uint32_t highWater() const { return highWater_; }
+
+private:
+    T                     buf_[N];
+    std::atomic<uint32_t> head_{0};
+    std::atomic<uint32_t> tail_{0};
+    std::atomic<uint32_t> dropped_{0};
+    uint32_t              highWater_ = 0;   /* producer-owned */
+};
@@ -0,0 +1,133 @@
+/*
+ * SafeNeck – per-stage loop timing from the cycle counter
+ * =======================================================
+ * How long each stage of a loop pass takes on the hardware, and how
+ * often it runs over its budget, without a debugger attached:
+ *
+ *   • Clock     – System.ticks(), the Cortex-M4 DWT cycle counter
+ *                 (64 per µs on the nRF52840).  Two reads per stage; it
+ *                 wraps every 67 s, far longer than any stage.
+ *   • Histogram – STAGE_BUCKETS fixed power-of-two buckets per stage:
+ *                 < 32 µs, < 64 µs, … < 32.8 ms, then everything longer.
+ *   • Deadline  – a pass over the stage's budget counts as a miss.
+ *
+ * Times are wall clock, so a stage preempted by a higher-priority thread
+ * is charged for it: that is the latency the next stage sees.  Each
+ * stage has one writer (the thread it runs on); readers on other threads
+ * may see a count and a total from neighbouring passes, which is fine
+ * for diagnostics.  No heap, no floats.
+ *
+ *   enum { STAGE_GPS, STAGE_FALL, STAGE_COUNT };
+ *   StageTimer<STAGE_COUNT> timing({ { "gps", 2500 }, { "fall", 5000 } });
+ *   { StageTimer<STAGE_COUNT>::Scope t(timing, STAGE_GPS); readGPS(); }
+ *   timing.format(buf, sizeof(buf), millis() / 1000);   // diagnostics text
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "Particle.h"
+
+static const uint8_t  STAGE_BUCKETS     = 12;
+static const uint32_t STAGE_BUCKET0_US  = 32;   /* upper bound of bucket 0 */
+
+/* Bucket of a duration: k such that it is below 32·2^k µs, or the last. */
+inline uint8_t stageBucket(uint32_t us) {
+    uint8_t b = 0;
+    for (uint32_t lim = STAGE_BUCKET0_US; b < STAGE_BUCKETS - 1 && us >= lim; lim <<= 1) b++;
+    return b;
+}
+
+struct StageSpec {
+    const char *name;
+    uint32_t    budgetUs;
+};
+
+template <uint8_t N>
+class StageTimer {
+public:
+    struct Stage {
+        const char *name     = "";
+        uint32_t    budgetUs = 0;
+        uint32_t    count    = 0;
+        uint32_t    misses   = 0;         /* passes over budgetUs */
+        uint32_t    lastUs   = 0;
+        uint32_t    maxUs    = 0;
+        uint64_t    totalUs  = 0;
+        uint32_t    hist[STAGE_BUCKETS] = {};
+
+        uint32_t meanUs() const { return count ? (uint32_t)(totalUs / count) : 0; }
+    };
+
+    /* Times one stage from construction to the end of the scope. */
+    class Scope {
+    public:
+        Scope(StageTimer &t, uint8_t stage) : t_(t), stage_(stage), start_(System.ticks()) {}
+        ~Scope() { t_.record(stage_, System.ticks() - start_); }
+    private:
+        StageTimer &t_;
+        uint8_t     stage_;
+        uint32_t    start_;
+    };
+
+    explicit StageTimer(const StageSpec (&specs)[N]) {
+        for (uint8_t i = 0; i < N; i++) {
+            s_[i].name     = specs[i].name;
+            s_[i].budgetUs = specs[i].budgetUs;
+        }
+    }
+
+    /* One pass of `stage` that took `ticks` cycles. */
+    void record(uint8_t stage, uint32_t ticks) {
+        Stage &s = s_[stage];
+        uint32_t us = ticks / System.ticksPerMicrosecond();
+        s.count++;
+        s.lastUs = us;
+        s.totalUs += us;
+        if (us > s.maxUs) s.maxUs = us;
+        if (s.budgetUs && us > s.budgetUs) s.misses++;
+        s.hist[stageBucket(us)]++;
+    }
+
+    const Stage &stage(uint8_t i) const { return s_[i]; }
+
+    /* Compact text for a Particle.variable or a diagnostics event:
+     *
+     *   t=<uptime s> <name>=<count>,<mean µs>,<max µs>,<misses>:<h0>.<h1>…
+     *
+     * one field per stage, trailing empty buckets left out.  Cumulative
+     * since boot, so a lost event loses nothing.  Returns the length, or
+     * 0 if it did not fit. */
+    size_t format(char *out, size_t cap, uint32_t uptimeS) const {
+        size_t n = 0;
+        if (!append(out, cap, n, snprintf(out, cap, "t=%lu", (unsigned long)uptimeS))) return 0;
+        for (uint8_t i = 0; i < N; i++) {
+            const Stage &s = s_[i];
+            if (!append(out, cap, n, snprintf(out + n, cap - n, " %s=%lu,%lu,%lu,%lu:", s.name,
+                                              (unsigned long)s.count, (unsigned long)s.meanUs(),
+                                              (unsigned long)s.maxUs, (unsigned long)s.misses)))
+                return 0;
+            uint8_t used = STAGE_BUCKETS;
+            while (used > 1 && !s.hist[used - 1]) used--;
+            for (uint8_t b = 0; b < used; b++) {
+                if (!append(out, cap, n, snprintf(out + n, cap - n, b ? ".%lu" : "%lu",
+                                                  (unsigned long)s.hist[b])))
+                    return 0;
+            }
+        }
+        return n;
+    }
+
+private:
+    static bool append(char *out, size_t cap, size_t &n, int wrote) {
+        if (wrote < 0 || n + (size_t)wrote >= cap) {
+            if (cap) out[0] = '\0';
+            return false;
+        }
+        n += (size_t)wrote;
+        return true;
+    }
+
+    Stage s_[N];
+};
@@ -0,0 +1,148 @@
+/*
+ * SafeNeck – batched, delta-encoded GPS track
+ * ===========================================
+ * Collects one fix per second and sends the lot as a single event.  The
+ * first point is absolute, every later one is the difference from its
+ * predecessor, so a walking-pace fix costs about 3 bytes instead of a
+ * ~120-character JSON object.
+ *
+ * Wire format (version 1), base64 in the event data:
+ *
+ *   u8      version
+ *   u8      battery %            (0xFF unknown)
+ *   u8      satellites           ┐ of the newest fix
+ *   varint  HDOP ×100            ┘
+ *   varint  Unix time            ┐
+ *   zigzag  latitude  1e-6°      │ first point, absolute
+ *   zigzag  longitude 1e-6°      ┘
+ *   { varint Δt s, zigzag Δlat, zigzag Δlon }…   later points
+ *
+ * Coordinates are rounded to 1e-6° (~11 cm), the precision the JSON
+ * location event already published.
+ *
+ *   TrackBatch<622> track;
+ *   if (!track.add(t, latE7, lonE7)) { send(); track.add(t, latE7, lonE7); }
+ *   track.encode(buf, sizeof(buf), battery, sats, hdop);  // then clear()
+ *
+ *   decodeTrack(text, len, header, [](const TrackPoint &p) { ... });
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "varint.h"
+#include "base64.h"
+
+struct TrackPoint {
+    uint32_t unixTime;
+    int32_t  latE7;
+    int32_t  lonE7;
+};
+
+struct TrackHeader {
+    uint8_t  version    = 0;
+    uint8_t  batteryPct = 0xFF;
+    uint8_t  sats       = 0;
+    uint16_t hdopX100   = 0;
+};
+
+static const uint8_t TRACK_VERSION = 1;
+
+template <size_t TEXT_MAX>
+class TrackBatch {
+public:
+    static const size_t HEADER_MAX = 3 + 3;                 /* u8 ×3, hdop */
+    static const size_t BINARY_MAX = TEXT_MAX * 3 / 4;
+
+    /* Appends a fix; false (batch unchanged) when it would not fit.  A
+     * repeat of the newest second, or an older one, is ignored. */
+    bool add(uint32_t unixTime, int32_t latE7, int32_t lonE7) {
+        if (count_ && (int32_t)(unixTime - lastTime_) <= 0) return true;
+        int32_t lat = toE6(latE7), lon = toE6(lonE7);
+
+        uint8_t tmp[3 * VARINT_MAX_BYTES];
+        uint8_t n = 0;
+        if (count_) {
+            n += putVarint(tmp + n, unixTime - lastTime_);
+            n += putVarint(tmp + n, zigzag(lat - lastLat_));
+            n += putVarint(tmp + n, zigzag(lon - lastLon_));
+        } else {
+            n += putVarint(tmp + n, unixTime);
+            n += putVarint(tmp + n, zigzag(lat));
+            n += putVarint(tmp + n, zigzag(lon));
+        }
+        if (HEADER_MAX + len_ + n > BINARY_MAX) return false;
+
+        memcpy(buf_ + HEADER_MAX + len_, tmp, n);
+        len_ += n;
+        count_++;
+        lastTime_ = unixTime;
+        lastLat_  = lat;
+        lastLon_  = lon;
+        return true;
+    }
+
+    /* Base64 of header + points into `out`; returns the text length, or 0
+     * if the batch is empty or `cap` is too small. */
+    size_t encode(char *out, size_t cap, uint8_t batteryPct, uint8_t sats, uint16_t hdopX100) {
+        if (!count_) return 0;
+        uint8_t hdr[HEADER_MAX];
+        uint8_t h = 0;
+        hdr[h++] = TRACK_VERSION;
+        hdr[h++] = batteryPct;
+        hdr[h++] = sats;
+        h += putVarint(hdr + h, hdopX100);
+        /* Header sits right before the points: one contiguous buffer. */
+        uint8_t *start = buf_ + HEADER_MAX - h;
+        memcpy(start, hdr, h);
+        return base64Encode(out, cap, start, h + len_);
+    }
+
+    void clear() { count_ = 0; len_ = 0; }
+
+    uint16_t count() const { return count_; }
+    size_t   bytes() const { return len_; }     /* points only */
+
+private:
+    static int32_t toE6(int32_t e7) { return (e7 + (e7 < 0 ? -5 : 5)) / 10; }
+
+    uint8_t  buf_[BINARY_MAX];
+    size_t   len_ = 0;
+    uint16_t count_ = 0;
+    uint32_t lastTime_ = 0;
+    int32_t  lastLat_ = 0, lastLon_ = 0;
+};
+
+/* Expands one batch into visit(const TrackPoint &) calls.  Returns the
+ * number of points, or -1 if the text is not a version-1 track. */
+template <typename Visit>
+int decodeTrack(const char *text, size_t len, TrackHeader &hdr, Visit &&visit) {
+    uint8_t bin[1024];
+    int n = base64Decode(bin, sizeof(bin), text, len);
+    if (n < 4 || bin[0] != TRACK_VERSION) return -1;
+
+    const uint8_t *p = bin + 3, *end = bin + n;
+    uint32_t hdop;
+    if (!getVarint(p, end, hdop)) return -1;
+    hdr.version    = bin[0];
+    hdr.batteryPct = bin[1];
+    hdr.sats       = bin[2];
+    hdr.hdopX100   = (uint16_t)hdop;
+
+    int count = 0;
+    uint32_t t = 0;
+    int32_t  lat = 0, lon = 0;
+    while (p < end) {
+        uint32_t dt, dlat, dlon;
+        if (!getVarint(p, end, dt) || !getVarint(p, end, dlat) || !getVarint(p, end, dlon))
+            return -1;
+        t   += dt;
+        lat += unzigzag(dlat);
+        lon += unzigzag(dlon);
+        visit(TrackPoint{ t, lat * 10, lon * 10 });
+        count++;
+    }
+    return count;
+}
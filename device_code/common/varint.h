@@ -0,0 +1,48 @@
+/*
+ * SafeNeck – LEB128 varints and zigzag signed mapping
+ * ===================================================
+ * 7 bits per byte, low group first, high bit set on every byte but the
+ * last.  Signed values go through zigzag first so small deltas of either
+ * sign stay short: 0→0, -1→1, 1→2, -2→3, …
+ *
+ *   n += putVarint(buf + n, zigzag(delta));
+ *   if (!getVarint(p, end, v)) ... truncated ...
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+static const uint8_t VARINT_MAX_BYTES = 5;   /* 32-bit values */
+
+inline uint32_t zigzag(int32_t v)   { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+inline int32_t  unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+inline uint8_t varintSize(uint32_t v) {
+    uint8_t n = 1;
+    while (v >= 0x80) { v >>= 7; n++; }
+    return n;
+}
+
+/* Writes at most VARINT_MAX_BYTES; returns the count written. */
+inline uint8_t putVarint(uint8_t *out, uint32_t v) {
+    uint8_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+/* Advances p; false if the input ends mid-varint or overflows 32 bits. */
+inline bool getVarint(const uint8_t *&p, const uint8_t *end, uint32_t &v) {
+    v = 0;
+    for (uint8_t shift = 0; shift < 35; shift += 7) {
+        if (p == end) return false;
+        uint8_t b = *p++;
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
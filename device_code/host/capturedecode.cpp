@@ -0,0 +1,122 @@
+/*
+ * SafeNeck – reassemble and decode pre/post-alert IMU captures
+ * ============================================================
+ * The receiving end of common/imu_capture.h.  Collects the chunks of
+ * each capture (in any order, duplicates ignored), and once a capture is
+ * complete decodes it and prints one CSV row per sample:
+ *
+ *   capture,unix_time,kind,index,t_ms,x,y,z,trigger
+ *
+ * t_ms is relative to the sample the alert fired on and x/y/z are m/s².
+ * A summary per capture, and the chunks still missing from incomplete
+ * ones, goes to stderr.  Input is `replay_* --publish` output or bare
+ * chunk lines, as eventdecode takes.
+ *
+ * Usage:
+ *   build/replay_reference --trace fall.trace --publish | capturedecode > capture.csv
+ * -----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <vector>
+
+#include "common/event_codec.h"
+#include "common/imu_capture.h"
+
+namespace {
+
+const char CAPTURE_EVENT[] = "safety/capture";
+
+struct Pending {
+    uint8_t total = 0;
+    std::vector<std::vector<uint8_t>> chunks;
+    std::vector<bool> have;
+    size_t chunkChars = 0;
+};
+
+const char *kindName(uint8_t k) { return k == ALERT_FALL ? "fall" : k == ALERT_IMPACT ? "impact" : "?"; }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        fprintf(stderr, "usage: capturedecode < publishes\n");
+        return 2;
+    }
+
+    std::map<uint16_t, Pending> pending;
+    int bad = 0, done = 0;
+    char line[2048];
+    printf("capture,unix_time,kind,index,t_ms,x,y,z,trigger\n");
+    while (fgets(line, sizeof(line), stdin)) {
+        char *data = line;
+        char *pub = line[0] == '[' ? strstr(line, "] publish ") : nullptr;
+        if (pub) {
+            char name[64];
+            if (sscanf(pub + 1, " publish %63s", name) != 1 || strcmp(name, CAPTURE_EVENT)) continue;
+            data = pub + 1 + strlen(" publish ") + strlen(name);
+            while (*data == ' ') data++;
+        } else if (strchr(line, ' ')) {
+            continue;
+        }
+        size_t len = strcspn(data, " \r\n");
+        if (!len) continue;
+
+        uint16_t id;
+        uint8_t index, total, bytes[512];
+        size_t n;
+        if (!decodeCaptureChunk(data, len, id, index, total, bytes, sizeof(bytes), n)) {
+            fprintf(stderr, "undecodable chunk: %.*s\n", (int)len, data);
+            bad++;
+            continue;
+        }
+        Pending &p = pending[id];
+        if (!p.total) {
+            p.total = total;
+            p.chunks.resize(total);
+            p.have.assign(total, false);
+        }
+        if (total != p.total || p.have[index]) continue;     /* retry or stray */
+        p.chunks[index].assign(bytes, bytes + n);
+        p.have[index] = true;
+        p.chunkChars += len;
+        bool complete = true;
+        for (bool h : p.have) complete = complete && h;
+        if (!complete) continue;
+
+        std::vector<uint8_t> blob;
+        for (auto &c : p.chunks) blob.insert(blob.end(), c.begin(), c.end());
+        static CaptureSample s[65535];
+        CaptureInfo info;
+        if (!decodeCapture(blob.data(), blob.size(), info, s, 65535)) {
+            fprintf(stderr, "capture %04x: undecodable snapshot\n", id);
+            bad++;
+        } else {
+            double scale = 1.0 / (1 << info.qPoint);
+            uint32_t t0 = s[info.trigger].ms;
+            for (uint16_t i = 0; i < info.count; i++) {
+                printf("%04x,%lu,%s,%u,%ld,%.4f,%.4f,%.4f,%d\n", id,
+                       (unsigned long)info.unixTime, kindName(info.kind), i,
+                       (long)(int32_t)(s[i].ms - t0), s[i].x * scale, s[i].y * scale,
+                       s[i].z * scale, i == info.trigger);
+            }
+            fprintf(stderr, "capture %04x: %s at %lu, %u samples (%ld..%ld ms), "
+                    "%zu B in %u chunks (%zu chars), raw %u B, ratio %.2f\n",
+                    id, kindName(info.kind), (unsigned long)info.unixTime, info.count,
+                    (long)(int32_t)(s[0].ms - t0), (long)(int32_t)(s[info.count - 1].ms - t0),
+                    blob.size(), p.total, p.chunkChars, info.count * 10u,
+                    (double)info.count * 10 / blob.size());
+            done++;
+        }
+        pending.erase(id);
+    }
+    for (auto &kv : pending) {
+        fprintf(stderr, "capture %04x: incomplete, missing chunks", kv.first);
+        for (uint8_t i = 0; i < kv.second.total; i++)
+            if (!kv.second.have[i]) fprintf(stderr, " %u", i);
+        fprintf(stderr, "\n");
+    }
+    fprintf(stderr, "%d captures, %zu incomplete, %d undecodable\n", done, pending.size(), bad);
+    return bad ? 1 : 0;
+}
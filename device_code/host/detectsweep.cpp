@@ -0,0 +1,354 @@
+/*
+ * SafeNeck – offline detector evaluation and threshold sweep
+ * ==========================================================
+ * Runs FallDetector (common/fall_detector.h) over every labelled trace in
+ * a directory for each point of a parameter grid and reports how each
+ * configuration trades missed falls against false alarms.
+ *
+ *   • Traces are decoded once: the BNO085 packets become the same
+ *     DetectorSample stream the firmware builds (squared Q8 magnitude,
+ *     stability class, feature-window spread).  The grid then only
+ *     re-runs the state machine, which is a few ns per sample.
+ *   • Grid points are handed out to one worker per core.  The swept
+ *     values are thread_local statics of the profile, so each worker
+ *     runs the same detector code the firmware compiles, with its own
+ *     thresholds.
+ *   • Labels come from FILE.labels next to each trace (tracegen writes
+ *     them): "fall|impact <seconds> [peak g]" per line.
+ *
+ * A fall alert from 1 s before to 10 s after a labelled fall is a hit and
+ * its latency is counted from the labelled impact; any other fall alert
+ * counts against precision.  An alert of either kind near no label at
+ * all is also a false alarm (FA/h).
+ *
+ * Usage:
+ *   detectsweep DIR [--base reference|main] [--threads N] [--top N]
+ *               [--impact LO:HI:STEP] [--freefall LO:HI:STEP]
+ *               [--confirm LO:HI:STEP] [--still LO:HI:STEP]
+ * -----------------------------------------------------------------------*/
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trace.h"
+#include "common/shtp.h"
+#include "common/fall_detector.h"
+#include "common/feature_window.h"
+
+namespace {
+
+const uint32_t MATCH_BEFORE_MS = 1000;
+const uint32_t MATCH_AFTER_MS  = 10000;
+
+/* ── Runtime profile ──────────────────────────────────────────────── */
+template <typename Base>
+struct Swept : Base {
+    static thread_local double   IMPACT_G;
+    static thread_local double   FREEFALL_G;
+    static thread_local uint32_t FREEFALL_CONFIRM_MS;
+    static thread_local uint32_t POST_IMPACT_STILL_MS;
+};
+template <typename B> thread_local double   Swept<B>::IMPACT_G             = B::IMPACT_G;
+template <typename B> thread_local double   Swept<B>::FREEFALL_G           = B::FREEFALL_G;
+template <typename B> thread_local uint32_t Swept<B>::FREEFALL_CONFIRM_MS  = B::FREEFALL_CONFIRM_MS;
+template <typename B> thread_local uint32_t Swept<B>::POST_IMPACT_STILL_MS = B::POST_IMPACT_STILL_MS;
+
+struct Params {
+    double   impactG;
+    double   freefallG;
+    uint32_t confirmMs;
+    uint32_t stillMs;
+};
+
+struct Label {
+    bool     fall;
+    uint32_t ms;
+};
+
+struct Trace {
+    std::string                 name;
+    std::vector<DetectorSample> samples;
+    std::vector<Label>          labels;
+    double                      hours;
+};
+
+struct Result {
+    Params   p;
+    uint32_t hits = 0, missed = 0, wrongFalls = 0, falseAlarms = 0;
+    uint64_t latencySumMs = 0;
+    uint32_t latencyMaxMs = 0;
+    double   precision = 0, recall = 0, f1 = 0, faPerHour = 0;
+};
+
+/* ── Loading ──────────────────────────────────────────────────────── */
+bool loadLabels(const std::string &path, std::vector<Label> &out) {
+    FILE *f = fopen(path.c_str(), "r");
+    if (!f) return false;
+    char kind[16];
+    double t;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%15s %lf", kind, &t) != 2) continue;
+        out.push_back({ !strcmp(kind, "fall"), (uint32_t)(t * 1000.0 + 0.5) });
+    }
+    fclose(f);
+    return true;
+}
+
+inline int16_t le16(const uint8_t *p) { return (int16_t)(p[0] | p[1] << 8); }
+
+/* toMilliG without pulling in event_codec.h */
+inline int32_t toMilliG(float g) { return (int32_t)(g * 1000.0f + 0.5f); }
+
+/* The firmware's sample stream: reference.c detects on linear
+ * acceleration (0x04) with the stability class, window spread and
+ * posture (0x08, 0x06), main.c on the raw accelerometer (0x01) alone. */
+bool loadTrace(const std::string &path, bool linear, Trace &t) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    std::vector<trace::Record> records;
+    bool ok = trace::readAll(f, records);
+    fclose(f);
+    if (!ok) return false;
+
+    static FeatureWindow<256> window(2000, 200, 3000);
+    window.clear();
+    const uint8_t want = linear ? 0x04 : 0x01;
+    uint8_t stability = 0;
+    UpTracker<250> orientation;
+    uint64_t lastUs = 0;
+    for (const trace::Record &r : records) {
+        if (r.addr != trace::ADDR_IMU || r.bytes.size() < 4) continue;
+        lastUs = r.tUs;
+        for (size_t pos = 4; pos < r.bytes.size(); ) {
+            const uint8_t *rep = &r.bytes[pos];
+            uint8_t len = shtpReportLength(rep[0]);
+            if (!len || pos + len > r.bytes.size()) break;
+            pos += len;
+            uint32_t ms = (uint32_t)(r.tUs / 1000);
+            if (rep[0] == 0x13) { stability = rep[4]; continue; }
+            if (rep[0] == 0x08) {
+                orientation.rotation(ms, le16(rep + 4), le16(rep + 6), le16(rep + 8), le16(rep + 10));
+                continue;
+            }
+            if (rep[0] == 0x06) { orientation.gravity(ms, le16(rep + 4), le16(rep + 6), le16(rep + 8)); continue; }
+            if (rep[0] != want) continue;
+
+            DetectorSample s;
+            s.ms    = ms;
+            s.magSq = accelMagSq(le16(rep + 4), le16(rep + 6), le16(rep + 8));
+            if (linear) {
+                window.push(s.ms, toMilliG(accelRawSqToG(s.magSq, 8)));
+                uint32_t sd = window.stddevMg();
+                s.stability = stability;
+                s.up        = orientation.up(ms);
+                s.spreadMg  = sd < DetectorSample::SPREAD_UNKNOWN ? (uint16_t)sd
+                                                                  : DetectorSample::SPREAD_UNKNOWN - 1;
+            }
+            t.samples.push_back(s);
+        }
+    }
+    t.hours = lastUs / 3.6e9;
+    return true;
+}
+
+/* ── Evaluation ───────────────────────────────────────────────────── */
+template <typename Profile>
+void evaluate(const std::vector<Trace> &traces, Result &res) {
+    typedef Swept<Profile> P;
+    P::IMPACT_G             = res.p.impactG;
+    P::FREEFALL_G           = res.p.freefallG;
+    P::FREEFALL_CONFIRM_MS  = res.p.confirmMs;
+    P::POST_IMPACT_STILL_MS = res.p.stillMs;
+
+    for (const Trace &t : traces) {
+        FallDetector<P> det;
+        std::vector<bool> matched(t.labels.size(), false);
+        for (const DetectorSample &s : t.samples) {
+            DetectorEvent ev = det.step(s);
+            if (ev != DETECTOR_ALERT_FALL && ev != DETECTOR_ALERT_IMPACT) continue;
+
+            bool nearAny = false, hit = false;
+            for (size_t i = 0; i < t.labels.size(); i++) {
+                const Label &l = t.labels[i];
+                if (s.ms + MATCH_BEFORE_MS < l.ms || s.ms > l.ms + MATCH_AFTER_MS) continue;
+                nearAny = true;
+                if (ev == DETECTOR_ALERT_FALL && l.fall && !matched[i]) {
+                    matched[i] = hit = true;
+                    uint32_t lat = s.ms > l.ms ? s.ms - l.ms : 0;
+                    res.latencySumMs += lat;
+                    res.latencyMaxMs = std::max(res.latencyMaxMs, lat);
+                    break;
+                }
+            }
+            if (hit) { res.hits++; continue; }
+            if (ev == DETECTOR_ALERT_FALL) res.wrongFalls++;   /* at a shove, or at nothing */
+            if (!nearAny) res.falseAlarms++;
+        }
+        for (size_t i = 0; i < t.labels.size(); i++)
+            if (t.labels[i].fall && !matched[i]) res.missed++;
+    }
+}
+
+void score(Result &r, double hours) {
+    uint32_t called = r.hits + r.wrongFalls;
+    r.precision = called ? (double)r.hits / called : 0;
+    r.recall    = r.hits + r.missed ? (double)r.hits / (r.hits + r.missed) : 0;
+    r.f1        = r.precision + r.recall > 0 ? 2 * r.precision * r.recall / (r.precision + r.recall) : 0;
+    r.faPerHour = hours > 0 ? r.falseAlarms / hours : 0;
+}
+
+bool parseRange(const char *v, double &lo, double &hi, double &step) {
+    return sscanf(v, "%lf:%lf:%lf", &lo, &hi, &step) == 3 && step > 0 && hi >= lo;
+}
+
+std::vector<double> expand(double lo, double hi, double step) {
+    std::vector<double> out;
+    for (double x = lo; x <= hi + step * 1e-6; x += step) out.push_back(x);
+    return out;
+}
+
+void usage() {
+    fprintf(stderr,
+        "usage: detectsweep DIR [--base reference|main] [--threads N] [--top N]\n"
+        "                   [--impact LO:HI:STEP] [--freefall LO:HI:STEP]\n"
+        "                   [--confirm LO:HI:STEP] [--still LO:HI:STEP]\n");
+}
+
+void printRow(const char *tag, const Result &r) {
+    printf("%-8s %6.2f %6.2f %6u %6u   %4u %4u %4u %6.2f   %5.3f %5.3f %5.3f   %6.0f %6u\n",
+           tag, r.p.impactG, r.p.freefallG, r.p.confirmMs, r.p.stillMs,
+           r.hits, r.missed, r.wrongFalls, r.faPerHour, r.precision, r.recall, r.f1,
+           r.hits ? (double)r.latencySumMs / r.hits : 0.0, r.latencyMaxMs);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argv[1][0] == '-') { usage(); return 2; }
+    const char *dir = argv[1];
+    bool linear = true;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t top = 15;
+
+    typedef ImpactStillnessProfile Ref;
+    typedef FreefallImpactProfile  Main;
+    double rng[4][3] = {
+        { 2.0, 4.5, 0.25 },       /* impact g      */
+        { 0.1, 0.4, 0.05 },       /* freefall g    */
+        { 100, 800, 100 },        /* confirm ms    */
+        { 500, 3000, 250 },       /* still ms      */
+    };
+    for (int i = 2; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!v) { usage(); return 2; }
+        int which = !strcmp(a, "--impact") ? 0 : !strcmp(a, "--freefall") ? 1 :
+                    !strcmp(a, "--confirm") ? 2 : !strcmp(a, "--still") ? 3 : -1;
+        if (which >= 0) {
+            if (!parseRange(v, rng[which][0], rng[which][1], rng[which][2])) { usage(); return 2; }
+        } else if (!strcmp(a, "--base"))    linear = strcmp(v, "main") != 0;
+        else if (!strcmp(a, "--threads"))   threads = std::max(1, atoi(v));
+        else if (!strcmp(a, "--top"))       top = (size_t)atoi(v);
+        else { usage(); return 2; }
+        i++;
+    }
+
+    /* Traces, decoded once */
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<Trace> traces;
+    DIR *d = opendir(dir);
+    if (!d) { perror(dir); return 1; }
+    std::vector<std::string> names;
+    while (dirent *e = readdir(d)) {
+        std::string n = e->d_name;
+        if (n.size() > 6 && n.compare(n.size() - 6, 6, ".trace") == 0) names.push_back(n);
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+    double hours = 0;
+    size_t samples = 0, falls = 0;
+    for (const std::string &n : names) {
+        Trace t;
+        t.name = n;
+        std::string path = std::string(dir) + "/" + n;
+        if (!loadLabels(path + ".labels", t.labels)) {
+            fprintf(stderr, "detectsweep: %s has no .labels, skipped\n", n.c_str());
+            continue;
+        }
+        if (!loadTrace(path, linear, t)) {
+            fprintf(stderr, "detectsweep: %s is not a trace\n", n.c_str());
+            return 1;
+        }
+        hours   += t.hours;
+        samples += t.samples.size();
+        for (const Label &l : t.labels) falls += l.fall;
+        traces.push_back(std::move(t));
+    }
+    if (traces.empty()) { fprintf(stderr, "detectsweep: no labelled traces in %s\n", dir); return 1; }
+    auto t1 = std::chrono::steady_clock::now();
+
+    /* Grid */
+    std::vector<Result> grid;
+    for (double ig : expand(rng[0][0], rng[0][1], rng[0][2]))
+        for (double fg : expand(rng[1][0], rng[1][1], rng[1][2]))
+            for (double cm : expand(rng[2][0], rng[2][1], rng[2][2]))
+                for (double sm : expand(rng[3][0], rng[3][1], rng[3][2])) {
+                    Result r;
+                    r.p = { ig, fg, (uint32_t)(cm + 0.5), (uint32_t)(sm + 0.5) };
+                    grid.push_back(r);
+                }
+    Result firmware;
+    firmware.p = linear ? Params{ Ref::IMPACT_G, Ref::FREEFALL_G, Ref::FREEFALL_CONFIRM_MS, Ref::POST_IMPACT_STILL_MS }
+                        : Params{ Main::IMPACT_G, Main::FREEFALL_G, Main::FREEFALL_CONFIRM_MS, Main::POST_IMPACT_STILL_MS };
+    grid.push_back(firmware);
+
+    std::atomic<size_t> next{0};
+    auto worker = [&] {
+        for (size_t i; (i = next.fetch_add(1)) < grid.size(); ) {
+            if (linear) evaluate<Ref>(traces, grid[i]);
+            else        evaluate<Main>(traces, grid[i]);
+            score(grid[i], hours);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < threads; i++) pool.emplace_back(worker);
+    for (std::thread &th : pool) th.join();
+    auto t2 = std::chrono::steady_clock::now();
+
+    firmware = grid.back();
+    grid.pop_back();
+    std::sort(grid.begin(), grid.end(), [](const Result &a, const Result &b) {
+        if (a.f1 != b.f1) return a.f1 > b.f1;
+        if (a.faPerHour != b.faPerHour) return a.faPerHour < b.faPerHour;
+        double la = a.hits ? (double)a.latencySumMs / a.hits : 1e12;
+        double lb = b.hits ? (double)b.latencySumMs / b.hits : 1e12;
+        return la < lb;
+    });
+
+    double loadS  = std::chrono::duration<double>(t1 - t0).count();
+    double sweepS = std::chrono::duration<double>(t2 - t1).count();
+    printf("traces           : %zu (%.2f h, %zu samples, %zu falls), %s profile\n",
+           traces.size(), hours, samples, falls, linear ? "reference.c" : "main.c");
+    printf("grid             : %zu configurations on %u threads\n", grid.size(), threads);
+    printf("time             : %.2f s decode, %.2f s sweep (%.0f Msamples/s)\n",
+           loadS, sweepS, sweepS > 0 ? (double)samples * (grid.size() + 1) / sweepS / 1e6 : 0.0);
+    printf("\n%-8s %6s %6s %6s %6s   %4s %4s %4s %6s   %5s %5s %5s   %6s %6s\n",
+           "", "imp g", "ff g", "conf", "still", "hit", "miss", "wrng", "FA/h",
+           "prec", "rec", "F1", "lat ms", "max");
+    printRow("firmware", firmware);
+    for (size_t i = 0; i < grid.size() && i < top; i++) {
+        char tag[24];
+        snprintf(tag, sizeof(tag), "#%zu", i + 1);
+        printRow(tag, grid[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * SafeNeck – packed event encoding vs snprintf JSON
+ * =================================================
+ * Encodes the same events the firmwares publish both ways and reports
+ * the cost per event and the bytes each puts on air.  The JSON formats
+ * are the ones main.c and reference.c used before event_codec.h, float
+ * conversions included.  Every binary encoding is decoded again and
+ * checked against its input.
+ *
+ * Timings are for the machine this runs on; on the Boron's Cortex-M4F
+ * the gap widens, since newlib's %f formatting is software double
+ * arithmetic there.
+ *
+ * Usage:
+ *   eventbench [--iterations N]
+ * -----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <functional>
+
+#include "common/event_codec.h"
+
+namespace {
+
+struct Case {
+    const char *name;
+    Event       event;
+    std::function<int(char *, size_t)> json;
+};
+
+volatile size_t gSink;
+
+double nsPer(uint32_t iterations, const std::function<size_t()> &fn) {
+    auto t0 = std::chrono::steady_clock::now();
+    size_t sink = 0;
+    for (uint32_t i = 0; i < iterations; i++) sink += fn();
+    auto t1 = std::chrono::steady_clock::now();
+    gSink = sink;
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / iterations;
+}
+
+bool same(const Event &a, const Event &b) {
+    return a.type == b.type && a.unixTime == b.unixTime && a.hasFix == b.hasFix &&
+           a.latE7 == b.latE7 && a.lonE7 == b.lonE7 && a.altDm == b.altDm &&
+           a.speedKmhX10 == b.speedKmhX10 && a.hdopX100 == b.hdopX100 && a.sats == b.sats &&
+           a.batteryPct == b.batteryPct && a.alertKind == b.alertKind && a.gMilli == b.gMilli &&
+           a.thresholdMilli == b.thresholdMilli && a.durationMs == b.durationMs;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    uint32_t iterations = 200000;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--iterations") && i + 1 < argc) iterations = (uint32_t)atoi(argv[++i]);
+        else { fprintf(stderr, "usage: eventbench [--iterations N]\n"); return 2; }
+    }
+
+    const double lat = 37.7749123, lon = -122.4194456, alt = 16.4, spd = 5.2, g = 3.374;
+    const float  battery = 87.5f;
+    const uint32_t ts = 1760000030;
+
+    Event loc;
+    loc.type = EVENT_LOCATION; loc.unixTime = ts; loc.hasFix = true;
+    loc.latE7 = 377749123; loc.lonE7 = -1224194456; loc.altDm = 164;
+    loc.speedKmhX10 = 52; loc.hdopX100 = 105; loc.sats = 8; loc.batteryPct = 88;
+
+    Event alert;
+    alert.type = EVENT_ALERT; alert.unixTime = ts; alert.hasFix = true; alert.alertKind = ALERT_FALL;
+    alert.latE7 = loc.latE7; alert.lonE7 = loc.lonE7; alert.gMilli = 3374; alert.batteryPct = 88;
+
+    Event impact;
+    impact.type = EVENT_IMPACT; impact.unixTime = ts; impact.gMilli = 3374; impact.thresholdMilli = 3000;
+
+    Event freefall;
+    freefall.type = EVENT_FREEFALL; freefall.unixTime = ts; freefall.gMilli = 120; freefall.durationMs = 500;
+
+    Case cases[] = {
+        { "location (main.c)", loc, [&](char *out, size_t cap) {
+              char la[16], lo[16];
+              formatE7(la, sizeof(la), loc.latE7);
+              formatE7(lo, sizeof(lo), loc.lonE7);
+              return snprintf(out, cap,
+                  "{\"lat\":%s,\"lon\":%s,\"spd\":%u.%u,\"fix\":%s,"
+                  "\"sats\":%u,\"hdop\":%u.%02u,\"bat\":%.1f,\"ts\":%lu}",
+                  la, lo, 5u, 2u, "true", 8u, 1u, 5u, battery, (unsigned long)ts);
+          } },
+        { "position (reference)", loc, [&](char *out, size_t cap) {
+              char a[16], h[16], s[16];
+              snprintf(a, sizeof(a), "%.*f", 1, alt);
+              snprintf(h, sizeof(h), "%.*f", 1, 1.05);
+              snprintf(s, sizeof(s), "%.*f", 1, spd);
+              return snprintf(out, cap,
+                  "{\"fix\":true,\"lat\":%.6f,\"lon\":%.6f,\"alt_m\":%s,\"hdop\":%s,\"spd_kmph\":%s,\"sats\":%u}",
+                  lat, lon, a, h, s, 8u);
+          } },
+        { "alert", alert, [&](char *out, size_t cap) {
+              return snprintf(out, cap,
+                  "{\"alert\":\"%s\",\"g\":%.2f,\"lat\":%.6f,\"lon\":%.6f,\"alt\":%.1f,\"sats\":%u}",
+                  "fall", g, lat, lon, alt, 8u);
+          } },
+        { "impact", impact, [&](char *out, size_t cap) {
+              return snprintf(out, cap,
+                  "{\"event\":\"impact_detected\",\"g\":%.2f,\"threshold\":%.1f}", g, 3.0);
+          } },
+        { "freefall", freefall, [&](char *out, size_t cap) {
+              return snprintf(out, cap,
+                  "{\"event\":\"freefall_detected\",\"g\":%.2f,\"duration_ms\":%lu}", 0.12, 500UL);
+          } },
+    };
+
+    printf("%-22s %12s %12s %12s   %10s %10s %10s\n", "event",
+           "json B", "base85 B", "base64 B", "json ns", "b85 ns", "b64 ns");
+    size_t totalJson = 0, total85 = 0, total64 = 0;
+    bool ok = true;
+    for (Case &c : cases) {
+        char buf[300];
+        size_t json = (size_t)c.json(buf, sizeof(buf));
+        size_t b85  = encodeEvent(c.event, buf, sizeof(buf), TEXT_BASE85);
+        Event back;
+        ok &= decodeEvent(buf, b85, back) && same(back, c.event);
+        size_t b64  = encodeEvent(c.event, buf, sizeof(buf), TEXT_BASE64);
+        ok &= decodeEvent(buf, b64, back) && same(back, c.event);
+
+        double nsJson = nsPer(iterations, [&] { return (size_t)c.json(buf, sizeof(buf)); });
+        double ns85   = nsPer(iterations, [&] { return encodeEvent(c.event, buf, sizeof(buf), TEXT_BASE85); });
+        double ns64   = nsPer(iterations, [&] { return encodeEvent(c.event, buf, sizeof(buf), TEXT_BASE64); });
+        printf("%-22s %12zu %12zu %12zu   %10.0f %10.0f %10.0f\n",
+               c.name, json, b85, b64, nsJson, ns85, ns64);
+        totalJson += json; total85 += b85; total64 += b64;
+    }
+    printf("%-22s %12zu %12zu %12zu   (%.0f%% / %.0f%% of JSON)\n", "total",
+           totalJson, total85, total64, 100.0 * total85 / totalJson, 100.0 * total64 / totalJson);
+    printf("round trip             : %s\n", ok ? "ok" : "MISMATCH");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,59 @@
+/*
+ * SafeNeck – decode packed binary events back into JSON
+ * =====================================================
+ * The receiving end of common/event_codec.h, as a webhook receiver would
+ * run it.  Reads one event per line: either the bare event data, or a
+ * `replay_* --publish` line ("[t] publish NAME DATA").  safeneck/track
+ * batches are left to trackdecode and safety/capture chunks to
+ * capturedecode.  Prints one JSON object per event:
+ *
+ *   {"name":"safety/alert","event":"alert","ts":…,"alert":"fall",…}
+ *
+ * Usage:
+ *   build/replay_reference --trace fall.trace --publish | eventdecode
+ *   eventdecode < webhook-payloads.txt
+ * -----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+
+#include "common/event_codec.h"
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        fprintf(stderr, "usage: eventdecode < events\n");
+        return 2;
+    }
+
+    char line[2048];
+    int events = 0, bad = 0;
+    while (fgets(line, sizeof(line), stdin)) {
+        char name[64] = "";
+        char *data = line;
+        char *pub = line[0] == '[' ? strstr(line, "] publish ") : nullptr;
+        if (pub) {
+            pub++;
+            if (sscanf(pub, " publish %63s", name) != 1) continue;
+            if (!strcmp(name, "safeneck/track") || !strcmp(name, "safety/capture")) continue;
+            data = pub + strlen(" publish ") + strlen(name);
+            while (*data == ' ') data++;
+        } else if (strchr(line, ' ')) {
+            continue;                       /* report text, not an event */
+        }
+        size_t len = strcspn(data, " \r\n");
+        if (!len) continue;
+
+        Event e;
+        if (!decodeEvent(data, len, e)) {
+            fprintf(stderr, "undecodable: %.*s\n", (int)len, data);
+            bad++;
+            continue;
+        }
+        char json[256];
+        formatEventJson(e, json, sizeof(json));
+        if (name[0]) printf("{\"name\":\"%s\",%s\n", name, json + 1);
+        else         printf("%s\n", json);
+        events++;
+    }
+    fprintf(stderr, "%d events, %d undecodable\n", events, bad);
+    return bad ? 1 : 0;
+}
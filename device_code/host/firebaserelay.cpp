@@ -0,0 +1,164 @@
+/*
+ * SafeNeck – relay device events into the app's Firebase layout
+ * =============================================================
+ * Location and alert events are packed binary records and positions come
+ * in safeneck/track batches, neither of which a Particle webhook can turn
+ * into the JSON the Flutter app reads.  This relay decodes them with
+ * decodeEvent()/formatEventJson() and decodeTrack() and prints one
+ * Firebase REST write per line:
+ *
+ *   PUT users/<uid>/devices/<device>/location {"ts":…,"fix":true,"lat":…,…}
+ *   PATCH users/<uid>/alerts/<device>-<ts> {"deviceId":"…","type":"fall",…}
+ *
+ * An older position than the one last written (a journal replay) is not
+ * written over it.  Alerts are keyed by device and time, so a replayed
+ * alert lands on the same entry, and PATCH keeps the app's "ack".
+ * Impact, freefall, diag and capture events are not relayed.
+ *
+ * Reads one event per line: `particle subscribe` output
+ * ({"name":…,"data":…,"coreid":…}), or a `replay_* --publish` line
+ * ("[t] publish NAME DATA"), whose device is --device.
+ *
+ * Usage:
+ *   particle subscribe safe --device <id> | firebaserelay --uid <uid> |
+ *       while read -r method path body; do
+ *           curl -sS -X "$method" -d "$body" "$DB/$path.json?auth=$TOKEN"
+ *       done
+ *   build/replay_main --trace fall.trace --publish | firebaserelay --uid test
+ * -----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <string>
+
+#include "common/event_codec.h"
+#include "common/nmea_fix.h"
+#include "common/track_batch.h"
+
+namespace {
+
+const char *uid = nullptr;
+const char *defaultDevice = "replay";
+std::map<std::string, uint32_t> lastFixTime;   /* per device */
+int writes = 0, skipped = 0, bad = 0;
+
+void usage() {
+    fprintf(stderr, "usage: firebaserelay --uid UID [--device ID] < events\n");
+}
+
+/* Copies the string value of "key" in a one-line JSON object. */
+bool jsonField(const char *line, const char *key, char *out, size_t cap) {
+    char pat[32];
+    snprintf(pat, sizeof(pat), "\"%s\":\"", key);
+    const char *p = strstr(line, pat);
+    if (!p) return false;
+    p += strlen(pat);
+    size_t n = strcspn(p, "\"");
+    if (n >= cap) return false;
+    memcpy(out, p, n);
+    out[n] = 0;
+    return true;
+}
+
+/* Writes the position unless the device already has a newer one. */
+bool newerFix(const char *device, uint32_t unixTime) {
+    uint32_t &last = lastFixTime[device];
+    if (unixTime < last) { skipped++; return false; }
+    last = unixTime;
+    return true;
+}
+
+void relayTrack(const char *device, const char *data, size_t len) {
+    TrackHeader hdr;
+    TrackPoint newest = {};
+    if (decodeTrack(data, len, hdr, [&](const TrackPoint &p) { newest = p; }) <= 0) {
+        fprintf(stderr, "undecodable track: %.*s\n", (int)len, data);
+        bad++;
+        return;
+    }
+    if (!newerFix(device, newest.unixTime)) return;
+    char lat[16], lon[16], bat[8];
+    formatE7(lat, sizeof(lat), newest.latE7);
+    formatE7(lon, sizeof(lon), newest.lonE7);
+    if (hdr.batteryPct == 0xFF) snprintf(bat, sizeof(bat), "null");
+    else                        snprintf(bat, sizeof(bat), "%u", hdr.batteryPct);
+    printf("PUT users/%s/devices/%s/location "
+           "{\"event\":\"location\",\"ts\":%lu,\"fix\":true,\"lat\":%s,\"lon\":%s,"
+           "\"hdop\":%u.%02u,\"sats\":%u,\"bat\":%s}\n",
+           uid, device, (unsigned long)newest.unixTime, lat, lon,
+           hdr.hdopX100 / 100, hdr.hdopX100 % 100, hdr.sats, bat);
+    writes++;
+}
+
+void relayEvent(const char *device, const char *data, size_t len) {
+    Event e;
+    if (!decodeEvent(data, len, e)) {
+        fprintf(stderr, "undecodable: %.*s\n", (int)len, data);
+        bad++;
+        return;
+    }
+    char json[256];
+    if (formatEventJson(e, json, sizeof(json)) >= (int)sizeof(json)) { bad++; return; }
+
+    switch (e.type) {
+    case EVENT_LOCATION:
+        if (!newerFix(device, e.unixTime)) return;
+        printf("PUT users/%s/devices/%s/location %s\n", uid, device, json);
+        break;
+    case EVENT_ALERT:
+        /* The app lists alerts by deviceId, type, lat, lon and ts. */
+        printf("PATCH users/%s/alerts/%s-%lu {\"deviceId\":\"%s\",\"type\":\"%s\",%s\n",
+               uid, device, (unsigned long)e.unixTime, device,
+               e.alertKind == ALERT_FALL ? "fall" : "impact", json + 1);
+        break;
+    default:
+        skipped++;
+        return;
+    }
+    writes++;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!v) { usage(); return 2; }
+        if      (!strcmp(a, "--uid"))    uid = v;
+        else if (!strcmp(a, "--device")) defaultDevice = v;
+        else { usage(); return 2; }
+        i++;
+    }
+    if (!uid) { usage(); return 2; }
+
+    char line[2048];
+    while (fgets(line, sizeof(line), stdin)) {
+        char name[64] = "", device[64], json[1024];
+        const char *data = json;
+        snprintf(device, sizeof(device), "%s", defaultDevice);
+        char *pub = line[0] == '[' ? strstr(line, "] publish ") : nullptr;
+        if (pub) {
+            if (sscanf(pub + 1, " publish %63s", name) != 1) continue;
+            data = pub + strlen("] publish ") + strlen(name);
+            while (*data == ' ') data++;
+        } else if (line[0] == '{') {
+            if (!jsonField(line, "name", name, sizeof(name)) ||
+                !jsonField(line, "data", json, sizeof(json))) continue;
+            jsonField(line, "coreid", device, sizeof(device));
+        } else {
+            continue;                       /* report text, not an event */
+        }
+        size_t len = strcspn(data, " \r\n");
+        if (!len) continue;
+
+        const char *kind = strrchr(name, '/');
+        kind = kind ? kind + 1 : name;
+        if (!strcmp(kind, "track"))                              relayTrack(device, data, len);
+        else if (strcmp(kind, "capture") && strcmp(kind, "diag")) relayEvent(device, data, len);
+        else                                                     skipped++;
+        fflush(stdout);
+    }
+    fprintf(stderr, "%d writes, %d skipped, %d undecodable\n", writes, skipped, bad);
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,230 @@
+/*
+ * SafeNeck – checks of the flash journal against the NOR stand-in
+ * ===============================================================
+ * Runs common/flash_journal.h on a 4 × 4 KB journal in a temporary
+ * --flash file and checks what it keeps and what it replays:
+ *
+ *   1. fill    – about 2.5 times the journal, an alert every 50th event:
+ *                segments roll, unsent events are overwritten and the
+ *                alerts are rescued, so every alert is still there.
+ *   2. reboot  – a fresh journal on the same file finds the same backlog
+ *                and replays it alerts first, each pass newest first,
+ *                ending with the newest events that were not overwritten.
+ *                The alerts are further apart than WALK_MAX, so next()
+ *                pauses on the way; the commit survives the next reboot.
+ *   3. tear    – the file is cut halfway through the last record, as a
+ *                brownout would leave it.  The rescan counts one corrupt
+ *                record, loses only that one, and appends after it.
+ *
+ * Each failed check is printed; the exit status is 1 if any failed.
+ *
+ * Usage:
+ *   build/journalcheck
+ * -----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "hal_host.h"
+#include "common/flash_journal.h"
+
+namespace {
+
+typedef FlashJournal<4, 4096, 622> Journal;
+
+const uint8_t  LOCATION    = 2;        /* PublishQueue::LOCATION */
+const uint32_t EVENTS      = 600;
+const uint32_t ALERT_EVERY = 50;
+
+int failures = 0;
+
+#define CHECK(cond, ...)                                               \
+    do {                                                               \
+        if (!(cond)) {                                                 \
+            printf("FAIL %s:%d: %s – ", __FILE__, __LINE__, #cond);    \
+            printf(__VA_ARGS__);                                       \
+            printf("\n");                                              \
+            failures++;                                                \
+        }                                                              \
+    } while (0)
+
+/* Boots a fresh journal on the flash file, as after a reboot. */
+std::unique_ptr<Journal> boot() {
+    flashHostRestart();
+    std::unique_ptr<Journal> j(new Journal("journal"));
+    CHECK(j->begin(), "begin() failed");
+    return j;
+}
+
+/* Event n: "n=NNNNN" and padding, 66 bytes in the journal. */
+bool append(Journal &j, uint32_t n, bool alert) {
+    char data[48];
+    snprintf(data, sizeof(data), "n=%05u ..............................", (unsigned)n);
+    return j.append(alert ? "safeneck/fall" : "safeneck/loc", data, alert ? JOURNAL_ALERT : LOCATION);
+}
+
+struct Replayed {
+    uint32_t seq;
+    uint8_t  prio;
+    uint32_t n;
+};
+
+/* Runs a whole replay and commits it; `pauses` counts next() calls that
+ * stopped at the walk limit. */
+std::vector<Replayed> replay(Journal &j, uint32_t &pauses) {
+    std::vector<Replayed> out;
+    Journal::Record r;
+    pauses = 0;
+    for (;;) {
+        if (j.next(r)) {
+            unsigned n = 0;
+            CHECK(sscanf(r.data, "n=%u", &n) == 1, "record data \"%s\"", r.data);
+            out.push_back({ r.seq, r.prio, n });
+        } else if (j.pending()) {
+            pauses++;
+        } else {
+            break;
+        }
+    }
+    CHECK(j.commit(), "commit() failed");
+    return out;
+}
+
+std::vector<uint8_t> readFile(const char *path) {
+    std::vector<uint8_t> buf;
+    FILE *f = fopen(path, "rb");
+    if (!f) return buf;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) buf.insert(buf.end(), chunk, chunk + n);
+    fclose(f);
+    return buf;
+}
+
+/* Offset of event n's data in the file, -1 if it is not there. */
+long findEvent(const std::vector<uint8_t> &flash, uint32_t n) {
+    char key[16];
+    snprintf(key, sizeof(key), "n=%05u ", (unsigned)n);
+    const void *at = memmem(flash.data(), flash.size(), key, strlen(key));
+    return at ? (long)((const uint8_t *)at - flash.data()) : -1;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        fprintf(stderr, "usage: journalcheck\n");
+        return 2;
+    }
+    char path[] = "/tmp/journalcheck-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) { perror("mkstemp"); return 1; }
+    close(fd);
+    hal::options().flashPath = path;
+
+    /* 1. Fill well past the journal's size. */
+    std::set<uint32_t> alerts;
+    uint32_t lastLoc = 0, locs = 0, overwritten, backlog;
+    {
+        auto j = boot();
+        for (uint32_t n = 1; n <= EVENTS; n++) {
+            bool alert = n % ALERT_EVERY == 0;
+            CHECK(append(*j, n, alert), "append %u failed", (unsigned)n);
+            if (alert) alerts.insert(n);
+            else       { lastLoc = n; locs++; }
+        }
+        const Journal::Stats &s = j->stats();
+        backlog     = j->backlog();
+        overwritten = s.overwritten;
+        printf("fill     : %u events, %u overwritten, %u alerts rescued, %u erases, backlog %u\n",
+               (unsigned)s.appended, (unsigned)s.overwritten, (unsigned)s.rescued,
+               (unsigned)s.erases, (unsigned)backlog);
+        CHECK(s.overwritten > 0, "the journal never filled");
+        CHECK(s.rescued > 0, "no alert was rescued");
+        CHECK(backlog == EVENTS - s.overwritten, "backlog %u, %u appended, %u overwritten",
+              (unsigned)backlog, (unsigned)EVENTS, (unsigned)s.overwritten);
+        CHECK(s.corrupt == 0 && s.failed == 0, "%u corrupt, %u failed",
+              (unsigned)s.corrupt, (unsigned)s.failed);
+    }
+
+    /* 2. Reboot and replay. */
+    {
+        auto j = boot();
+        CHECK(j->backlog() == backlog, "backlog %u after the reboot, %u before",
+              (unsigned)j->backlog(), (unsigned)backlog);
+        uint32_t pauses;
+        std::vector<Replayed> got = replay(*j, pauses);
+        printf("replay   : %u events, %u pauses at the walk limit\n",
+               (unsigned)got.size(), (unsigned)pauses);
+        CHECK(got.size() == backlog, "replayed %u of %u", (unsigned)got.size(), (unsigned)backlog);
+        CHECK(pauses > 0, "the alert pass never reached the walk limit");
+
+        size_t i = 0;
+        std::set<uint32_t> seen;
+        for (; i < got.size() && got[i].prio == JOURNAL_ALERT; i++) {
+            CHECK(i == 0 || got[i].seq < got[i - 1].seq, "alert %u not newest first", (unsigned)got[i].n);
+            seen.insert(got[i].n);
+        }
+        CHECK(seen == alerts, "%u of %u alerts replayed", (unsigned)seen.size(), (unsigned)alerts.size());
+        uint32_t want = lastLoc;
+        for (; i < got.size(); i++) {
+            CHECK(got[i].prio == LOCATION, "alert %u after the alert pass", (unsigned)got[i].n);
+            CHECK(got[i].n == want, "event %u, expected %u", (unsigned)got[i].n, (unsigned)want);
+            do want--; while (want % ALERT_EVERY == 0);
+        }
+        CHECK(got.size() - seen.size() == locs - overwritten, "%u events after the alerts, %u kept",
+              (unsigned)(got.size() - seen.size()), (unsigned)(locs - overwritten));
+    }
+    {
+        auto j = boot();
+        CHECK(j->backlog() == 0, "backlog %u after a committed replay", (unsigned)j->backlog());
+    }
+
+    /* 3. Tear the last record of the last segment. */
+    uint32_t torn = 0;
+    {
+        auto j = boot();
+        for (uint32_t n = EVENTS + 1; n < EVENTS * 2 && !torn; n++) {
+            CHECK(append(*j, n, false), "append %u failed", (unsigned)n);
+            if (findEvent(readFile(path), n) >= 3 * 4096 + JOURNAL_HEADER) torn = n;
+        }
+        CHECK(torn, "never reached the last segment");
+        backlog = j->backlog();
+    }
+    std::vector<uint8_t> flash = readFile(path);
+    long at = findEvent(flash, torn);
+    CHECK(truncate(path, at + 10) == 0, "truncate failed");
+    {
+        auto j = boot();
+        const Journal::Stats &s = j->stats();
+        printf("tear     : event %u cut at byte %ld, %u corrupt, backlog %u\n",
+               (unsigned)torn, at + 10, (unsigned)s.corrupt, (unsigned)j->backlog());
+        CHECK(s.corrupt == 1, "%u corrupt records", (unsigned)s.corrupt);
+        CHECK(j->backlog() == backlog - 1, "backlog %u, %u before the tear",
+              (unsigned)j->backlog(), (unsigned)backlog);
+        uint32_t pauses;
+        std::vector<Replayed> got = replay(*j, pauses);
+        CHECK(!got.empty() && got[0].n == torn - 1, "replay starts at %u, expected %u",
+              got.empty() ? 0u : (unsigned)got[0].n, (unsigned)(torn - 1));
+        CHECK(append(*j, EVENTS * 2, true), "append after the tear failed");
+    }
+    {
+        auto j = boot();
+        CHECK(j->stats().corrupt == 1, "%u corrupt records", (unsigned)j->stats().corrupt);
+        CHECK(j->backlog() == 1, "backlog %u after the tear", (unsigned)j->backlog());
+        Journal::Record r;
+        while (!j->next(r) && j->pending()) {}
+        unsigned n = 0;
+        CHECK(sscanf(r.data, "n=%u", &n) == 1 && n == EVENTS * 2 && r.prio == JOURNAL_ALERT,
+              "replayed \"%.7s\" after the tear", r.data);
+    }
+
+    unlink(path);
+    printf("%s\n", failures ? "journal check FAILED" : "journal check passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * SafeNeck – micro-benchmark of the accelerometer batch kernels
+ * =============================================================
+ * Runs every variant of common/accel_batch.h this host can execute
+ * (scalar, SSE2, AVX2 if the CPU has it) over the same synthetic
+ * samples, checks each against the scalar result and prints ns per
+ * sample.  Batches are the size the firmware sees per BNO085 packet
+ * (--batch, default 20) and a long one, so call overhead shows.
+ *
+ * The scalar loops are built with the same flags as everything else, so
+ * whatever the compiler vectorises on its own is in the baseline.
+ *
+ * Usage:
+ *   build/kernelbench [--batch N] [--samples N]
+ * -----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <random>
+#include <vector>
+
+#include "common/accel_batch.h"
+#include "common/accel_q.h"
+
+namespace {
+
+uint64_t nowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+struct Variant {
+    const char *name;
+    void       (*magSq)(const AccelXyz *, uint32_t *, size_t);
+    size_t     (*firstOutside)(const uint32_t *, size_t, uint32_t, uint32_t);
+    AccelStats (*windowStats)(const int16_t *, size_t);
+};
+
+volatile uint64_t gSink;   /* keeps results live */
+
+/* Best of a few rounds of `fn` over the whole data in `batch`-sized calls. */
+template <typename Fn>
+double nsPerSample(size_t total, size_t batch, Fn &&fn) {
+    double best = 1e30;
+    for (int round = 0; round < 7; round++) {
+        uint64_t t0 = nowNs();
+        for (size_t off = 0; off < total; off += batch)
+            fn(off, batch < total - off ? batch : total - off);
+        double ns = (double)(nowNs() - t0) / total;
+        if (ns < best) best = ns;
+    }
+    return best;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    size_t batch = 20, total = 1 << 20;
+    for (int i = 1; i < argc; i++) {
+        const char *v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if      (!strcmp(argv[i], "--batch") && v)   { batch = strtoul(v, nullptr, 10); i++; }
+        else if (!strcmp(argv[i], "--samples") && v) { total = strtoul(v, nullptr, 10); i++; }
+        else {
+            fprintf(stderr, "usage: kernelbench [--batch N] [--samples N]\n");
+            return 2;
+        }
+    }
+    if (!batch || !total) return 2;
+
+    /* Q8 m/s² around 1 g with occasional spikes and dips, and milli-g
+     * magnitudes for the window statistics. */
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(0.0, 60.0);
+    std::vector<AccelXyz> s(total);
+    std::vector<int16_t>  mg(total);
+    for (size_t i = 0; i < total; i++) {
+        double k = i % 997 == 0 ? 4.0 : i % 991 == 0 ? 0.1 : 1.0;
+        s[i].x = (int16_t)noise(rng);
+        s[i].y = (int16_t)(2511 * k + noise(rng));
+        s[i].z = (int16_t)noise(rng);
+        s[i].pad = 0;
+        mg[i] = (int16_t)(sqrt((double)accelMagSq(s[i].x, s[i].y, s[i].z)) * 1000 / 2511);
+    }
+    s[7].x = s[7].y = s[7].z = INT16_MIN;        /* the overflow corner */
+    const uint32_t lo = accelRawSq(0.85, 8), hi = accelRawSq(1.15, 8);
+
+    std::vector<Variant> variants;
+    variants.push_back({ "scalar", accel_batch::scalar::magSq, accel_batch::scalar::firstOutside,
+                         accel_batch::scalar::windowStats });
+#if ACCEL_BATCH_X86
+    variants.push_back({ "sse2", accel_batch::sse2::magSq, accel_batch::sse2::firstOutside,
+                         accel_batch::sse2::windowStats });
+    if (__builtin_cpu_supports("avx2"))
+        variants.push_back({ "avx2", accel_batch::avx2::magSq, accel_batch::avx2::firstOutside,
+                             accel_batch::avx2::windowStats });
+    else
+        printf("(no AVX2 on this CPU – skipped)\n");
+#endif
+
+    std::vector<uint32_t> ref(total), out(total);
+    accel_batch::scalar::magSq(s.data(), ref.data(), total);
+
+    printf("%zu samples, batches of %zu; ns/sample (best of 7)\n", total, batch);
+    printf("%-8s %14s %14s %14s %14s\n", "variant", "magSq", "magSq long", "firstOutside", "windowStats");
+    int bad = 0;
+    for (const Variant &v : variants) {
+        /* Correctness against the scalar reference first. */
+        v.magSq(s.data(), out.data(), total);
+        if (memcmp(out.data(), ref.data(), total * sizeof(uint32_t))) {
+            printf("%-8s magSq differs from scalar\n", v.name);
+            bad++;
+        }
+        for (size_t off = 0; off < total; off += batch) {
+            size_t n = batch < total - off ? batch : total - off;
+            if (v.firstOutside(ref.data() + off, n, lo, hi) !=
+                accel_batch::scalar::firstOutside(ref.data() + off, n, lo, hi)) {
+                printf("%-8s firstOutside differs at batch %zu\n", v.name, off / batch);
+                bad++;
+                break;
+            }
+        }
+        AccelStats a = v.windowStats(mg.data(), 32768 < total ? 32768 : total);
+        AccelStats b = accel_batch::scalar::windowStats(mg.data(), 32768 < total ? 32768 : total);
+        if (a.sum != b.sum || a.sumSq != b.sumSq || a.peak != b.peak) {
+            printf("%-8s windowStats differs from scalar\n", v.name);
+            bad++;
+        }
+
+        double m = nsPerSample(total, batch, [&](size_t off, size_t n) {
+            v.magSq(s.data() + off, out.data() + off, n);
+        });
+        double ml = nsPerSample(total, 4096, [&](size_t off, size_t n) {
+            v.magSq(s.data() + off, out.data() + off, n);
+        });
+        double f = nsPerSample(total, batch, [&](size_t off, size_t n) {
+            gSink = gSink + v.firstOutside(ref.data() + off, n, lo, hi);
+        });
+        double w = nsPerSample(total, batch, [&](size_t off, size_t n) {
+            gSink = gSink + (uint64_t)v.windowStats(mg.data() + off, n).sumSq;
+        });
+        printf("%-8s %14.3f %14.3f %14.3f %14.3f\n", v.name, m, ml, f, w);
+    }
+    printf("results      : %s\n", bad ? "MISMATCH" : "identical to scalar");
+    return bad ? 1 : 0;
+}
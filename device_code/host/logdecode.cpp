@@ -0,0 +1,118 @@
+/*
+ * SafeNeck – decode the deferred binary log
+ * =========================================
+ * The host end of common/binlog.h.  Firmware built with raw log frames
+ * prints each record as "@<base64>"; this tool formats them with the
+ * catalog it was built from (common/log_catalog.h) and passes every
+ * other line through unchanged.  The catalog hash in the boot record is
+ * checked against this build's, so a capture from another build is
+ * flagged rather than mis-decoded.
+ *
+ *   build/replay_reference --trace fall.trace --serial | logdecode
+ *   logdecode < serial-capture.txt
+ *
+ * --bench times a log() call against formatting the same message with
+ * snprintf, the way the call sites did before.
+ * -----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "common/binlog.h"
+
+/* binlog.h stamps records with millis(); the tool has no device clock. */
+unsigned long millis() { return 0; }
+
+namespace {
+
+uint64_t nowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+int bench() {
+    const int N = 1 << 18;                  /* 10 words per pass: fits the ring */
+    volatile float g = 3.37f;
+    volatile uint32_t count = 4;
+    static BinLog<1 << 22> log;
+
+    uint64_t t0 = nowNs();
+    for (int i = 0; i < N; i++) {
+        log.log(LOG_IMPACT, g, 3.0, g * 12.5f);
+        log.log(LOG_ALERT_UPDATE_FALL, count, count, count);
+    }
+    uint64_t logNs = nowNs() - t0;
+
+    char buf[BINLOG_LINE_MAX];
+    volatile size_t sinkLen = 0;
+    uint64_t t2 = nowNs();
+    for (int i = 0; i < N; i++) {
+        sinkLen = sinkLen + snprintf(buf, sizeof(buf), "IMPACT detected: %.2fg (threshold: %.1fg, jerk %.0fg/s)",
+                                     (double)g, 3.0, (double)(g * 12.5f));
+        sinkLen = sinkLen + snprintf(buf, sizeof(buf), "*** ALERT UPDATE %u: fall, %u detections in %u s ***",
+                                     (unsigned)count, (unsigned)count, (unsigned)count);
+    }
+    uint64_t t3 = nowNs();
+
+    printf("per message      : log() %.1f ns, snprintf %.1f ns\n",
+           (double)logNs / (2.0 * N), (double)(t3 - t2) / (2.0 * N));
+    printf("ring             : %lu records, %lu dropped, high water %lu words\n",
+           (unsigned long)log.stats().records, (unsigned long)log.stats().dropped,
+           (unsigned long)log.stats().highWater);
+    printf("catalog          : %u formats, hash %08lx\n", (unsigned)LOG_ID_COUNT,
+           (unsigned long)LOG_CATALOG_HASH);
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc == 2 && !strcmp(argv[1], "--bench")) return bench();
+    if (argc > 1) {
+        fprintf(stderr, "usage: logdecode [--bench] < serial-output\n");
+        return 2;
+    }
+
+    char line[1024];
+    int records = 0, bad = 0, foreign = 0;
+    while (fgets(line, sizeof(line), stdin)) {
+        if (line[0] != '@') {
+            fputs(line, stdout);
+            continue;
+        }
+        size_t len = strcspn(line + 1, " \r\n");
+        uint8_t bytes[BINLOG_MAX_WORDS * 4];
+        int n = base64Decode(bytes, sizeof(bytes), line + 1, len);
+        if (n < 8 || n % 4) {
+            fprintf(stderr, "undecodable: %s", line);
+            bad++;
+            continue;
+        }
+        uint32_t words[BINLOG_MAX_WORDS];
+        for (int i = 0; i < n / 4; i++) {
+            words[i] = (uint32_t)bytes[4 * i] | (uint32_t)bytes[4 * i + 1] << 8 |
+                       (uint32_t)bytes[4 * i + 2] << 16 | (uint32_t)bytes[4 * i + 3] << 24;
+        }
+        uint8_t id = (uint8_t)words[0];
+        uint8_t nargs = (uint8_t)(words[0] >> 8);
+        if (nargs != n / 4 - 2) {
+            fprintf(stderr, "bad argument count: %s", line);
+            bad++;
+            continue;
+        }
+        if (id == LOG_BOOT && nargs && words[2] != LOG_CATALOG_HASH) {
+            fprintf(stderr, "catalog %08lx in the capture, %08lx in this build: "
+                            "formats may not match\n",
+                    (unsigned long)words[2], (unsigned long)LOG_CATALOG_HASH);
+            foreign++;
+        }
+        char text[BINLOG_LINE_MAX];
+        binlogFormat(id, words + 2, nargs, text, sizeof(text));
+        printf("[%lu] %s\n", (unsigned long)words[1], text);
+        records++;
+    }
+    fprintf(stderr, "%d records, %d undecodable%s\n", records, bad,
+            foreign ? ", from another catalog" : "");
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,247 @@
+/*
+ * SafeNeck – faster-than-real-time replay harness
+ * ===============================================
+ * Links against one firmware (main.c or reference.c) and the host HAL,
+ * replays a recorded I2C trace through setup()/loop() on a virtual clock
+ * and reports the host CPU time of every loop() iteration (less the cost
+ * of emulating switches to firmware threads, which are listed separately).
+ *
+ * Usage:
+ *   replay_main      --trace FILE [options]
+ *   replay_reference --trace FILE [options]
+ *
+ * Options:
+ *   --max-iter N        stop after N loop() iterations
+ *   --loop-gap-us N     virtual time Device OS spends between loop() calls
+ *                       (default 50; also keeps a loop that neither sleeps
+ *                       nor touches the bus from stalling the clock)
+ *   --warmup-s S        exclude the first S virtual seconds from the
+ *                       steady-state heap figures (default 5)
+ *   --ack-ms N          virtual time a WITH_ACK publish blocks (default 500)
+ *   --gps-fifo N        PA1010D output buffer in bytes (default 1024)
+ *   --gps-hot-ms N      PA1010D silent this long after a wake-up (default 1000)
+ *   --publish-fail-pct N  share of publishes that are never ACKed
+ *   --offline A:B       cloud unreachable from A to B virtual seconds
+ *                       (repeatable)
+ *   --flash FILE        keep the journal flash in FILE, so the next run
+ *                       boots from it (default: a fresh temporary file)
+ *   --retained FILE     restore `retained` RAM from FILE before setup()
+ *                       and save it at the end: the next run is a reset
+ *   --clock-s S         Time.now() starts S seconds later (a reset that
+ *                       came S seconds into the previous run)
+ *   --gps-cold-ms N     PA1010D has no fix for N ms after power-on unless
+ *                       aided (default 0: the trace's own fix)
+ *   --gps-aided-ms N    fix this long after PMTK740 + PMTK741 (default 5000)
+ *   --gps-boot-ms N     PA1010D NACKs its address for N ms after power-on
+ *                       (default 300; a huge N is a module that never answers)
+ *   --serial            echo Serial output
+ *   --publish           echo every publish
+ * -----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Particle.h"
+#include "hal_host.h"
+
+#ifndef HOST_FIRMWARE_NAME
+#define HOST_FIRMWARE_NAME "firmware"
+#endif
+
+void setup();
+void loop();
+
+namespace {
+
+uint64_t cpuNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t wallNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t percentile(const std::vector<uint64_t> &sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[i];
+}
+
+void usage() {
+    fprintf(stderr,
+        "usage: %s --trace FILE [--max-iter N] [--loop-gap-us N] [--warmup-s S]\n"
+        "          [--ack-ms N] [--gps-fifo N] [--gps-hot-ms N]\n"
+        "          [--publish-fail-pct N] [--offline A:B] [--flash FILE]\n"
+        "          [--retained FILE] [--clock-s S] [--gps-cold-ms N] [--gps-aided-ms N]\n"
+        "          [--gps-boot-ms N] [--serial] [--publish]\n",
+        "replay");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *tracePath = nullptr;
+    uint64_t maxIter   = UINT64_MAX;
+    uint64_t loopGapUs = 50;
+    double   warmupS   = 5.0;
+
+    hal::Options &opt = hal::options();
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if      (!strcmp(a, "--serial"))  { opt.serialEcho = true;  continue; }
+        else if (!strcmp(a, "--publish")) { opt.publishEcho = true; continue; }
+        if (!v) { usage(); return 2; }
+        if      (!strcmp(a, "--trace"))       tracePath = v;
+        else if (!strcmp(a, "--max-iter"))    maxIter = strtoull(v, nullptr, 10);
+        else if (!strcmp(a, "--loop-gap-us")) loopGapUs = strtoull(v, nullptr, 10);
+        else if (!strcmp(a, "--warmup-s"))    warmupS = atof(v);
+        else if (!strcmp(a, "--ack-ms"))      opt.ackLatencyMs = (uint32_t)atoi(v);
+        else if (!strcmp(a, "--gps-fifo"))    opt.gpsFifoBytes = (uint32_t)atoi(v);
+        else if (!strcmp(a, "--gps-hot-ms"))  opt.gpsHotStartMs = (uint32_t)atoi(v);
+        else if (!strcmp(a, "--publish-fail-pct")) opt.publishFailPct = (uint32_t)atoi(v);
+        else if (!strcmp(a, "--flash"))       opt.flashPath = v;
+        else if (!strcmp(a, "--retained"))    opt.retainedPath = v;
+        else if (!strcmp(a, "--clock-s"))     opt.clockS = (uint32_t)atoi(v);
+        else if (!strcmp(a, "--gps-cold-ms")) opt.gpsColdMs = (uint32_t)atoi(v);
+        else if (!strcmp(a, "--gps-aided-ms")) opt.gpsAidedMs = (uint32_t)atoi(v);
+        else if (!strcmp(a, "--gps-boot-ms")) opt.gpsBootMs = (uint32_t)strtoul(v, nullptr, 10);
+        else if (!strcmp(a, "--offline")) {
+            double from = 0, to = 0;
+            if (sscanf(v, "%lf:%lf", &from, &to) != 2 || to <= from) { usage(); return 2; }
+            opt.offline.push_back({ (uint64_t)(from * 1e6), (uint64_t)(to * 1e6) });
+        }
+        else { usage(); return 2; }
+        i++;
+    }
+    if (!tracePath) { usage(); return 2; }
+
+    std::vector<trace::Record> records;
+    FILE *f = fopen(tracePath, "rb");
+    if (!f) { perror(tracePath); return 1; }
+    bool ok = trace::readAll(f, records);
+    fclose(f);
+    if (!ok) { fprintf(stderr, "%s: not a SafeNeck trace\n", tracePath); return 1; }
+    hal::loadTrace(std::move(records));
+    const uint64_t endUs = hal::traceEndUs();
+
+    std::vector<uint64_t> iterNs;
+    iterNs.reserve(std::min<uint64_t>(maxIter, 4000000));
+
+    hal::counters() = hal::Counters{};
+    const bool restored = hal::loadRetained();
+    const uint64_t wall0 = wallNs();
+    setup();
+    const uint64_t setupVirtUs = hal::nowUs();
+
+    hal::Counters steady{};
+    bool warm = false;
+    uint64_t iter = 0;
+    uint64_t stallUs = 0, stallAtUs = 0;      /* longest single loop()  */
+    while (hal::nowUs() < endUs && iter < maxIter) {
+        if (!warm && hal::nowUs() >= (uint64_t)(warmupS * 1e6)) {
+            steady = hal::counters();
+            warm = true;
+        }
+        uint64_t v0 = hal::nowUs();
+        uint64_t c0 = cpuNs() - hal::switchCpuNs();
+        loop();
+        uint64_t c1 = cpuNs() - hal::switchCpuNs();
+        if (hal::nowUs() - v0 > stallUs) {
+            stallUs = hal::nowUs() - v0;
+            stallAtUs = v0;
+        }
+        if (iterNs.size() < iterNs.capacity()) iterNs.push_back(c1 - c0);
+        hal::advanceUs(loopGapUs);
+        iter++;
+    }
+    const uint64_t wall1 = wallNs();
+    if (opt.retainedPath && !hal::saveRetained())
+        fprintf(stderr, "%s: retained RAM not saved\n", opt.retainedPath);
+
+    const hal::Counters &c = hal::counters();
+    const double virtS = hal::nowUs() / 1e6;
+    const double wallS = (wall1 - wall0) / 1e9;
+    const double loopS = virtS - setupVirtUs / 1e6;
+
+    uint64_t sum = 0;
+    for (uint64_t ns : iterNs) sum += ns;
+    std::sort(iterNs.begin(), iterNs.end());
+
+    printf("firmware         : %s\n", HOST_FIRMWARE_NAME);
+    printf("trace            : %s (%.1f s)\n", tracePath, endUs / 1e6);
+    printf("iterations       : %llu  (virtual period %.3f ms, setup %.1f ms)\n",
+           (unsigned long long)iter, iter ? loopS * 1e3 / iter : 0.0, setupVirtUs / 1e3);
+    printf("boot             : %s, %llu probes NACKed while booting",
+           restored ? "retained RAM restored" : "cold", (unsigned long long)c.i2cBootNacks);
+    if (opt.gpsColdMs) {
+        printf(", GPS fix from %.1f s", c.gpsFixFromUs / 1e6);
+        if (c.gpsAidedAtUs) printf(" (aided at %.1f s)", c.gpsAidedAtUs / 1e6);
+        else                printf(" (not aided)");
+    }
+    printf("\n");
+    printf("virtual / wall   : %.1f s / %.3f s  (%.0fx real time)\n",
+           virtS, wallS, wallS > 0 ? virtS / wallS : 0.0);
+    printf("loop cpu ns      : mean %.0f  p50 %llu  p90 %llu  p99 %llu  max %llu\n",
+           iterNs.empty() ? 0.0 : (double)sum / iterNs.size(),
+           (unsigned long long)percentile(iterNs, 0.50),
+           (unsigned long long)percentile(iterNs, 0.90),
+           (unsigned long long)percentile(iterNs, 0.99),
+           (unsigned long long)(iterNs.empty() ? 0 : iterNs.back()));
+    printf("longest loop()   : %.1f ms virtual (at %.1f s)\n", stallUs / 1e3, stallAtUs / 1e6);
+    printf("i2c gps 0x10     : %llu reads, %llu B (%llu padding), %llu writes, %llu B lost to FIFO overflow\n",
+           (unsigned long long)c.i2cReads[0], (unsigned long long)c.i2cReadBytes[0],
+           (unsigned long long)c.gpsPaddingBytes, (unsigned long long)c.i2cWrites[0],
+           (unsigned long long)c.gpsOverflowBytes);
+    if (c.gpsStandbyUs) {
+        printf("gps power        : receiver on %.1f s (%.1f%%), standby %.1f s, %llu B not produced\n",
+               c.gpsOnUs / 1e6, c.gpsOnUs * 100.0 / (c.gpsOnUs + c.gpsStandbyUs),
+               c.gpsStandbyUs / 1e6, (unsigned long long)c.gpsSuppressedBytes);
+    }
+    printf("i2c imu 0x4A     : %llu reads, %llu B, %llu reports in %llu packets served, %llu lost\n",
+           (unsigned long long)c.i2cReads[1], (unsigned long long)c.i2cReadBytes[1],
+           (unsigned long long)c.imuReports,
+           (unsigned long long)c.imuPacketsServed, (unsigned long long)c.imuPacketsLost);
+    printf("i2c bus          : %.1f%% busy, %llu tx bytes truncated\n",
+           virtS > 0 ? c.i2cBusUs / 1e4 / virtS : 0.0, (unsigned long long)c.i2cTxTruncated);
+    if (c.stops) {
+        printf("stop mode        : %llu sleeps, %.1f s (%.1f%% of the run), %llu woken by IMU INT\n",
+               (unsigned long long)c.stops, c.stopUs / 1e6,
+               virtS > 0 ? c.stopUs / 1e4 / virtS : 0.0, (unsigned long long)c.stopIntWakes);
+    }
+    printf("heap             : %llu allocations (%llu B), steady state %llu (%.1f /s)\n",
+           (unsigned long long)c.allocations, (unsigned long long)c.allocBytes,
+           (unsigned long long)(c.allocations - steady.allocations),
+           virtS > warmupS ? (c.allocations - steady.allocations) / (virtS - warmupS) : 0.0);
+    printf("publish          : %llu events, %llu B, %.1f s blocked on ACK, %llu failed\n",
+           (unsigned long long)c.publishes, (unsigned long long)c.publishBytes,
+           c.publishBlockedUs / 1e6, (unsigned long long)c.publishFailed);
+    printf("serial           : %llu B\n", (unsigned long long)c.serialBytes);
+    if (c.flashProgramBytes || c.flashErases) {
+        printf("journal flash    : %llu B programmed in %llu pages (%.2fx in whole pages), "
+               "%llu sector erases, %llu B read%s\n",
+               (unsigned long long)c.flashProgramBytes, (unsigned long long)c.flashPagePrograms,
+               c.flashProgramBytes ? c.flashPagePrograms * (double)opt.flashPageBytes /
+                                     c.flashProgramBytes : 0.0,
+               (unsigned long long)c.flashErases, (unsigned long long)c.flashReadBytes,
+               c.flashBadPrograms ? "  ** BYTES PROGRAMMED TWICE **" : "");
+    }
+    for (const auto &v : hal::variables())
+        printf("variable %-8s : %s\n", v.first, v.second);
+    std::vector<hal::ThreadInfo> threads = hal::threads();
+    for (size_t i = 1; i < threads.size(); i++) {
+        const hal::ThreadInfo &t = threads[i];
+        printf("thread %-9s : priority %u, %llu wakeups, cpu %.1f ms (%.0f ns/wakeup)\n",
+               t.name, t.priority, (unsigned long long)t.wakeups, t.cpuNs / 1e6,
+               t.wakeups ? (double)t.cpuNs / t.wakeups : 0.0);
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Host stand-in for Adafruit_BNO08x – see Adafruit_BNO08x_Sahagun.h.
+ * -----------------------------------------------------------------------*/
+#include "Adafruit_BNO08x_Sahagun.h"
+
+namespace {
+
+/* Report length (including the id byte) for every report we may see. */
+int reportLength(uint8_t id) {
+    switch (id) {
+    case 0xFA: case 0xFB:                      return 5;
+    case SH2_ACCELEROMETER:
+    case SH2_GYROSCOPE_CALIBRATED:
+    case SH2_MAGNETIC_FIELD_CALIBRATED:
+    case SH2_LINEAR_ACCELERATION:
+    case SH2_GRAVITY:                          return 10;
+    case SH2_ROTATION_VECTOR:                  return 14;
+    case SH2_GAME_ROTATION_VECTOR:             return 12;
+    case SH2_SIGNIFICANT_MOTION:
+    case SH2_STABILITY_CLASSIFIER:
+    case SH2_SHAKE_DETECTOR:                   return 6;
+    default:                                   return 0;
+    }
+}
+
+inline int16_t le16(const uint8_t *p) { return (int16_t)((uint16_t)p[0] | ((uint16_t)p[1] << 8)); }
+
+} // namespace
+
+bool Adafruit_BNO08x::begin_I2C(uint8_t addr, TwoWire *wire, int32_t sensorId) {
+    (void)sensorId;
+    addr_ = addr;
+    wire_ = wire;
+    wire_->beginTransmission(addr_);
+    return wire_->endTransmission() == 0;
+}
+
+bool Adafruit_BNO08x::enableReport(sh2_SensorId_t sensor, uint32_t intervalUs) {
+    static uint8_t seq = 0;
+    uint8_t cmd[21] = {
+        21, 0, 2, seq++,                       /* header, control channel */
+        0xFD, sensor, 0, 0, 0,                 /* set feature             */
+        (uint8_t)intervalUs, (uint8_t)(intervalUs >> 8),
+        (uint8_t)(intervalUs >> 16), (uint8_t)(intervalUs >> 24),
+    };
+    wire_->beginTransmission(addr_);
+    wire_->write(cmd, sizeof(cmd));
+    return wire_->endTransmission() == 0;
+}
+
+/* Same transaction pattern as the Adafruit I2C HAL (i2chal_read). */
+int Adafruit_BNO08x::readPacket() {
+    const size_t maxRead = TwoWire::BUFFER_LENGTH;
+
+    uint8_t header[4];
+    if (wire_->requestFrom(addr_, 4) != 4) return 0;
+    for (int i = 0; i < 4; i++) header[i] = (uint8_t)wire_->read();
+
+    size_t packetSize = ((size_t)header[0] | ((size_t)header[1] << 8)) & 0x7FFF;
+    if (packetSize == 0 || packetSize > sizeof(packet_)) return 0;
+
+    size_t remaining = packetSize;
+    uint8_t *dst = packet_;
+    bool first = true;
+    while (remaining > 0) {
+        size_t readSize = first ? remaining : remaining + 4;
+        if (readSize > maxRead) readSize = maxRead;
+        wire_->requestFrom(addr_, (int)readSize);
+        uint8_t chunk[TwoWire::BUFFER_LENGTH];
+        for (size_t i = 0; i < readSize; i++) chunk[i] = (uint8_t)wire_->read();
+
+        size_t skip = first ? 0 : 4;
+        size_t n = readSize - skip;
+        memcpy(dst, chunk + skip, n);
+        dst += n;
+        remaining -= n;
+        first = false;
+    }
+    return (int)packetSize;
+}
+
+void Adafruit_BNO08x::decodePacket(int len) {
+    uint8_t channel = packet_[2];
+    if (channel != 3 && channel != 5) return;  /* sensor reports only  */
+
+    int pos = 4;
+    while (pos < len) {
+        uint8_t id = packet_[pos];
+        int rlen = reportLength(id);
+        if (rlen == 0 || pos + rlen > len) return;
+        const uint8_t *r = packet_ + pos;
+        pos += rlen;
+        if (id == 0xFA || id == 0xFB) continue;
+
+        sh2_SensorValue_t *v = out_;
+        v->sensorId  = id;
+        v->sequence  = r[1];
+        v->status    = r[2] & 0x03;
+        v->delay     = ((uint32_t)(r[2] >> 2) << 8) | r[3];
+        v->timestamp = (uint64_t)micros() + 1;
+
+        switch (id) {
+        case SH2_ACCELEROMETER:
+        case SH2_LINEAR_ACCELERATION:
+        case SH2_GRAVITY:
+            v->un.accelerometer.x = le16(r + 4) / 256.0f;
+            v->un.accelerometer.y = le16(r + 6) / 256.0f;
+            v->un.accelerometer.z = le16(r + 8) / 256.0f;
+            break;
+        case SH2_GAME_ROTATION_VECTOR:
+            v->un.gameRotationVector.i    = le16(r + 4)  / 16384.0f;
+            v->un.gameRotationVector.j    = le16(r + 6)  / 16384.0f;
+            v->un.gameRotationVector.k    = le16(r + 8)  / 16384.0f;
+            v->un.gameRotationVector.real = le16(r + 10) / 16384.0f;
+            break;
+        case SH2_ROTATION_VECTOR:
+            v->un.rotationVector.i        = le16(r + 4)  / 16384.0f;
+            v->un.rotationVector.j        = le16(r + 6)  / 16384.0f;
+            v->un.rotationVector.k        = le16(r + 8)  / 16384.0f;
+            v->un.rotationVector.real     = le16(r + 10) / 16384.0f;
+            v->un.rotationVector.accuracy = le16(r + 12) / 4096.0f;
+            break;
+        case SH2_STABILITY_CLASSIFIER:
+            v->un.stabilityClassifier.classification = r[4];
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+bool Adafruit_BNO08x::getSensorEvent(sh2_SensorValue_t *value) {
+    out_ = value;
+    value->timestamp = 0;
+    int len = readPacket();
+    if (len > 0) decodePacket(len);
+    return value->timestamp != 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Host stand-in for Adafruit_BNO08x (+ the sh2 types it exposes)
+ * ==============================================================
+ * Reads SHTP packets from the replayed BNO085 through the same Wire
+ * calls the Adafruit I2C HAL makes (4-byte header read, then the
+ * packet in buffer-sized chunks with continuation headers) and decodes
+ * them like sh2.  As in the real library only the last report of each
+ * packet survives to getSensorEvent().
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+
+#include "Particle.h"
+
+#define BNO08x_I2CADDR_DEFAULT 0x4A
+
+typedef uint8_t sh2_SensorId_t;
+
+enum {
+    SH2_ACCELEROMETER          = 0x01,
+    SH2_GYROSCOPE_CALIBRATED   = 0x02,
+    SH2_MAGNETIC_FIELD_CALIBRATED = 0x03,
+    SH2_LINEAR_ACCELERATION    = 0x04,
+    SH2_ROTATION_VECTOR        = 0x05,
+    SH2_GRAVITY                = 0x06,
+    SH2_GAME_ROTATION_VECTOR   = 0x08,
+    SH2_SIGNIFICANT_MOTION     = 0x12,
+    SH2_STABILITY_CLASSIFIER   = 0x13,
+    SH2_SHAKE_DETECTOR         = 0x19,
+};
+
+typedef struct { float x, y, z; } sh2_Accelerometer_t;
+typedef struct { float i, j, k, real; } sh2_RotationVector_t;
+typedef struct { float i, j, k, real, accuracy; } sh2_RotationVectorWAcc_t;
+typedef struct { uint8_t classification; } sh2_StabilityClassifier_t;
+
+typedef struct {
+    uint8_t  sensorId;
+    uint8_t  sequence;
+    uint8_t  status;
+    uint64_t timestamp;
+    uint32_t delay;
+    union {
+        sh2_Accelerometer_t       accelerometer;
+        sh2_Accelerometer_t       linearAcceleration;
+        sh2_Accelerometer_t       gravity;
+        sh2_RotationVectorWAcc_t  rotationVector;
+        sh2_RotationVector_t      gameRotationVector;
+        sh2_StabilityClassifier_t stabilityClassifier;
+    } un;
+} sh2_SensorValue_t;
+
+class Adafruit_BNO08x {
+public:
+    explicit Adafruit_BNO08x(int8_t resetPin = -1) { (void)resetPin; }
+
+    bool begin_I2C(uint8_t addr = BNO08x_I2CADDR_DEFAULT, TwoWire *wire = &Wire,
+                   int32_t sensorId = 0);
+    bool enableReport(sh2_SensorId_t sensor, uint32_t intervalUs = 10000);
+    bool getSensorEvent(sh2_SensorValue_t *value);
+    bool wasReset() { return false; }
+
+private:
+    int  readPacket();
+    void decodePacket(int len);
+
+    TwoWire *wire_ = nullptr;
+    uint8_t  addr_ = BNO08x_I2CADDR_DEFAULT;
+    uint8_t  packet_[256];
+    sh2_SensorValue_t *out_ = nullptr;
+};
@@ -0,0 +1,256 @@
+/*
+ * Host stand-in for Particle Device OS
+ * ====================================
+ * Just enough of the Device OS API for `main.c` and `reference.c` to
+ * compile and run on Linux inside the replay harness (see host/replay.cpp).
+ *
+ *   • millis()/micros()/delay() run on a virtual clock that only moves
+ *     when the firmware sleeps or occupies the I2C bus.
+ *   • Wire transactions are served from a recorded trace of the PA1010D
+ *     (0x10) and BNO085 (0x4A) byte streams.
+ *   • Cloud, Serial, Time and FuelGauge are recorded, not transmitted.
+ *   • Threads are real host threads run one at a time by a priority
+ *     scheduler on the virtual clock: a ready higher-priority thread
+ *     preempts whenever the running one sleeps, blocks on a lock or
+ *     spends time on the bus.
+ *
+ * Everything the harness needs to steer or observe lives in hal_host.h.
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <functional>
+#include <mutex>
+
+#include "WString.h"
+
+/* ── System ────────────────────────────────────────────────────────── */
+#define SYSTEM_MODE(mode)     typedef int hal_system_mode_unused_t
+#define SYSTEM_THREAD(state)  typedef int hal_system_thread_unused_t
+
+/* ── GPIO ──────────────────────────────────────────────────────────── */
+typedef uint16_t pin_t;
+enum PinMode  { INPUT, OUTPUT, INPUT_PULLUP, INPUT_PULLDOWN };
+enum PinState { LOW = 0, HIGH = 1 };
+enum : pin_t  { D0 = 0, D1, D2, D3, D4, D5, D6, D7, D8 };
+
+void    pinMode(pin_t pin, PinMode mode);
+void    digitalWrite(pin_t pin, uint8_t value);
+int32_t digitalRead(pin_t pin);
+
+/* ── Timing (virtual clock) ────────────────────────────────────────── */
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+/* ── Threads ───────────────────────────────────────────────────────── */
+typedef uint32_t system_tick_t;
+typedef uint8_t  os_thread_prio_t;
+typedef void     os_thread_return_t;
+typedef os_thread_return_t (*os_thread_fn_t)(void *param);
+typedef std::function<os_thread_return_t(void)> wiring_thread_fn_t;
+
+#define OS_THREAD_PRIORITY_DEFAULT    2
+#define OS_THREAD_PRIORITY_CRITICAL   9
+#define OS_THREAD_STACK_SIZE_DEFAULT  3072
+
+class Thread {
+public:
+    Thread() {}
+    Thread(const char *name, wiring_thread_fn_t function,
+           os_thread_prio_t priority = OS_THREAD_PRIORITY_DEFAULT,
+           size_t stackSize = OS_THREAD_STACK_SIZE_DEFAULT);
+    Thread(const char *name, os_thread_fn_t function, void *param = nullptr,
+           os_thread_prio_t priority = OS_THREAD_PRIORITY_DEFAULT,
+           size_t stackSize = OS_THREAD_STACK_SIZE_DEFAULT);
+    bool isValid() const { return task_ != nullptr; }
+private:
+    void *task_ = nullptr;
+};
+
+/* FreeRTOS vTaskDelayUntil(): sleep until *previousWakeTime += increment. */
+int os_thread_delay_until(system_tick_t *previousWakeTime, system_tick_t timeIncrement);
+
+/* Recursive mutex that hands the CPU to its holder while blocked. */
+class RecursiveMutex {
+public:
+    void lock();
+    bool trylock();
+    void unlock();
+private:
+    void *owner_ = nullptr;
+    int   depth_ = 0;
+};
+
+#define WITH_LOCK(lock) \
+    for (std::unique_lock<decltype(lock)> __lock__((lock)); __lock__; __lock__.unlock())
+
+/* ── Sleep ─────────────────────────────────────────────────────────────
+ * STOP mode halts every thread and jumps the virtual clock to the wake
+ * time.  The only interrupt line wired on the host is the BNO085 INT
+ * (hal::Options::imuIntPin, low while the hub has a packet queued), so
+ * any gpio() wake source is taken to be it.                            */
+enum InterruptMode { CHANGE, RISING, FALLING };
+
+enum class SystemSleepMode : uint8_t { NONE, STOP, ULTRA_LOW_POWER, HIBERNATE };
+
+enum class SystemSleepWakeupReason : uint16_t {
+    UNKNOWN = 0, BY_GPIO = 1, BY_ADC = 2, BY_DAC = 3, BY_RTC = 4, BY_LPCOMP = 5,
+    BY_USART = 6, BY_CAN = 7, BY_NETWORK = 8,
+};
+
+typedef uint8_t network_interface_t;
+const network_interface_t NETWORK_INTERFACE_CELLULAR = 2;
+
+class SystemSleepConfiguration {
+public:
+    SystemSleepConfiguration &mode(SystemSleepMode m)          { mode_ = m; return *this; }
+    SystemSleepConfiguration &duration(system_tick_t ms)        { durationMs_ = ms; return *this; }
+    SystemSleepConfiguration &gpio(pin_t pin, InterruptMode m)  { (void)m; pin_ = pin; gpio_ = true; return *this; }
+    SystemSleepConfiguration &network(network_interface_t n)    { (void)n; return *this; }
+
+    SystemSleepMode sleepMode()  const { return mode_; }
+    system_tick_t   durationMs() const { return durationMs_; }
+    bool            gpioWake()   const { return gpio_; }
+    pin_t           gpioPin()    const { return pin_; }
+
+private:
+    SystemSleepMode mode_ = SystemSleepMode::NONE;
+    system_tick_t   durationMs_ = 0;
+    bool            gpio_ = false;
+    pin_t           pin_ = 0;
+};
+
+class SystemSleepResult {
+public:
+    SystemSleepResult(SystemSleepWakeupReason r = SystemSleepWakeupReason::UNKNOWN, pin_t pin = 0)
+        : reason_(r), pin_(pin) {}
+    SystemSleepWakeupReason wakeupReason() const { return reason_; }
+    pin_t                   wakeupPin()    const { return pin_; }
+    int                     error()        const { return 0; }
+
+private:
+    SystemSleepWakeupReason reason_;
+    pin_t                   pin_;
+};
+
+class SystemClass {
+public:
+    SystemSleepResult sleep(const SystemSleepConfiguration &config);
+    /* DWT cycle counter at the Boron's 64 MHz, run off the virtual clock. */
+    uint32_t        ticks();
+    static uint32_t ticksPerMicrosecond() { return 64; }
+};
+extern SystemClass System;
+
+/* ── Serial ────────────────────────────────────────────────────────── */
+class USBSerial {
+public:
+    void   begin(long baud) { (void)baud; }
+    size_t write(const uint8_t *buf, size_t len);
+    size_t print(const char *s);
+    size_t print(const String &s) { return print(s.c_str()); }
+    size_t print(char c);
+    size_t print(int v);
+    size_t println()              { return print("\r\n"); }
+    size_t println(const char *s) { return print(s) + println(); }
+    size_t println(const String &s) { return println(s.c_str()); }
+    size_t println(int v)         { return print(v) + println(); }
+    size_t printf(const char *fmt, ...)   __attribute__((format(printf, 2, 3)));
+    size_t printlnf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+private:
+    size_t vprintf(bool newline, const char *fmt, va_list args);
+};
+extern USBSerial Serial;
+
+/* ── Cloud ─────────────────────────────────────────────────────────── */
+class PublishFlags {
+public:
+    constexpr explicit PublishFlags(uint8_t bits = 0) : bits_(bits) {}
+    constexpr PublishFlags operator|(PublishFlags o) const { return PublishFlags(bits_ | o.bits_); }
+    constexpr bool has(PublishFlags o) const { return (bits_ & o.bits_) != 0; }
+    constexpr uint8_t bits() const { return bits_; }
+private:
+    uint8_t bits_;
+};
+constexpr PublishFlags PUBLIC(0x00);
+constexpr PublishFlags PRIVATE(0x01);
+constexpr PublishFlags NO_ACK(0x02);
+constexpr PublishFlags WITH_ACK(0x08);
+
+class CloudClass {
+public:
+    bool connected();
+    void process() {}
+    bool publish(const char *name, const char *data, PublishFlags f1,
+                 PublishFlags f2 = PublishFlags());
+    /* String variables only; the harness reads them back (hal::variables()). */
+    bool variable(const char *name, const char *var);
+};
+extern CloudClass Particle;
+
+/* ── Retained RAM ──────────────────────────────────────────────────
+ * Device OS leaves `retained` variables alone across a reset; here
+ * they share one section the harness can save and restore
+ * (hal::loadRetained()).                                            */
+#define retained __attribute__((section("retained_user")))
+
+/* ── Time ──────────────────────────────────────────────────────────── */
+class TimeClass {
+public:
+    time_t now();
+    bool   isValid() { return true; }
+};
+extern TimeClass Time;
+
+/* ── Power ─────────────────────────────────────────────────────────── */
+class FuelGauge {
+public:
+    float getSoC();
+    float getVCell();
+};
+
+/* ── I2C ───────────────────────────────────────────────────────────── */
+#define CLOCK_SPEED_100KHZ 100000
+#define CLOCK_SPEED_400KHZ 400000
+
+class TwoWire {
+public:
+    void    begin() {}
+    bool    lock()   { lock_.lock(); return true; }
+    void    unlock() { lock_.unlock(); }
+    void    setSpeed(uint32_t hz) { clockHz_ = hz; }
+    void    beginTransmission(int address);
+    uint8_t endTransmission(bool stop = true);
+    size_t  write(uint8_t b);
+    size_t  write(const uint8_t *buf, size_t len);
+    size_t  requestFrom(int address, int quantity, int stop = 1);
+    int     available() { return (int)(rxLen_ - rxPos_); }
+    int     read()      { return rxPos_ < rxLen_ ? rxBuf_[rxPos_++] : -1; }
+    int     peek()      { return rxPos_ < rxLen_ ? rxBuf_[rxPos_] : -1; }
+
+    /* Device OS limits a transaction to the Wire buffer (32 bytes
+     * unless the application provides acquireWireBuffer()).          */
+    static const size_t BUFFER_LENGTH = 32;
+
+private:
+    RecursiveMutex lock_;
+    uint32_t clockHz_ = 100000;
+    uint8_t  txAddr_  = 0;
+    uint8_t  txBuf_[BUFFER_LENGTH];
+    size_t   txLen_   = 0;
+    uint8_t  rxBuf_[BUFFER_LENGTH];
+    size_t   rxLen_   = 0;
+    size_t   rxPos_   = 0;
+};
+extern TwoWire Wire;
@@ -0,0 +1,195 @@
+/*
+ * Host stand-in for TinyGPS++ – see TinyGPS++.h.
+ * -----------------------------------------------------------------------*/
+#include "TinyGPS++.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "Particle.h"
+
+namespace {
+
+int fromHex(char a) {
+    if (a >= 'A' && a <= 'F') return a - 'A' + 10;
+    if (a >= 'a' && a <= 'f') return a - 'a' + 10;
+    return a - '0';
+}
+
+/* "123.45" → 12345 (hundredths) */
+int32_t parseDecimal(const char *term) {
+    bool negative = *term == '-';
+    if (negative) ++term;
+    int32_t ret = 100 * (int32_t)atol(term);
+    while (isdigit((unsigned char)*term)) ++term;
+    if (*term == '.' && isdigit((unsigned char)term[1])) {
+        ret += 10 * (term[1] - '0');
+        if (isdigit((unsigned char)term[2])) ret += term[2] - '0';
+    }
+    return negative ? -ret : ret;
+}
+
+/* "dddmm.mmmm" → whole degrees + billionths */
+void parseDegrees(const char *term, RawDegrees &deg) {
+    uint32_t leftOfDecimal = (uint32_t)atol(term);
+    uint16_t minutes = (uint16_t)(leftOfDecimal % 100);
+    uint32_t multiplier = 10000000UL;
+    uint32_t tenMillionthsOfMinutes = minutes * multiplier;
+
+    deg.deg = (uint16_t)(leftOfDecimal / 100);
+
+    while (isdigit((unsigned char)*term)) ++term;
+    if (*term == '.') {
+        while (isdigit((unsigned char)*++term)) {
+            multiplier /= 10;
+            tenMillionthsOfMinutes += (*term - '0') * multiplier;
+        }
+    }
+    deg.billionths = (5 * tenMillionthsOfMinutes + 1) / 3;
+    deg.negative = false;
+}
+
+} // namespace
+
+/* ── Location ──────────────────────────────────────────────────────── */
+void TinyGPSLocation::commit() {
+    lat_ = newLat_;
+    lng_ = newLng_;
+    valid_ = updated_ = true;
+    lastCommit_ = millis();
+}
+
+uint32_t TinyGPSLocation::age() const {
+    return valid_ ? millis() - lastCommit_ : (uint32_t)0xFFFFFFFF;
+}
+
+double TinyGPSLocation::lat() {
+    updated_ = false;
+    double ret = lat_.deg + lat_.billionths / 1000000000.0;
+    return lat_.negative ? -ret : ret;
+}
+
+double TinyGPSLocation::lng() {
+    updated_ = false;
+    double ret = lng_.deg + lng_.billionths / 1000000000.0;
+    return lng_.negative ? -ret : ret;
+}
+
+/* ── Parser ────────────────────────────────────────────────────────── */
+bool TinyGPSPlus::encode(char c) {
+    ++encodedChars_;
+
+    switch (c) {
+    case ',':
+        parity_ ^= (uint8_t)c;
+        /* fall through */
+    case '\r':
+    case '\n':
+    case '*': {
+        bool isValidSentence = false;
+        if (curTermOffset_ < sizeof(term_)) {
+            term_[curTermOffset_] = 0;
+            isValidSentence = endOfTermHandler();
+        }
+        ++curTermNumber_;
+        curTermOffset_ = 0;
+        isChecksumTerm_ = c == '*';
+        return isValidSentence;
+    }
+
+    case '$':
+        curTermNumber_ = curTermOffset_ = 0;
+        parity_ = 0;
+        curSentenceType_ = SENTENCE_OTHER;
+        isChecksumTerm_ = false;
+        sentenceHasFix_ = false;
+        return false;
+
+    default:
+        if (curTermOffset_ < sizeof(term_) - 1) term_[curTermOffset_++] = c;
+        if (!isChecksumTerm_) parity_ ^= (uint8_t)c;
+        return false;
+    }
+}
+
+bool TinyGPSPlus::endOfTermHandler() {
+    if (isChecksumTerm_) {
+        uint8_t checksum = (uint8_t)(16 * fromHex(term_[0]) + fromHex(term_[1]));
+        if (checksum != parity_) {
+            ++failedChecksum_;
+            return false;
+        }
+        ++passedChecksum_;
+        if (sentenceHasFix_) ++sentencesWithFix_;
+
+        switch (curSentenceType_) {
+        case SENTENCE_GPRMC:
+            date.commit();
+            time.commit();
+            if (sentenceHasFix_) {
+                location.commit();
+                speed.commit();
+                course.commit();
+            }
+            break;
+        case SENTENCE_GPGGA:
+            time.commit();
+            if (sentenceHasFix_) {
+                location.commit();
+                altitude.commit();
+            }
+            satellites.commit();
+            hdop.commit();
+            break;
+        }
+        return true;
+    }
+
+    if (curTermNumber_ == 0) {
+        if (!strcmp(term_, "GPRMC"))      curSentenceType_ = SENTENCE_GPRMC;
+        else if (!strcmp(term_, "GPGGA")) curSentenceType_ = SENTENCE_GPGGA;
+        else                              curSentenceType_ = SENTENCE_OTHER;
+        return false;
+    }
+
+    if (curSentenceType_ == SENTENCE_OTHER || !term_[0]) return false;
+
+    const bool rmc = curSentenceType_ == SENTENCE_GPRMC;
+    switch (curTermNumber_) {
+    case 1: time.newTime_ = (uint32_t)parseDecimal(term_); break;
+    case 2:
+        if (rmc) sentenceHasFix_ = term_[0] == 'A';
+        else     parseDegrees(term_, location.newLat_);
+        break;
+    case 3:
+        if (rmc) parseDegrees(term_, location.newLat_);
+        else     location.newLat_.negative = term_[0] == 'S';
+        break;
+    case 4:
+        if (rmc) location.newLat_.negative = term_[0] == 'S';
+        else     parseDegrees(term_, location.newLng_);
+        break;
+    case 5:
+        if (rmc) parseDegrees(term_, location.newLng_);
+        else     location.newLng_.negative = term_[0] == 'W';
+        break;
+    case 6:
+        if (rmc) location.newLng_.negative = term_[0] == 'W';
+        else     sentenceHasFix_ = term_[0] > '0';
+        break;
+    case 7:
+        if (rmc) speed.newVal_ = parseDecimal(term_);
+        else     satellites.newVal_ = (uint32_t)atol(term_);
+        break;
+    case 8:
+        if (rmc) course.newVal_ = parseDecimal(term_);
+        else     hdop.newVal_ = parseDecimal(term_);
+        break;
+    case 9:
+        if (rmc) date.newDate_ = (uint32_t)atol(term_);
+        else     altitude.newVal_ = parseDecimal(term_);
+        break;
+    }
+    return false;
+}
@@ -0,0 +1,136 @@
+/*
+ * Host stand-in for TinyGPS++
+ * ===========================
+ * Mirrors the TinyGPS++ API and parsing strategy (term-by-term, fixed
+ * buffers, checksum verified before a sentence is committed) for the
+ * fields `reference.c` reads.  Like the release the firmware was written
+ * against, only the "GP" talker is recognised – hence the GN→GP remap in
+ * the firmware.
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+
+struct RawDegrees {
+    uint16_t deg        = 0;
+    uint32_t billionths = 0;
+    bool     negative   = false;
+};
+
+class TinyGPSLocation {
+    friend class TinyGPSPlus;
+public:
+    bool       isValid()   const { return valid_; }
+    bool       isUpdated() const { return updated_; }
+    uint32_t   age() const;
+    const RawDegrees &rawLat() { updated_ = false; return lat_; }
+    const RawDegrees &rawLng() { updated_ = false; return lng_; }
+    double     lat();
+    double     lng();
+private:
+    void commit();
+    bool       valid_ = false, updated_ = false;
+    RawDegrees lat_, lng_, newLat_, newLng_;
+    uint32_t   lastCommit_ = 0;
+};
+
+class TinyGPSDate {
+    friend class TinyGPSPlus;
+public:
+    bool     isValid() const { return valid_; }
+    uint32_t value()   const { return date_; }
+    uint16_t year()    const { return (uint16_t)(date_ % 100 + 2000); }
+    uint8_t  month()   const { return (uint8_t)((date_ / 100) % 100); }
+    uint8_t  day()     const { return (uint8_t)(date_ / 10000); }
+private:
+    void commit() { date_ = newDate_; valid_ = true; }
+    bool     valid_ = false;
+    uint32_t date_ = 0, newDate_ = 0;
+};
+
+class TinyGPSTime {
+    friend class TinyGPSPlus;
+public:
+    bool     isValid() const { return valid_; }
+    uint32_t value()   const { return time_; }
+    uint8_t  hour()    const { return (uint8_t)(time_ / 1000000); }
+    uint8_t  minute()  const { return (uint8_t)((time_ / 10000) % 100); }
+    uint8_t  second()  const { return (uint8_t)((time_ / 100) % 100); }
+private:
+    void commit() { time_ = newTime_; valid_ = true; }
+    bool     valid_ = false;
+    uint32_t time_ = 0, newTime_ = 0;
+};
+
+class TinyGPSDecimal {
+    friend class TinyGPSPlus;
+public:
+    bool    isValid() const { return valid_; }
+    int32_t value()   const { return val_; }          /* hundredths */
+private:
+    void commit() { val_ = newVal_; valid_ = true; }
+    bool    valid_ = false;
+    int32_t val_ = 0, newVal_ = 0;
+};
+
+class TinyGPSInteger {
+    friend class TinyGPSPlus;
+public:
+    bool     isValid() const { return valid_; }
+    uint32_t value()   const { return val_; }
+private:
+    void commit() { val_ = newVal_; valid_ = true; }
+    bool     valid_ = false;
+    uint32_t val_ = 0, newVal_ = 0;
+};
+
+struct TinyGPSSpeed : TinyGPSDecimal {
+    double knots() const { return value() / 100.0; }
+    double kmph()  const { return 1.852 * knots(); }
+};
+
+struct TinyGPSAltitude : TinyGPSDecimal {
+    double meters() const { return value() / 100.0; }
+};
+
+struct TinyGPSHDOP : TinyGPSDecimal {
+    double hdop() const { return value() / 100.0; }
+};
+
+class TinyGPSPlus {
+public:
+    bool encode(char c);
+
+    TinyGPSLocation location;
+    TinyGPSDate     date;
+    TinyGPSTime     time;
+    TinyGPSSpeed    speed;
+    TinyGPSDecimal  course;
+    TinyGPSAltitude altitude;
+    TinyGPSInteger  satellites;
+    TinyGPSHDOP     hdop;
+
+    uint32_t charsProcessed()   const { return encodedChars_; }
+    uint32_t sentencesWithFix() const { return sentencesWithFix_; }
+    uint32_t failedChecksum()   const { return failedChecksum_; }
+    uint32_t passedChecksum()   const { return passedChecksum_; }
+
+private:
+    enum SentenceType { SENTENCE_GPGGA, SENTENCE_GPRMC, SENTENCE_OTHER };
+    enum { MAX_FIELD_SIZE = 15 };
+
+    bool endOfTermHandler();
+
+    uint8_t  parity_ = 0;
+    bool     isChecksumTerm_ = false;
+    char     term_[MAX_FIELD_SIZE];
+    uint8_t  curSentenceType_ = SENTENCE_OTHER;
+    uint8_t  curTermNumber_ = 0;
+    uint8_t  curTermOffset_ = 0;
+    bool     sentenceHasFix_ = false;
+
+    uint32_t encodedChars_ = 0;
+    uint32_t sentencesWithFix_ = 0;
+    uint32_t failedChecksum_ = 0;
+    uint32_t passedChecksum_ = 0;
+};
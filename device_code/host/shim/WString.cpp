@@ -0,0 +1,130 @@
+/*
+ * Host stand-in for the Wiring `String` class – see WString.h.
+ * -----------------------------------------------------------------------*/
+#include "WString.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal_host.h"
+
+String::String(const char *s) {
+    if (s && *s) append(s, (unsigned int)strlen(s));
+}
+
+String::String(const String &other) {
+    if (other.len_) append(other.buf_, other.len_);
+}
+
+String::String(char c) {
+    append(&c, 1);
+}
+
+String::~String() {
+    free(buf_);
+}
+
+String &String::operator=(const String &other) {
+    if (this == &other) return *this;
+    len_ = 0;
+    if (other.len_) append(other.buf_, other.len_);
+    else if (buf_)  buf_[0] = '\0';
+    return *this;
+}
+
+String &String::operator=(const char *s) {
+    len_ = 0;
+    if (s && *s) append(s, (unsigned int)strlen(s));
+    else if (buf_) buf_[0] = '\0';
+    return *this;
+}
+
+String &String::operator+=(const char *s) {
+    return s ? append(s, (unsigned int)strlen(s)) : *this;
+}
+
+bool String::grow(unsigned int cap) {
+    if (cap <= cap_) return true;
+    /* Wiring's String reallocates to the exact size it needs. */
+    char *p = (char *)realloc(buf_, cap + 1);
+    if (!p) return false;
+    hal::countAlloc(cap + 1);
+    buf_ = p;
+    cap_ = cap;
+    return true;
+}
+
+bool String::reserve(unsigned int size) {
+    if (!grow(size)) return false;
+    if (len_ == 0) buf_[0] = '\0';
+    return true;
+}
+
+String &String::append(const char *s, unsigned int n) {
+    if (!grow(len_ + n)) return *this;
+    memmove(buf_ + len_, s, n);
+    len_ += n;
+    buf_[len_] = '\0';
+    return *this;
+}
+
+bool String::startsWith(const String &prefix) const {
+    return prefix.len_ <= len_ && memcmp(c_str(), prefix.c_str(), prefix.len_) == 0;
+}
+
+int String::indexOf(char c) const {
+    for (unsigned int i = 0; i < len_; ++i) if (buf_[i] == c) return (int)i;
+    return -1;
+}
+
+int String::lastIndexOf(char c) const {
+    for (unsigned int i = len_; i > 0; --i) if (buf_[i - 1] == c) return (int)(i - 1);
+    return -1;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+    if (to > len_) to = len_;
+    String out;
+    if (from < to) out.append(buf_ + from, to - from);
+    return out;
+}
+
+void String::replace(const String &find, const String &with) {
+    if (find.len_ == 0 || len_ < find.len_) return;
+    if (find.len_ == with.len_) {
+        /* Same-length replacement is done in place, like Wiring. */
+        for (unsigned int i = 0; i + find.len_ <= len_; ) {
+            if (memcmp(buf_ + i, find.buf_, find.len_) == 0) {
+                memcpy(buf_ + i, with.buf_, with.len_);
+                i += find.len_;
+            } else {
+                i++;
+            }
+        }
+        return;
+    }
+    String out;
+    unsigned int i = 0;
+    while (i < len_) {
+        if (i + find.len_ <= len_ && memcmp(buf_ + i, find.buf_, find.len_) == 0) {
+            out.append(with.c_str(), with.len_);
+            i += find.len_;
+        } else {
+            out.append(buf_ + i, 1);
+            i++;
+        }
+    }
+    *this = out;
+}
+
+bool String::operator==(const String &o) const {
+    return len_ == o.len_ && memcmp(c_str(), o.c_str(), len_) == 0;
+}
+
+bool String::operator==(const char *s) const {
+    return strcmp(c_str(), s ? s : "") == 0;
+}
+
+String operator+(const String &a, const String &b) { String r(a); r += b; return r; }
+String operator+(const String &a, const char *b)   { String r(a); r += b; return r; }
+String operator+(const char *a, const String &b)   { String r(a); r += b; return r; }
@@ -0,0 +1,55 @@
+/*
+ * Host stand-in for the Wiring `String` class
+ * ===========================================
+ * Implements the subset of the Device OS `String` API used by the
+ * firmwares.  Storage lives on the heap exactly like the real class
+ * (malloc/realloc/free) so the replay harness can count allocations.
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stddef.h>
+
+class String {
+public:
+    String(const char *s = "");
+    String(const String &other);
+    explicit String(char c);
+    ~String();
+
+    String &operator=(const String &other);
+    String &operator=(const char *s);
+
+    String &operator+=(const String &s) { return append(s.buf_, s.len_); }
+    String &operator+=(const char *s);
+    String &operator+=(char c)          { return append(&c, 1); }
+
+    unsigned int length() const { return len_; }
+    const char  *c_str()  const { return buf_ ? buf_ : ""; }
+    char         charAt(unsigned int i) const { return i < len_ ? buf_[i] : '\0'; }
+    char         operator[](unsigned int i) const { return charAt(i); }
+
+    bool startsWith(const String &prefix) const;
+    int  indexOf(char c) const;
+    int  lastIndexOf(char c) const;
+    String substring(unsigned int from) const { return substring(from, len_); }
+    String substring(unsigned int from, unsigned int to) const;
+    void replace(const String &find, const String &with);
+    bool reserve(unsigned int size);
+
+    bool operator==(const String &o) const;
+    bool operator==(const char *s) const;
+    bool operator!=(const String &o) const { return !(*this == o); }
+    bool operator!=(const char *s) const   { return !(*this == s); }
+
+private:
+    String &append(const char *s, unsigned int n);
+    bool    grow(unsigned int cap);
+
+    char        *buf_ = nullptr;
+    unsigned int len_ = 0;
+    unsigned int cap_ = 0;
+};
+
+String operator+(const String &a, const String &b);
+String operator+(const String &a, const char *b);
+String operator+(const char *a, const String &b);
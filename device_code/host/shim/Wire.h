@@ -0,0 +1,4 @@
+/* Host stand-in: Device OS exposes Wire through Particle.h */
+#pragma once
+
+#include "Particle.h"
@@ -0,0 +1,93 @@
+/*
+ * Host flash – see flash_host.h.  pread/pwrite on a plain descriptor, so
+ * the stand-in touches neither the heap nor stdio once it is open.
+ * -----------------------------------------------------------------------*/
+#include "flash_host.h"
+#include "hal_host.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static off_t flashAllocated;     /* bytes of the part given out so far */
+
+void flashHostRestart() { flashAllocated = 0; }
+
+JournalStore::~JournalStore() {
+    if (fd_ >= 0) close(fd_);
+}
+
+bool JournalStore::begin(uint8_t segments, uint32_t segBytes) {
+    const hal::Options &o = hal::options();
+    if (segBytes % o.flashSectorBytes) return false;
+    segments_ = segments;
+    segBytes_ = segBytes;
+    base_     = flashAllocated;
+    flashAllocated += (off_t)segments * segBytes;
+    if (o.flashPath) {
+        fd_ = open(o.flashPath, O_RDWR | O_CREAT, 0644);
+    } else {
+        char path[] = "/tmp/safeneck-flash-XXXXXX";
+        fd_ = mkstemp(path);
+        if (fd_ >= 0) unlink(path);
+    }
+    if (fd_ < 0) return false;
+
+    /* A new (or shorter) file is blank flash. */
+    off_t size = lseek(fd_, 0, SEEK_END);
+    uint8_t blank[256];
+    memset(blank, 0xFF, sizeof(blank));
+    off_t end = base_ + (off_t)segments * segBytes;
+    for (off_t at = size; at < end; at += sizeof(blank)) {
+        size_t n = end - at;
+        if (pwrite(fd_, blank, n < sizeof(blank) ? n : sizeof(blank), at) < 0) return false;
+    }
+    return true;
+}
+
+bool JournalStore::read(uint8_t seg, uint32_t off, void *p, uint32_t n) {
+    if (fd_ < 0 || seg >= segments_ || off + n > segBytes_) return false;
+    hal::Counters &c = hal::counters();
+    c.flashReadBytes += n;
+    hal::advanceUs(hal::options().flashReadUs + n / 4);    /* 32 MHz SPI */
+    return pread(fd_, p, n, base_ + (off_t)seg * segBytes_ + off) == (ssize_t)n;
+}
+
+bool JournalStore::program(uint8_t seg, uint32_t off, const void *p, uint32_t n) {
+    if (fd_ < 0 || seg >= segments_ || off + n > segBytes_ || !n) return false;
+    const hal::Options &o = hal::options();
+    hal::Counters &c = hal::counters();
+    off_t base = base_ + (off_t)seg * segBytes_ + off;
+    uint8_t old[512];
+    const uint8_t *in = (const uint8_t *)p;
+    for (uint32_t done = 0; done < n;) {
+        uint32_t k = n - done < sizeof(old) ? n - done : (uint32_t)sizeof(old);
+        if (pread(fd_, old, k, base + done) != (ssize_t)k) return false;
+        for (uint32_t i = 0; i < k; i++) {
+            if ((old[i] & in[done + i]) != in[done + i]) c.flashBadPrograms++;
+            old[i] &= in[done + i];          /* NOR: bits only go to 0 */
+        }
+        if (pwrite(fd_, old, k, base + done) != (ssize_t)k) return false;
+        done += k;
+    }
+    uint32_t pages = (off + n - 1) / o.flashPageBytes - off / o.flashPageBytes + 1;
+    c.flashProgramBytes += n;
+    c.flashPagePrograms += pages;
+    hal::advanceUs((uint64_t)pages * o.flashPageProgramUs);
+    return true;
+}
+
+bool JournalStore::erase(uint8_t seg) {
+    if (fd_ < 0 || seg >= segments_) return false;
+    const hal::Options &o = hal::options();
+    uint8_t blank[256];
+    memset(blank, 0xFF, sizeof(blank));
+    for (uint32_t at = 0; at < segBytes_; at += sizeof(blank)) {
+        if (pwrite(fd_, blank, sizeof(blank), base_ + (off_t)seg * segBytes_ + at) < 0) return false;
+    }
+    uint32_t sectors = segBytes_ / o.flashSectorBytes;
+    hal::counters().flashErases += sectors;
+    hal::advanceUs((uint64_t)sectors * o.flashSectorEraseUs);
+    return true;
+}
@@ -0,0 +1,43 @@
+/*
+ * Host flash – file-backed stand-in for the journal's segments
+ * ============================================================
+ * What common/flash_journal.h gets on the host instead of LittleFS: a
+ * NOR flash the size of the journal, kept in a file (--flash FILE, so a
+ * second run starts from what the first left behind, as after a
+ * reboot) or in an anonymous temporary file.  It behaves like the part:
+ *
+ *   • erase sets a segment's sectors to 0xFF and costs sectorEraseUs each,
+ *   • program can only clear bits (a write over programmed bytes is
+ *     counted as bad) and costs pageProgramUs per page it touches,
+ *
+ * and counts both in hal::counters(), so write amplification (bytes of
+ * whole pages programmed per journal byte) and erases per hour can be
+ * read from a replay.  Stores are laid out one after another in the
+ * order they begin() (the boot record's two slots, then the journal), so
+ * one file holds the whole part.
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+class JournalStore {
+public:
+    explicit JournalStore(const char *dir) {}
+    ~JournalStore();
+
+    bool begin(uint8_t segments, uint32_t segBytes);
+    bool read(uint8_t seg, uint32_t off, void *p, uint32_t n);
+    bool program(uint8_t seg, uint32_t off, const void *p, uint32_t n);
+    bool erase(uint8_t seg);
+
+private:
+    int      fd_       = -1;
+    uint8_t  segments_ = 0;
+    uint32_t segBytes_ = 0;
+    off_t    base_     = 0;     /* where this store starts in the part */
+};
+
+/* Lays the next store out at the start of the part again, as a reboot
+ * does: for a tool that begin()s a fresh journal on the same file. */
+void flashHostRestart();
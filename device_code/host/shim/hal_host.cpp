@@ -0,0 +1,922 @@
+/*
+ * Host HAL – virtual clock, replayed I2C sensors and cloud stand-ins
+ * ==================================================================
+ * See Particle.h for what the firmware sees and hal_host.h for what the
+ * harness controls.  Nothing in here allocates once a trace is loaded,
+ * so the heap counters only ever reflect the firmware itself.
+ * -----------------------------------------------------------------------*/
+#include "Particle.h"
+#include "hal_host.h"
+#include "common/shtp.h"
+#include "common/heap_stats.h"
+
+#include <malloc.h>
+
+#include <condition_variable>
+#include <new>
+#include <thread>
+
+USBSerial  Serial;
+CloudClass Particle;
+TimeClass  Time;
+TwoWire    Wire;
+
+namespace hal {
+namespace {
+
+Options  gOptions;
+Counters gCounters;
+uint64_t gNowUs = 0;
+
+std::vector<trace::Record> gTrace;
+size_t                     gNextRecord = 0;
+bool                       gPresent[2] = {false, false};
+
+/* ── PA1010D: byte FIFO, padded with '\n' when empty ────────────────── */
+std::vector<uint8_t> gGpsFifo;
+size_t gGpsHead = 0, gGpsCount = 0;
+
+/* Power: PMTK161,0 is standby, PMTK225,2,run,sleep,run2,sleep2 periodic
+ * standby (the short form is ignored, as the module does) and
+ * PMTK225,0 back to full power; any byte written wakes it from standby.
+ * The traced NMEA is only produced while the receiver runs, and not for
+ * gpsHotStartMs after each wake-up (the hot start; the trace itself
+ * carries the cold start at power-on, unless gpsColdMs says otherwise). */
+enum GpsPower : uint8_t { GPS_RUN, GPS_STANDBY, GPS_PERIODIC };
+GpsPower gGpsPower = GPS_RUN;
+uint64_t gGpsPowerSinceUs = 0;        /* mode, or periodic cycle, start */
+uint64_t gGpsRunUs = 0, gGpsSleepUs = 0;
+uint64_t gGpsAccountedUs = 0;
+bool     gGpsWoken = false;            /* left RUN at least once        */
+char     gGpsCmd[96];
+size_t   gGpsCmdLen = 0;
+
+/* Acquisition (gpsColdMs): until gGpsFixUs the receiver has no fix, so
+ * its GGA and RMC lines leave in their no-fix form with the same time
+ * and date; the trace is reassembled into lines for that.  PMTK740 and
+ * PMTK741 together bring gGpsFixUs forward to gpsAidedMs after them. */
+uint64_t gGpsFixUs = 0;
+bool     gGpsAidTime = false, gGpsAidPos = false;
+char     gGpsLine[128];
+size_t   gGpsLineLen = 0;
+
+/* Receiver-on time from the mode start to `t`. */
+uint64_t gpsOnSince(uint64_t t) {
+    uint64_t d = t - gGpsPowerSinceUs;
+    if (gGpsPower == GPS_RUN)     return d;
+    if (gGpsPower == GPS_STANDBY) return 0;
+    uint64_t period = gGpsRunUs + gGpsSleepUs;
+    uint64_t rem = d % period;
+    return d / period * gGpsRunUs + (rem < gGpsRunUs ? rem : gGpsRunUs);
+}
+
+void gpsAccount(uint64_t now) {
+    if (now <= gGpsAccountedUs) return;
+    uint64_t on = gpsOnSince(now) - gpsOnSince(gGpsAccountedUs);
+    gCounters.gpsOnUs += on;
+    gCounters.gpsStandbyUs += now - gGpsAccountedUs - on;
+    gGpsAccountedUs = now;
+}
+
+bool gpsOutputs(uint64_t t) {
+    uint64_t hot = (uint64_t)gOptions.gpsHotStartMs * 1000;
+    uint64_t d = t - gGpsPowerSinceUs;
+    if (gGpsPower == GPS_RUN)     return !gGpsWoken || d >= hot;
+    if (gGpsPower == GPS_STANDBY) return false;
+    uint64_t phase = d % (gGpsRunUs + gGpsSleepUs);
+    return phase >= hot && phase < gGpsRunUs;
+}
+
+void gpsSetPower(GpsPower p, uint64_t now) {
+    gpsAccount(now);
+    gGpsWoken = true;
+    gGpsPower = p;
+    gGpsPowerSinceUs = now;
+}
+
+void gpsCommand(const char *line) {
+    unsigned run = 0, sleep = 0, run2 = 0, sleep2 = 0;
+    if (!strncmp(line, "$PMTK161,0*", 11)) {
+        gpsSetPower(GPS_STANDBY, gNowUs);
+    } else if (!strncmp(line, "$PMTK225,0*", 11)) {
+        if (gGpsPower != GPS_RUN) gpsSetPower(GPS_RUN, gNowUs);
+    } else if (sscanf(line, "$PMTK225,2,%u,%u,%u,%u*", &run, &sleep, &run2, &sleep2) == 4 &&
+               run) {
+        gGpsRunUs = (uint64_t)run * 1000;
+        gGpsSleepUs = (uint64_t)sleep * 1000;
+        gpsSetPower(GPS_PERIODIC, gNowUs);
+    } else if (!strncmp(line, "$PMTK740,", 9) || !strncmp(line, "$PMTK741,", 9)) {
+        (line[7] == '0' ? gGpsAidTime : gGpsAidPos) = true;
+        uint64_t aided = gNowUs + (uint64_t)gOptions.gpsAidedMs * 1000;
+        if (gGpsAidTime && gGpsAidPos && !gCounters.gpsAidedAtUs) {
+            gCounters.gpsAidedAtUs = gNowUs;
+            if (aided < gGpsFixUs) gGpsFixUs = aided;
+        }
+    }
+}
+
+void gpsWrite(const uint8_t *buf, size_t len) {
+    if (len && gGpsPower == GPS_STANDBY) gpsSetPower(GPS_RUN, gNowUs);
+    for (size_t i = 0; i < len; i++) {
+        if (buf[i] == '$') gGpsCmdLen = 0;
+        if (gGpsCmdLen < sizeof(gGpsCmd) - 1) gGpsCmd[gGpsCmdLen++] = (char)buf[i];
+        if (buf[i] == '\n') {
+            gGpsCmd[gGpsCmdLen] = 0;
+            gpsCommand(gGpsCmd);
+            gGpsCmdLen = 0;
+        }
+    }
+}
+
+void gpsFifoPut(const uint8_t *bytes, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (gGpsCount == gGpsFifo.size()) {       /* drop oldest          */
+            gGpsHead = (gGpsHead + 1) % gGpsFifo.size();
+            gGpsCount--;
+            gCounters.gpsOverflowBytes++;
+        }
+        gGpsFifo[(gGpsHead + gGpsCount) % gGpsFifo.size()] = bytes[i];
+        gGpsCount++;
+    }
+}
+
+/* Comma-separated field `n` of an NMEA line, up to the next ',' or '*'. */
+size_t nmeaField(const char *line, int n, const char **at) {
+    const char *p = line;
+    for (int i = 0; i < n && (p = strchr(p, ',')); i++) p++;
+    if (!p) { *at = ""; return 0; }
+    *at = p;
+    return strcspn(p, ",*\r\n");
+}
+
+/* A complete line while acquiring: GGA and RMC without their fix. */
+void gpsLine(const char *line, size_t len, uint64_t tUs) {
+    bool gga = len > 6 && !strncmp(line + 3, "GGA,", 4);
+    bool rmc = len > 6 && !strncmp(line + 3, "RMC,", 4);
+    if (tUs >= gGpsFixUs || (!gga && !rmc)) {
+        if ((gga || rmc) && !gCounters.gpsFixFromUs) gCounters.gpsFixFromUs = tUs;
+        gpsFifoPut((const uint8_t *)line, len);
+        return;
+    }
+    const char *hms, *dmy;
+    int nHms = (int)nmeaField(line, 1, &hms);
+    int nDmy = (int)nmeaField(line, 9, &dmy);
+    char body[96], out[104];
+    if (gga) snprintf(body, sizeof(body), "%.2sGGA,%.*s,,,,,0,00,,,M,,M,,", line + 1, nHms, hms);
+    else     snprintf(body, sizeof(body), "%.2sRMC,%.*s,V,,,,,0.00,0.00,%.*s,,,N",
+                      line + 1, nHms, hms, nDmy, dmy);
+    uint8_t sum = 0;
+    for (const char *p = body; *p; p++) sum ^= (uint8_t)*p;
+    int n = snprintf(out, sizeof(out), "$%s*%02X\r\n", body, sum);
+    gpsFifoPut((const uint8_t *)out, (size_t)n);
+}
+
+void gpsPush(const std::vector<uint8_t> &bytes, uint64_t tUs) {
+    if (!gpsOutputs(tUs)) {
+        gCounters.gpsSuppressedBytes += bytes.size();
+        return;
+    }
+    if (!gOptions.gpsColdMs) {
+        gpsFifoPut(bytes.data(), bytes.size());
+        return;
+    }
+    for (uint8_t b : bytes) {
+        if (b == '$') gGpsLineLen = 0;
+        if (gGpsLineLen == sizeof(gGpsLine) - 1) gGpsLineLen = 0;   /* not NMEA */
+        gGpsLine[gGpsLineLen++] = (char)b;
+        if (b != '\n') continue;
+        gGpsLine[gGpsLineLen] = 0;
+        gpsLine(gGpsLine, gGpsLineLen, tUs);
+        gGpsLineLen = 0;
+    }
+}
+
+void gpsRead(uint8_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (gGpsCount) {
+            out[i] = gGpsFifo[gGpsHead];
+            gGpsHead = (gGpsHead + 1) % gGpsFifo.size();
+            gGpsCount--;
+        } else {
+            out[i] = 0x0A;
+            gCounters.gpsPaddingBytes++;
+        }
+    }
+}
+
+/* ── BNO085: sensor hub with on-chip batching ──────────────────────
+ * Trace packets are taken apart into reports.  Once the firmware has
+ * sent a Set Feature command, only enabled reports are produced, each
+ * at its requested interval; otherwise every traced report is.  Reports
+ * wait in the hub's batch until the earliest batch deadline among them
+ * (immediately for an interval-only report) and then leave as one
+ * packet: 0xFB base timestamp, then each report with its delay and its
+ * own sequence number.  A report with change sensitivity enabled is only
+ * produced when an axis moved by more than the sensitivity since the
+ * last one it produced (absolute mode).  Packets queue for the host and
+ * hold INT low; a partial read is answered with continuation headers,
+ * and a full queue loses the oldest packet. */
+const size_t IMU_PACKET_MAX = 256;
+const uint64_t NEVER_US = UINT64_MAX;
+
+struct ImuFeature {
+    bool     on = false;
+    uint8_t  flags = 0;
+    uint16_t sensitivity = 0;
+    int16_t  last[3] = { 0, 0, 0 };       /* axes of the last produced    */
+    uint32_t intervalUs = 0, batchUs = 0;
+    uint64_t lastUs = 0;
+    bool     produced = false;
+    uint8_t  seq = 0;
+};
+
+struct ImuPacket {
+    size_t  len = 0;
+    uint8_t bytes[IMU_PACKET_MAX];
+};
+
+ImuFeature gImuFeature[256];
+bool       gImuConfigured = false;        /* a Set Feature was seen      */
+uint8_t    gImuBatch[IMU_PACKET_MAX];     /* cargo after the 0xFB record */
+size_t     gImuBatchLen = 0;
+uint64_t   gImuBatchStartUs = 0, gImuBatchDueUs = NEVER_US;
+uint8_t    gImuChannelSeq = 0;
+
+std::vector<ImuPacket> gImuQueue;
+size_t gImuHead = 0, gImuCount = 0;
+size_t gImuOffset = 0;               /* bytes of the head packet read   */
+
+inline uint32_t le32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* Set Feature (channel 2, 0xFD): id, flags, sensitivity, interval, batch. */
+void imuWrite(const uint8_t *buf, size_t len) {
+    if (len < 17 || buf[2] != 2 || buf[4] != 0xFD) return;
+    ImuFeature &f = gImuFeature[buf[5]];
+    f.flags       = buf[6];
+    f.sensitivity = (uint16_t)(buf[7] | buf[8] << 8);
+    f.intervalUs = le32(buf + 9);
+    f.batchUs    = le32(buf + 13);
+    f.on         = f.intervalUs != 0;
+    f.produced   = false;
+    gImuConfigured = true;
+}
+
+void imuFlush(uint64_t atUs) {
+    if (!gImuBatchLen) return;
+    if (gImuCount == gImuQueue.size()) {
+        gImuHead = (gImuHead + 1) % gImuQueue.size();
+        gImuCount--;
+        gImuOffset = 0;
+        gCounters.imuPacketsLost++;
+    }
+    ImuPacket &p = gImuQueue[(gImuHead + gImuCount) % gImuQueue.size()];
+    uint32_t ticks = (uint32_t)((atUs - gImuBatchStartUs) / 100);
+    size_t   len = 4 + 5 + gImuBatchLen;
+    uint8_t  hdr[9] = { (uint8_t)len, (uint8_t)(len >> 8), 3, gImuChannelSeq++,
+                        0xFB, (uint8_t)ticks, (uint8_t)(ticks >> 8),
+                        (uint8_t)(ticks >> 16), (uint8_t)(ticks >> 24) };
+    memcpy(p.bytes, hdr, sizeof(hdr));
+    memcpy(p.bytes + sizeof(hdr), gImuBatch, gImuBatchLen);
+    p.len = len;
+    gImuCount++;
+    gImuBatchLen = 0;
+    gImuBatchDueUs = NEVER_US;
+}
+
+void imuPush(const trace::Record &rec) {
+    const std::vector<uint8_t> &pkt = rec.bytes;
+    size_t pos = 4;
+    while (pos < pkt.size()) {
+        uint8_t id = pkt[pos];
+        size_t rlen = shtpReportLength(id);
+        if (!rlen || pos + rlen > pkt.size()) break;
+        const uint8_t *r = pkt.data() + pos;
+        pos += rlen;
+        if (id == 0xFA || id == 0xFB) continue;
+
+        ImuFeature &f = gImuFeature[id];
+        if (gImuConfigured) {
+            if (!f.on) continue;
+            if (f.produced && rec.tUs - f.lastUs < f.intervalUs - f.intervalUs / 8) continue;
+            if ((f.flags & 0x03) == 0x02 && f.produced && rlen >= 10) {
+                bool moved = false;
+                for (int a = 0; a < 3; a++) {
+                    int d = (int16_t)(r[4 + 2 * a] | r[5 + 2 * a] << 8) - f.last[a];
+                    moved |= (d < 0 ? -d : d) > f.sensitivity;
+                }
+                if (!moved) continue;
+            }
+        }
+        f.produced = true;
+        f.lastUs = rec.tUs;
+        if (rlen >= 10) {
+            for (int a = 0; a < 3; a++) f.last[a] = (int16_t)(r[4 + 2 * a] | r[5 + 2 * a] << 8);
+        }
+
+        if (gImuBatchLen && (gImuBatchLen + rlen > IMU_PACKET_MAX - 9 ||
+                             (rec.tUs - gImuBatchStartUs) / 100 > 0x3FFF))
+            imuFlush(rec.tUs);
+        if (!gImuBatchLen) gImuBatchStartUs = rec.tUs;
+
+        uint8_t *o = gImuBatch + gImuBatchLen;
+        memcpy(o, r, rlen);
+        uint32_t delay = (uint32_t)((rec.tUs - gImuBatchStartUs) / 100);
+        o[1] = f.seq++;
+        o[2] = (uint8_t)((r[2] & 0x03) | ((delay >> 8) << 2));
+        o[3] = (uint8_t)delay;
+        gImuBatchLen += rlen;
+        gCounters.imuReports++;
+
+        uint64_t due = rec.tUs + (gImuConfigured ? f.batchUs : 0);
+        if (due < gImuBatchDueUs) gImuBatchDueUs = due;
+    }
+}
+
+void imuRead(uint8_t *out, size_t n) {
+    memset(out, 0, n);
+    if (!gImuCount || n == 0) return;
+
+    const ImuPacket &pkt = gImuQueue[gImuHead];
+    size_t pos = 0;
+    if (gImuOffset == 0) {
+        /* Fresh packet: header + cargo straight from the sensor. */
+        size_t take = n < pkt.len ? n : pkt.len;
+        memcpy(out, pkt.bytes, take);
+        gImuOffset = take;
+        pos = take;
+    } else {
+        /* Continuation: new header carrying the remaining length. */
+        uint16_t remain = (uint16_t)(pkt.len - gImuOffset + 4);
+        uint8_t  hdr[4] = { (uint8_t)(remain & 0xFF), (uint8_t)((remain >> 8) | 0x80),
+                            pkt.bytes[2], pkt.bytes[3] };
+        size_t take = n < 4 ? n : 4;
+        memcpy(out, hdr, take);
+        pos = take;
+        size_t cargo = n - pos;
+        if (cargo > pkt.len - gImuOffset) cargo = pkt.len - gImuOffset;
+        memcpy(out + pos, pkt.bytes + gImuOffset, cargo);
+        gImuOffset += cargo;
+        pos += cargo;
+    }
+    if (gImuOffset >= pkt.len) {
+        gImuHead = (gImuHead + 1) % gImuQueue.size();
+        gImuCount--;
+        gImuOffset = 0;
+        gCounters.imuPacketsServed++;
+    }
+}
+
+/* Deliver every trace record whose timestamp has passed. */
+void pump() {
+    while (gNextRecord < gTrace.size() && gTrace[gNextRecord].tUs <= gNowUs) {
+        const trace::Record &r = gTrace[gNextRecord];
+        if (gImuBatchDueUs <= r.tUs) imuFlush(gImuBatchDueUs);
+        if (r.addr == trace::ADDR_GPS)      gpsPush(r.bytes, r.tUs);
+        else if (r.addr == trace::ADDR_IMU) imuPush(r);
+        gNextRecord++;
+    }
+    if (gImuBatchDueUs <= gNowUs) imuFlush(gImuBatchDueUs);
+    gpsAccount(gNowUs);
+}
+
+/* STOP mode: no thread runs while the clock walks from one sensor event
+ * to the next, until INT goes low (with `wakeOnInt`) or `maxUs` passes. */
+bool stop(uint64_t maxUs, bool wakeOnInt) {
+    const uint64_t start = gNowUs, until = gNowUs + maxUs;
+    bool byInt = false;
+    for (;;) {
+        pump();
+        if (wakeOnInt && gImuCount) { byInt = true; break; }
+        if (gNowUs >= until) break;
+        uint64_t next = until;
+        if (gNextRecord < gTrace.size() && gTrace[gNextRecord].tUs < next) next = gTrace[gNextRecord].tUs;
+        if (gImuBatchDueUs < next) next = gImuBatchDueUs;
+        gNowUs = next > gNowUs ? next : gNowUs + 1;
+    }
+    gCounters.stops++;
+    gCounters.stopUs += gNowUs - start;
+    if (byInt) gCounters.stopIntWakes++;
+    return byInt;
+}
+
+int slot(uint8_t addr) {
+    if (addr == trace::ADDR_GPS) return 0;
+    if (addr == trace::ADDR_IMU) return 1;
+    return -1;
+}
+
+/* A device in the trace that has finished booting ACKs its address. */
+bool acks(int s) {
+    if (s < 0 || !gPresent[s]) return false;
+    if (gNowUs >= (uint64_t)(s ? gOptions.imuBootMs : gOptions.gpsBootMs) * 1000) return true;
+    gCounters.i2cBootNacks++;
+    return false;
+}
+
+/* Bus occupancy of one transaction: address byte + payload, 9 bits each. */
+void busTime(size_t bytes, uint32_t clockHz) {
+    uint64_t us = ((uint64_t)(bytes + 1) * 9 * 1000000ULL + clockHz - 1) / clockHz;
+    gCounters.i2cBusUs += us;
+    advanceUs(us);
+}
+
+} // namespace
+
+Options  &options()  { return gOptions; }
+Counters &counters() { return gCounters; }
+
+void loadTrace(std::vector<trace::Record> records) {
+    gTrace = std::move(records);
+    gNextRecord = 0;
+    gPresent[0] = gPresent[1] = false;
+    for (const trace::Record &r : gTrace) {
+        int s = slot(r.addr);
+        if (s >= 0) gPresent[s] = true;
+    }
+    gGpsFifo.assign(gOptions.gpsFifoBytes ? gOptions.gpsFifoBytes : 1, 0);
+    gGpsHead = gGpsCount = 0;
+    gGpsPower = GPS_RUN;
+    gGpsPowerSinceUs = gGpsAccountedUs = 0;
+    gGpsWoken = false;
+    gGpsCmdLen = 0;
+    gGpsFixUs = (uint64_t)gOptions.gpsColdMs * 1000;
+    gGpsAidTime = gGpsAidPos = false;
+    gGpsLineLen = 0;
+    gImuQueue.assign(gOptions.imuQueuePackets ? gOptions.imuQueuePackets : 1, ImuPacket());
+    gImuHead = gImuCount = gImuOffset = 0;
+    for (ImuFeature &f : gImuFeature) f = ImuFeature();
+    gImuConfigured = false;
+    gImuBatchLen = 0;
+    gImuBatchDueUs = NEVER_US;
+}
+
+uint64_t traceEndUs() { return gTrace.empty() ? 0 : gTrace.back().tUs; }
+uint64_t nowUs()      { return gNowUs; }
+
+/* ── Threads ───────────────────────────────────────────────────────────
+ * Every firmware thread is a host thread, but only the one named by
+ * gCurrent runs; the others wait on their condition variable.  Whoever
+ * gives up the CPU picks the highest-priority ready task and, if none is
+ * ready, jumps the clock to the earliest wake-up.  Equal priorities
+ * round-robin on the 1 ms FreeRTOS tick.  Tasks and the mutex
+ * are never freed: parked threads outlive main().
+ * ───────────────────────────────────────────────────────────────────── */
+namespace {
+
+const uint64_t NEVER   = UINT64_MAX;
+const uint64_t TICK_US = 1000;      /* FreeRTOS time slice */
+
+struct Task {
+    Task(const char *n, uint8_t p) : name(n), prio(p) {}
+    const char             *name;
+    uint8_t                 prio;
+    uint64_t                wakeUs   = 0;       /* ready once the clock passes */
+    const void             *waitLock = nullptr; /* blocked on this mutex      */
+    bool                    done     = false;
+    uint64_t                wakeups  = 0;
+    uint64_t                cpuNs    = 0;
+    uint64_t                cpuMark  = 0;
+    uint64_t                switchNs = 0;       /* CPU spent handing off      */
+    uint64_t                sliceUs  = 0;       /* when it last got the CPU   */
+    std::function<void()>   fn;
+    std::condition_variable cv;
+};
+
+std::mutex          *gSchedMutex = nullptr;
+std::vector<Task *>  gTasks;
+Task                *gCurrent = nullptr;
+
+uint64_t threadCpuNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* The caller, creating the setup()/loop() task on first use. */
+Task *currentTask() {
+    if (!gCurrent) {
+        gSchedMutex = new std::mutex;
+        gCurrent = new Task("loop", OS_THREAD_PRIORITY_DEFAULT);
+        gCurrent->cpuMark = threadCpuNs();
+        gTasks.push_back(gCurrent);
+    }
+    return gCurrent;
+}
+
+bool ready(const Task *t) { return !t->done && !t->waitLock && t->wakeUs <= gNowUs; }
+
+/* Highest-priority ready task; `self` keeps the CPU on a tie. */
+Task *pick(Task *self) {
+    Task *best = ready(self) ? self : nullptr;
+    for (Task *t : gTasks) {
+        if (ready(t) && (!best || t->prio > best->prio)) best = t;
+    }
+    return best;
+}
+
+void switchTo(Task *self, Task *next) {
+    const uint64_t t0 = threadCpuNs();
+    self->cpuNs += t0 - self->cpuMark;
+    next->sliceUs = gNowUs;
+    std::unique_lock<std::mutex> lk(*gSchedMutex);
+    gCurrent = next;
+    next->cv.notify_one();
+    if (self->done) return;
+    self->cv.wait(lk, [self] { return gCurrent == self; });
+    self->cpuMark = threadCpuNs();
+    self->switchNs += self->cpuMark - t0;
+}
+
+/* Give up the CPU; returns once `self` is picked again. */
+void reschedule(Task *self) {
+    Task *next;
+    while (!(next = pick(self))) {
+        uint64_t wake = NEVER;
+        for (Task *t : gTasks) {
+            if (!t->done && !t->waitLock && t->wakeUs < wake) wake = t->wakeUs;
+        }
+        if (wake == NEVER) {
+            fprintf(stderr, "host: every thread is blocked\n");
+            abort();
+        }
+        gNowUs = wake;
+    }
+    if (next != self) switchTo(self, next);
+}
+
+/* Next ready task of the same priority after `self`, round-robin. */
+Task *peer(const Task *self) {
+    size_t n = gTasks.size(), at = 0;
+    while (gTasks[at] != self) at++;
+    for (size_t k = 1; k < n; k++) {
+        Task *t = gTasks[(at + k) % n];
+        if (ready(t) && t->prio == self->prio) return t;
+    }
+    return nullptr;
+}
+
+/* Earliest wake-up of a task that would preempt `self`. */
+uint64_t nextPreemption(const Task *self) {
+    uint64_t at = NEVER;
+    for (const Task *t : gTasks) {
+        if (t != self && !t->done && !t->waitLock && t->prio > self->prio && t->wakeUs < at)
+            at = t->wakeUs;
+    }
+    return at;
+}
+
+} // namespace
+
+void advanceUs(uint64_t us) {
+    if (gTasks.size() <= 1) { gNowUs += us; return; }
+    Task *self = gCurrent;
+    for (;;) {
+        uint64_t at = nextPreemption(self);
+        if (at == NEVER || at >= gNowUs + us) { gNowUs += us; break; }
+        if (at > gNowUs) { us -= at - gNowUs; gNowUs = at; }
+        reschedule(self);
+    }
+    if (gNowUs - self->sliceUs >= TICK_US) {
+        self->sliceUs = gNowUs;
+        if (Task *t = peer(self)) switchTo(self, t);
+    }
+}
+
+void sleepUs(uint64_t us) {
+    if (gTasks.size() <= 1) { gNowUs += us; return; }
+    Task *self = gCurrent;
+    self->wakeUs = gNowUs + us;
+    reschedule(self);
+    self->wakeups++;
+}
+
+uint64_t switchCpuNs() { return gCurrent ? gCurrent->switchNs : 0; }
+
+std::vector<ThreadInfo> threads() {
+    std::vector<ThreadInfo> out;
+    for (const Task *t : gTasks) {
+        uint64_t cpu = t->cpuNs + (t == gCurrent ? threadCpuNs() - t->cpuMark : 0);
+        out.push_back({ t->name, t->prio, t->wakeups, cpu });
+    }
+    return out;
+}
+
+void *spawn(const char *name, uint8_t prio, std::function<void()> fn) {
+    Task *self = currentTask();
+    Task *t = new Task(name, prio);
+    t->wakeUs = gNowUs;
+    t->fn = std::move(fn);
+    gTasks.push_back(t);
+    std::thread([t] {
+        {
+            std::unique_lock<std::mutex> lk(*gSchedMutex);
+            t->cv.wait(lk, [t] { return gCurrent == t; });
+        }
+        t->cpuMark = threadCpuNs();
+        t->fn();
+        t->done = true;
+        reschedule(t);
+    }).detach();
+    if (prio > self->prio) reschedule(self);
+    return t;
+}
+
+} // namespace hal
+
+/* ── Firmware-facing thread API ────────────────────────────────────── */
+Thread::Thread(const char *name, wiring_thread_fn_t function, os_thread_prio_t priority, size_t) {
+    task_ = hal::spawn(name, priority, std::move(function));
+}
+
+Thread::Thread(const char *name, os_thread_fn_t function, void *param,
+               os_thread_prio_t priority, size_t) {
+    task_ = hal::spawn(name, priority, [function, param] { function(param); });
+}
+
+int os_thread_delay_until(system_tick_t *previousWakeTime, system_tick_t timeIncrement) {
+    *previousWakeTime += timeIncrement;
+    int32_t wait = (int32_t)(*previousWakeTime - (system_tick_t)millis());
+    if (wait > 0) hal::sleepUs((uint64_t)wait * 1000);
+    return 0;
+}
+
+void RecursiveMutex::lock() {
+    hal::Task *self = hal::currentTask();
+    while (owner_ && owner_ != self) {
+        self->waitLock = this;
+        hal::reschedule(self);
+    }
+    owner_ = self;
+    depth_++;
+}
+
+bool RecursiveMutex::trylock() {
+    hal::Task *self = hal::currentTask();
+    if (owner_ && owner_ != self) return false;
+    owner_ = self;
+    depth_++;
+    return true;
+}
+
+void RecursiveMutex::unlock() {
+    if (depth_ == 0 || --depth_) return;
+    owner_ = nullptr;
+    hal::Task *self = hal::currentTask();
+    bool preempt = false;
+    for (hal::Task *t : hal::gTasks) {
+        if (t->waitLock != this) continue;
+        t->waitLock = nullptr;
+        preempt |= t->prio > self->prio;
+    }
+    if (preempt) hal::reschedule(self);
+}
+
+/* ── Retained RAM ──────────────────────────────────────────────────────
+ * The linker brackets the `retained` section (Particle.h) with these;
+ * they stay null in a firmware that has no retained variables.       */
+extern "C" {
+extern uint8_t __start_retained_user[] __attribute__((weak));
+extern uint8_t __stop_retained_user[] __attribute__((weak));
+}
+
+bool hal::loadRetained() {
+    const char *path = options().retainedPath;
+    size_t size = (size_t)(__stop_retained_user - __start_retained_user);
+    FILE *f = path && size ? fopen(path, "rb") : nullptr;
+    if (!f) return false;
+    fseek(f, 0, SEEK_END);
+    bool ok = ftell(f) == (long)size;
+    fseek(f, 0, SEEK_SET);
+    ok = ok && fread(__start_retained_user, 1, size, f) == size;
+    fclose(f);
+    return ok;
+}
+
+bool hal::saveRetained() {
+    const char *path = options().retainedPath;
+    size_t size = (size_t)(__stop_retained_user - __start_retained_user);
+    FILE *f = path && size ? fopen(path, "wb") : nullptr;
+    if (!f) return false;
+    bool ok = fwrite(__start_retained_user, 1, size, f) == size;
+    return fclose(f) == 0 && ok;
+}
+
+/* ── Heap accounting ───────────────────────────────────────────────────
+ * heapStats() (common/heap_stats.h) reads glibc's mallinfo2().  The
+ * harness itself allocates nothing after loadTrace(), so from then on
+ * any movement is the firmware's.                                     */
+void hal::countAlloc(size_t n) {
+    counters().allocations++;
+    counters().allocBytes += n;
+}
+
+HeapStats heapStats() {
+    struct mallinfo2 mi = mallinfo2();
+    HeapStats h;
+    h.usedBytes  = (uint32_t)mi.uordblks;
+    h.freeBytes  = (uint32_t)mi.fordblks;
+    h.freeBlocks = (uint32_t)mi.ordblks;
+    return h;
+}
+
+void *operator new(size_t n) {
+    if (void *p = malloc(n ? n : 1)) {
+        hal::countAlloc(n);
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void *operator new[](size_t n)                 { return operator new(n); }
+void  operator delete(void *p) noexcept         { free(p); }
+void  operator delete[](void *p) noexcept       { free(p); }
+void  operator delete(void *p, size_t) noexcept { free(p); }
+void  operator delete[](void *p, size_t) noexcept { free(p); }
+
+/* ── GPIO ──────────────────────────────────────────────────────────── */
+static uint8_t gPinState[16];
+
+void pinMode(pin_t, PinMode) {}
+void digitalWrite(pin_t pin, uint8_t value) { if (pin < 16) gPinState[pin] = value; }
+int32_t digitalRead(pin_t pin) {
+    if (pin == hal::options().imuIntPin) {
+        hal::pump();
+        return hal::gImuCount ? LOW : HIGH;
+    }
+    return pin < 16 ? gPinState[pin] : (int32_t)LOW;
+}
+
+/* ── Sleep ─────────────────────────────────────────────────────────── */
+SystemClass System;
+
+SystemSleepResult SystemClass::sleep(const SystemSleepConfiguration &config) {
+    if (config.sleepMode() != SystemSleepMode::STOP) return SystemSleepResult();
+    uint64_t maxUs = config.durationMs() ? (uint64_t)config.durationMs() * 1000 : UINT64_MAX / 2;
+    bool byInt = hal::stop(maxUs, config.gpioWake());
+    /* Threads whose time came while stopped run first, as after a real wake. */
+    hal::reschedule(hal::currentTask());
+    return byInt ? SystemSleepResult(SystemSleepWakeupReason::BY_GPIO, config.gpioPin())
+                 : SystemSleepResult(SystemSleepWakeupReason::BY_RTC);
+}
+
+uint32_t SystemClass::ticks() { return (uint32_t)(hal::nowUs() * ticksPerMicrosecond()); }
+
+/* ── Timing ────────────────────────────────────────────────────────── */
+unsigned long millis() { return (unsigned long)(uint32_t)(hal::nowUs() / 1000); }
+unsigned long micros() { return (unsigned long)(uint32_t)hal::nowUs(); }
+void delay(unsigned long ms)          { hal::sleepUs((uint64_t)ms * 1000); }
+void delayMicroseconds(unsigned int us) { hal::advanceUs(us); }
+
+/* ── Serial ────────────────────────────────────────────────────────── */
+size_t USBSerial::write(const uint8_t *buf, size_t len) {
+    hal::counters().serialBytes += len;
+    if (hal::options().serialEcho) fwrite(buf, 1, len, stdout);
+    return len;
+}
+
+size_t USBSerial::print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+size_t USBSerial::print(char c)        { return write((const uint8_t *)&c, 1); }
+size_t USBSerial::print(int v)         { return printf("%d", v); }
+
+size_t USBSerial::vprintf(bool newline, const char *fmt, va_list args) {
+    char buf[512];
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    if (n < 0) return 0;
+    size_t len = (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1;
+    len = write((const uint8_t *)buf, len);
+    return newline ? len + println() : len;
+}
+
+size_t USBSerial::printf(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    size_t n = vprintf(false, fmt, args);
+    va_end(args);
+    return n;
+}
+
+size_t USBSerial::printlnf(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    size_t n = vprintf(true, fmt, args);
+    va_end(args);
+    return n;
+}
+
+/* ── Cloud ─────────────────────────────────────────────────────────── */
+bool CloudClass::connected() {
+    for (const auto &w : hal::options().offline) {
+        if (hal::nowUs() >= w.first && hal::nowUs() < w.second) return false;
+    }
+    return true;
+}
+
+bool CloudClass::publish(const char *name, const char *data, PublishFlags f1, PublishFlags f2) {
+    hal::Counters &c = hal::counters();
+    if (!connected()) {
+        c.publishFailed++;
+        return false;
+    }
+    /* Deterministic loss: every publish past the next whole percent fails. */
+    static uint32_t lossAcc = 0;
+    lossAcc += hal::options().publishFailPct;
+    bool lost = lossAcc >= 100;
+    if (lost) lossAcc -= 100;
+
+    c.publishes++;
+    c.publishBytes += strlen(data);
+    if (hal::options().publishEcho) {
+        ::printf("[%10.3f] publish %s %s%s\n", hal::nowUs() / 1e6, name, data,
+                 lost ? "  (lost)" : "");
+    }
+    if ((f1 | f2).has(WITH_ACK)) {
+        /* WITH_ACK blocks the calling thread until the cloud answers
+         * (or, for a lost event, until the ACK times out). */
+        uint64_t us = (uint64_t)hal::options().ackLatencyMs * 1000;
+        c.publishBlockedUs += us;
+        hal::sleepUs(us);
+    }
+    if (lost) c.publishFailed++;
+    return !lost;
+}
+
+/* Fixed table, so registering in setup() costs the heap counters nothing. */
+static std::pair<const char *, const char *> gVariables[20];
+static size_t gVariableCount = 0;
+
+bool CloudClass::variable(const char *name, const char *var) {
+    if (gVariableCount == sizeof(gVariables) / sizeof(gVariables[0])) return false;
+    gVariables[gVariableCount++] = { name, var };
+    return true;
+}
+
+std::vector<std::pair<const char *, const char *>> hal::variables() {
+    return { gVariables, gVariables + gVariableCount };
+}
+
+/* ── Time / power ──────────────────────────────────────────────────── */
+static const time_t HOST_EPOCH = 1792231200;   /* 2026-10-17 10:00 UTC, as tracegen's NMEA */
+
+time_t TimeClass::now() {
+    return HOST_EPOCH + hal::options().clockS + (time_t)(hal::nowUs() / 1000000);
+}
+
+float FuelGauge::getSoC() {
+    float soc = 87.5f - (float)(hal::nowUs() / 3600e6) * 2.0f;
+    return soc > 0.0f ? soc : 0.0f;
+}
+
+float FuelGauge::getVCell() { return 3.7f + getSoC() * 0.005f; }
+
+/* ── I2C ───────────────────────────────────────────────────────────── */
+void TwoWire::beginTransmission(int address) {
+    txAddr_ = (uint8_t)address;
+    txLen_  = 0;
+}
+
+size_t TwoWire::write(uint8_t b) {
+    if (txLen_ >= BUFFER_LENGTH) {
+        hal::counters().i2cTxTruncated++;
+        return 0;
+    }
+    txBuf_[txLen_++] = b;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t *buf, size_t len) {
+    size_t n = 0;
+    while (n < len && write(buf[n])) n++;
+    if (n < len) hal::counters().i2cTxTruncated += len - n - 1;
+    return n;
+}
+
+uint8_t TwoWire::endTransmission(bool stop) {
+    (void)stop;
+    hal::busTime(txLen_, clockHz_);
+    int s = hal::slot(txAddr_);
+    if (!hal::acks(s)) return 2;                  /* address NACK       */
+    hal::counters().i2cWrites[s]++;
+    if (s == 0) hal::gpsWrite(txBuf_, txLen_);
+    else        hal::imuWrite(txBuf_, txLen_);
+    return 0;
+}
+
+size_t TwoWire::requestFrom(int address, int quantity, int stop) {
+    (void)stop;
+    rxLen_ = rxPos_ = 0;
+    int s = hal::slot((uint8_t)address);
+    size_t n = quantity < 0 ? 0 : (size_t)quantity;
+    if (n > BUFFER_LENGTH) n = BUFFER_LENGTH;
+
+    hal::busTime(n, clockHz_);
+    if (n == 0 || !hal::acks(s)) return 0;
+
+    hal::pump();
+    if (s == 0) hal::gpsRead(rxBuf_, n);
+    else        hal::imuRead(rxBuf_, n);
+    hal::counters().i2cReads[s]++;
+    hal::counters().i2cReadBytes[s] += n;
+    rxLen_ = n;
+    return n;
+}
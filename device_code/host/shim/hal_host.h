@@ -0,0 +1,134 @@
+/*
+ * Host HAL – harness-side controls for the Device OS stand-in
+ * ===========================================================
+ * The firmware only ever sees Particle.h; the replay harness uses this
+ * header to load traces, drive the virtual clock and read counters.
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "../trace.h"
+
+namespace hal {
+
+struct Counters {
+    /* heap (operator new + String storage) */
+    uint64_t allocations   = 0;
+    uint64_t allocBytes    = 0;
+
+    /* I2C */
+    uint64_t i2cReads[2]      = {0, 0};   /* [0]=GPS 0x10, [1]=IMU 0x4A */
+    uint64_t i2cReadBytes[2]  = {0, 0};
+    uint64_t i2cWrites[2]     = {0, 0};
+    uint64_t i2cTxTruncated   = 0;        /* writes past the Wire buffer */
+    uint64_t gpsPaddingBytes  = 0;        /* 0x0A filler served         */
+    uint64_t gpsOverflowBytes = 0;        /* NMEA lost to a full FIFO   */
+    uint64_t gpsSuppressedBytes = 0;      /* not produced: asleep / hot start */
+    uint64_t gpsOnUs          = 0;        /* receiver running            */
+    uint64_t gpsStandbyUs     = 0;        /* PMTK161 / PMTK225 sleep     */
+    uint64_t gpsFixFromUs     = 0;        /* first fix, with gpsColdMs   */
+    uint64_t gpsAidedAtUs     = 0;        /* PMTK740 + PMTK741 complete  */
+    uint64_t i2cBootNacks     = 0;        /* probes before a device boots */
+    uint64_t imuReports       = 0;        /* produced by the hub        */
+    uint64_t imuPacketsServed = 0;
+    uint64_t imuPacketsLost   = 0;        /* overwritten before read    */
+    uint64_t i2cBusUs         = 0;        /* time the bus was occupied  */
+    /* sleep */
+    uint64_t stops            = 0;        /* System.sleep(STOP) calls   */
+    uint64_t stopUs           = 0;        /* virtual time spent in STOP */
+    uint64_t stopIntWakes     = 0;        /* ended by the BNO085 INT    */
+
+    /* cloud / console */
+    uint64_t publishes     = 0;
+    uint64_t publishBytes  = 0;
+    uint64_t publishBlockedUs = 0;        /* time spent waiting on ACKs */
+    uint64_t publishFailed = 0;           /* offline or not ACKed       */
+    uint64_t serialBytes   = 0;
+    /* journal flash (flash_host.h) */
+    uint64_t flashReadBytes    = 0;
+    uint64_t flashProgramBytes = 0;       /* as asked for               */
+    uint64_t flashPagePrograms = 0;       /* pages those touched        */
+    uint64_t flashErases       = 0;       /* sectors                    */
+    uint64_t flashBadPrograms  = 0;       /* bytes written over 0 bits  */
+};
+
+struct Options {
+    bool     serialEcho   = false;  /* copy Serial output to stdout     */
+    bool     publishEcho  = false;  /* print every publish to stdout    */
+    uint32_t ackLatencyMs = 500;    /* virtual time a WITH_ACK blocks   */
+    uint32_t gpsFifoBytes = 1024;   /* PA1010D output buffer            */
+    uint32_t gpsHotStartMs = 1000;  /* no NMEA this long after power-up */
+    uint32_t imuQueuePackets = 8;   /* BNO085 host-interface queue      */
+    uint16_t imuIntPin    = 3;      /* D3: BNO085 INT, low while queued */
+    uint32_t publishFailPct = 0;    /* share of publishes never ACKed   */
+
+    /* Power-on.  Each device NACKs its address until it has booted
+     * (typical figures, not datasheet limits).  With gpsColdMs the
+     * PA1010D reports no fix for that long after power-on – the trace's
+     * own fix is held back – unless it is aided with time (PMTK740) and
+     * position (PMTK741), which brings the fix to gpsAidedMs after the
+     * aiding: a receiver whose ephemeris survived in backup RAM. */
+    uint32_t imuBootMs    = 100;
+    uint32_t gpsBootMs    = 300;
+    uint32_t gpsColdMs    = 0;      /* 0: the trace decides             */
+    uint32_t gpsAidedMs   = 5000;
+
+    /* Time.now() at t = 0, seconds past the host epoch, so a run that
+     * stands for the boot after another can continue its clock.  The
+     * firmware's `retained` section is restored from retainedPath
+     * before setup() and saved back at the end (loadRetained()). */
+    uint32_t clockS       = 0;
+    const char *retainedPath = nullptr;
+
+    /* Journal flash: backing file (nullptr = a fresh temporary one) and
+     * the timing of a typical 4 MB SPI NOR part. */
+    const char *flashPath      = nullptr;
+    uint32_t flashPageBytes     = 256;
+    uint32_t flashSectorBytes   = 4096;
+    uint32_t flashReadUs        = 5;      /* per read command          */
+    uint32_t flashPageProgramUs = 700;
+    uint32_t flashSectorEraseUs = 45000;
+
+    /* [start, end) virtual µs windows with the cloud unreachable. */
+    std::vector<std::pair<uint64_t, uint64_t>> offline;
+};
+
+Options  &options();
+Counters &counters();
+
+/* Replays `records` from t = 0; records are delivered as the clock passes them. */
+void     loadTrace(std::vector<trace::Record> records);
+uint64_t traceEndUs();
+
+uint64_t nowUs();
+void     advanceUs(uint64_t us);   /* busy: bus transfers, spinning   */
+void     sleepUs(uint64_t us);     /* blocking: other threads may run */
+
+/* Firmware threads, [0] being the one that runs setup()/loop(). */
+struct ThreadInfo {
+    const char *name;
+    uint8_t     priority;
+    uint64_t    wakeups;          /* times it was given the CPU        */
+    uint64_t    cpuNs;            /* host CPU time while it ran        */
+};
+std::vector<ThreadInfo> threads();
+
+/* Particle.variable() registrations, read at the time of the call. */
+std::vector<std::pair<const char *, const char *>> variables();
+
+/* The firmware's `retained` variables (Particle.h) from and to
+ * options().retainedPath.  A file of another size – another build – is
+ * ignored, as Device OS clears retained RAM for a new firmware. */
+bool loadRetained();
+bool saveRetained();
+
+/* Counts one firmware allocation of `n` bytes (operator new, String). */
+void countAlloc(size_t n);
+
+/* Host CPU the calling thread has spent in emulated context switches. */
+uint64_t switchCpuNs();
+
+} // namespace hal
@@ -0,0 +1,71 @@
+/*
+ * SafeNeck – I2C replay trace format
+ * ==================================
+ * A trace is the byte stream each sensor made available on the bus,
+ * stamped with the time it became available:
+ *
+ *   file    := "SNTRACE1" record*
+ *   record  := t_us:u64  addr:u8  reserved:u8  len:u16  bytes[len]
+ *
+ * All integers are little-endian.  Records are sorted by `t_us`.
+ *
+ *   • 0x10 (PA1010D) records are raw NMEA text; the replayed module
+ *     appends them to its output FIFO and pads reads with '\n' (0x0A)
+ *     once the FIFO is empty, exactly like the real part.
+ *   • 0x4A (BNO085) records are complete SHTP packets including the
+ *     4-byte header; the replayed sensor hands them out one packet per
+ *     read, emitting continuation headers for partial reads.
+ * -----------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+namespace trace {
+
+static const char     MAGIC[8]  = { 'S','N','T','R','A','C','E','1' };
+static const uint8_t  ADDR_GPS  = 0x10;
+static const uint8_t  ADDR_IMU  = 0x4A;
+
+struct Record {
+    uint64_t             tUs;
+    uint8_t              addr;
+    std::vector<uint8_t> bytes;
+};
+
+inline bool writeHeader(FILE *f) {
+    return fwrite(MAGIC, 1, sizeof(MAGIC), f) == sizeof(MAGIC);
+}
+
+inline bool writeRecord(FILE *f, const Record &r) {
+    uint8_t hdr[12];
+    for (int i = 0; i < 8; i++) hdr[i] = (uint8_t)(r.tUs >> (8 * i));
+    hdr[8]  = r.addr;
+    hdr[9]  = 0;
+    hdr[10] = (uint8_t)(r.bytes.size() & 0xFF);
+    hdr[11] = (uint8_t)(r.bytes.size() >> 8);
+    return fwrite(hdr, 1, sizeof(hdr), f) == sizeof(hdr) &&
+           fwrite(r.bytes.data(), 1, r.bytes.size(), f) == r.bytes.size();
+}
+
+/* Reads a whole trace; returns false on a malformed file. */
+inline bool readAll(FILE *f, std::vector<Record> &out) {
+    char magic[8];
+    if (fread(magic, 1, sizeof(magic), f) != sizeof(magic)) return false;
+    for (int i = 0; i < 8; i++) if (magic[i] != MAGIC[i]) return false;
+
+    uint8_t hdr[12];
+    while (fread(hdr, 1, sizeof(hdr), f) == sizeof(hdr)) {
+        Record r;
+        r.tUs = 0;
+        for (int i = 0; i < 8; i++) r.tUs |= (uint64_t)hdr[i] << (8 * i);
+        r.addr = hdr[8];
+        r.bytes.resize((size_t)hdr[10] | ((size_t)hdr[11] << 8));
+        if (fread(r.bytes.data(), 1, r.bytes.size(), f) != r.bytes.size()) return false;
+        out.push_back(std::move(r));
+    }
+    return true;
+}
+
+} // namespace trace
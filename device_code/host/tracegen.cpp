@@ -0,0 +1,380 @@
+/*
+ * SafeNeck – synthetic I2C trace generator
+ * ========================================
+ * Produces a replay trace (see trace.h) of a wearer alternating between
+ * walking, standing and sitting, with optional falls (free-fall → hard
+ * impact → lying still) and shoves (impact while upright).  The byte
+ * streams are what the PA1010D and BNO085 would put on the bus:
+ *
+ *   0x10  NMEA at --gps-rate Hz, trickling in at the module's 115200 baud
+ *         internal UART rate; GN talker for GGA/RMC like the MT3333.
+ *   0x4A  one SHTP packet per report on channel 3, each led by a 0xFB
+ *         base-timestamp record.  The stability classifier, gravity and
+ *         game rotation vector come at 20 Hz, as the firmware asks.
+ *
+ * The ground truth goes to FILE.labels, one event per line, for
+ * detectsweep:  "fall 200.000 5.44"  (kind, impact time s, peak g).
+ *
+ * Usage:
+ *   tracegen -o walk.trace [--duration 600] [--gps-rate 1] [--imu-rate 100]
+ *            [--falls 2] [--impacts 2] [--ttff 30] [--nmea full|rmcgga]
+ *            [--reports 01,04,06,08,13] [--seed 1]
+ * -----------------------------------------------------------------------*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "trace.h"
+
+namespace {
+
+const double G = 9.80665;
+
+struct Config {
+    const char *out      = nullptr;
+    double   durationS   = 600;
+    double   gpsRateHz   = 1;
+    double   imuRateHz   = 100;
+    int      falls       = 2;
+    int      impacts     = 2;
+    double   ttffS       = 30;
+    bool     nmeaFull    = true;
+    uint32_t seed        = 1;
+    std::vector<uint8_t> reports = { 0x01, 0x04, 0x06, 0x08, 0x13 };
+};
+
+enum Activity { WALK, STAND, SIT };
+
+struct Event {
+    double   t;
+    bool     fall;      /* false = shove/impact while upright */
+    double   peakG;
+};
+
+/* ── Wearer model ─────────────────────────────────────────────────── */
+struct Pose {
+    double  accel[3];       /* specific force incl. gravity, m/s²     */
+    double  tiltRad;        /* 0 = upright, π/2 = lying               */
+    uint8_t stability;      /* BNO085 stability classifier            */
+    bool    moving;         /* for the GPS track                      */
+};
+
+class Wearer {
+public:
+    Wearer(const Config &cfg, std::mt19937 &rng) : rng_(rng) {
+        /* Activity schedule: 20–120 s segments. */
+        std::uniform_real_distribution<double> len(20, 120);
+        std::uniform_int_distribution<int> pick(0, 2);
+        for (double t = 0; t < cfg.durationS; ) {
+            double l = len(rng);
+            segments_.push_back({ t, (Activity)pick(rng) });
+            t += l;
+        }
+        std::uniform_real_distribution<double> peak(3.5, 7.0);
+        for (int i = 0; i < cfg.falls; i++)
+            events_.push_back({ cfg.durationS * (i + 1) / (cfg.falls + 1), true, peak(rng) });
+        for (int i = 0; i < cfg.impacts; i++)
+            events_.push_back({ cfg.durationS * (i + 0.5) / (cfg.impacts + 0.5) + 7.0, false,
+                                peak(rng) * 0.8 });
+        std::sort(events_.begin(), events_.end(),
+                  [](const Event &a, const Event &b) { return a.t < b.t; });
+    }
+
+    const std::vector<Event> &events() const { return events_; }
+
+    Pose at(double t) {
+        std::normal_distribution<double> noise(0.0, 1.0);
+        Pose p{};
+        Activity act = activityAt(t);
+        double n = act == WALK ? 0.03 : act == STAND ? 0.015 : 0.008;
+        p.stability = act == WALK ? 4 : act == STAND ? 3 : 2;
+        p.moving = act == WALK;
+        p.tiltRad = act == SIT ? 0.35 : 0.0;
+
+        double lin[3] = { 0, 0, 0 };
+        if (act == WALK) {
+            lin[1] = 0.25 * G * sin(2 * M_PI * 1.8 * t);
+            lin[2] = 0.10 * G * sin(2 * M_PI * 0.9 * t + 0.7);
+        }
+
+        bool freefall = false;
+        for (const Event &e : events_) {
+            double dt = t - e.t;
+            if (e.fall) {
+                if (dt >= -0.45 && dt < 0.0) { freefall = true; p.stability = 4; }
+                else if (dt >= 0.0 && dt < 0.04) {
+                    lin[2] += e.peakG * G * sin(M_PI * dt / 0.04);
+                    lin[1] -= 0.5 * G * sin(M_PI * dt / 0.04);
+                    p.stability = 4;
+                }
+                if (dt >= 0.0 && dt < 12.0) {
+                    p.tiltRad = std::min(M_PI / 2, dt / 0.04 * M_PI / 2);
+                    if (dt >= 0.04) { lin[0] = lin[1] = lin[2] = 0; n = 0.008; }
+                    p.stability = dt < 0.3 ? 4 : 2;
+                    p.moving = false;
+                }
+            } else if (dt >= 0.0 && dt < 0.03) {
+                lin[0] += e.peakG * G * sin(M_PI * dt / 0.03);
+                p.stability = 4;
+            }
+        }
+
+        double gy = G * cos(p.tiltRad), gz = G * sin(p.tiltRad);
+        double grav[3] = { 0.0, gy, gz };
+        for (int i = 0; i < 3; i++) {
+            p.accel[i] = (freefall ? 0.0 : grav[i]) + lin[i] + n * G * noise(rng_);
+        }
+        return p;
+    }
+
+private:
+    Activity activityAt(double t) const {
+        Activity a = WALK;
+        for (const auto &s : segments_) { if (s.first > t) break; a = s.second; }
+        return a;
+    }
+
+    std::mt19937 &rng_;
+    std::vector<std::pair<double, Activity>> segments_;
+    std::vector<Event> events_;
+};
+
+/* ── SHTP packets ─────────────────────────────────────────────────── */
+class ShtpWriter {
+public:
+    trace::Record report(uint64_t tUs, uint8_t id, const int16_t *v, int nv, uint8_t extra) {
+        std::vector<uint8_t> r = { id, reportSeq_[id]++, 0x03, 0x00 };
+        for (int i = 0; i < nv; i++) {
+            r.push_back((uint8_t)(v[i] & 0xFF));
+            r.push_back((uint8_t)((uint16_t)v[i] >> 8));
+        }
+        if (id == 0x13) { r.push_back(extra); r.push_back(0); }
+
+        uint16_t len = (uint16_t)(4 + 5 + r.size());
+        trace::Record rec;
+        rec.tUs  = tUs;
+        rec.addr = trace::ADDR_IMU;
+        rec.bytes = { (uint8_t)(len & 0xFF), (uint8_t)(len >> 8), 3, channelSeq_++,
+                      0xFB, 0, 0, 0, 0 };
+        rec.bytes.insert(rec.bytes.end(), r.begin(), r.end());
+        return rec;
+    }
+
+private:
+    uint8_t channelSeq_ = 0;
+    uint8_t reportSeq_[256] = {};
+};
+
+int16_t q(double v, int qpoint) {
+    double s = v * (1 << qpoint);
+    if (s > 32767) s = 32767;
+    if (s < -32768) s = -32768;
+    return (int16_t)lrint(s);
+}
+
+/* ── NMEA ─────────────────────────────────────────────────────────── */
+std::string nmea(const std::string &body) {
+    uint8_t cs = 0;
+    for (char c : body) cs ^= (uint8_t)c;
+    char tail[8];
+    snprintf(tail, sizeof(tail), "*%02X\r\n", cs);
+    return "$" + body + tail;
+}
+
+std::string ddmm(double deg, bool lon) {
+    double a = fabs(deg);
+    int d = (int)a;
+    double m = (a - d) * 60.0;
+    char buf[32];
+    snprintf(buf, sizeof(buf), lon ? "%03d%07.4f" : "%02d%07.4f", d, m);
+    return buf;
+}
+
+void usage() {
+    fprintf(stderr,
+        "usage: tracegen -o FILE [--duration S] [--gps-rate HZ] [--imu-rate HZ]\n"
+        "                [--falls N] [--impacts N] [--ttff S] [--nmea full|rmcgga]\n"
+        "                [--reports 01,04,06,08,13] [--seed N]\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Config cfg;
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!v) { usage(); return 2; }
+        if      (!strcmp(a, "-o"))          cfg.out = v;
+        else if (!strcmp(a, "--duration")) cfg.durationS = atof(v);
+        else if (!strcmp(a, "--gps-rate")) cfg.gpsRateHz = atof(v);
+        else if (!strcmp(a, "--imu-rate")) cfg.imuRateHz = atof(v);
+        else if (!strcmp(a, "--falls"))    cfg.falls = atoi(v);
+        else if (!strcmp(a, "--impacts"))  cfg.impacts = atoi(v);
+        else if (!strcmp(a, "--ttff"))     cfg.ttffS = atof(v);
+        else if (!strcmp(a, "--nmea"))     cfg.nmeaFull = strcmp(v, "rmcgga") != 0;
+        else if (!strcmp(a, "--seed"))     cfg.seed = (uint32_t)atoi(v);
+        else if (!strcmp(a, "--reports")) {
+            cfg.reports.clear();
+            for (const char *p = v; *p; ) {
+                cfg.reports.push_back((uint8_t)strtoul(p, (char **)&p, 16));
+                if (*p == ',') p++;
+            }
+        } else { usage(); return 2; }
+        i++;
+    }
+    if (!cfg.out || cfg.gpsRateHz <= 0 || cfg.imuRateHz <= 0) { usage(); return 2; }
+
+    std::mt19937 rng(cfg.seed);
+    Wearer wearer(cfg, rng);
+    std::vector<trace::Record> records;
+
+    /* IMU: one packet per enabled report per sample; classifier and
+     * orientation at ≤20 Hz. */
+    ShtpWriter shtp;
+    double gravEst[3] = { 0, G, 0 };
+    const double dt = 1.0 / cfg.imuRateHz;
+    const int slowDiv = std::max(1, (int)lrint(cfg.imuRateHz / 20.0));
+    int sample = 0;
+    for (double t = 0.05; t < cfg.durationS; t += dt, sample++) {
+        Pose p = wearer.at(t);
+        /* Fusion gravity estimate: slow low-pass of the specific force. */
+        double alpha = dt / 0.5;
+        double norm = 0;
+        for (int i = 0; i < 3; i++) {
+            gravEst[i] += alpha * (p.accel[i] - gravEst[i]);
+            norm += gravEst[i] * gravEst[i];
+        }
+        norm = sqrt(norm);
+        double grav[3], lin[3];
+        for (int i = 0; i < 3; i++) {
+            grav[i] = norm > 0.1 ? gravEst[i] * G / norm : 0;
+            lin[i]  = p.accel[i] - grav[i];
+        }
+
+        uint64_t tUs = (uint64_t)llround(t * 1e6);
+        for (uint8_t id : cfg.reports) {
+            int16_t v[4] = { 0, 0, 0, 0 };
+            int nv = 3;
+            switch (id) {
+            case 0x01: for (int i = 0; i < 3; i++) v[i] = q(p.accel[i], 8); break;
+            case 0x04: for (int i = 0; i < 3; i++) v[i] = q(lin[i], 8);     break;
+            case 0x06:
+                if (sample % slowDiv) continue;
+                for (int i = 0; i < 3; i++) v[i] = q(grav[i], 8);
+                break;
+            case 0x08: {
+                /* Rotation about x whose up vector matches the gravity
+                 * direction above: (0, cos tilt, sin tilt). */
+                if (sample % slowDiv) continue;
+                double a = M_PI / 2 - p.tiltRad;
+                v[0] = q(sin(a / 2), 14);
+                v[3] = q(cos(a / 2), 14);
+                nv = 4;
+                break;
+            }
+            case 0x13:
+                if (sample % slowDiv) continue;
+                nv = 0;
+                break;
+            default:
+                continue;
+            }
+            records.push_back(shtp.report(tUs, id, v, nv, p.stability));
+        }
+    }
+
+    /* GPS: one burst per epoch, bytes arriving at 115200 baud. */
+    double lat = 37.774900, lon = -122.419400;
+    const double gpsDt = 1.0 / cfg.gpsRateHz;
+    int epoch = 0;
+    for (double t = 0.5; t < cfg.durationS; t += gpsDt, epoch++) {
+        Pose p = wearer.at(t);
+        bool fix = t >= cfg.ttffS;
+        double spdKn = p.moving ? 2.7 : 0.0;
+        if (p.moving) {
+            lat += 1.4 * gpsDt / 111320.0;
+            lon += 0.3 * gpsDt / (111320.0 * cos(lat * M_PI / 180.0));
+        }
+
+        long secs = (long)t;
+        char hms[16], dmy[8];
+        snprintf(hms, sizeof(hms), "%02ld%02ld%02ld.%03d",
+                 (10 + secs / 3600) % 24, (secs / 60) % 60, secs % 60,
+                 (int)lrint((t - secs) * 1000) % 1000);
+        snprintf(dmy, sizeof(dmy), "171026");
+
+        std::vector<std::string> out;
+        char body[160];
+        if (fix) {
+            snprintf(body, sizeof(body), "GNGGA,%s,%s,N,%s,W,1,08,1.05,16.4,M,-25.6,M,,",
+                     hms, ddmm(lat, false).c_str(), ddmm(lon, true).c_str());
+        } else {
+            snprintf(body, sizeof(body), "GNGGA,%s,,,,,0,00,,,M,,M,,", hms);
+        }
+        out.push_back(nmea(body));
+        if (cfg.nmeaFull) out.push_back(nmea(fix ? "GPGSA,A,3,10,12,15,18,24,25,29,32,,,,,1.38,1.05,0.90"
+                                                 : "GPGSA,A,1,,,,,,,,,,,,,,,"));
+        if (cfg.nmeaFull && epoch % (int)std::max(1.0, cfg.gpsRateHz) == 0) {
+            out.push_back(nmea("GPGSV,3,1,11,10,63,137,17,12,29,310,28,15,10,049,22,18,48,063,27"));
+            out.push_back(nmea("GPGSV,3,2,11,24,47,243,33,25,41,300,39,29,20,165,21,32,73,322,20"));
+            out.push_back(nmea("GPGSV,3,3,11,13,05,213,,19,02,134,,23,08,272,"));
+        }
+        if (fix) {
+            snprintf(body, sizeof(body), "GNRMC,%s,A,%s,N,%s,W,%.2f,61.55,%s,,,A",
+                     hms, ddmm(lat, false).c_str(), ddmm(lon, true).c_str(), spdKn, dmy);
+        } else {
+            snprintf(body, sizeof(body), "GNRMC,%s,V,,,,,0.00,0.00,%s,,,N", hms, dmy);
+        }
+        out.push_back(nmea(body));
+        if (cfg.nmeaFull) {
+            snprintf(body, sizeof(body), "GNVTG,61.55,T,,M,%.2f,N,%.2f,K,%c",
+                     spdKn, spdKn * 1.852, fix ? 'A' : 'N');
+            out.push_back(nmea(body));
+        }
+
+        /* Split into 16-byte slices stamped with their UART arrival time. */
+        double byteT = t;
+        for (const std::string &s : out) {
+            for (size_t off = 0; off < s.size(); off += 16) {
+                size_t n = std::min<size_t>(16, s.size() - off);
+                byteT += n / 11520.0;
+                trace::Record r;
+                r.tUs  = (uint64_t)llround(byteT * 1e6);
+                r.addr = trace::ADDR_GPS;
+                r.bytes.assign(s.begin() + off, s.begin() + off + n);
+                records.push_back(std::move(r));
+            }
+        }
+    }
+
+    std::stable_sort(records.begin(), records.end(),
+                     [](const trace::Record &a, const trace::Record &b) { return a.tUs < b.tUs; });
+
+    FILE *f = fopen(cfg.out, "wb");
+    if (!f) { perror(cfg.out); return 1; }
+    bool ok = trace::writeHeader(f);
+    for (const trace::Record &r : records) ok = ok && trace::writeRecord(f, r);
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) { fprintf(stderr, "tracegen: write failed\n"); return 1; }
+
+    std::string labels = std::string(cfg.out) + ".labels";
+    f = fopen(labels.c_str(), "w");
+    if (!f) { perror(labels.c_str()); return 1; }
+    for (const Event &e : wearer.events())
+        fprintf(f, "%s %.3f %.2f\n", e.fall ? "fall" : "impact", e.t, e.peakG);
+    if (fclose(f) != 0) { fprintf(stderr, "tracegen: write failed\n"); return 1; }
+
+    fprintf(stderr, "tracegen: %zu records, %.0f s", records.size(), cfg.durationS);
+    for (const Event &e : wearer.events())
+        fprintf(stderr, "%s %s@%.1fs(%.1fg)", &e == &wearer.events()[0] ? "," : "",
+                e.fall ? "fall" : "impact", e.t, e.peakG);
+    fprintf(stderr, "\n");
+    return 0;
+}
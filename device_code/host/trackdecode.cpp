@@ -0,0 +1,57 @@
+/*
+ * SafeNeck – expand safeneck/track batches into points
+ * ====================================================
+ * Reads one event per line: either the bare base64 data, or a
+ * `replay_* --publish` line, from which the data after "safeneck/track"
+ * is taken (other events are skipped).  Prints one CSV row per fix:
+ *
+ *   batch,unix_time,lat,lon,battery,sats,hdop
+ *
+ * Usage:
+ *   build/replay_main --trace walk.trace --publish | trackdecode
+ *   trackdecode < webhook-payloads.txt
+ * -----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+
+#include "common/nmea_fix.h"
+#include "common/track_batch.h"
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        fprintf(stderr, "usage: trackdecode < events\n");
+        return 2;
+    }
+
+    char line[2048];
+    int batches = 0, points = 0, bad = 0;
+    size_t chars = 0;
+    printf("batch,unix_time,lat,lon,battery,sats,hdop\n");
+    while (fgets(line, sizeof(line), stdin)) {
+        char *data = line;
+        if (strchr(line, ' ')) {
+            char *ev = strstr(line, "safeneck/track ");
+            if (!ev) continue;
+            data = ev + strlen("safeneck/track ");
+        }
+        size_t len = strcspn(data, " \r\n");
+        if (!len) continue;
+
+        TrackHeader hdr;
+        int batch = batches;
+        int n = decodeTrack(data, len, hdr, [&](const TrackPoint &p) {
+            char lat[16], lon[16];
+            formatE7(lat, sizeof(lat), p.latE7);
+            formatE7(lon, sizeof(lon), p.lonE7);
+            printf("%d,%lu,%s,%s,%u,%u,%u.%02u\n", batch, (unsigned long)p.unixTime,
+                   lat, lon, hdr.batteryPct, hdr.sats, hdr.hdopX100 / 100, hdr.hdopX100 % 100);
+        });
+        if (n < 0) { bad++; continue; }
+        batches++;
+        points += n;
+        chars += len;
+    }
+    fprintf(stderr, "%d batches, %d points, %.1f chars/point, %d undecodable\n",
+            batches, points, points ? (double)chars / points : 0.0, bad);
+    return bad ? 1 : 0;
+}
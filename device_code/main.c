@@ -7,20 +7,28 @@
  *   • Adafruit Mini GPS PA1010D   (I2C – STEMMA QT / Qwiic)
  *
  * Behaviour:
- *   1. Reads GPS coordinates every PUBLISH_INTERVAL seconds and publishes
- *      them to the Particle Cloud event "safeneck/location".
+ *   1. Records one GPS fix per second and publishes them every
+ *      PUBLISH_INTERVAL seconds as one delta-encoded "safeneck/track"
+ *      batch (or a single "safeneck/location" record while there is no
+ *      fix, or with LOCATION_BATCHING off).
  *   2. Continuously monitors the BNO085 accelerometer for sudden
  *      free-fall → impact patterns. When a fall is detected it
  *      immediately publishes a "safeneck/fall" event.
  *   3. Reports battery level alongside every location publish.
- *   4. A Particle Cloud webhook forwards every event to the Firebase
+ *   4. host/firebaserelay decodes the events into the Firebase
  *      Realtime Database for the companion Flutter app to consume.
+ *   5. Events raised while offline are kept in a flash journal and
+ *      replayed, alerts first, once the cloud is back.
+ *   6. Comes back from a reset within seconds: sensors are polled until
+ *      they answer, the GPS is aided with the time and last fix, and an
+ *      open fall alert is picked up again (retained RAM, then flash).
  *
  * Wiring (all via STEMMA QT / Qwiic I2C daisy-chain):
  *   Boron SDA  → BNO085 SDA  → GPS SDA
  *   Boron SCL  → BNO085 SCL  → GPS SCL
  *   Boron 3V3  → BNO085 VIN  → GPS VIN
  *   Boron GND  → BNO085 GND  → GPS GND
+ *   Boron D3   ← BNO085 INT               (stop-mode wake, LOW_POWER_MODE)
  *
  * Build with Particle Device OS (compile as C++ – Particle toolchain).
  * Rename to main.ino or main.cpp for the Particle CLI if needed.
@@ -29,6 +37,24 @@
 #include "Particle.h"
 #include <Wire.h>
 #include <math.h>
+#include "common/nmea_fix.h"
+#include "common/gps_i2c.h"
+#include "common/gps_power.h"
+#include "common/alert_coalescer.h"
+#include "common/spsc_ring.h"
+#include "common/publish_queue.h"
+#include "common/track_batch.h"
+#include "common/event_codec.h"
+#include "common/accel_q.h"
+#include "common/accel_batch.h"
+#include "common/shtp.h"
+#include "common/fall_detector.h"
+#include "common/imu_rate.h"
+#include "common/stage_timer.h"
+#include "common/binlog.h"
+#include "common/flash_journal.h"
+#include "common/boot_state.h"
+#include <atomic>
 
 /* ── Feature flags ─────────────────────────────────────────────────── */
 SYSTEM_MODE(AUTOMATIC);            /* auto-connect cellular             */
@@ -36,307 +62,958 @@ SYSTEM_THREAD(ENABLED);            /* non-blocking system thread        */
 
 /* ── Configuration ─────────────────────────────────────────────────── */
 #define PUBLISH_INTERVAL_SEC   30  /* seconds between location publishes */
-#define FALL_COOLDOWN_SEC      60  /* ignore repeat fall alerts          */
+#define ALERT_WINDOW_SEC       60  /* falls this close fold into one alert */
+#define ALERT_BAND_G           2.0 /* a peak this much higher re-sends it */
 #define GPS_I2C_ADDR           0x10  /* PA1010D default I2C address      */
 #define BNO085_I2C_ADDR        0x4A  /* BNO085 default I2C address       */
-#define FALL_ACCEL_THRESHOLD   2.5   /* g – spike that counts as impact  */
-#define FREEFALL_THRESHOLD     0.4   /* g – below this is free-fall      */
-#define GPS_READ_BUFFER        255
+#define ACCEL_Q_POINT          8     /* BNO085 accelerometer Q-format    */
+#define GPS_DRAIN_BUDGET_US    2000  /* µs of bus time per GPS poll      */
+#define IMU_BATCH_MS           100   /* BNO085 on-chip batch interval    */
+#define IMU_POLL_PERIOD_MS     50    /* IMU thread cadence (½ batch)     */
+#define IMU_DRAIN_PACKETS      8     /* packets read per wake, at most   */
+#define IMU_RING_SAMPLES       512   /* ~10 s of 50 Hz, 2.5 s of 200 Hz  */
+#define IMU_BATCH_SAMPLES      32    /* one packet's reports, per kernel pass */
+#define OUTBOX_SLOTS           8     /* queued cloud events (~5.5 KB)    */
+#define PUBLISH_DATA_MAX       622   /* Particle event data limit (Gen3) */
+#define LOCATION_BATCHING      1     /* 1 Hz fixes → one batch/interval  */
+#define SHADOW_DETECTOR        1     /* run ShadowProfile alongside, log only */
+#define LOOP_PERIOD_MS         20    /* ~50 Hz loop: the pass deadline    */
+#define LOG_RING_WORDS         512   /* deferred log (binlog.h), 2 KB     */
+#define LOG_DRAIN_RECORDS      16    /* formatted per idle pass, at most  */
+#define LOG_RAW_FRAMES         0     /* 1: "@base64" lines for host/logdecode */
+
+/* Motion-adaptive accelerometer rate (imu_rate.h): slow while |a| sits
+ * at 1 g, back to 50 Hz when moving, 200 Hz from the first sample of a
+ * dip or spike until IMU_BURST_HOLD_MS after it.                      */
+#define IMU_ADAPTIVE_RATE      1
+#define IMU_REST_US            50000 /* 20 Hz: stationary                */
+#define IMU_ACTIVE_US          20000 /* 50 Hz: moving                    */
+#define IMU_BURST_US           5000  /* 200 Hz: dip or spike             */
+#define IMU_REST_AFTER_MS      5000  /* no motion this long = rest       */
+#define IMU_BURST_HOLD_MS      1000  /* the whole freefall → impact      */
+#define IMU_MOVING_G           0.15  /* | |a| − 1 g | above this = moving */
+#define IMU_TRANSIENT_LO_G     0.6   /* |a| below / above these = burst  */
+#define IMU_TRANSIENT_HI_G     1.8
+
+/* Stop mode at rest: the BNO085 batches a second of 20 Hz samples in
+ * its FIFO and the Boron sleeps until INT.  A linear-acceleration
+ * report with change sensitivity and no batching is the high-g wake:
+ * any jump bigger than HIGH_G_WAKE_G flushes the FIFO at once.       */
+#define LOW_POWER_MODE         1
+#define BNO085_INT_PIN         D3    /* BNO085 INT, active low           */
+#define IMU_REST_BATCH_MS      1000  /* FIFO batch while stopped         */
+#define STOP_MAX_MS            2000  /* timer wake if INT never comes    */
+#define HIGH_G_WAKE_G          0.5   /* per-axis change that wakes       */
+
+/* GPS duty cycling (gps_power.h): after GPS_PERIODIC_AFTER_MS at the
+ * IMU rest rate with a good fix, the PA1010D only runs GPS_RUN_MS of
+ * every publish interval; after GPS_STANDBY_AFTER_MS it stops fixing
+ * until the wearer moves.  Motion or a fall alert resumes 1 Hz at once,
+ * and after an alert it stays there for GPS_ALERT_HOLD_MS.            */
+#define GPS_DUTY_CYCLE         1
+#define GPS_PERIODIC_AFTER_MS  60000
+#define GPS_STANDBY_AFTER_MS   600000
+#define GPS_RUN_MS             3000  /* hot fix + a few epochs           */
+#define GPS_SLEEP_MS           27000 /* run + sleep = PUBLISH_INTERVAL_SEC */
+#define GPS_ALERT_HOLD_MS      600000
+#define GPS_GOOD_HDOP_X100     250   /* fix good enough to stop tracking */
+#define GPS_GOOD_SATS          5
+
+/* Stage timing (stage_timer.h): cycle-counter histograms and budget
+ * misses per stage, readable any time as the "diag" cloud variable
+ * (refreshed every publish interval) and sent as "safeneck/diag"
+ * every DIAG_INTERVAL_SEC.                                           */
+#define DIAG_INTERVAL_SEC      300
+#define GPS_STAGE_BUDGET_US    (GPS_DRAIN_BUDGET_US + 1000)  /* + lock, power */
+#define TRACK_STAGE_BUDGET_US  500
+#define FALL_STAGE_BUDGET_US   5000  /* whole ring, after a stall too    */
+#define PUBLISH_STAGE_BUDGET_US 5000
+#define IMU_STAGE_BUDGET_US    10000 /* IMU_DRAIN_PACKETS at 400 kHz     */
+
+/* Store and forward (flash_journal.h): events raised while the cloud
+ * is unreachable, or with the outbox full, are appended to a journal
+ * in flash instead and replayed after reconnecting – alerts first,
+ * newest first, at most JOURNAL_REPLAY_BATCH in the outbox at a time
+ * so its 1 event/s pacing applies and live alerts still find a slot. */
+#define JOURNAL_DIR            "/safeneck/journal"
+#define JOURNAL_SEGMENTS       16    /* 64 KB: ~3 h of tracks offline    */
+#define JOURNAL_SEG_BYTES      4096  /* one flash sector                 */
+#define JOURNAL_REPLAY_BATCH   4
+
+/* Fast cold start (boot_state.h): the last fix, UTC and the open alert
+ * live in retained RAM and are mirrored to flash every BOOT_SAVE_SEC
+ * and at each alert.  setup() polls each sensor until it ACKs instead
+ * of sleeping, and the GPS gets the time and the last fix (PMTK740 /
+ * PMTK741) so it does not start its search from nothing.             */
+#define BOOT_DIR               "/safeneck/boot"
+#define BOOT_SAVE_SEC          300
+#define SENSOR_READY_TIMEOUT_MS 2000 /* give up on a sensor after this   */
+#define SENSOR_POLL_MS         5     /* address probe cadence at boot    */
+#define GPS_AID_MAX_AGE_SEC    14400 /* an older last fix is not sent    */
+
+/* Fall detection profiles (fall_detector.h).  The live one decides
+ * alerts; the shadow one sees the same samples and is only counted and
+ * logged, so a candidate profile can be trialled on real wearers.      */
+typedef FreefallImpactProfile FallProfile;    /* < 0.4 g, then > 2.5 g  */
+struct ShadowProfile : FreefallImpactProfile {
+    static constexpr double IMPACT_G = 2.2;   /* lighter falls          */
+};
+static_assert(FallProfile::Q_POINT == ACCEL_Q_POINT, "profile units must match the accelerometer report");
 
 /* ── Global state ──────────────────────────────────────────────────── */
 unsigned long lastPublishMs    = 0;
-unsigned long lastFallAlertMs  = 0;
 
-double gpsLat   = 0.0;
-double gpsLon   = 0.0;
-float  gpsSpeed = 0.0;
-bool   gpsFix   = false;
-
-float  accelX = 0.0, accelY = 0.0, accelZ = 0.0;
-float  accelMagnitude = 1.0;
+NmeaFixParser gps;                 /* RMC/GGA → fixed-point GpsFix      */
+GpsI2cDrain   gpsDrain(GPS_I2C_ADDR, GPS_DRAIN_BUDGET_US);
+GpsPowerManager gpsPower(GPS_PERIODIC_AFTER_MS, GPS_STANDBY_AFTER_MS,
+                         GPS_RUN_MS, GPS_SLEEP_MS, GPS_ALERT_HOLD_MS);
+uint32_t gpsFixesLogged = 0;
+
+/* One accelerometer report, stamped when the IMU thread read it. */
+struct AccelSample {
+    uint32_t ms;
+    int16_t  x, y, z;              /* raw, Q8 m/s²                      */
+    uint32_t magSq;                /* x² + y² + z², from the batch pass */
+};
+SpscRing<AccelSample, IMU_RING_SAMPLES> imuRing;   /* IMU thread → loop */
+Thread  *imuThread = nullptr;
+uint32_t imuDropsReported = 0;
+ShtpReader bno(BNO085_I2C_ADDR);   /* IMU thread only                  */
+std::atomic<uint32_t> imuReportGaps{0};
+uint32_t imuGapsReported = 0;
+ImuRateGovernor imuRate(IMU_REST_US, IMU_ACTIVE_US, IMU_BURST_US,   /* IMU thread */
+                        IMU_REST_AFTER_MS, IMU_BURST_HOLD_MS);
+ImuRateShared imuRateShared;       /* imuRate as loop() may read it    */
+uint32_t imuRateSwitchesLogged = 0;
+std::atomic<uint32_t> imuHighGWakes{0};
+
+/* Where the time goes: loop() work and threads, delay() between passes,
+ * and stop mode.  run = total − idle − stop.                          */
+struct PowerTime {
+    uint32_t startMs  = 0;
+    uint32_t idleMs   = 0;
+    uint32_t stopMs   = 0;
+    uint32_t stops    = 0;
+    uint32_t intWakes = 0;         /* INT: batch due or high-g report  */
+} power;
+
+float  fallImpactG    = 0.0;       /* g of the impact that confirmed it */
 
 bool   fallDetected    = false;
-bool   inFreeFall      = false;
-unsigned long freeFallStart = 0;
-
-char   publishBuf[256];
+bool   fallAlertDue    = false;    /* the coalesced alert needs sending */
+AlertCoalescer fallAlerts(ALERT_WINDOW_SEC * 1000UL, (uint16_t)(ALERT_BAND_G * 1000));
+FallDetector<FallProfile>   fallDetector;
+FallDetector<ShadowProfile> shadowDetector;
+
+char   publishBuf[PUBLISH_DATA_MAX + 1];
+PublishQueue<OUTBOX_SLOTS, PUBLISH_DATA_MAX> outbox;          /* → cloud */
+
+FlashJournal<JOURNAL_SEGMENTS, JOURNAL_SEG_BYTES, PUBLISH_DATA_MAX> journal(JOURNAL_DIR);
+decltype(journal)::Record journalRecord;   /* journal → outbox       */
+uint32_t journalReplayMs = 0;              /* current replay: start, */
+uint32_t journalReplayFrom = 0;            /* replayed count then,   */
+uint32_t journalReplayDrops = 0;           /* outbox drops then      */
+char     journalText[152];                 /* "journal" variable: nine 10-digit counts */
+
+retained BootRecord bootRetained;          /* kept across a reset    */
+BootState boot(bootRetained, BOOT_DIR);
+uint32_t bootSavedMs   = 0;                /* last flash mirror      */
+uint32_t gpsFirstFixMs = 0;                /* since power-on         */
+bool     gpsAidPending = true;             /* PMTK740/741 not sent   */
+
+TrackBatch<PUBLISH_DATA_MAX> track;    /* fixes since the last publish */
+uint32_t lastTrackTime = 0;
+
+/* Loop stages and the IMU thread's read, each timed on its own thread. */
+enum Stage : uint8_t {
+    STAGE_GPS, STAGE_TRACK, STAGE_FALL, STAGE_PUBLISH, STAGE_LOOP, STAGE_IMU, STAGE_COUNT
+};
+typedef StageTimer<STAGE_COUNT> LoopTiming;
+LoopTiming timing({
+    { "gps",     GPS_STAGE_BUDGET_US },
+    { "track",   TRACK_STAGE_BUDGET_US },
+    { "fall",    FALL_STAGE_BUDGET_US },
+    { "publish", PUBLISH_STAGE_BUDGET_US },
+    { "loop",    LOOP_PERIOD_MS * 1000UL },    /* a pass's work, sleep excluded */
+    { "imu",     IMU_STAGE_BUDGET_US },
+});
+char     diagText[PUBLISH_DATA_MAX + 1];   /* "diag" cloud variable    */
+uint32_t lastDiagMs = 0;
+
+/* Detection and alert messages: ID + raw arguments now, text in idle
+ * time (binlog.h, formats in common/log_catalog.h).  loop() only.    */
+BinLog<LOG_RING_WORDS> binlog;
 
 /* ── Forward declarations ──────────────────────────────────────────── */
 void  readGPS();
-void  parseNMEA(const char *sentence);
-double nmeaToDecimal(const char *raw, char hemisphere);
+void  recordTrack();
+void  manageGpsPower();
+void  sendGpsPower(const char *cmd);
+void  logGpsPower();
 void  readBNO085();
-void  checkFall();
+void  enableAccelReport(uint32_t intervalUs);
+void  enableHighGWake();
+void  logImuRate();
+bool  readyToStop();
+void  stopUntilImu();
+void  logPower();
+void  imuSampler();
+void  checkFall(const AccelSample &s);
 void  publishLocation();
+void  publishTrack();
+void  logOutbox();
+bool  queueEvent(const char *name, const char *data, uint8_t prio);
+void  replayJournal();
+void  logJournal();
 void  publishFallAlert();
-float getBatteryLevel();
+void  publishDiagnostics(bool send);
+int32_t waitForDevice(uint8_t addr);
+void  aidGps();
+void  resumeAlert();
+void  rememberAlert(bool toFlash);
+void  keepBootState(bool toFlash);
+uint8_t getBatteryPct();
 
 /* ─────────────────────────────────────────────────────────────────────
  *  SETUP
  * ───────────────────────────────────────────────────────────────────── */
 void setup() {
     Serial.begin(115200);
+    Wire.setSpeed(CLOCK_SPEED_400KHZ);  /* BNO085 and PA1010D both do 400 kHz */
     Wire.begin();
-    delay(1000);
+
+    /* What the last run left in retained RAM, or else in flash. */
+    static const char *const sources[] = { "none", "retained RAM", "flash" };
+    BootState::Source src = boot.begin();
+    Serial.printlnf("[SafeNeck] Boot %lu – saved state from %s",
+                    (unsigned long)boot.record().boots, sources[src]);
 
     /* ── Initialise BNO085 ──────────────────────────────────────────
      *  The BNO085 needs a "set feature command" to enable the
-     *  accelerometer report.  A minimal soft-reset + enable sequence
-     *  is sent over I2C.  For a production build swap this out for
-     *  Adafruit's BNO08x library; here we use raw I2C for clarity.
+     *  accelerometer report.  It NACKs its address until it has
+     *  booted and takes commands as soon as it ACKs; its start-up
+     *  advertisement is drained by the IMU thread like any packet.
+     *  For a production build swap this out for Adafruit's BNO08x
+     *  library; here we use raw I2C for clarity.
      * ────────────────────────────────────────────────────────────── */
+    int32_t imuWaitMs = waitForDevice(BNO085_I2C_ADDR);
     Wire.beginTransmission(BNO085_I2C_ADDR);
     Wire.write(0x01);            /* product-id request (wake sensor)   */
     Wire.endTransmission();
-    delay(300);
 
-    /* Enable accelerometer report at 50 Hz (20 ms interval).
-     * SHTP "Set Feature Command" for report 0x01 (accelerometer).    */
-    uint8_t enableAccel[] = {
-        0x15, 0x00,              /* length (LSB, MSB)                  */
-        0x02,                    /* channel: control                   */
-        0x00,                    /* sequence                           */
-        0xFD,                    /* Set Feature Command                */
-        0x01,                    /* report id: accelerometer           */
-        0x00, 0x00,              /* feature flags                      */
-        0x00, 0x00,              /* change sensitivity                 */
-        0x20, 0x4E, 0x00, 0x00  /* report interval 20 000 µs (50 Hz) */
-    };
-    Wire.beginTransmission(BNO085_I2C_ADDR);
-    Wire.write(enableAccel, sizeof(enableAccel));
-    Wire.endTransmission();
-    delay(100);
+    /* Enable accelerometer report at 50 Hz (20 ms interval), batched
+     * on-chip for up to IMU_BATCH_MS so one packet carries several.   */
+    enableAccelReport(IMU_ACTIVE_US);
+    if (LOW_POWER_MODE) {
+        pinMode(BNO085_INT_PIN, INPUT_PULLUP);
+        enableHighGWake();
+    }
+
+    /* ── Start IMU sampling ─────────────────────────────────────────
+     *  Fall detection comes first, the GPS can wait.  From here on the
+     *  bus is shared: every Wire transaction must hold WITH_LOCK(Wire).
+     *  The thread outranks loop() so a publish blocked on its ACK
+     *  cannot starve it.  An alert still open before the reset is
+     *  picked up again.
+     * ────────────────────────────────────────────────────────────── */
+    imuThread = new Thread("imu", imuSampler, OS_THREAD_PRIORITY_DEFAULT + 1);
+    resumeAlert();
 
     /* ── Initialise GPS (PA1010D) ──────────────────────────────────
      *  Send PMTK command to set update rate to 1 Hz and enable
-     *  only GGA + RMC sentences to reduce I2C traffic.
+     *  only GGA + RMC sentences to reduce I2C traffic, then the time
+     *  and last fix as aiding.
      * ────────────────────────────────────────────────────────────── */
-    const char *pmtkRMCGGA = "$PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*28\r\n";
-    Wire.beginTransmission(GPS_I2C_ADDR);
-    Wire.write((const uint8_t *)pmtkRMCGGA, strlen(pmtkRMCGGA));
-    Wire.endTransmission();
-    delay(100);
+    int32_t gpsWaitMs = waitForDevice(GPS_I2C_ADDR);
+    WITH_LOCK(Wire) {
+        gpsDrain.command("PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0");
+        gpsDrain.command("PMTK220,1000");
+        aidGps();
+    }
+    Serial.printlnf("[SafeNeck] Sensors ready – BNO085 %ld ms, PA1010D %ld ms (-1: not found)",
+                    (long)imuWaitMs, (long)gpsWaitMs);
 
-    const char *pmtk1Hz = "$PMTK220,1000*1F\r\n";
-    Wire.beginTransmission(GPS_I2C_ADDR);
-    Wire.write((const uint8_t *)pmtk1Hz, strlen(pmtk1Hz));
-    Wire.endTransmission();
-    delay(100);
+    /* Cloud events leave through the outbox's own sender thread. */
+    outbox.begin();
+    Particle.variable("diag", diagText);
+
+    /* Events journalled before the reboot go out once connected. */
+    if (journal.begin()) {
+        Serial.printlnf("[SafeNeck] Journal: %lu events to replay",
+                        (unsigned long)journal.backlog());
+    } else {
+        Serial.println("[SafeNeck] Flash journal unavailable – offline events are dropped");
+    }
+    Particle.variable("journal", journalText);
 
-    Serial.println("[SafeNeck] Setup complete – sensors initialised.");
+    Serial.printlnf("[SafeNeck] Setup complete – sensors initialised in %lu ms.",
+                    (unsigned long)millis());
+    binlog.log(LOG_BOOT, LOG_CATALOG_HASH, LOG_ID_COUNT);
+    power.startMs = millis();
 }
 
 /* ─────────────────────────────────────────────────────────────────────
  *  LOOP  –  runs continuously
  * ───────────────────────────────────────────────────────────────────── */
 void loop() {
-    /* 1.  Read sensors ------------------------------------------------ */
-    readGPS();
-    readBNO085();
+    uint32_t passStart = System.ticks();
+
+    /* 1.  Read GPS (the IMU thread samples the BNO085 on its own) --- */
+    {
+        LoopTiming::Scope t(timing, STAGE_GPS);   /* includes the lock wait */
+        WITH_LOCK(Wire) {
+            readGPS();
+            if (GPS_DUTY_CYCLE) manageGpsPower();
+            if (gpsAidPending) aidGps();        /* waiting on the RTC */
+        }
+    }
+    {
+        LoopTiming::Scope t(timing, STAGE_TRACK);
+        recordTrack();
+    }
 
-    /* 2.  Fall detection ---------------------------------------------- */
-    checkFall();
+    /* 2.  Fall detection over every sample queued since last pass ----- */
+    {
+        LoopTiming::Scope t(timing, STAGE_FALL);
+        AccelSample sample;
+        while (imuRing.pop(sample)) {
+            checkFall(sample);
+        }
+    }
+    if (imuRing.dropped() != imuDropsReported) {
+        imuDropsReported = imuRing.dropped();
+        binlog.log(LOG_IMU_DROPS, imuDropsReported);
+    }
+    if (IMU_ADAPTIVE_RATE) logImuRate();
+    if (imuReportGaps.load() != imuGapsReported) {
+        imuGapsReported = imuReportGaps.load();
+        binlog.log(LOG_IMU_GAPS, imuGapsReported);
+    }
     if (fallDetected) {
-        unsigned long now = millis();
-        if ((now - lastFallAlertMs) > (FALL_COOLDOWN_SEC * 1000UL)) {
-            publishFallAlert();
-            lastFallAlertMs = now;
+        if (GPS_DUTY_CYCLE) {
+            WITH_LOCK(Wire) {
+                sendGpsPower(gpsPower.alert(millis()));
+            }
         }
         fallDetected = false;
     }
 
-    /* 3.  Periodic location publish ----------------------------------- */
-    unsigned long now = millis();
-    if ((now - lastPublishMs) > (PUBLISH_INTERVAL_SEC * 1000UL)) {
-        publishLocation();
-        lastPublishMs = now;
+    /* 3.  Alerts and the periodic location publish -------------------- */
+    {
+        LoopTiming::Scope t(timing, STAGE_PUBLISH);
+        /*  Repeat falls fold into the open alert (alert_coalescer.h); it
+         *  is sent again when it gets more severe, and once more with
+         *  the totals when its window closes.                          */
+        if (fallAlertDue || fallAlerts.expire(millis())) {
+            publishFallAlert();
+            fallAlertDue = false;
+        }
+        replayJournal();
+
+        unsigned long now = millis();
+        if ((now - lastPublishMs) > (PUBLISH_INTERVAL_SEC * 1000UL)) {
+            if (LOCATION_BATCHING && track.count()) publishTrack();
+            else                                    publishLocation();
+            logOutbox();
+            logJournal();
+            if (LOW_POWER_MODE) logPower();
+            if (GPS_DUTY_CYCLE) logGpsPower();
+            publishDiagnostics(now - lastDiagMs >= DIAG_INTERVAL_SEC * 1000UL);
+            keepBootState(now - bootSavedMs >= BOOT_SAVE_SEC * 1000UL);
+            lastPublishMs = now;
+        }
     }
+    timing.record(STAGE_LOOP, System.ticks() - passStart);
 
-    delay(20);  /* ~50 Hz sensor loop */
+    /* 4.  Idle: the deferred log goes out now, after the pass -------- */
+    binlog.drain(Serial, LOG_DRAIN_RECORDS, LOG_RAW_FRAMES);
+
+    /* 5.  Sleep: stop mode while at rest, else a short delay ---------- */
+    if (LOW_POWER_MODE && readyToStop()) {
+        stopUntilImu();
+    } else {
+        uint32_t t0 = millis();
+        delay(LOOP_PERIOD_MS);  /* ~50 Hz sensor loop */
+        power.idleMs += millis() - t0;
+    }
 }
 
 /* ─────────────────────────────────────────────────────────────────────
- *  GPS  –  read NMEA sentences from PA1010D over I2C
+ *  GPS  –  stream NMEA from PA1010D over I2C
+ *
+ *  Every byte goes straight into the RMC/GGA tokenizer (nmea_fix.h),
+ *  which verifies the checksum and accumulates each field as integers:
+ *  no line buffer, no strtok/atof and no double maths in the loop.
+ *
+ *  gps_i2c.h reads in 32-byte chunks, stops at the first padding byte,
+ *  skips the bus between the module's output bursts and never spends
+ *  more than GPS_DRAIN_BUDGET_US per call.
  * ───────────────────────────────────────────────────────────────────── */
 void readGPS() {
-    char buf[GPS_READ_BUFFER + 1];
-    uint8_t idx = 0;
-
-    Wire.requestFrom(GPS_I2C_ADDR, GPS_READ_BUFFER);
-    while (Wire.available() && idx < GPS_READ_BUFFER) {
-        char c = Wire.read();
-        if (c == '\n' || c == '\r') {
-            if (idx > 0) {
-                buf[idx] = '\0';
-                parseNMEA(buf);
-                idx = 0;
-            }
-        } else if (c != 0x0A && c != 0xFF) {   /* skip padding bytes */
-            buf[idx++] = c;
-        }
+    gpsDrain.poll([](char c) {
+        if (gps.feed(c) && gps.fix().valid) gpsPower.fixed(millis());
+    });
+    if (!gpsFirstFixMs && gps.fix().valid) {
+        gpsFirstFixMs = millis();
+        gpsAidPending = false;
+        Serial.printlnf("[SafeNeck] First fix %lu ms after power-on", (unsigned long)gpsFirstFixMs);
     }
 }
 
-/* Parse a $GPRMC or $GPGGA sentence for lat/lon/speed ─────────────── */
-void parseNMEA(const char *sentence) {
-    if (strstr(sentence, "$GPRMC") == sentence ||
-        strstr(sentence, "$GNRMC") == sentence) {
-        /*  $GPRMC,time,status,lat,N/S,lon,E/W,speed,...
-         *  fields[0]=id  [1]=time  [2]=A/V  [3]=lat  [4]=N/S
-         *           [5]=lon [6]=E/W [7]=speed                        */
-        char copy[GPS_READ_BUFFER + 1];
-        strncpy(copy, sentence, GPS_READ_BUFFER);
-        copy[GPS_READ_BUFFER] = '\0';
-
-        char *fields[15];
-        int   fi = 0;
-        char *tok = strtok(copy, ",");
-        while (tok && fi < 15) {
-            fields[fi++] = tok;
-            tok = strtok(NULL, ",");
-        }
-
-        if (fi >= 8 && fields[2][0] == 'A') {
-            gpsLat   = nmeaToDecimal(fields[3], fields[4][0]);
-            gpsLon   = nmeaToDecimal(fields[5], fields[6][0]);
-            gpsSpeed = atof(fields[7]) * 1.852;  /* knots → km/h     */
-            gpsFix   = true;
-        } else {
-            gpsFix = false;
-        }
+/* Step the PA1010D down while the IMU is at rest and back up as soon
+ * as it is not (gps_power.h).  Called with the bus held.             */
+void manageGpsPower() {
+    const GpsFix &fix = gps.fix();
+    bool good = fix.valid && fix.hdopX100 && fix.hdopX100 <= GPS_GOOD_HDOP_X100 &&
+                fix.sats >= GPS_GOOD_SATS;
+    sendGpsPower(gpsPower.update(millis(), imuRateShared.rate() == IMU_RATE_REST, good));
+
+    const GpsPowerManager::Stats &st = gpsPower.stats();
+    if (st.fixes != gpsFixesLogged) {
+        gpsFixesLogged = st.fixes;
+        Serial.printlnf("[SafeNeck] GPS fix %lu ms after resume", (unsigned long)st.ttffLastMs);
     }
 }
 
-/* Convert NMEA ddmm.mmmm → decimal degrees ───────────────────────── */
-double nmeaToDecimal(const char *raw, char hemisphere) {
-    double val   = atof(raw);
-    int    deg   = (int)(val / 100);
-    double min   = val - (deg * 100);
-    double dec   = deg + (min / 60.0);
-    if (hemisphere == 'S' || hemisphere == 'W') dec = -dec;
-    return dec;
+void sendGpsPower(const char *cmd) {
+    if (!cmd) return;
+    bool ok = gpsDrain.command(cmd);
+    Serial.printlnf("[SafeNeck] GPS → %s (%s)%s", gpsPowerName(gpsPower.mode()), cmd,
+                    ok ? "" : " – not acknowledged");
+}
+
+/* Time in each GPS mode and time to fix after a resume, logged with
+ * every location publish.                                            */
+void logGpsPower() {
+    uint32_t now = millis();
+    uint32_t ms[GPS_POWER_COUNT], total = 0;
+    for (int m = 0; m < GPS_POWER_COUNT; m++) total += ms[m] = gpsPower.msIn((GpsPowerMode)m, now);
+    if (!total) return;
+    const GpsPowerManager::Stats &st = gpsPower.stats();
+    Serial.printlnf("[SafeNeck] GPS power – tracking %lu%%  periodic %lu%%  standby %lu%% of %lu s, "
+                    "%lu resumes (%lu by alert), fix after %lu/%lu/%lu ms last/mean/max, first fix %lu ms",
+                    (unsigned long)((uint64_t)ms[GPS_POWER_TRACKING] * 100 / total),
+                    (unsigned long)((uint64_t)ms[GPS_POWER_PERIODIC] * 100 / total),
+                    (unsigned long)((uint64_t)ms[GPS_POWER_STANDBY] * 100 / total),
+                    (unsigned long)(total / 1000), (unsigned long)st.resumes,
+                    (unsigned long)st.byAlert, (unsigned long)st.ttffLastMs,
+                    (unsigned long)(st.fixes ? st.ttffSumMs / st.fixes : 0),
+                    (unsigned long)st.ttffMaxMs, (unsigned long)st.bootFixMs);
 }
 
 /* ─────────────────────────────────────────────────────────────────────
- *  BNO085  –  read accelerometer via I2C (SHTP protocol, simplified)
+ *  COLD START  –  sensor readiness, GPS aiding, state across a reset
+ *
+ *  boot_state.h keeps the record in retained RAM (a watchdog reset or a
+ *  brownout that left SRAM powered) and two flash slots (a power loss).
  * ───────────────────────────────────────────────────────────────────── */
-void readBNO085() {
-    uint8_t header[4];
-    Wire.requestFrom(BNO085_I2C_ADDR, 4);
-    if (Wire.available() < 4) return;
-    for (int i = 0; i < 4; i++) header[i] = Wire.read();
-
-    uint16_t packetLen = (uint16_t)header[0] | ((uint16_t)(header[1] & 0x7F) << 8);
-    if (packetLen == 0 || packetLen > 128) return;
-
-    uint8_t body[128];
-    uint16_t toRead = packetLen - 4;
-    if (toRead > 124) toRead = 124;
-    Wire.requestFrom(BNO085_I2C_ADDR, (int)toRead);
-    for (uint16_t i = 0; i < toRead && Wire.available(); i++) {
-        body[i] = Wire.read();
+
+/* Probes `addr` with an empty write every SENSOR_POLL_MS until it ACKs.
+ * Returns the ms it took, or -1 after SENSOR_READY_TIMEOUT_MS.        */
+int32_t waitForDevice(uint8_t addr) {
+    uint32_t start = millis();
+    for (;;) {
+        uint8_t err;
+        WITH_LOCK(Wire) {
+            Wire.beginTransmission(addr);
+            err = Wire.endTransmission();
+        }
+        if (err == 0) return (int32_t)(millis() - start);
+        if (millis() - start >= SENSOR_READY_TIMEOUT_MS) return -1;
+        delay(SENSOR_POLL_MS);
+    }
+}
+
+/* UTC, and the last fix unless it is stale, as PA1010D aiding.  Needs
+ * the RTC: after a power loss that waits for the cloud's time sync, so
+ * loop() keeps calling until it has gone out or a fix made it moot.
+ * Caller holds the bus.                                              */
+void aidGps() {
+    if (!Time.isValid()) return;
+    gpsAidPending = false;
+    uint32_t now = (uint32_t)Time.now();
+    const BootRecord &r = boot.record();
+    char body[96];
+    bool ok = gpsTimeAid(body, sizeof(body), now) && gpsDrain.command(body);
+    bool pos = r.fixUnix && now - r.fixUnix <= GPS_AID_MAX_AGE_SEC;
+    if (pos) ok = gpsPositionAid(body, sizeof(body), r, now) && gpsDrain.command(body) && ok;
+    Serial.printlnf("[SafeNeck] GPS aided with UTC%s%s", pos ? " and the last fix" : "",
+                    ok ? "" : " – not acknowledged");
+}
+
+/* An alert sent less than ALERT_WINDOW_SEC before the reset is reopened
+ * and sent again as its next update; later falls fold into it.  The GPS
+ * stays at full power for what is left of GPS_ALERT_HOLD_MS.  Undated
+ * without the RTC, so only after a reset that kept it running.       */
+void resumeAlert() {
+    const BootRecord &r = boot.record();
+    if (!r.alertUnix || !Time.isValid()) return;
+    uint32_t ageS = (uint32_t)Time.now() - r.alertUnix;
+    if (ageS >= GPS_ALERT_HOLD_MS / 1000) return;
+    uint32_t now = millis();
+    CoalescedAlert a;
+    a.kind      = (AlertKind)r.alertKind;
+    a.peakMilli = r.alertPeakMilli;
+    a.count     = r.alertCount;
+    a.update    = r.alertUpdate;
+    a.lastMs    = r.alertSpanS * 1000UL;          /* firstMs 0: the span */
+    if (fallAlerts.resume(a, now, ageS * 1000UL)) {
+        fallAlertDue = true;
+        Serial.printlnf("[SafeNeck] Fall alert from %lu s ago reopened", (unsigned long)ageS);
     }
+    if (GPS_DUTY_CYCLE) gpsPower.alert(now - ageS * 1000UL);
+}
 
-    /* Look for accelerometer report (report id 0x01) */
-    if (toRead >= 10 && body[0] == 0x01) {
-        /*  Q-point for accelerometer is 8  →  divide by 256          */
-        int16_t rawX = (int16_t)((uint16_t)body[4] | ((uint16_t)body[5] << 8));
-        int16_t rawY = (int16_t)((uint16_t)body[6] | ((uint16_t)body[7] << 8));
-        int16_t rawZ = (int16_t)((uint16_t)body[8] | ((uint16_t)body[9] << 8));
+/* The open alert into the boot record, so it outlives a reset: every
+ * detection in retained RAM, every send in flash too.                */
+void rememberAlert(bool toFlash) {
+    const CoalescedAlert &a = fallAlerts.current();
+    BootRecord &r = boot.record();
+    uint32_t ageS = (millis() - a.lastMs) / 1000;
+    r.alertUnix      = Time.isValid() ? (uint32_t)Time.now() - ageS : 0;
+    r.alertKind      = a.kind;
+    r.alertPeakMilli = a.peakMilli;
+    r.alertCount     = a.count;
+    r.alertSpanS     = a.spanS();
+    r.alertUpdate    = a.update;
+    if (toFlash) keepBootState(true);
+    else         boot.keep();
+}
 
-        accelX = rawX / 256.0f;  /* m/s² → roughly g when /9.81      */
-        accelY = rawY / 256.0f;
-        accelZ = rawZ / 256.0f;
+/* The last fix and UTC into retained RAM, and with `toFlash` the whole
+ * record into flash as well.                                         */
+void keepBootState(bool toFlash) {
+    BootRecord &r = boot.record();
+    const GpsFix &fix = gps.fix();
+    uint32_t t = fixUnixTime(fix);
+    if (fix.valid && t) {
+        r.fixUnix = t;
+        r.latE7   = fix.latE7;
+        r.lonE7   = fix.lonE7;
+        r.altDm   = fix.altDm;
+    }
+    if (Time.isValid()) r.savedUnix = (uint32_t)Time.now();
+    if (!toFlash) {
+        boot.keep();
+        return;
+    }
+    if (!boot.save()) Serial.println("[SafeNeck] Boot state not saved to flash");
+    bootSavedMs = millis();
+}
 
-        accelMagnitude = sqrtf(accelX * accelX +
-                               accelY * accelY +
-                               accelZ * accelZ) / 9.81f;  /* in g    */
+/* One point per new UTC second with a valid fix (track_batch.h).  A
+ * batch that fills before the interval is up goes out early. */
+void recordTrack() {
+    if (!LOCATION_BATCHING) return;
+    const GpsFix &fix = gps.fix();
+    uint32_t t = fixUnixTime(fix);
+    if (!fix.valid || !t || t == lastTrackTime) return;
+    lastTrackTime = t;
+    if (!track.add(t, fix.latE7, fix.lonE7)) {
+        publishTrack();
+        track.add(t, fix.latE7, fix.lonE7);
     }
 }
 
 /* ─────────────────────────────────────────────────────────────────────
- *  FALL DETECTION  –  free-fall → impact pattern
+ *  IMU THREAD  –  fixed-cadence BNO085 sampling
+ *
+ *  Runs above loop() priority so neither a WITH_ACK publish nor the
+ *  alert path can delay it.  Samples go through a lock-free SPSC ring
+ *  (spsc_ring.h); loop() consumes them in order, using each sample's
+ *  own timestamp, however late it gets to them.  The sensor batches
+ *  reports on-chip, so waking at twice the batch rate is enough.
  * ───────────────────────────────────────────────────────────────────── */
-void checkFall() {
-    unsigned long now = millis();
-
-    if (!inFreeFall && accelMagnitude < FREEFALL_THRESHOLD) {
-        /* Entered free-fall */
-        inFreeFall    = true;
-        freeFallStart = now;
+void imuSampler() {
+    system_tick_t wake = millis();
+    for (;;) {
+        {
+            LoopTiming::Scope t(timing, STAGE_IMU);
+            WITH_LOCK(Wire) {
+                readBNO085();
+            }
+        }
+        imuReportGaps.store(bno.stats().reportGaps);
+        imuRateShared.publish(imuRate, millis());
+        /* Back from stop mode: restart the cadence, don't catch up.   */
+        if ((int32_t)(millis() - wake) > IMU_POLL_PERIOD_MS) wake = millis();
+        os_thread_delay_until(&wake, IMU_POLL_PERIOD_MS);
     }
+}
 
-    if (inFreeFall) {
-        /* If high-g impact follows within 500 ms → fall detected */
-        if (accelMagnitude > FALL_ACCEL_THRESHOLD) {
-            if ((now - freeFallStart) < 500) {
-                fallDetected = true;
-                Serial.println("[SafeNeck] ** FALL DETECTED **");
-            }
-            inFreeFall = false;
+/* ─────────────────────────────────────────────────────────────────────
+ *  BNO085  –  drain queued SHTP packets (shtp.h)
+ *
+ *  Each packet is read in as few transactions as the Wire buffer
+ *  allows and every report in it is decoded, stamped with the sensor's
+ *  own time from the 0xFB base timestamp and the report delay.
+ * ───────────────────────────────────────────────────────────────────── */
+void readBNO085() {
+    /*  Rate verdicts: |a|² against a band around 1 g, in raw units.   */
+    constexpr uint32_t stillLoSq = accelRawSq(1.0 - IMU_MOVING_G, ACCEL_Q_POINT);
+    constexpr uint32_t stillHiSq = accelRawSq(1.0 + IMU_MOVING_G, ACCEL_Q_POINT);
+    constexpr uint32_t spikeLoSq = accelRawSq(IMU_TRANSIENT_LO_G, ACCEL_Q_POINT);
+    constexpr uint32_t spikeHiSq = accelRawSq(IMU_TRANSIENT_HI_G, ACCEL_Q_POINT);
+
+    /*  A packet's reports are collected and go through the batch
+     *  kernels (accel_batch.h) together: |a|² with the M4's dual
+     *  16-bit MACs, then the still band checked for the whole batch.  */
+    static AccelXyz xyz[IMU_BATCH_SAMPLES];      /* IMU thread only    */
+    static uint32_t ms[IMU_BATCH_SAMPLES], magSq[IMU_BATCH_SAMPLES];
+    size_t n = 0;
+
+    static uint32_t lastMs = 0;
+    uint32_t nowMs = millis(), nowUs = micros();
+    bool rateChanged = false;
+    auto flush = [&]() {
+        if (!n) return;
+        accelMagSqBatch(xyz, magSq, n);
+        for (size_t i = 0; i < n; i++) {
+            AccelSample s = { ms[i], xyz[i].x, xyz[i].y, xyz[i].z, magSq[i] };
+            imuRing.push(s);     /* full ring → counted in dropped()   */
         }
-        /* Timeout – no impact, cancel */
-        if ((now - freeFallStart) > 1000) {
-            inFreeFall = false;
+        if (IMU_ADAPTIVE_RATE) {
+            /* Samples before the first one off 1 g only move the clock. */
+            size_t q = accelFirstOutside(magSq, n, stillLoSq, stillHiSq);
+            if (q) rateChanged |= imuRate.update(ms[q - 1], false, false);
+            for (size_t i = q; i < n; i++) {
+                uint32_t m = magSq[i];
+                rateChanged |= imuRate.update(ms[i], m < stillLoSq || m > stillHiSq,
+                                              m < spikeLoSq || m > spikeHiSq);
+            }
         }
+        n = 0;
+    };
+    auto onReport = [&](const ShtpReport &r) {
+        if (r.id == 0x04) { imuHighGWakes++; return; }   /* wake report */
+        if (r.id != 0x01) return;            /* accelerometer only       */
+        if (n == IMU_BATCH_SAMPLES) flush();
+        /* Signed: a report read by a later poll of this wake is
+         * stamped after nowUs.  Never behind the previous stamp, so the
+         * detector and the rate governor only see time move forward,
+         * and never ahead of millis(), since it has been read by now. */
+        uint32_t t = nowMs + (int32_t)(r.timeUs - nowUs) / 1000;
+        uint32_t readMs = millis();
+        if ((int32_t)(t - readMs) > 0) t = readMs;
+        if ((int32_t)(t - lastMs) < 0) t = lastMs;
+        ms[n] = lastMs = t;
+        xyz[n] = { r.i16(0), r.i16(1), r.i16(2), 0 };
+        n++;
+    };
+    for (int i = 0; i < IMU_DRAIN_PACKETS; i++) {
+        int got = bno.poll(onReport);
+        flush();
+        if (got < 0) break;                  /* nothing pending          */
+    }
+    /* Reprogram in the same wake as the sample that asked for it.     */
+    if (rateChanged) enableAccelReport(imuRate.intervalUs());
+}
+
+/* SHTP "Set Feature Command".  Caller holds the bus.                 */
+void setFeature(uint8_t reportId, uint8_t flags, uint16_t sensitivity,
+                uint32_t intervalUs, uint32_t batchUs) {
+    static uint8_t seq = 0;                  /* control channel sequence */
+    uint8_t cmd[] = {
+        0x15, 0x00,              /* length 21 (LSB, MSB)               */
+        0x02,                    /* channel: control                   */
+        seq++,                   /* sequence                           */
+        0xFD,                    /* Set Feature Command                */
+        reportId,                /* report id                          */
+        flags,                   /* feature flags                      */
+        (uint8_t)sensitivity, (uint8_t)(sensitivity >> 8),  /* change  */
+        (uint8_t)intervalUs, (uint8_t)(intervalUs >> 8),   /* report   */
+        (uint8_t)(intervalUs >> 16), (uint8_t)(intervalUs >> 24),
+        (uint8_t)batchUs, (uint8_t)(batchUs >> 8),         /* batch    */
+        (uint8_t)(batchUs >> 16), (uint8_t)(batchUs >> 24),
+        0x00, 0x00, 0x00, 0x00   /* sensor-specific configuration      */
+    };
+    Wire.beginTransmission(BNO085_I2C_ADDR);
+    Wire.write(cmd, sizeof(cmd));
+    Wire.endTransmission();
+}
+
+/* Report 0x01 (accelerometer), batched on-chip for IMU_BATCH_MS, or
+ * for IMU_REST_BATCH_MS at the rest rate so stop mode lasts longer.   */
+void enableAccelReport(uint32_t intervalUs) {
+    bool rest = LOW_POWER_MODE && intervalUs == IMU_REST_US;
+    setFeature(0x01, 0x00, 0, intervalUs,
+               (rest ? IMU_REST_BATCH_MS : IMU_BATCH_MS) * 1000UL);
+}
+
+/* Report 0x04 (linear acceleration) as a wake-up source: change
+ * sensitivity enabled (absolute), wake-up flag, no batching, so only a
+ * jump of HIGH_G_WAKE_G on some axis is reported and it flushes the
+ * FIFO – pulling INT low – immediately.                               */
+void enableHighGWake() {
+    constexpr uint16_t sensitivity =
+        (uint16_t)(HIGH_G_WAKE_G * ACCEL_G_MS2 * (1 << ACCEL_Q_POINT) + 0.5);
+    setFeature(0x04, 0x02 | 0x04, sensitivity, 10000, 0);
+}
+
+/* ─────────────────────────────────────────────────────────────────────
+ *  LOW POWER  –  stop mode between IMU batches
+ *
+ *  Only at the rest rate, with nothing left to do: every sample
+ *  consumed, no detection or alert in progress, the outbox empty, no
+ *  journal replay due, the deferred log written out, the GPS buffer
+ *  read dry and INT high (the FIFO drained).  The MCU then stops until
+ *  INT – the batch falling due or the high-g wake – or, at the latest,
+ *  the next location publish.  Cellular stays attached in the
+ *  meantime.
+ * ───────────────────────────────────────────────────────────────────── */
+bool readyToStop() {
+    return imuRateShared.rate() == IMU_RATE_REST && imuRing.size() == 0 &&
+           fallDetector.state() == DETECTOR_IDLE && shadowDetector.state() == DETECTOR_IDLE &&
+           !fallDetected && outbox.metrics().depth == 0 && gpsDrain.drained() && binlog.empty() &&
+           !(journal.backlog() && Particle.connected()) &&
+           digitalRead(BNO085_INT_PIN) == HIGH;
+}
+
+void stopUntilImu() {
+    uint32_t now = millis();
+    uint32_t toPublish = PUBLISH_INTERVAL_SEC * 1000UL - (now - lastPublishMs);
+    if ((int32_t)toPublish <= 0) return;
+    SystemSleepConfiguration config;
+    config.mode(SystemSleepMode::STOP)
+          .gpio(BNO085_INT_PIN, FALLING)
+          .duration(toPublish < STOP_MAX_MS ? toPublish + 1 : STOP_MAX_MS)
+          .network(NETWORK_INTERFACE_CELLULAR);
+    SystemSleepResult r = System.sleep(config);
+    power.stopMs += millis() - now;
+    power.stops++;
+    if (r.wakeupReason() == SystemSleepWakeupReason::BY_GPIO) power.intWakes++;
+}
+
+/* Duty cycle so far, logged with every location publish.             */
+void logPower() {
+    uint32_t total = millis() - power.startMs;
+    if (!total) return;
+    uint32_t run = total - power.idleMs - power.stopMs;
+    Serial.printlnf("[SafeNeck] Power – run %lu%%  idle %lu%%  stop %lu%% of %lu s, "
+                    "%lu stops (%lu by INT), %lu high-g reports",
+                    (unsigned long)((uint64_t)run * 100 / total),
+                    (unsigned long)((uint64_t)power.idleMs * 100 / total),
+                    (unsigned long)((uint64_t)power.stopMs * 100 / total),
+                    (unsigned long)(total / 1000), (unsigned long)power.stops,
+                    (unsigned long)power.intWakes, (unsigned long)imuHighGWakes.load());
+}
+
+/* One line per rate change with the share of time at each rate.      */
+void logImuRate() {
+    ImuRateSnapshot rate = imuRateShared.read();
+    if (rate.switches == imuRateSwitchesLogged) return;
+    imuRateSwitchesLogged = rate.switches;
+    uint32_t now = millis();
+    uint32_t ms[IMU_RATE_COUNT], total = 0;
+    for (int r = 0; r < IMU_RATE_COUNT; r++) total += ms[r] = rate.msIn((ImuRate)r, now);
+    if (!total) total = 1;
+    Serial.printlnf("[SafeNeck] IMU rate → %s (%lu Hz) – rest %lu%%  active %lu%%  burst %lu%% of %lu s",
+                    imuRateName(rate.rate), (unsigned long)(1000000UL / rate.intervalUs),
+                    (unsigned long)(ms[IMU_RATE_REST] * 100 / total),
+                    (unsigned long)(ms[IMU_RATE_ACTIVE] * 100 / total),
+                    (unsigned long)(ms[IMU_RATE_BURST] * 100 / total),
+                    (unsigned long)(total / 1000));
+}
+
+/* ─────────────────────────────────────────────────────────────────────
+ *  FALL DETECTION  –  free-fall → impact pattern
+ * ───────────────────────────────────────────────────────────────────── */
+void checkFall(const AccelSample &s) {
+    /*  Squared magnitude in raw Q8 units against squared thresholds
+     *  folded from the profile: no sqrt, divide or float per sample.  */
+    DetectorSample d;
+    d.ms    = s.ms;
+    d.magSq = s.magSq;
+
+    if (fallDetector.step(d) == DETECTOR_ALERT_FALL) {
+        fallDetected = true;
+        fallImpactG  = fallDetector.peakG();
+        binlog.log(LOG_FALL_DETECTED, fallImpactG);
+        if (fallAlerts.add(s.ms, ALERT_FALL, toMilliG(fallImpactG)) == AlertCoalescer::SEND)
+            fallAlertDue = true;
+        else
+            rememberAlert(false);             /* folded: RAM only     */
+    }
+    if (SHADOW_DETECTOR && shadowDetector.step(d) == DETECTOR_ALERT_FALL) {
+        binlog.log(LOG_SHADOW_FALL, shadowDetector.peakG(), shadowDetector.stats().fallAlerts);
     }
 }
 
 /* ─────────────────────────────────────────────────────────────────────
  *  PUBLISH helpers  –  Particle Cloud events
  *
- *  Events are forwarded to Firebase RTDB via a Particle Webhook:
- *    Event name  →  "safeneck/location"  or  "safeneck/fall"
- *    Data format →  JSON string
+ *  Events reach Firebase RTDB through host/firebaserelay, which
+ *  decodes them into the JSON the app reads:
+ *    Event name  →  "safeneck/location", "safeneck/track", "safeneck/fall"
+ *    Data format →  packed binary as base85 (event_codec.h), or the
+ *                   delta-encoded track batch (track_batch.h)
  *
- *  Configure a Particle Integration (Webhook) to POST to:
- *    https://<project>.firebaseio.com/devices/{{PARTICLE_DEVICE_ID}}.json
+ *  Both helpers only queue the event (publish_queue.h): the sender
+ *  thread publishes WITH_ACK, alerts ahead of locations, and retries
+ *  with backoff while an ACK never arrives.  While the cloud is out of
+ *  reach they go to the flash journal instead (queueEvent()).
  * ───────────────────────────────────────────────────────────────────── */
 void publishLocation() {
-    if (!Particle.connected()) return;
-
-    float battery = getBatteryLevel();
-
-    snprintf(publishBuf, sizeof(publishBuf),
-        "{\"lat\":%.6f,\"lon\":%.6f,\"spd\":%.1f,\"fix\":%s,"
-        "\"bat\":%.1f,\"ts\":%lu}",
-        gpsLat, gpsLon, gpsSpeed,
-        gpsFix ? "true" : "false",
-        battery, (unsigned long)Time.now());
-
-    bool ok = Particle.publish("safeneck/location", publishBuf,
-                               PRIVATE | WITH_ACK);
-    if (ok) {
-        Serial.printlnf("[SafeNeck] Published location – lat %.6f  lon %.6f  bat %.0f%%",
-                        gpsLat, gpsLon, battery);
+    const GpsFix &fix = gps.fix();
+    Event e;
+    e.type        = EVENT_LOCATION;
+    e.unixTime    = (uint32_t)Time.now();
+    e.hasFix      = fix.valid;
+    e.latE7       = fix.latE7;
+    e.lonE7       = fix.lonE7;
+    e.altDm       = fix.altDm;
+    e.speedKmhX10 = fix.speedKmhX10;
+    e.hdopX100    = fix.hdopX100;
+    e.sats        = fix.sats;
+    e.batteryPct  = getBatteryPct();
+
+    if (encodeEvent(e, publishBuf, sizeof(publishBuf)) &&
+        queueEvent("safeneck/location", publishBuf, outbox.LOCATION)) {
+        Serial.printlnf("[SafeNeck] Queued location – fix %d  sats %u  bat %u%%",
+                        e.hasFix, e.sats, e.batteryPct);
     } else {
-        Serial.println("[SafeNeck] Publish location FAILED");
+        Serial.println("[SafeNeck] Location not queued");
     }
 }
 
-void publishFallAlert() {
-    if (!Particle.connected()) return;
+/* Every fix recorded since the last publish in one event; decode with
+ * host/trackdecode, or decodeTrack() as host/firebaserelay does. */
+void publishTrack() {
+    uint8_t battery = getBatteryPct();
+    const GpsFix &fix = gps.fix();
+    uint16_t n = track.count();
+    size_t len = track.encode(publishBuf, sizeof(publishBuf), battery,
+                              fix.sats, fix.hdopX100);
+    track.clear();
+    if (!len) return;
+
+    if (queueEvent("safeneck/track", publishBuf, outbox.LOCATION)) {
+        Serial.printlnf("[SafeNeck] Queued track – %u fixes in %u chars  bat %u%%",
+                        n, (unsigned)len, battery);
+    } else {
+        Serial.println("[SafeNeck] Track not queued");
+    }
+}
+
+void logOutbox() {
+    auto m = outbox.metrics();
+    Serial.printlnf("[SafeNeck] Outbox depth %u (max %u), %lu acked, %lu retried, "
+                    "%lu dropped, %lu diag shed, ack %lu ms (max %lu), alert queued max %lu ms",
+                    m.depth, m.highWater, (unsigned long)m.acked,
+                    (unsigned long)m.failures, (unsigned long)m.dropped, (unsigned long)m.shed,
+                    (unsigned long)m.ackMsLast, (unsigned long)m.ackMsMax,
+                    (unsigned long)m.queuedMsMax[outbox.ALERT]);
+}
 
-    float battery = getBatteryLevel();
+/* Online, straight into the outbox; an alert may evict a location
+ * from a full one.  Offline, or with no room, into the flash journal. */
+bool queueEvent(const char *name, const char *data, uint8_t prio) {
+    if (Particle.connected() &&
+        (prio == outbox.ALERT || outbox.metrics().depth < OUTBOX_SLOTS))
+        return outbox.publish(name, data, (decltype(outbox)::Priority)prio);
+    return journal.append(name, data, prio);
+}
+
+/* Hands journalled events to the outbox while connected, a batch at a
+ * time; once the outbox has delivered the last of them the replay is
+ * committed and its duration logged.  If the outbox refused one, or
+ * evicted anything while the replay ran (a live alert into a full
+ * outbox), the replay is abandoned instead and sent again in full:
+ * nothing is marked delivered that may not have been. */
+void replayJournal() {
+    if (!journal.backlog() || !Particle.connected()) return;
+    if (!journal.replaying()) {
+        journalReplayMs    = millis();
+        journalReplayFrom  = journal.stats().replayed;
+        journalReplayDrops = outbox.metrics().dropped;
+    }
+    while (outbox.metrics().depth < JOURNAL_REPLAY_BATCH) {
+        if (!journal.next(journalRecord)) {
+            if (journal.pending()) return;      /* walk limit: on next loop */
+            auto m = outbox.metrics();
+            if (m.depth != 0) return;
+            if (m.dropped != journalReplayDrops) {
+                journal.abandon();
+                Serial.printlnf("[SafeNeck] Journal replay abandoned – %lu outbox drops, resending",
+                                (unsigned long)(m.dropped - journalReplayDrops));
+            } else if (journal.commit()) {
+                Serial.printlnf("[SafeNeck] Journal replayed – %lu events in %lu s",
+                                (unsigned long)(journal.stats().replayed - journalReplayFrom),
+                                (unsigned long)((millis() - journalReplayMs) / 1000));
+            }
+            return;
+        }
+        /* Refused (outbox full of more important events): counted as
+         * dropped, so this replay will not commit.  Wait for room. */
+        if (!outbox.publish(journalRecord.name, journalRecord.data,
+                            (decltype(outbox)::Priority)journalRecord.prio))
+            return;
+    }
+}
 
-    snprintf(publishBuf, sizeof(publishBuf),
-        "{\"lat\":%.6f,\"lon\":%.6f,\"bat\":%.1f,"
-        "\"type\":\"fall\",\"ts\":%lu}",
-        gpsLat, gpsLon, battery, (unsigned long)Time.now());
+/* Journal totals since boot, for the log and the "journal" variable:
+ * backlog, appended, replayed, lost to a full journal and alerts
+ * rescued from it, bytes of events
+ * and bytes written to flash for them, erase counts across segments. */
+void logJournal() {
+    const auto &s = journal.stats();
+    uint32_t lo, hi;
+    journal.eraseCounts(lo, hi);
+    snprintf(journalText, sizeof(journalText),
+             "backlog=%lu appended=%lu replayed=%lu lost=%lu rescued=%lu bytes=%lu/%lu erases=%lu-%lu",
+             (unsigned long)journal.backlog(), (unsigned long)s.appended,
+             (unsigned long)s.replayed, (unsigned long)s.overwritten, (unsigned long)s.rescued,
+             (unsigned long)s.payloadBytes, (unsigned long)s.writtenBytes,
+             (unsigned long)lo, (unsigned long)hi);
+    if (s.appended || journal.backlog()) Serial.printlnf("[SafeNeck] Journal %s", journalText);
+}
 
-    bool ok = Particle.publish("safeneck/fall", publishBuf,
-                               PRIVATE | WITH_ACK);
-    if (ok) {
-        Serial.println("[SafeNeck] ** Published FALL ALERT **");
+void publishFallAlert() {
+    const GpsFix &fix = gps.fix();
+    Event e;
+    e.type       = EVENT_ALERT;
+    e.alertKind  = ALERT_FALL;
+    e.unixTime   = (uint32_t)Time.now();
+    e.hasFix     = fix.valid;
+    e.latE7      = fix.latE7;
+    e.lonE7      = fix.lonE7;
+    e.batteryPct = getBatteryPct();
+    const CoalescedAlert &a = fallAlerts.current();
+    a.fill(e);
+
+    if (encodeEvent(e, publishBuf, sizeof(publishBuf)) &&
+        queueEvent("safeneck/fall", publishBuf, outbox.ALERT)) {
+        if (a.update)
+            binlog.log(LOG_FALL_ALERT_UPDATE, a.update, a.count, a.spanS(), a.peakMilli);
+        else
+            binlog.log(LOG_FALL_ALERT);
     } else {
-        Serial.println("[SafeNeck] Publish fall alert FAILED");
+        binlog.log(LOG_FALL_ALERT_FULL);
     }
+    rememberAlert(true);
+}
+
+/* Stage timings as compact text (stage_timer.h): refreshes the "diag"
+ * variable and, when `send`, queues it as "safeneck/diag" as well.
+ *   t=<s> <stage>=<n>,<mean µs>,<max µs>,<misses>:<histogram>…        */
+void publishDiagnostics(bool send) {
+    if (!timing.format(diagText, sizeof(diagText), millis() / 1000)) return;
+    const LoopTiming::Stage &l = timing.stage(STAGE_LOOP);
+    Serial.printlnf("[SafeNeck] Loop %lu passes, mean %lu us, max %lu us, %lu over %u ms",
+                    (unsigned long)l.count, (unsigned long)l.meanUs(),
+                    (unsigned long)l.maxUs, (unsigned long)l.misses, LOOP_PERIOD_MS);
+    /* Best effort: never journalled, and not queued where it would
+     * only wait, or push out an event, in a full outbox.             */
+    if (!send || !Particle.connected() || outbox.metrics().depth >= OUTBOX_SLOTS) return;
+    if (outbox.publish("safeneck/diag", diagText, outbox.DIAG)) lastDiagMs = millis();
 }
 
 /* ─────────────────────────────────────────────────────────────────────
  *  BATTERY  –  read the Boron's LiPo fuel gauge
  * ───────────────────────────────────────────────────────────────────── */
-float getBatteryLevel() {
+uint8_t getBatteryPct() {
     FuelGauge fuel;
-    return fuel.getSoC();   /* returns 0.0 – 100.0 % */
+    float soc = fuel.getSoC();   /* 0.0 – 100.0 %, negative on error */
+    if (soc < 0) return 0xFF;
+    return soc >= 100 ? 100 : (uint8_t)(soc + 0.5f);
 }
\ No newline at end of file
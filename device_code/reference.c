@@ -2,8 +2,26 @@
 #include <TinyGPS++.h>
 #include "Particle.h"
 #include <Adafruit_BNO08x_Sahagun.h>
-#include <cmath>   // for std::isnan
-#include <cctype>
+#include <cmath>   // for lround
+#include "common/ring_buffer.h"
+#include "common/nmea_stream.h"
+#include "common/gps_i2c.h"
+#include "common/gps_power.h"
+#include "common/alert_coalescer.h"
+#include "common/spsc_ring.h"
+#include "common/publish_queue.h"
+#include "common/event_codec.h"
+#include "common/feature_window.h"
+#include "common/accel_batch.h"
+#include "common/fall_detector.h"
+#include "common/orientation.h"
+#include "common/imu_rate.h"
+#include "common/imu_capture.h"
+#include "common/stage_timer.h"
+#include "common/binlog.h"
+#include "common/heap_stats.h"
+#include "common/flash_journal.h"
+#include "common/boot_state.h"
 
 SYSTEM_MODE(AUTOMATIC);
 SYSTEM_THREAD(ENABLED);
@@ -13,16 +31,72 @@ TinyGPSPlus gps;
 const uint8_t  GPS_I2C_ADDR         = 0x10;      // PA1010D default I2C
 const uint32_t DIAG_PRINT_PERIOD_MS = 1000;      // 1 Hz digest
 const uint32_t PUBLISH_PERIOD_MS    = 30000;     // publish every 30 s
-const int      I2C_CHUNK_BYTES      = 32;        // Wire max per request
-const int      I2C_BURST_CHUNKS     = 10;        // ~320 B per poll
+const uint32_t GPS_DRAIN_BUDGET_US  = 2000;      // bus time allowed per GPS poll
+const uint32_t GPS_RING_BYTES       = 512;       // raw NMEA staged between bus reads and parsing
 
 // Optional debug toggles
 const bool     PRINT_EVERY_LINE     = false;     // print every NMEA line (noisy)
 const bool     DEBUG_GPS            = false;      // print GPS section in digest
 const bool     DEBUG_IMU            = false;      // print IMU section in digest
+const bool     DEBUG_PUBLISH        = false;      // print outbox section in digest
+const bool     DEBUG_TIMING         = false;      // print stage timing section in digest
+const bool     DEBUG_HEAP           = false;      // print heap section in digest
+
+// Detection and alert messages are deferred (common/binlog.h): the call site stores a
+// format ID and raw arguments, and the text is made after the pass, once no samples wait
+const uint32_t LOG_DRAIN_RECORDS    = 8;         // formatted per idle pass, at most
+const bool     LOG_RAW_FRAMES       = false;     // "@base64" lines for host/logdecode instead
+
+// ===== STAGE TIMING =====
+// Cycle-counter histograms and budget misses per loop stage and for the IMU thread's
+// poll (common/stage_timer.h); the "diag" cloud variable holds them as compact text,
+// refreshed every publish, and "safety/diag" carries them every DIAG_PUBLISH_PERIOD_MS
+const uint32_t DIAG_PUBLISH_PERIOD_MS = 300000;
+const uint32_t LOOP_BUDGET_US       = 10000;     // one 100 Hz report period per pass
 
 // ===== BNO085 IMU CONFIGURATION =====
 const uint8_t  BNO085_I2C_ADDR      = 0x4A;      // BNO085 default I2C address
+const uint32_t IMU_POLL_PERIOD_MS   = 5;         // IMU thread cadence (2x the 100 Hz report)
+const uint32_t IMU_REST_POLL_PERIOD_MS = 25;     // cadence while at the rest rate (2x 20 Hz)
+const uint32_t IMU_RING_SAMPLES     = 1024;      // ~10 s of 100 Hz samples (a long publish stall)
+const uint16_t IMU_BATCH_SAMPLES    = 32;        // samples per pass through the batch kernels
+const uint32_t FEATURE_WINDOW_MS    = 2000;      // span of the detector's feature window
+const uint16_t FEATURE_WINDOW_SAMPLES = 512;     // >= 2 s at the 200 Hz burst rate; 12 KB, fixed
+
+// ===== MOTION-ADAPTIVE REPORT RATE =====
+// Linear acceleration at 20 Hz while nothing moves, 100 Hz while moving and
+// 200 Hz from the first sample of a transient (common/imu_rate.h)
+const bool     IMU_ADAPTIVE_RATE    = true;
+const uint32_t IMU_REST_US          = 50000;     // 20 Hz: stationary / on a table
+const uint32_t IMU_ACTIVE_US        = 10000;     // 100 Hz: moving
+const uint32_t IMU_BURST_US         = 5000;      // 200 Hz: transient or motion onset
+const uint32_t IMU_REST_AFTER_MS    = 5000;      // no motion this long = rest
+const uint32_t IMU_BURST_HOLD_MS    = 2500;      // covers the post-impact stillness check
+constexpr double IMU_MOVING_G         = 0.2;       // linear |a| above this = moving
+constexpr double IMU_TRANSIENT_G      = 0.8;       // linear |a| above this = burst (freefall reads ~1 g)
+const uint32_t ORIENTATION_PERIOD_US = 50000;    // game rotation vector + gravity at 20 Hz
+const uint32_t ORIENTATION_STALE_MS  = 250;      // older than this: posture unknown
+
+// ===== ALERT CAPTURE =====
+// Raw linear acceleration around every alert, compressed and uploaded in chunks
+// as "safety/capture" (common/imu_capture.h, host/capturedecode)
+const bool     CAPTURE_ON_ALERT       = true;
+const uint16_t CAPTURE_SAMPLES        = 640;     // 6.4 s at 100 Hz, 3.2 s at 200 Hz; 7.5 KB ring
+const uint16_t CAPTURE_POST_SAMPLES   = 200;     // 2 s after the alert (fall alerts come 2 s after impact)
+const size_t   CAPTURE_SNAPSHOT_BYTES = 3072;    // compressed snapshot awaiting upload
+const uint32_t CAPTURE_CHUNK_PERIOD_MS = 1000;   // at most one chunk queued per second
+
+// ===== GPS DUTY CYCLE =====
+// PA1010D in periodic standby after a minute at the IMU rest rate with a good fix,
+// full standby after ten; motion or an alert resumes 1 Hz at once (common/gps_power.h)
+const bool     GPS_DUTY_CYCLE         = true;
+const uint32_t GPS_PERIODIC_AFTER_MS  = 60000;
+const uint32_t GPS_STANDBY_AFTER_MS   = 600000;
+const uint32_t GPS_RUN_MS             = 3000;    // hot fix + a few epochs
+const uint32_t GPS_SLEEP_MS           = 27000;   // run + sleep = PUBLISH_PERIOD_MS: a fresh fix per publish
+const uint32_t GPS_ALERT_HOLD_MS      = 600000;  // full power this long after an alert
+const uint32_t GPS_GOOD_HDOP_X100     = 250;     // fix good enough to stop tracking
+const uint32_t GPS_GOOD_SATS          = 5;
 
 // ===== CONFIGURABLE FALL/IMPACT DETECTION THRESHOLDS =====
 // Impact force thresholds (in g-force units, where 1g = 9.8 m/s²)
@@ -35,174 +109,287 @@ const uint8_t  BNO085_I2C_ADDR      = 0x4A;      // BNO085 default I2C address
 // ~4.0g - Violent push, punch impact, falling and hitting object, tackle
 // ~5.0g+ - Severe assault, high-speed collision, major fall impact, car accident
 //
-// Adjust IMPACT_THRESHOLD_G based on your sensitivity needs:
+// Adjust IMPACT_G based on your sensitivity needs:
 // - Lower values (2.0-2.5g): More sensitive, catches lighter impacts, more false positives
 // - Medium values (3.0-3.5g): Balanced detection, good for general safety monitoring
 // - Higher values (4.0g+): Less sensitive, only severe impacts, fewer false alarms
 //
-const float    IMPACT_THRESHOLD_G       = 3.0;   // Trigger threshold for impact detection
-const float    FALL_FREEFALL_THRESH_G   = 0.2;   // Below this = freefall (sitting rarely goes this low)
-const uint32_t FREEFALL_CONFIRM_MS      = 500;    // Must sustain low-g for this long to confirm freefall
-const uint32_t FALL_FREEFALL_MIN_MS     = 100;   // Min freefall duration before impact counts
-const uint32_t POST_IMPACT_STILL_MS     = 2000;  // Stillness duration after impact = likely fall
-const uint32_t ALERT_COOLDOWN_MS        = 30000; // Prevent alert spam (30 seconds between alerts)
+// The profile is a compile-time parameter of the detector (common/fall_detector.h):
+// every value below folds into its comparisons.
+struct FieldProfile : ImpactStillnessProfile {
+  static constexpr double   IMPACT_G             = 3.0;   // Trigger threshold for impact detection
+  static constexpr double   FREEFALL_G           = 0.2;   // Below this = freefall (sitting rarely goes this low)
+  static constexpr uint32_t FREEFALL_CONFIRM_MS  = 500;   // Must sustain low-g for this long to confirm freefall
+  static constexpr uint32_t FREEFALL_MIN_MS      = 100;   // Min freefall duration before impact counts
+  static constexpr uint32_t POST_IMPACT_STILL_MS = 2000;  // Stillness duration after impact = likely fall
+  static constexpr double   STILL_SPREAD_G       = 0.15;  // Window std dev below this = still (no stability class)
+  static constexpr double   POST_IMPACT_TILT_DEG = 45;    // Still but tipped less than this = impact (standing), not fall
+};
+
+// Shadow profile: fed the same samples as FieldProfile, never publishes; its
+// would-be alerts are logged and counted so a candidate can be trialled in the field
+const bool SHADOW_DETECTOR = true;
+struct ShadowProfile : FieldProfile {
+  static constexpr double   IMPACT_G             = 2.5;   // Moderate push, tripping
+  static constexpr uint32_t POST_IMPACT_STILL_MS = 1500;
+};
+
+// Detections within ALERT_WINDOW_MS of the last one fold into the same alert (count, peak g,
+// span); it is re-sent only when it gets more severe - impact -> fall, or a peak
+// ALERT_BAND_G higher - and once with the totals when the window closes
+const uint32_t ALERT_WINDOW_MS          = 30000;
+const double   ALERT_BAND_G             = 2.0;
 
 unsigned long lastDiag = 0;
 unsigned long lastPub  = 0;
 
-String lineBuf;
-String lastGGA;
-String lastRMC;
+RingBuffer<char, GPS_RING_BYTES> gpsRing;   // raw I2C bytes awaiting the framer
+NmeaFramer nmea;                            // streaming '$'..'*HH' state machine
+uint32_t gpsRingOverflows = 0;
+GpsI2cDrain gpsDrain(GPS_I2C_ADDR, GPS_DRAIN_BUDGET_US);  // stops on padding, skips between bursts
+GpsPowerManager gpsPower(GPS_PERIODIC_AFTER_MS, GPS_STANDBY_AFTER_MS,
+                         GPS_RUN_MS, GPS_SLEEP_MS, GPS_ALERT_HOLD_MS);
+uint32_t gpsFixSentences = 0;                // TinyGPS++ sentencesWithFix() already seen
+uint32_t gpsFixesLogged = 0;
+
+// Latest GGA/RMC for the digest, copied from the framer's buffer: fixed storage, no heap
+char lastGGA[NMEA_MAX_SENTENCE + 1];
+char lastRMC[NMEA_MAX_SENTENCE + 1];
+
+// Heap readings, checked every publish: after setup used bytes and free blocks must not move
+HeapWatch heap;
 
 // ===== BNO085 IMU Objects =====
 Adafruit_BNO08x bno08x;
 sh2_SensorValue_t sensorValue;
 bool bno085Ready = false;
 
-// Detection state machine for fall/impact detection
-enum DetectionState {
-  DETECT_IDLE,              // Normal monitoring
-  DETECT_FREEFALL,          // Freefall detected, waiting for impact
-  DETECT_IMPACT,            // Impact detected, transitioning to monitoring
-  DETECT_POST_IMPACT        // Monitoring for stillness after impact
+// One linear-acceleration report plus the stability class and posture current at
+// that time, stamped by the IMU thread and consumed in order by loop()
+struct ImuSample {
+  uint32_t ms;
+  int16_t  x, y, z;      // Q8 m/s² as on the wire, gravity removed
+  uint8_t  stability;
+  UpVector up;           // world up in the sensor frame, Q14 (unknown = 0)
+};
+SpscRing<ImuSample, IMU_RING_SAMPLES> imuRing;  // IMU thread -> loop, lock-free
+Thread* imuThread = nullptr;
+
+// Every cloud event goes through the outbox: a sender thread publishes WITH_ACK,
+// alerts first, retrying with backoff, so loop() never waits on the network
+const uint8_t OUTBOX_SLOTS = 8;
+const size_t  PUBLISH_DATA_MAX = 622;           // Gen3 event limit: the stage timing text needs it
+PublishQueue<OUTBOX_SLOTS, PUBLISH_DATA_MAX> outbox;
+
+// Offline, or with the outbox full, events go to a journal in flash instead
+// (common/flash_journal.h) and are replayed once connected: alerts first, newest
+// first, a few at a time so the outbox's 1/s pacing applies. Survives a reboot.
+const uint8_t  JOURNAL_SEGMENTS     = 16;        // 64 KB: hours of positions offline
+const uint32_t JOURNAL_SEG_BYTES    = 4096;      // one flash sector
+const uint8_t  JOURNAL_REPLAY_BATCH = 4;         // journal events in the outbox at once
+FlashJournal<JOURNAL_SEGMENTS, JOURNAL_SEG_BYTES, PUBLISH_DATA_MAX> journal("/safety/journal");
+decltype(journal)::Record journalRecord;
+unsigned long journalReplayStart = 0;
+uint32_t journalReplayDrops = 0;                  // outbox drops when the replay started
+
+// After a reset (common/boot_state.h): retained RAM, else flash, gives back the last
+// fix for GPS aiding (PMTK740/741) and the open alert; setup() polls each sensor
+// until it ACKs instead of sleeping a fixed time
+const uint32_t BOOT_SAVE_PERIOD_MS     = 300000;  // flash copy of the record, besides alerts
+const uint32_t SENSOR_READY_TIMEOUT_MS = 2000;    // give up on a sensor after this
+const uint32_t SENSOR_POLL_MS          = 5;       // address probe cadence while it boots
+const uint32_t GPS_AID_MAX_AGE_S       = 14400;   // an older last fix is not sent
+retained BootRecord bootRetained;
+BootState boot(bootRetained, "/safety/boot");
+unsigned long bootSaved = 0;
+unsigned long gpsFirstFix = 0;                    // ms since power-on, 0 = none yet
+bool gpsAidPending = true;                        // waits for a valid RTC
+uint8_t sampledStability = 0;                   // owned by the IMU thread
+UpTracker<ORIENTATION_STALE_MS> orientation;     // owned by the IMU thread
+ImuRateGovernor imuRate(IMU_REST_US, IMU_ACTIVE_US, IMU_BURST_US,   // owned by the IMU thread
+                        IMU_REST_AFTER_MS, IMU_BURST_HOLD_MS);
+ImuRateShared imuRateShared;                     // imuRate as loop() may read it
+uint32_t imuRateSwitchesLogged = 0;
+
+// Fall/impact detection: idle -> (freefall ->) impact -> post-impact stillness
+FallDetector<FieldProfile> detector;
+FallDetector<ShadowProfile> shadowDetector;
+ImuCapture<CAPTURE_SAMPLES, CAPTURE_POST_SAMPLES, CAPTURE_SNAPSHOT_BYTES> capture(8);
+unsigned long lastCaptureChunk = 0;
+AlertCoalescer alerts(ALERT_WINDOW_MS, (uint16_t)(ALERT_BAND_G * 1000));
+
+// Loop stages and the IMU thread's poll; each stage is written by its own thread only
+enum Stage : uint8_t {
+  STAGE_GPS, STAGE_DETECT, STAGE_CAPTURE, STAGE_DIGEST, STAGE_PUBLISH, STAGE_LOOP, STAGE_IMU,
+  STAGE_COUNT
 };
-DetectionState detectionState = DETECT_IDLE;
-unsigned long stateStartTime = 0;
-unsigned long lastAlertTime = 0;
-unsigned long freefallStartTime = 0;  // Track when low-g started
-bool freefallConfirmed = false;       // Only true after sustained low-g
-float peakImpactG = 0;      // Track peak g-force during impact event
+typedef StageTimer<STAGE_COUNT> LoopTiming;
+LoopTiming timing({
+  { "gps",     GPS_DRAIN_BUDGET_US + 1000 },   // drain + parse + power
+  { "detect",  5000 },
+  { "capture", 2000 },                         // one chunk compressed
+  { "digest",  5000 },                         // Serial at 115200 is the cost
+  { "publish", 2000 },
+  { "loop",    LOOP_BUDGET_US },
+  { "imu",     IMU_REST_POLL_PERIOD_MS * 1000 },
+});
+char diagText[PUBLISH_DATA_MAX + 1];           // "diag" cloud variable
+unsigned long lastDiagPub = 0;
+
+BinLog<512> binlog;                            // loop() only; formats in common/log_catalog.h
 
 // Current IMU sensor readings
 float linAccelX = 0, linAccelY = 0, linAccelZ = 0;
 float accelMagnitude = 0;
 uint8_t stabilityClass = 0;  // 0=unknown, 1=on table, 2=stationary, 3=stable, 4=motion
-
-// ---------- Utils ----------
-static inline bool startsWithAny(const String& s, const char* const* prefixes, size_t n) {
-  for (size_t i = 0; i < n; ++i) if (s.startsWith(prefixes[i])) return true;
-  return false;
+UpVector postureUp;          // latest up vector seen by the detector
+
+// Last FEATURE_WINDOW_MS of |a| in milli-g: mean, spread, peaks, jerk and time spent
+// below freefall / above impact, each updated in O(1) per sample
+FeatureWindow<FEATURE_WINDOW_SAMPLES> accelWindow(FEATURE_WINDOW_MS,
+                                                  toMilliG(FieldProfile::FREEFALL_G),
+                                                  toMilliG(FieldProfile::IMPACT_G));
+
+// Feed a verified (GN->GP remapped, checksum corrected) sentence to TinyGPS++
+void feedSentenceToParser(const char* sentence) {
+  for (const char* p = sentence; *p; ++p) gps.encode(*p);
+  gps.encode('\r');
+  gps.encode('\n');
 }
 
-// Compute NMEA checksum (XOR of all chars between '$' and '*')
-uint8_t nmeaChecksum(const String& body) {
-  uint8_t cs = 0;
-  for (size_t i = 0; i < body.length(); ++i) cs ^= (uint8_t)body.charAt(i);
-  return cs;
-}
+void handleSentence(const char* sentence) {
+  if (PRINT_EVERY_LINE) { Serial.print("NMEA> "); Serial.println(sentence); }
 
-// Convert a hex nibble value (0..15) to uppercase hex char
-char hexDigit(uint8_t v) { v &= 0x0F; return (v < 10) ? ('0' + v) : ('A' + (v - 10)); }
-
-// Validate that a line looks like a complete NMEA sentence with checksum "*HH"
-bool hasCompleteChecksum(const String& line) {
-  int star = line.lastIndexOf('*');
-  if (star < 0 || (size_t)star + 2 >= line.length()) return false;
-  // Ensure the two following chars are hex-ish
-  char a = line.charAt(star + 1);
-  char b = line.charAt(star + 2);
-  return std::isxdigit((unsigned char)a) && std::isxdigit((unsigned char)b);
+  // Feed to TinyGPS++ (CRLF appended inside)
+  feedSentenceToParser(sentence);
+
+  // Cache latest GGA/RMC for the human digest (as fed, i.e. after the GN->GP remap);
+  // the framer already knows the type, whatever the talker
+  if (!DEBUG_GPS) return;
+  if (nmea.typeIs("GGA"))      memcpy(lastGGA, sentence, nmea.length() + 1);
+  else if (nmea.typeIs("RMC")) memcpy(lastRMC, sentence, nmea.length() + 1);
 }
 
-// Returns a sentence with optional GN->GP remap AND a corrected checksum.
-// Requires input to contain '*' checksum. Adds CRLF when feeding.
-String remapAndFixChecksumIfNeeded(const String& line) {
-  // Split into: '$' + body (to '*') + "*HH"
-  int dollar = line.indexOf('$');
-  int star   = line.lastIndexOf('*');
-  if (dollar != 0 || star < 0) {
-    // Not a standard NMEA line; return as-is (TinyGPS++ will likely ignore)
-    return line;
+void pollGpsI2C() {
+  // Bus phase: move raw bytes into the ring, nothing else; the drain stops
+  // at the first padding byte or when the time budget is spent
+  WITH_LOCK(Wire) {
+    gpsDrain.poll([](char c) {
+      if (!gpsRing.push(c)) gpsRingOverflows++;
+    });
   }
 
-  String body = line.substring(1, star);  // between '$' and '*'
-  String talker = body.substring(0, 5);   // e.g., "GNGGA", "GNRMC", "GPGGA", ...
-
-  // Remap only the talker for GGA/RMC if needed
-  if (talker == "GNGGA")      body.replace("GNGGA", "GPGGA");
-  else if (talker == "GNRMC") body.replace("GNRMC", "GPRMC");
-
-  // Recompute checksum on the possibly modified body
-  uint8_t cs = nmeaChecksum(body);
-
-  // Build new full sentence with corrected checksum (no CRLF here)
-  String fixed = "$" + body + "*";
-  fixed += hexDigit((cs >> 4) & 0x0F);
-  fixed += hexDigit(cs & 0x0F);
-  return fixed;
+  // Parse phase: the framer checks the checksum and remaps GN->GP as bytes pass
+  char c;
+  while (gpsRing.pop(c)) {
+    if (nmea.feed(c) == NmeaFramer::VALID) handleSentence(nmea.sentence());
+  }
 }
 
-// Feed a full (already corrected) NMEA line with CRLF to TinyGPS++
-void feedSentenceToParser(const String& sentenceNoCrlf) {
-  String s = sentenceNoCrlf;
-  s += "\r\n";
-  for (size_t i = 0; i < s.length(); ++i) gps.encode(s.charAt(i));
+// ===== GPS Duty Cycle =====
+// Send the PMTK command the power manager asked for, if any
+void sendGpsPower(const char* cmd) {
+  if (!cmd) return;
+  bool ok;
+  WITH_LOCK(Wire) {
+    ok = gpsDrain.command(cmd);
+  }
+  Serial.printlnf("GPS -> %s (%s)%s", gpsPowerName(gpsPower.mode()), cmd, ok ? "" : " NACK");
 }
 
-void handleFullLine(const String& rawLine) {
-  if (PRINT_EVERY_LINE) { Serial.print("NMEA> "); Serial.println(rawLine); }
-
-  // Must have checksum to be worth parsing (otherwise often partials)
-  if (!hasCompleteChecksum(rawLine)) {
-    // Skip partial/truncated lines to avoid parser noise
-    return;
+// Step the PA1010D down while the IMU is at rest and back up as soon as it is not;
+// a new sentence with a fix closes the time-to-fix of the last resume
+void manageGpsPower() {
+  if (gps.sentencesWithFix() != gpsFixSentences) {
+    gpsFixSentences = gps.sentencesWithFix();
+    gpsPower.fixed(millis());
+  }
+  const auto& st = gpsPower.stats();
+  if (st.fixes != gpsFixesLogged) {
+    gpsFixesLogged = st.fixes;
+    Serial.printlnf("GPS fix %lu ms after resume", (unsigned long)st.ttffLastMs);
   }
 
-  // Remap GN->GP for GGA/RMC and apply corrected checksum
-  String corrected = remapAndFixChecksumIfNeeded(rawLine);
-
-  // Feed to TinyGPS++ (with CRLF appended inside)
-  feedSentenceToParser(corrected);
-
-  // Cache latest GGA/RMC (for human digest, show raw line for transparency)
-  static const char* GGAp[] = {"$GPGGA","$GNGGA","$GAGGA","$BDGGA","$GLGGA"};
-  static const char* RMCp[] = {"$GPRMC","$GNRMC","$GARMC","$BDRMC","$GLRMC"};
-  if (startsWithAny(rawLine, GGAp, sizeof(GGAp)/sizeof(GGAp[0])))      lastGGA = rawLine;
-  else if (startsWithAny(rawLine, RMCp, sizeof(RMCp)/sizeof(RMCp[0]))) lastRMC = rawLine;
+  bool good = gps.location.isValid() && gps.hdop.isValid() && gps.hdop.value() > 0 &&
+              (uint32_t)gps.hdop.value() <= GPS_GOOD_HDOP_X100 &&
+              gps.satellites.isValid() && gps.satellites.value() >= GPS_GOOD_SATS;
+  sendGpsPower(gpsPower.update(millis(), imuRateShared.rate() == IMU_RATE_REST, good));
 }
 
-void pollGpsI2C() {
-  for (int i = 0; i < I2C_BURST_CHUNKS; i++) {
-    Wire.requestFrom(GPS_I2C_ADDR, (uint8_t)I2C_CHUNK_BYTES);
-    while (Wire.available()) {
-      char c = Wire.read();
-
-      if (c == '\n') {
-        // We have a full line (ending in \r\n); handle and reset
-        handleFullLine(lineBuf);
-        lineBuf = "";
-      } else if (c != '\r') {
-        lineBuf += c;
-      }
-    }
-    delayMicroseconds(400);
+// ===== BNO085 IMU Polling (IMU thread) =====
+// Reprogram the linear acceleration interval as soon as a sample calls for it;
+// the squared thresholds fold to constants in raw Q8 units
+void adaptImuRate(const ImuSample& s) {
+  constexpr uint32_t MOVING_SQ = accelRawSq(IMU_MOVING_G, 8);
+  constexpr uint32_t TRANSIENT_SQ = accelRawSq(IMU_TRANSIENT_G, 8);
+  uint32_t magSq = accelMagSq(s.x, s.y, s.z);
+  bool moving = s.stability == 4 || magSq > MOVING_SQ;
+  if (imuRate.update(s.ms, moving, magSq > TRANSIENT_SQ)) {
+    bno08x.enableReport(SH2_LINEAR_ACCELERATION, imuRate.intervalUs());
   }
 }
 
-// ===== BNO085 IMU Polling =====
 void pollBNO085() {
-  if (!bno085Ready) return;
-
   while (bno08x.getSensorEvent(&sensorValue)) {
     switch (sensorValue.sensorId) {
-      case SH2_LINEAR_ACCELERATION:
+      case SH2_LINEAR_ACCELERATION: {
         // Linear acceleration with gravity removed (in m/s²)
-        linAccelX = sensorValue.un.linearAcceleration.x;
-        linAccelY = sensorValue.un.linearAcceleration.y;
-        linAccelZ = sensorValue.un.linearAcceleration.z;
-        // Calculate magnitude and convert to g-force (divide by 9.81)
-        accelMagnitude = sqrt(linAccelX*linAccelX + linAccelY*linAccelY + linAccelZ*linAccelZ) / 9.81;
+        // Back to the Q8 the chip sent: the detector works on raw squared magnitude
+        ImuSample s;
+        s.ms = millis();
+        s.x = (int16_t)lroundf(sensorValue.un.linearAcceleration.x * 256);
+        s.y = (int16_t)lroundf(sensorValue.un.linearAcceleration.y * 256);
+        s.z = (int16_t)lroundf(sensorValue.un.linearAcceleration.z * 256);
+        s.stability = sampledStability;
+        s.up = orientation.up(s.ms);
+        imuRing.push(s);  // a full ring is counted in imuRing.dropped()
+        if (IMU_ADAPTIVE_RATE) adaptImuRate(s);
+        break;
+      }
+
+      case SH2_GAME_ROTATION_VECTOR:
+        // Unit quaternion, Q14 on the wire; reduced to an up vector in integer math
+        orientation.rotation(millis(),
+                             (int16_t)lroundf(sensorValue.un.gameRotationVector.i * 16384),
+                             (int16_t)lroundf(sensorValue.un.gameRotationVector.j * 16384),
+                             (int16_t)lroundf(sensorValue.un.gameRotationVector.k * 16384),
+                             (int16_t)lroundf(sensorValue.un.gameRotationVector.real * 16384));
+        break;
+
+      case SH2_GRAVITY:
+        // Only used while the rotation vector is missing
+        orientation.gravity(millis(),
+                            (int16_t)lroundf(sensorValue.un.gravity.x * 256),
+                            (int16_t)lroundf(sensorValue.un.gravity.y * 256),
+                            (int16_t)lroundf(sensorValue.un.gravity.z * 256));
         break;
 
       case SH2_STABILITY_CLASSIFIER:
         // Stability: 0=unknown, 1=on table, 2=stationary, 3=stable, 4=motion
-        stabilityClass = sensorValue.un.stabilityClassifier.classification;
+        sampledStability = sensorValue.un.stabilityClassifier.classification;
         break;
 
     }
   }
 }
 
+// Fixed-cadence sampling above loop() priority, so a publish waiting on its
+// ACK or the alert LED flash cannot make us miss reports; slower at the rest rate
+void imuSampler() {
+  system_tick_t wake = millis();
+  for (;;) {
+    {
+      LoopTiming::Scope t(timing, STAGE_IMU);   // includes waiting for the bus
+      WITH_LOCK(Wire) {
+        pollBNO085();
+      }
+    }
+    imuRateShared.publish(imuRate, millis());
+    os_thread_delay_until(&wake, imuRate.rate() == IMU_RATE_REST ? IMU_REST_POLL_PERIOD_MS
+                                                                  : IMU_POLL_PERIOD_MS);
+  }
+}
+
 // ===== LED Alert Flash =====
 void flashAlertLED() {
   // Rapid flash pattern on D7 LED (10 flashes, 1 second total)
@@ -214,176 +401,325 @@ void flashAlertLED() {
   }
 }
 
-// ===== Alert Trigger Function =====
-void triggerAlert(const char* alertType) {
-  unsigned long now = millis();
+// ===== Cloud Events =====
+// Packed binary records sent as base85 (common/event_codec.h): no float formatting,
+// about a quarter of the JSON size. host/eventdecode turns them back into JSON.
+void fillPosition(Event& e) {
+  e.hasFix = gps.location.isValid();
+  if (!e.hasFix) return;
+  e.latE7 = (int32_t)lround(gps.location.lat() * 1e7);
+  e.lonE7 = (int32_t)lround(gps.location.lng() * 1e7);
+  e.sats  = gps.satellites.isValid() ? (uint8_t)gps.satellites.value() : 0;
+}
 
-  // Prevent alert spam with cooldown period
-  if (now - lastAlertTime < ALERT_COOLDOWN_MS && lastAlertTime != 0) {
-    Serial.printlnf("Alert suppressed (cooldown): %s", alertType);
-    return;
+void publishEvent(const char* name, const Event& e, decltype(outbox)::Priority prio) {
+  char text[48];
+  if (!encodeEvent(e, text, sizeof(text))) return;
+  // The fields go to the log as they are; the text is made in idle time
+  switch (e.type) {
+    case EVENT_ALERT:
+      binlog.log(LOG_PUB_ALERT, e.alertKind, e.gMilli, e.alertCount, e.alertSpanS, e.alertUpdate,
+                 e.hasFix, e.latE7, e.lonE7);
+      break;
+    case EVENT_IMPACT:   binlog.log(LOG_PUB_IMPACT, e.gMilli, e.thresholdMilli); break;
+    case EVENT_FREEFALL: binlog.log(LOG_PUB_FREEFALL, e.gMilli, e.durationMs);   break;
+    case EVENT_LOCATION:
+      binlog.log(LOG_PUB_POSITION, e.hasFix, e.latE7, e.lonE7, e.sats, e.hdopX100);
+      break;
   }
-  lastAlertTime = now;
+  if (Particle.connected() && (prio == outbox.ALERT || outbox.metrics().depth < OUTBOX_SLOTS)) {
+    outbox.publish(name, text, prio);
+  } else {
+    journal.append(name, text, prio);
+  }
+}
 
-  // Flash LED to indicate alert
-  flashAlertLED();
+// Feed journalled events to the outbox while connected; commit once it has
+// delivered the last of them, unless it refused or evicted any event meanwhile:
+// then the whole replay goes again rather than marking a lost event delivered
+void replayJournal() {
+  if (!journal.backlog() || !Particle.connected()) return;
+  if (!journal.replaying()) {
+    journalReplayStart = millis();
+    journalReplayDrops = outbox.metrics().dropped;
+  }
+  while (outbox.metrics().depth < JOURNAL_REPLAY_BATCH) {
+    if (!journal.next(journalRecord)) {
+      if (journal.pending()) return;  // paused at its walk limit; resumes next loop
+      auto m = outbox.metrics();
+      if (m.depth != 0) return;
+      if (m.dropped != journalReplayDrops) {
+        journal.abandon();
+        Serial.printlnf("Journal replay abandoned: %lu outbox drops, resending",
+                        (unsigned long)(m.dropped - journalReplayDrops));
+      } else if (journal.commit()) {
+        Serial.printlnf("Journal replayed in %lu s: %lu events so far, %lu lost to a full journal",
+                        (millis() - journalReplayStart) / 1000, (unsigned long)journal.stats().replayed,
+                        (unsigned long)journal.stats().overwritten);
+      }
+      return;
+    }
+    // Refused: counted as dropped, so this replay won't commit; wait for room
+    if (!outbox.publish(journalRecord.name, journalRecord.data,
+                        (decltype(outbox)::Priority)journalRecord.prio))
+      return;
+  }
+}
 
-  // Build JSON payload with alert info and GPS coordinates
-  char payload[280];
-  if (gps.location.isValid()) {
-    snprintf(payload, sizeof(payload),
-      "{\"alert\":\"%s\",\"g\":%.2f,\"lat\":%.6f,\"lon\":%.6f,\"alt\":%.1f,\"sats\":%u}",
-      alertType,
-      peakImpactG,
-      gps.location.lat(),
-      gps.location.lng(),
-      gps.altitude.isValid() ? gps.altitude.meters() : 0.0,
-      gps.satellites.isValid() ? gps.satellites.value() : 0);
-  } else {
-    snprintf(payload, sizeof(payload),
-      "{\"alert\":\"%s\",\"g\":%.2f,\"gps\":false}",
-      alertType, peakImpactG);
+// ===== Cold Start =====
+// Probe `addr` with an empty write until it ACKs; ms taken, or -1 on timeout
+int32_t waitForDevice(uint8_t addr) {
+  unsigned long start = millis();
+  for (;;) {
+    uint8_t err;
+    WITH_LOCK(Wire) {
+      Wire.beginTransmission(addr);
+      err = Wire.endTransmission();
+    }
+    if (err == 0) return (int32_t)(millis() - start);
+    if (millis() - start >= SENSOR_READY_TIMEOUT_MS) return -1;
+    delay(SENSOR_POLL_MS);
+  }
+}
+
+// UTC, plus the last fix unless stale, as PA1010D aiding; retried from loop()
+// until the RTC is valid (after a power loss: the cloud time sync)
+void aidGps() {
+  if (!Time.isValid()) return;
+  gpsAidPending = false;
+  uint32_t now = (uint32_t)Time.now();
+  const BootRecord& r = boot.record();
+  char body[96];
+  bool pos = r.fixUnix && now - r.fixUnix <= GPS_AID_MAX_AGE_S;
+  bool ok;
+  WITH_LOCK(Wire) {
+    ok = gpsTimeAid(body, sizeof(body), now) && gpsDrain.command(body);
+    if (pos) ok = gpsPositionAid(body, sizeof(body), r, now) && gpsDrain.command(body) && ok;
+  }
+  Serial.printlnf("GPS aided: UTC%s%s", pos ? " + last fix" : "", ok ? "" : " (NACK)");
+}
+
+// Last fix (stamped by the RTC: TinyGPS++ keeps no Unix time) and UTC into
+// retained RAM; with `toFlash` into flash as well
+void keepBootState(bool toFlash) {
+  BootRecord& r = boot.record();
+  if (gps.location.isValid() && gps.location.age() < 2000 && Time.isValid()) {
+    r.fixUnix = (uint32_t)Time.now();
+    r.latE7   = (int32_t)lround(gps.location.lat() * 1e7);
+    r.lonE7   = (int32_t)lround(gps.location.lng() * 1e7);
+    r.altDm   = gps.altitude.isValid() ? (int32_t)lround(gps.altitude.meters() * 10) : 0;
+  }
+  if (Time.isValid()) r.savedUnix = (uint32_t)Time.now();
+  if (!toFlash) {
+    boot.keep();
+    return;
   }
+  if (!boot.save()) Serial.println("Boot state not saved to flash");
+  bootSaved = millis();
+}
 
-  Serial.printlnf("*** ALERT: %s ***", payload);
-  Particle.publish("safety/alert", payload, PRIVATE, WITH_ACK);
+// The open alert into the boot record: every detection in retained RAM, each send
+// to flash as well
+void rememberAlert(bool toFlash) {
+  const CoalescedAlert& a = alerts.current();
+  BootRecord& r = boot.record();
+  uint32_t ageS = (millis() - a.lastMs) / 1000;
+  r.alertUnix      = Time.isValid() ? (uint32_t)Time.now() - ageS : 0;
+  r.alertKind      = a.kind;
+  r.alertPeakMilli = a.peakMilli;
+  r.alertCount     = a.count;
+  r.alertSpanS     = a.spanS();
+  r.alertUpdate    = a.update;
+  if (toFlash) keepBootState(true);
+  else         boot.keep();
+}
 
-  // Reset peak tracker
-  peakImpactG = 0;
+// ===== Alert Trigger Function =====
+// Publish the open alert as it stands: first report, severity step or closing totals
+void publishAlert() {
+  const CoalescedAlert& a = alerts.current();
+  Event e;
+  e.type     = EVENT_ALERT;
+  e.unixTime = (uint32_t)Time.now();
+  a.fill(e);
+  fillPosition(e);
+  bool fall = a.kind == ALERT_FALL;
+  if (a.update) {
+    binlog.log(fall ? LOG_ALERT_UPDATE_FALL : LOG_ALERT_UPDATE_IMPACT, a.update, a.count, a.spanS());
+  } else {
+    binlog.log(fall ? LOG_ALERT_FALL : LOG_ALERT_IMPACT);
+  }
+  publishEvent("safety/alert", e, outbox.ALERT);
+  rememberAlert(true);
 }
 
-// ===== Fall/Impact Detection State Machine =====
-void checkForFallOrImpact() {
-  if (!bno085Ready) return;
+// An alert still inside its window at the reset is reopened and sent again as its
+// next update, and the GPS held at full power for the rest of the alert hold
+void resumeAlert() {
+  const BootRecord& r = boot.record();
+  if (!r.alertUnix || !Time.isValid()) return;
+  uint32_t ageS = (uint32_t)Time.now() - r.alertUnix;
+  if (ageS >= GPS_ALERT_HOLD_MS / 1000) return;
+  unsigned long now = millis();
+  CoalescedAlert a;
+  a.kind      = (AlertKind)r.alertKind;
+  a.peakMilli = r.alertPeakMilli;
+  a.count     = r.alertCount;
+  a.update    = r.alertUpdate;
+  a.lastMs    = r.alertSpanS * 1000UL;   // firstMs 0: carries the span
+  if (alerts.resume(a, now, ageS * 1000UL)) {
+    Serial.printlnf("Alert from %lu s ago reopened", (unsigned long)ageS);
+    publishAlert();
+  }
+  if (GPS_DUTY_CYCLE) gpsPower.alert(now - ageS * 1000UL);
+}
 
+void triggerAlert(AlertKind kind, float peakG) {
   unsigned long now = millis();
 
-  // Track peak g-force during detection events
-  if (accelMagnitude > peakImpactG) {
-    peakImpactG = accelMagnitude;
+  // Positions at full rate for the responders, folded or not
+  if (GPS_DUTY_CYCLE) sendGpsPower(gpsPower.alert(now));
+
+  // Repeats within the window only count, unless they make the alert more severe
+  if (alerts.add(now, kind, toMilliG(peakG)) == AlertCoalescer::FOLDED) {
+    binlog.log(kind == ALERT_FALL ? LOG_FOLDED_FALL : LOG_FOLDED_IMPACT, alerts.current().count);
+    rememberAlert(false);
+    return;
   }
 
-  // Freefall confirmation logic: require sustained low-g before entering freefall state
-  // This prevents false triggers from sensor noise when stationary
-  if (accelMagnitude < FALL_FREEFALL_THRESH_G && stabilityClass == 4) {
-    // Only consider freefall if device was in motion (stabilityClass == 4)
-    if (freefallStartTime == 0) {
-      freefallStartTime = now;
-    } else if ((now - freefallStartTime) >= FREEFALL_CONFIRM_MS && !freefallConfirmed) {
-      freefallConfirmed = true;
-    }
-  } else {
-    // Reset freefall tracking if acceleration is normal
-    if (accelMagnitude >= FALL_FREEFALL_THRESH_G) {
-      freefallStartTime = 0;
-      freefallConfirmed = false;
+  // Flash LED to indicate alert
+  flashAlertLED();
+  publishAlert();
+
+  // Freeze the samples around this alert once the post-alert ones are in
+  if (CAPTURE_ON_ALERT && !capture.trigger((uint32_t)Time.now(), kind)) {
+    binlog.log(LOG_CAPTURE_SKIPPED);
+  }
+}
+
+// Queue the next capture chunk while the outbox is nearly idle, so alerts and
+// positions always go first and a capture never fills the queue
+void uploadCapture() {
+  if (!capture.pending() || millis() - lastCaptureChunk < CAPTURE_CHUNK_PERIOD_MS) return;
+  if (outbox.metrics().depth > 1) return;
+  char text[280];
+  if (!capture.nextChunk(text, sizeof(text))) return;
+  if (outbox.publish("safety/capture", text, outbox.LOCATION)) {
+    capture.sent();
+    lastCaptureChunk = millis();
+    if (!capture.pending()) {
+      const auto& cs = capture.stats();
+      Serial.printlnf("Capture queued: %lu B (raw %lu B) in %lu chunks total",
+                      (unsigned long)cs.bytes, (unsigned long)cs.rawBytes, (unsigned long)cs.chunks);
     }
   }
+}
 
-  switch (detectionState) {
-    case DETECT_IDLE:
-      // Check for sudden high-g impact (push, shove, attack, or fall impact)
-      if (accelMagnitude > IMPACT_THRESHOLD_G) {
-        detectionState = DETECT_IMPACT;
-        stateStartTime = now;
-        peakImpactG = accelMagnitude;
-        Serial.printlnf("IMPACT detected: %.2fg (threshold: %.1fg)", accelMagnitude, IMPACT_THRESHOLD_G);
-
-        // Publish impact detection event
-        char impactPayload[128];
-        snprintf(impactPayload, sizeof(impactPayload),
-          "{\"event\":\"impact_detected\",\"g\":%.2f,\"threshold\":%.1f}",
-          accelMagnitude, IMPACT_THRESHOLD_G);
-        Serial.printlnf("Publishing: %s", impactPayload);
-        Particle.publish("safety/impact_detected", impactPayload, PRIVATE);
-      }
-      // Check for confirmed freefall (sustained low-g while in motion)
-      else if (freefallConfirmed) {
-        detectionState = DETECT_FREEFALL;
-        stateStartTime = now;
-        peakImpactG = 0;
-        Serial.printlnf("FREEFALL confirmed: %.2fg (sustained %lums)", accelMagnitude, FREEFALL_CONFIRM_MS);
-
-        // Publish freefall detection event
-        char freefallPayload[128];
-        snprintf(freefallPayload, sizeof(freefallPayload),
-          "{\"event\":\"freefall_detected\",\"g\":%.2f,\"duration_ms\":%lu}",
-          accelMagnitude, FREEFALL_CONFIRM_MS);
-        Serial.printlnf("Publishing: %s", freefallPayload);
-        Particle.publish("safety/freefall_detected", freefallPayload, PRIVATE);
-      }
+// ===== Fall/Impact Detection =====
+// The state machine lives in FallDetector; this turns its transitions into events
+void checkForFallOrImpact(const DetectorSample& d) {
+  switch (detector.step(d)) {
+    case DETECTOR_IMPACT: {
+      binlog.log(LOG_IMPACT, accelMagnitude, FieldProfile::IMPACT_G, accelWindow.jerkMgPerS() / 1000.0f);
+
+      // Publish impact detection event
+      Event e;
+      e.type           = EVENT_IMPACT;
+      e.unixTime       = (uint32_t)Time.now();
+      e.gMilli         = toMilliG(accelMagnitude);
+      e.thresholdMilli = toMilliG(FieldProfile::IMPACT_G);
+      publishEvent("safety/impact_detected", e, outbox.EVENT);
       break;
-
-    case DETECT_FREEFALL:
-      // If freefall ends with a strong impact, this is a classic fall pattern
-      if (accelMagnitude > IMPACT_THRESHOLD_G) {
-        if ((now - stateStartTime) >= FALL_FREEFALL_MIN_MS) {
-          // Valid fall pattern: freefall followed by impact
-          Serial.printlnf("FALL PATTERN: freefall->impact (%.2fg)", accelMagnitude);
-          peakImpactG = accelMagnitude;
-          detectionState = DETECT_POST_IMPACT;
-          stateStartTime = now;
-        } else {
-          // Freefall too short, treat as regular impact
-          detectionState = DETECT_IMPACT;
-          stateStartTime = now;
-          peakImpactG = accelMagnitude;
-        }
-        freefallConfirmed = false;
-        freefallStartTime = 0;
-      }
-      // Freefall ended normally (no impact) - false alarm, return to idle
-      else if (accelMagnitude >= FALL_FREEFALL_THRESH_G && accelMagnitude <= IMPACT_THRESHOLD_G) {
-        detectionState = DETECT_IDLE;
-        peakImpactG = 0;
-        freefallConfirmed = false;
-        freefallStartTime = 0;
-      }
-      // Timeout: if freefall lasts too long without impact, reset
-      else if ((now - stateStartTime) > 1000) {
-        detectionState = DETECT_IDLE;
-        peakImpactG = 0;
-        freefallConfirmed = false;
-        freefallStartTime = 0;
-      }
+    }
+    case DETECTOR_FREEFALL_START: {
+      binlog.log(LOG_FREEFALL, accelMagnitude, FieldProfile::FREEFALL_CONFIRM_MS);
+
+      // Publish freefall detection event
+      Event e;
+      e.type       = EVENT_FREEFALL;
+      e.unixTime   = (uint32_t)Time.now();
+      e.gMilli     = toMilliG(accelMagnitude);
+      e.durationMs = FieldProfile::FREEFALL_CONFIRM_MS;
+      publishEvent("safety/freefall_detected", e, outbox.EVENT);
       break;
-
-    case DETECT_IMPACT:
-      // Transition to post-impact monitoring
-      detectionState = DETECT_POST_IMPACT;
-      stateStartTime = now;
-      Serial.println("Monitoring post-impact activity...");
+    }
+    case DETECTOR_FALL_PATTERN:
+      binlog.log(LOG_FALL_PATTERN, accelMagnitude);
       break;
-
-    case DETECT_POST_IMPACT:
-      // Check if person remains still after impact (indicates fall/incapacitation)
-      // stabilityClass: 0=unknown, 1=on table, 2=stationary, 3=stable, 4=motion
-      if ((now - stateStartTime) >= POST_IMPACT_STILL_MS) {
-        if (stabilityClass <= 3 && stabilityClass > 0) {
-          // Person is still/stable after impact - likely a fall
-          triggerAlert("fall");
-        } else {
-          // Person resumed movement - likely just an impact/shove
-          triggerAlert("impact");
-        }
-        detectionState = DETECT_IDLE;
-      }
-      // If significant movement detected quickly after impact, it's just a bump
-      else if ((now - stateStartTime) >= 500 && stabilityClass == 4) {
-        // Moving again - just a bump/shove, still alert but as "impact"
-        triggerAlert("impact");
-        detectionState = DETECT_IDLE;
-      }
-      // Timeout safety - return to idle after extended period
-      else if ((now - stateStartTime) > POST_IMPACT_STILL_MS + 2000) {
-        Serial.println("Post-impact timeout, returning to idle");
-        detectionState = DETECT_IDLE;
-        peakImpactG = 0;
-      }
+    case DETECTOR_MONITORING:
+      binlog.log(LOG_MONITORING);
       break;
+    case DETECTOR_TIMEOUT:
+      binlog.log(LOG_POST_TIMEOUT);
+      break;
+    case DETECTOR_ALERT_FALL:   triggerAlert(ALERT_FALL, detector.peakG());   break;
+    case DETECTOR_ALERT_IMPACT: triggerAlert(ALERT_IMPACT, detector.peakG()); break;
+    default: break;
+  }
+
+  // Shadow profile: same samples, log only
+  if (SHADOW_DETECTOR) {
+    DetectorEvent ev = shadowDetector.step(d);
+    if (ev == DETECTOR_ALERT_FALL)   binlog.log(LOG_SHADOW_ALERT_FALL, shadowDetector.peakG());
+    if (ev == DETECTOR_ALERT_IMPACT) binlog.log(LOG_SHADOW_ALERT_IMPACT, shadowDetector.peakG());
   }
 }
 
+// ===== IMU sample consumption (loop) =====
+// Samples leave the ring in batches so |a|^2 runs through the SIMD kernel
+// (common/accel_batch.h), then the detector steps through them in order
+void processImuSamples() {
+  static ImuSample batch[IMU_BATCH_SAMPLES];
+  static AccelXyz xyz[IMU_BATCH_SAMPLES];
+  static uint32_t magSq[IMU_BATCH_SAMPLES];
+  size_t n;
+  do {
+    n = 0;
+    while (n < IMU_BATCH_SAMPLES && imuRing.pop(batch[n])) {
+      xyz[n] = { batch[n].x, batch[n].y, batch[n].z, 0 };
+      n++;
+    }
+    accelMagSqBatch(xyz, magSq, n);
+
+    for (size_t i = 0; i < n; i++) {
+      const ImuSample& s = batch[i];
+      linAccelX = s.x / 256.0f;
+      linAccelY = s.y / 256.0f;
+      linAccelZ = s.z / 256.0f;
+      // Magnitude in g-force (divide by 9.81)
+      accelMagnitude = sqrtf((float)magSq[i]) / 256.0f / 9.81f;
+      stabilityClass = s.stability;
+      postureUp = s.up;
+      accelWindow.push(s.ms, toMilliG(accelMagnitude));
+      if (CAPTURE_ON_ALERT) capture.push(s.ms, s.x, s.y, s.z);
+
+      DetectorSample d;
+      d.ms        = s.ms;
+      d.magSq     = magSq[i];
+      d.stability = s.stability;
+      d.up        = s.up;
+      uint32_t sd = accelWindow.stddevMg();
+      d.spreadMg  = sd < DetectorSample::SPREAD_UNKNOWN ? (uint16_t)sd : DetectorSample::SPREAD_UNKNOWN - 1;
+      checkForFallOrImpact(d);
+    }
+  } while (n == IMU_BATCH_SAMPLES);
+}
+
+// Log each report-rate change with the time spent at every rate so far
+void logImuRate() {
+  ImuRateSnapshot rate = imuRateShared.read();
+  if (rate.switches == imuRateSwitchesLogged) return;
+  imuRateSwitchesLogged = rate.switches;
+  uint32_t now = millis();
+  uint32_t rest = rate.msIn(IMU_RATE_REST, now), active = rate.msIn(IMU_RATE_ACTIVE, now),
+           burst = rate.msIn(IMU_RATE_BURST, now), total = rest + active + burst;
+  if (!total) total = 1;
+  Serial.printlnf("IMU rate -> %s (%lu Hz) | rest %lu%% active %lu%% burst %lu%% of %lu s",
+                  imuRateName(rate.rate), (unsigned long)(1000000UL / rate.intervalUs),
+                  (unsigned long)(rest * 100 / total), (unsigned long)(active * 100 / total),
+                  (unsigned long)(burst * 100 / total), (unsigned long)(total / 1000));
+}
+
 // Helper to convert stability class to human-readable string
 const char* stabilityToString(uint8_t stability) {
   switch (stability) {
@@ -396,37 +732,33 @@ const char* stabilityToString(uint8_t stability) {
   }
 }
 
-// Helper to convert detection state to human-readable string
-const char* detectionStateToString(DetectionState state) {
-  switch (state) {
-    case DETECT_IDLE: return "idle";
-    case DETECT_FREEFALL: return "freefall";
-    case DETECT_IMPACT: return "impact";
-    case DETECT_POST_IMPACT: return "post_impact";
-    default: return "?";
-  }
+// Free heap blocks as text: "n/a" where the allocator does not count them (newlib-nano)
+const char* heapBlocksText(const HeapStats& h, char* buf, size_t size) {
+  if (h.freeBlocks == HEAP_BLOCKS_UNKNOWN) return "n/a";
+  snprintf(buf, size, "%lu", (unsigned long)h.freeBlocks);
+  return buf;
 }
 
 void printOncePerSecondDigest() {
-  if (!DEBUG_GPS && !DEBUG_IMU) return;  // Skip if both disabled
+  if (!DEBUG_GPS && !DEBUG_IMU && !DEBUG_PUBLISH && !DEBUG_TIMING && !DEBUG_HEAP) return;  // Skip if all disabled
 
   Serial.println("\n--- SAFETY MONITOR DIGEST (1 Hz) ---");
 
   // GPS Status
   if (DEBUG_GPS) {
     Serial.println("[GPS]");
-    if (lastGGA.length()) { Serial.print("  GGA> "); Serial.println(lastGGA); }
-    if (lastRMC.length()) { Serial.print("  RMC> "); Serial.println(lastRMC); }
+    if (lastGGA[0]) { Serial.print("  GGA> "); Serial.println(lastGGA); }
+    if (lastRMC[0]) { Serial.print("  RMC> "); Serial.println(lastRMC); }
 
     if (gps.location.isValid()) {
       Serial.printlnf("  Fix: YES  lat: %.6f  lon: %.6f  age(ms): %lu",
-                      gps.location.lat(), gps.location.lng(), gps.location.age());
+                      gps.location.lat(), gps.location.lng(), (unsigned long)gps.location.age());
     } else {
       Serial.println("  Fix: NO   (waiting for satellites)");
     }
 
     if (gps.satellites.isValid()) Serial.printlnf("  Satellites: %u", gps.satellites.value());
-    if (gps.hdop.isValid())       Serial.printlnf("  HDOP: %.2f", gps.hdop.value());
+    if (gps.hdop.isValid())       Serial.printlnf("  HDOP: %.2f", gps.hdop.hdop());
     if (gps.altitude.isValid())   Serial.printlnf("  Alt: %.1f m", gps.altitude.meters());
     if (gps.speed.isValid())      Serial.printlnf("  Speed: %.2f km/h", gps.speed.kmph());
 
@@ -437,8 +769,29 @@ void printOncePerSecondDigest() {
     }
 
     Serial.printlnf("  [Stats] chars=%lu withFix=%lu pass=%lu fail=%lu",
-                    gps.charsProcessed(), gps.sentencesWithFix(),
-                    gps.passedChecksum(), gps.failedChecksum());
+                    (unsigned long)gps.charsProcessed(), (unsigned long)gps.sentencesWithFix(),
+                    (unsigned long)gps.passedChecksum(), (unsigned long)gps.failedChecksum());
+    Serial.printlnf("  [NMEA]  pass=%lu fail=%lu overrun=%lu ringOverflow=%lu",
+                    (unsigned long)nmea.passed, (unsigned long)nmea.failed,
+                    (unsigned long)nmea.overruns, (unsigned long)gpsRingOverflows);
+    const GpsI2cDrain::Stats& ds = gpsDrain.stats();
+    Serial.printlnf("  [I2C]   polls=%lu skipped=%lu chunks=%lu budgetStops=%lu nacks=%lu maxUs=%lu burst=%lums",
+                    (unsigned long)ds.polls, (unsigned long)ds.skipped, (unsigned long)ds.chunks,
+                    (unsigned long)ds.budgetStops, (unsigned long)ds.nacks, (unsigned long)ds.maxPollUs,
+                    (unsigned long)gpsDrain.burstPeriodMs());
+    if (GPS_DUTY_CYCLE) {
+      uint32_t now = millis();
+      const auto& ps = gpsPower.stats();
+      Serial.printlnf("  [Power] %s | s tracking=%lu periodic=%lu standby=%lu | resumes=%lu (alert %lu) "
+                      "ttff last/mean/max=%lu/%lu/%lu ms first=%lu ms",
+                      gpsPowerName(gpsPower.mode()),
+                      (unsigned long)(gpsPower.msIn(GPS_POWER_TRACKING, now) / 1000),
+                      (unsigned long)(gpsPower.msIn(GPS_POWER_PERIODIC, now) / 1000),
+                      (unsigned long)(gpsPower.msIn(GPS_POWER_STANDBY, now) / 1000),
+                      (unsigned long)ps.resumes, (unsigned long)ps.byAlert, (unsigned long)ps.ttffLastMs,
+                      (unsigned long)(ps.fixes ? ps.ttffSumMs / ps.fixes : 0),
+                      (unsigned long)ps.ttffMaxMs, (unsigned long)ps.bootFixMs);
+    }
   }
 
   // IMU Status
@@ -448,99 +801,252 @@ void printOncePerSecondDigest() {
       Serial.printlnf("  Accel: %.2fg (X:%.2f Y:%.2f Z:%.2f m/s²)",
                       accelMagnitude, linAccelX, linAccelY, linAccelZ);
       Serial.printlnf("  Stability: %s (%d)", stabilityToString(stabilityClass), stabilityClass);
-      Serial.printlnf("  Detection: %s | Threshold: %.1fg",
-                      detectionStateToString(detectionState), IMPACT_THRESHOLD_G);
+      Serial.printlnf("  Window: n=%u mean=%.2fg sd=%.2fg peak=%.2fg peakJerk=%.0fg/s low=%lums high=%lums",
+                      accelWindow.count(), accelWindow.meanMg() / 1000.0, accelWindow.stddevMg() / 1000.0,
+                      accelWindow.peakMg() / 1000.0, accelWindow.peakJerkMgPerS() / 1000.0,
+                      (unsigned long)accelWindow.msBelowFreefall(), (unsigned long)accelWindow.msAboveImpact());
+      if (postureUp.known()) {
+        Serial.printlnf("  Up: X:%.2f Y:%.2f Z:%.2f", postureUp.x / 16384.0,
+                        postureUp.y / 16384.0, postureUp.z / 16384.0);
+      } else {
+        Serial.println("  Up: unknown");
+      }
+      Serial.printlnf("  Detection: %s | Threshold: %.1fg | upright vetoes: %lu",
+                      detectorStateName(detector.state()), FieldProfile::IMPACT_G,
+                      (unsigned long)detector.stats().tiltVetoes);
+      if (SHADOW_DETECTOR) {
+        const auto& st = shadowDetector.stats();
+        Serial.printlnf("  Shadow: %s | Threshold: %.1fg | alerts fall=%lu impact=%lu (live %lu/%lu)",
+                        detectorStateName(shadowDetector.state()), ShadowProfile::IMPACT_G,
+                        (unsigned long)st.fallAlerts, (unsigned long)st.impactAlerts,
+                        (unsigned long)detector.stats().fallAlerts,
+                        (unsigned long)detector.stats().impactAlerts);
+      }
+      Serial.printlnf("  Ring: depth=%lu highWater=%lu dropped=%lu",
+                      (unsigned long)imuRing.size(), (unsigned long)imuRing.highWater(),
+                      (unsigned long)imuRing.dropped());
+      if (IMU_ADAPTIVE_RATE) {
+        uint32_t now = millis();
+        ImuRateSnapshot rate = imuRateShared.read();
+        Serial.printlnf("  Rate: %s | s at rest=%lu active=%lu burst=%lu | switches=%lu",
+                        imuRateName(rate.rate),
+                        (unsigned long)(rate.msIn(IMU_RATE_REST, now) / 1000),
+                        (unsigned long)(rate.msIn(IMU_RATE_ACTIVE, now) / 1000),
+                        (unsigned long)(rate.msIn(IMU_RATE_BURST, now) / 1000),
+                        (unsigned long)rate.switches);
+      }
     } else {
       Serial.println("  BNO085: NOT READY");
     }
   }
 
+  // Outbox Status
+  if (DEBUG_PUBLISH) {
+    auto m = outbox.metrics();
+    Serial.println("[PUBLISH]");
+    Serial.printlnf("  Queue: depth=%u highWater=%u enqueued=%lu acked=%lu failed=%lu dropped=%lu shed=%lu",
+                    m.depth, m.highWater, (unsigned long)m.enqueued, (unsigned long)m.acked,
+                    (unsigned long)m.failures, (unsigned long)m.dropped, (unsigned long)m.shed);
+    Serial.printlnf("  Ack ms: last=%lu max=%lu mean=%lu",
+                    (unsigned long)m.ackMsLast, (unsigned long)m.ackMsMax,
+                    (unsigned long)(m.acked ? m.ackMsSum / m.acked : 0));
+    Serial.printlnf("  Queued ms (last/max): alert=%lu/%lu event=%lu/%lu location=%lu/%lu",
+                    (unsigned long)m.queuedMsLast[outbox.ALERT],    (unsigned long)m.queuedMsMax[outbox.ALERT],
+                    (unsigned long)m.queuedMsLast[outbox.EVENT],    (unsigned long)m.queuedMsMax[outbox.EVENT],
+                    (unsigned long)m.queuedMsLast[outbox.LOCATION], (unsigned long)m.queuedMsMax[outbox.LOCATION]);
+    const auto& cs = capture.stats();
+    Serial.printlnf("  Capture: taken=%lu busy=%lu failed=%lu chunks=%lu last=%lu/%lu B pending=%d",
+                    (unsigned long)cs.captures, (unsigned long)cs.busy, (unsigned long)cs.failed,
+                    (unsigned long)cs.chunks, (unsigned long)cs.bytes, (unsigned long)cs.rawBytes,
+                    capture.pending());
+    const auto& js = journal.stats();
+    uint32_t lo, hi;
+    journal.eraseCounts(lo, hi);
+    Serial.printlnf("  Journal: backlog=%lu appended=%lu replayed=%lu lost=%lu rescued=%lu "
+                    "bytes=%lu/%lu erases=%lu-%lu",
+                    (unsigned long)journal.backlog(), (unsigned long)js.appended,
+                    (unsigned long)js.replayed, (unsigned long)js.overwritten, (unsigned long)js.rescued,
+                    (unsigned long)js.payloadBytes, (unsigned long)js.writtenBytes,
+                    (unsigned long)lo, (unsigned long)hi);
+  }
+
+  // Stage timing: cumulative since boot, histogram buckets < 32 us, < 64 us, ...
+  if (DEBUG_TIMING) {
+    Serial.println("[TIMING]");
+    for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+      const LoopTiming::Stage& st = timing.stage(i);
+      Serial.printf("  %-7s n=%lu last=%lu mean=%lu max=%lu us over %lu us: %lu |",
+                    st.name, (unsigned long)st.count, (unsigned long)st.lastUs,
+                    (unsigned long)st.meanUs(), (unsigned long)st.maxUs, (unsigned long)st.budgetUs,
+                    (unsigned long)st.misses);
+      for (uint8_t b = 0; b < STAGE_BUCKETS; b++) Serial.printf(" %lu", (unsigned long)st.hist[b]);
+      Serial.println();
+    }
+  }
+
+  // Heap: used and free blocks should stay put once running; churn counts the checks
+  // (one per publish) that saw them move
+  if (DEBUG_HEAP) {
+    const HeapStats& h = heap.last();
+    char blocks[12];
+    Serial.println("[HEAP]");
+    Serial.printlnf("  used=%lu peak=%lu free=%lu freeBlocks=%s churn=%lu/%lu",
+                    (unsigned long)h.usedBytes, (unsigned long)heap.peakBytes(), (unsigned long)h.freeBytes,
+                    heapBlocksText(h, blocks, sizeof(blocks)),
+                    (unsigned long)heap.churn(), (unsigned long)heap.checks());
+  }
+
   Serial.println("------------------------------------");
 }
 
-static inline void jsonNumberOrNull(char* out, size_t outSz, double v, int decimals) {
-  if (std::isnan(v)) snprintf(out, outSz, "null");
-  else               snprintf(out, outSz, "%.*f", decimals, v);
+// Stage timings as compact text (common/stage_timer.h) for the "diag" variable,
+// also queued as "safety/diag" when `send`
+void publishDiagnostics(bool send) {
+  if (!timing.format(diagText, sizeof(diagText), millis() / 1000)) return;
+  // Best effort: not journalled, and kept out of a full outbox
+  if (!send || !Particle.connected() || outbox.metrics().depth >= OUTBOX_SLOTS) return;
+  if (outbox.publish("safety/diag", diagText, outbox.DIAG)) lastDiagPub = millis();
 }
 
 void setup() {
   Serial.begin(115200);
+  Wire.setSpeed(CLOCK_SPEED_400KHZ); // BNO085 and PA1010D both support fast mode
   Wire.begin(); // SDA=D0, SCL=D1
-  delay(1200);
+  static const char* const sources[] = { "none", "retained RAM", "flash" };
+  BootState::Source src = boot.begin();
+  Serial.printlnf("Boot %lu: saved state from %s", (unsigned long)boot.record().boots, sources[src]);
 
   // Setup LED for alerts
   pinMode(D7, OUTPUT);
   digitalWrite(D7, LOW);
 
+  // Start the cloud sender thread before anything can raise an alert
+  outbox.begin();
+  Particle.variable("diag", diagText);
+  if (!journal.begin()) Serial.println("Flash journal unavailable: offline events will be lost");
+  else if (journal.backlog()) Serial.printlnf("Journal: %lu events to replay", (unsigned long)journal.backlog());
+
   Serial.println("\n=== GPS + IMU Fall Safety Monitor ===");
   Serial.println("GPS: PA1010D (I2C 0x10)");
   Serial.println("IMU: BNO085 (I2C 0x4A)");
   Serial.println("Wiring: VIN->3V3, GND->GND, SDA->D0, SCL->D1");
-  Serial.printlnf("Impact threshold: %.1fg", IMPACT_THRESHOLD_G);
+  Serial.printlnf("Impact threshold: %.1fg", FieldProfile::IMPACT_G);
   Serial.println("Digest logs once per second; publish every 30 s.\n");
+  binlog.log(LOG_BOOT, LOG_CATALOG_HASH, LOG_ID_COUNT);
 
-  // Initialize BNO085 IMU
+  // Initialize BNO085 IMU as soon as it answers its address
   Serial.print("Initializing BNO085... ");
-  if (!bno08x.begin_I2C(BNO085_I2C_ADDR, &Wire)) {
+  int32_t imuWait = waitForDevice(BNO085_I2C_ADDR);
+  if (imuWait < 0 || !bno08x.begin_I2C(BNO085_I2C_ADDR, &Wire)) {
     Serial.println("FAILED! Check wiring.");
     bno085Ready = false;
   } else {
-    Serial.println("OK");
+    Serial.printlnf("OK after %ld ms", (long)imuWait);
     bno085Ready = true;
 
     // Enable sensor reports
-    // Linear acceleration (gravity removed) at 100Hz for impact detection
-    if (!bno08x.enableReport(SH2_LINEAR_ACCELERATION, 10000)) {
+    // Linear acceleration (gravity removed) at 100Hz for impact detection; the
+    // IMU thread moves it between 20 and 200 Hz with activity
+    if (!bno08x.enableReport(SH2_LINEAR_ACCELERATION, IMU_ACTIVE_US)) {
       Serial.println("  WARNING: Could not enable linear acceleration report");
     }
     // Stability classifier at 20Hz for post-impact stillness detection
     if (!bno08x.enableReport(SH2_STABILITY_CLASSIFIER, 50000)) {
       Serial.println("  WARNING: Could not enable stability classifier");
     }
-    Serial.println("  IMU reports enabled: LINEAR_ACCEL, STABILITY");
+    // Orientation at 20Hz for the post-impact posture check; gravity covers for
+    // the rotation vector if it stops
+    if (!bno08x.enableReport(SH2_GAME_ROTATION_VECTOR, ORIENTATION_PERIOD_US)) {
+      Serial.println("  WARNING: Could not enable game rotation vector");
+    }
+    if (!bno08x.enableReport(SH2_GRAVITY, ORIENTATION_PERIOD_US)) {
+      Serial.println("  WARNING: Could not enable gravity report");
+    }
+    Serial.println("  IMU reports enabled: LINEAR_ACCEL, STABILITY, GAME_ROTATION, GRAVITY");
+
+    // From here on the bus is shared with the IMU thread: hold WITH_LOCK(Wire)
+    imuThread = new Thread("imu", imuSampler, OS_THREAD_PRIORITY_DEFAULT + 1);
   }
+  resumeAlert();
+
+  // The GPS streams NMEA once it answers; aid it with the time and last fix
+  int32_t gpsWait = waitForDevice(GPS_I2C_ADDR);
+  if (gpsWait < 0) Serial.println("PA1010D not answering");
+  else             Serial.printlnf("PA1010D ready after %ld ms", (long)gpsWait);
+  aidGps();
+
+  // Baseline for the heap checks: everything allocated from here on is churn
+  heap.check();
 }
 
 void loop() {
-  // Poll sensors
-  pollGpsI2C();
-  pollBNO085();
+  uint32_t passStart = System.ticks();
+
+  // Poll GPS; the IMU thread samples the BNO085 on its own cadence
+  {
+    LoopTiming::Scope t(timing, STAGE_GPS);
+    pollGpsI2C();
+    if (GPS_DUTY_CYCLE) manageGpsPower();
+    if (gpsAidPending) aidGps();
+    if (!gpsFirstFix && gps.location.isValid()) {
+      gpsFirstFix = millis();
+      gpsAidPending = false;
+      Serial.printlnf("First fix %lu ms after power-on", gpsFirstFix);
+    }
+  }
+
+  // Run fall/impact detection over every sample queued since the last pass
+  {
+    LoopTiming::Scope t(timing, STAGE_DETECT);
+    processImuSamples();
+  }
+
+  // Closing totals of an alert that folded detections since it was last sent
+  if (alerts.expire(millis())) publishAlert();
+  replayJournal();
+
+  // Upload the last alert's IMU capture in the background
+  {
+    LoopTiming::Scope t(timing, STAGE_CAPTURE);
+    uploadCapture();
+  }
 
-  // Run fall/impact detection state machine
-  checkForFallOrImpact();
+  // Note every report-rate change made by the IMU thread
+  if (IMU_ADAPTIVE_RATE) logImuRate();
 
   // Print diagnostic digest once per second
   if (millis() - lastDiag >= DIAG_PRINT_PERIOD_MS) {
+    LoopTiming::Scope t(timing, STAGE_DIGEST);
     lastDiag = millis();
     printOncePerSecondDigest();
   }
 
   if (millis() - lastPub >= PUBLISH_PERIOD_MS) {
+    LoopTiming::Scope t(timing, STAGE_PUBLISH);
     lastPub = millis();
 
-    if (gps.location.isValid()) {
-      double lat  = gps.location.lat();
-      double lon  = gps.location.lng();
-      double alt  = gps.altitude.isValid() ? gps.altitude.meters() : NAN;
-      double hdop = gps.hdop.isValid()     ? gps.hdop.value()      : NAN;
-      double spd  = gps.speed.isValid()    ? gps.speed.kmph()      : NAN;
-      uint32_t sats = gps.satellites.isValid() ? gps.satellites.value() : 0;
-
-      char alt_s[16], hdop_s[16], spd_s[16];
-      jsonNumberOrNull(alt_s,  sizeof(alt_s),  alt,  1);
-      jsonNumberOrNull(hdop_s, sizeof(hdop_s), hdop, 1);
-      jsonNumberOrNull(spd_s,  sizeof(spd_s),  spd,  1);
-
-      char payload[220];
-      snprintf(payload, sizeof(payload),
-        "{\"fix\":true,\"lat\":%.6f,\"lon\":%.6f,\"alt_m\":%s,\"hdop\":%s,\"spd_kmph\":%s,\"sats\":%u}",
-        lat, lon, alt_s, hdop_s, spd_s, sats);
-
-      Serial.printlnf("Publish: %s", payload);
-      Particle.publish("gps/position", payload, PRIVATE, WITH_ACK);
-    } else {
-      Serial.println("Publish: {\"fix\":false}");
-      Particle.publish("gps/position", "{\"fix\":false}", PRIVATE, WITH_ACK);
+    Event e;
+    e.type     = EVENT_LOCATION;
+    e.unixTime = (uint32_t)Time.now();
+    fillPosition(e);
+    if (e.hasFix) {
+      if (gps.altitude.isValid()) e.altDm       = (int32_t)lround(gps.altitude.meters() * 10);
+      if (gps.hdop.isValid())     e.hdopX100    = (uint16_t)gps.hdop.value();
+      if (gps.speed.isValid())    e.speedKmhX10 = (uint16_t)lround(gps.speed.kmph() * 10);
+    }
+    publishEvent("gps/position", e, outbox.LOCATION);
+    publishDiagnostics(millis() - lastDiagPub >= DIAG_PUBLISH_PERIOD_MS);
+    keepBootState(millis() - bootSaved >= BOOT_SAVE_PERIOD_MS);
+    if (heap.check()) {
+      const HeapStats& h = heap.last();
+      char blocks[12];
+      Serial.printlnf("Heap moved: used %lu B (peak %lu), %lu B free in %s blocks",
+                      (unsigned long)h.usedBytes, (unsigned long)heap.peakBytes(), (unsigned long)h.freeBytes,
+                      heapBlocksText(h, blocks, sizeof(blocks)));
     }
   }
+  timing.record(STAGE_LOOP, System.ticks() - passStart);
+
+  // Idle: the deferred log goes out once no samples are waiting
+  if (imuRing.size() == 0) binlog.drain(Serial, LOG_DRAIN_RECORDS, LOG_RAW_FRAMES);
 }
\ No newline at end of file